@@ -15,6 +15,7 @@ const SdlSdk = @import("vendor/SDL.zig/Sdk.zig");
 const AndroidSdk = @import("vendor/ZigAndroidTemplate/Sdk.zig");
 const TemplateStep = @import("vendor/ztt/src/TemplateStep.zig");
 const NFD = @import("vendor/nfd/build.zig");
+const LayoutCompiler = @import("tools/layout-compiler.zig");
 
 pub const Platform = union(enum) {
     desktop: std.zig.CrossTarget,
@@ -148,6 +149,18 @@ pub fn getLibraryPackage(sdk: *Sdk, name: []const u8) std.build.Pkg {
     return sdk.builder.dupePkg(pkg);
 }
 
+/// Compiles the `.layout` template `file` into a package called `name`. The package exports a struct
+/// that creates the widget and layout trees without parsing or allocating, see `tools/layout-compiler.zig`.
+/// `dependencies` must provide the packages `zero-ui` and `layout-engine`.
+pub fn createLayoutPackage(sdk: *Sdk, name: []const u8, file: std.build.FileSource, dependencies: []const std.build.Pkg) std.build.Pkg {
+    const compile_step = CompileLayoutStep.create(sdk, file);
+    return sdk.builder.dupePkg(std.build.Pkg{
+        .name = name,
+        .source = compile_step.getOutputSource(),
+        .dependencies = dependencies,
+    });
+}
+
 pub fn createApplication(sdk: *Sdk, name: []const u8, root_file: []const u8) *Application {
     return createApplicationSource(sdk, name, .{ .path = root_file });
 }
@@ -556,6 +569,52 @@ const CreateAppMetaStep = struct {
     }
 };
 
+const CompileLayoutStep = struct {
+    step: std.build.Step,
+
+    sdk: *Sdk,
+    source: std.build.FileSource,
+
+    outfile: std.build.GeneratedFile,
+
+    pub fn create(sdk: *Sdk, source: std.build.FileSource) *CompileLayoutStep {
+        const ms = sdk.builder.allocator.create(CompileLayoutStep) catch @panic("out of memory");
+        ms.* = CompileLayoutStep{
+            .step = std.build.Step.init(.custom, "Compile layout template", sdk.builder.allocator, make),
+
+            .sdk = sdk,
+            .source = source.dupe(sdk.builder),
+
+            .outfile = std.build.GeneratedFile{ .step = &ms.step },
+        };
+        source.addStepDependencies(&ms.step);
+        return ms;
+    }
+
+    pub fn getOutputSource(self: *CompileLayoutStep) std.build.FileSource {
+        return std.build.FileSource{ .generated = &self.outfile };
+    }
+
+    fn make(step: *std.build.Step) !void {
+        const self = @fieldParentPtr(CompileLayoutStep, "step", step);
+
+        const path = self.source.getPath(self.sdk.builder);
+        const source = try std.fs.cwd().readFileAlloc(self.sdk.builder.allocator, path, 1 << 20);
+        defer self.sdk.builder.allocator.free(source);
+
+        var file_data = std.ArrayList(u8).init(self.sdk.builder.allocator);
+        defer file_data.deinit();
+
+        try LayoutCompiler.compile(self.sdk.builder.allocator, source, path, file_data.writer());
+
+        var cache = CacheBuilder.init(self.sdk.builder, "zero-graphics");
+        cache.addBytes(file_data.items);
+
+        const file_name = try std.mem.concat(self.sdk.builder.allocator, u8, &.{ std.fs.path.stem(path), ".zig" });
+        self.outfile.path = try cache.createSingleFile(file_name, file_data.items);
+    }
+};
+
 const CreateApplicationHtmlPageStep = struct {
     step: std.build.Step,
 
@@ -693,7 +752,7 @@ const CacheBuilder = struct {
     }
 };
 
-fn createScintilla(b: *std.build.Builder) *std.build.LibExeObjStep {
+pub fn createScintilla(b: *std.build.Builder) *std.build.LibExeObjStep {
     const lib = b.addStaticLibrary("scintilla", null);
     lib.setBuildMode(.ReleaseSafe);
     lib.addCSourceFiles(&scintilla_sources, &scintilla_flags);
@@ -7,6 +7,7 @@ pub fn build(b: *std.build.Builder) !void {
     const enable_android = b.option(bool, "enable-android", "Enables android build support. Requires the android sdk and ndk to be installed.") orelse false;
 
     const app_only_step = b.step("app", "Builds only the desktop application");
+    const test_step = b.step("test", "Runs the unit tests");
 
     const sdk = Sdk.init(b, enable_android);
     const assimp = Assimp.init(b);
@@ -54,16 +55,203 @@ pub fn build(b: *std.build.Builder) !void {
             .name = "z3d",
             .source = .{ .path = "src/rendering/z3d-format.zig" },
         });
+        converter.addPackage(std.build.Pkg{
+            .name = "zani",
+            .source = .{ .path = "src/rendering/zani-format.zig" },
+        });
         converter.addPackage(std.build.Pkg{
             .name = "args",
             .source = .{ .path = "vendor/args/args.zig" },
         });
+        converter.addPackage(std.build.Pkg{
+            .name = "zigimg",
+            .source = .{ .path = "vendor/zigimg/zigimg.zig" },
+        });
         converter.linkLibC();
         converter.linkLibCpp();
         assimp.addTo(converter, .static, Assimp.FormatSet.default);
         converter.install();
     }
 
+    {
+        const layout_compiler_tests = b.addTest("tools/layout-compiler.zig");
+        test_step.dependOn(&layout_compiler_tests.step);
+    }
+
+    {
+        const atlas_tests = b.addTest("tools/zero-convert/atlas.zig");
+        atlas_tests.addPackage(std.build.Pkg{
+            .name = "zigimg",
+            .source = .{ .path = "vendor/zigimg/zigimg.zig" },
+        });
+        test_step.dependOn(&atlas_tests.step);
+    }
+
+    {
+        // Each file is its own test root, so no test depends on being reachable from another one.
+        const src_test_files = [_][]const u8{
+            "src/Input.zig",
+            "src/RedrawScheduler.zig",
+            "src/UserInterface.zig",
+            "src/gl_es_2v0.zig",
+            "src/rendering/ResourceManager.zig",
+            "src/rendering/Renderer3D.zig",
+            "src/rendering/StaticBatch.zig",
+            "src/rendering/bvh.zig",
+            "src/rendering/frustum.zig",
+            "src/rendering/occlusion.zig",
+            "src/rendering/parallel.zig",
+            "src/rendering/skinning.zig",
+            "src/rendering/z3d-format.zig",
+            "src/ui/core/HitGrid.zig",
+            "src/ui/core/MemoryPool.zig",
+            "src/ui/core/RingBuffer.zig",
+            "src/ui/core/TextBuffer.zig",
+            "src/ui/core/View.zig",
+            "src/ui/standard-controls/RowIndex.zig",
+            "src/ui/standard-controls/TreeView.zig",
+            "src/ui/standard-layout/standard-layout.zig",
+        };
+
+        const zero_g_pkg = sdk.getLibraryPackage("zero-graphics");
+        const controls_pkg = std.build.Pkg{
+            .name = "controls",
+            .source = .{ .path = "src/ui/standard-controls/standard-controls.zig" },
+            .dependencies = &.{
+                .{
+                    .name = "ui",
+                    .source = .{ .path = "src/ui/core/ui.zig" },
+                    .dependencies = &.{zero_g_pkg},
+                },
+                .{
+                    .name = "TextEditor",
+                    .source = .{ .path = "vendor/text-editor/src/TextEditor.zig" },
+                    .dependencies = &.{
+                        .{
+                            .name = "ziglyph",
+                            .source = .{ .path = "vendor/ziglyph/src/ziglyph.zig" },
+                        },
+                    },
+                },
+            },
+        };
+        const ui_pkg = std.build.Pkg{
+            .name = "ui",
+            .source = .{ .path = "src/ui/core/ui.zig" },
+            .dependencies = &.{ zero_g_pkg, controls_pkg },
+        };
+
+        for (src_test_files) |path| {
+            const tests = b.addTest(path);
+            tests.setBuildMode(mode);
+            tests.main_pkg_path = "src";
+            tests.addPackage(zero_g_pkg);
+            for (zero_g_pkg.dependencies.?) |dep| {
+                tests.addPackage(dep);
+            }
+            tests.addPackage(controls_pkg);
+            tests.addPackage(ui_pkg);
+
+            // the renderers import stb_truetype
+            tests.addIncludePath("vendor/stb");
+            tests.addCSourceFile("src/rendering/stb_truetype.c", &[_][]const u8{"-std=c99"});
+            tests.linkLibC();
+
+            test_step.dependOn(&tests.step);
+        }
+    }
+
+    {
+        const bvh_bench = b.addExecutable("bvh-bench", "tools/bvh-bench.zig");
+        bvh_bench.setBuildMode(.ReleaseFast);
+        bvh_bench.addPackage(std.build.Pkg{
+            .name = "bvh",
+            .source = .{ .path = "src/rendering/bvh.zig" },
+        });
+
+        const run_bench = bvh_bench.run();
+        const bench_step = b.step("bench-bvh", "Benchmarks building and ray casting the bounding volume hierarchy");
+        bench_step.dependOn(&run_bench.step);
+    }
+
+    {
+        const z3d_bench = b.addExecutable("z3d-bench", "tools/z3d-bench.zig");
+        z3d_bench.setBuildMode(.ReleaseFast);
+        z3d_bench.addPackage(sdk.getLibraryPackage("zero-graphics"));
+        z3d_bench.addPackage(std.build.Pkg{
+            .name = "z3d",
+            .source = .{ .path = "src/rendering/z3d-format.zig" },
+        });
+
+        const run_bench = z3d_bench.run();
+        const bench_step = b.step("bench-z3d", "Benchmarks loading a large z3d model with and without copying its data");
+        bench_step.dependOn(&run_bench.step);
+    }
+
+    {
+        const skinning_bench = b.addExecutable("skinning-bench", "tools/skinning-bench.zig");
+        skinning_bench.setBuildMode(.ReleaseFast);
+        skinning_bench.addPackage(sdk.getLibraryPackage("zero-graphics"));
+
+        const run_bench = skinning_bench.run();
+        const bench_step = b.step("bench-skinning", "Benchmarks skinning a large mesh on the CPU");
+        bench_step.dependOn(&run_bench.step);
+    }
+
+    {
+        const ui_bench = b.addExecutable("ui-bench", "tools/ui-bench.zig");
+        ui_bench.setBuildMode(.ReleaseFast);
+        ui_bench.addPackage(sdk.getLibraryPackage("zero-graphics"));
+
+        const run_bench = ui_bench.run();
+        const bench_step = b.step("bench-ui", "Benchmarks widget lookup and hit testing in the immediate mode user interface");
+        bench_step.dependOn(&run_bench.step);
+    }
+
+    {
+        const layout_bench = b.addExecutable("layout-bench", "tools/layout-bench.zig");
+        layout_bench.setBuildMode(.ReleaseFast);
+        layout_bench.addPackage(std.build.Pkg{
+            .name = "layout-engine",
+            .source = .{ .path = "src/ui/standard-layout/standard-layout.zig" },
+            .dependencies = &.{
+                .{
+                    .name = "ui",
+                    .source = .{ .path = "src/ui/core/ui.zig" },
+                    .dependencies = &.{sdk.getLibraryPackage("zero-graphics")},
+                },
+            },
+        });
+
+        const run_bench = layout_bench.run();
+        const bench_step = b.step("bench-layout", "Benchmarks a full layout against an incremental relayout");
+        bench_step.dependOn(&run_bench.step);
+    }
+
+    {
+        const occlusion_bench = b.addExecutable("occlusion-bench", "tools/occlusion-bench.zig");
+        occlusion_bench.setBuildMode(.ReleaseFast);
+        occlusion_bench.addPackage(std.build.Pkg{
+            .name = "occlusion",
+            .source = .{ .path = "src/rendering/occlusion.zig" },
+        });
+
+        const run_bench = occlusion_bench.run();
+        const bench_step = b.step("bench-occlusion", "Benchmarks rasterizing occluders and culling boxes behind them");
+        bench_step.dependOn(&run_bench.step);
+    }
+
+    {
+        const scintilla_bench = b.addExecutable("scintilla-bench", "tools/scintilla-bench.zig");
+        scintilla_bench.setBuildMode(.ReleaseFast);
+        scintilla_bench.addIncludePath("src/scintilla");
+        scintilla_bench.linkLibrary(Sdk.createScintilla(b));
+
+        const run_bench = scintilla_bench.run();
+        const bench_step = b.step("bench-scintilla", "Benchmarks laying out a 100k line file through the Scintilla bridge");
+        bench_step.dependOn(&run_bench.step);
+    }
+
     const app = sdk.createApplication("demo_application", "examples/features/feature-demo.zig");
     app.setDisplayName("ZeroGraphics Demo");
     app.setPackageName("net.random_projects.zero_graphics.demo");
@@ -152,16 +340,23 @@ pub fn build(b: *std.build.Builder) !void {
             },
         };
 
+        const layout_engine_pkg = std.build.Pkg{
+            .name = "layout-engine",
+            .source = .{ .path = "src/ui/standard-layout/standard-layout.zig" },
+            .dependencies = &.{zero_ui_pkg},
+        };
+
         const ui_demo = sdk.createApplication("ui_demo", "examples/ui/demo.zig");
         ui_demo.setDisplayName("Zero UI");
         ui_demo.setPackageName("net.random_projects.zero_graphics.ui_demo");
         ui_demo.setBuildMode(mode);
         ui_demo.addPackage(zero_ui_pkg);
-        ui_demo.addPackage(.{
-            .name = "layout-engine",
-            .source = .{ .path = "src/ui/standard-layout/standard-layout.zig" },
-            .dependencies = &.{zero_ui_pkg},
-        });
+        ui_demo.addPackage(layout_engine_pkg);
+        ui_demo.addPackage(sdk.createLayoutPackage(
+            "login-window",
+            .{ .path = "design/ui/login-window.layout" },
+            &.{ zero_ui_pkg, layout_engine_pkg },
+        ));
         ui_demo.addPackage(.{
             .name = "render-engine",
             .source = .{ .path = "src/ui/standard-renderer/standard-renderer.zig" },
@@ -105,6 +105,7 @@ pub fn init(app: *Application) !void {
     app.mesh = try core().resources.createGeometry(ResourceManager.Z3DGeometry(TextureLoader){
         .data = @embedFile("twocubes.z3d"),
         .loader = .{},
+        .borrow_data = true, // embedded data lives forever
     });
 
     try app.editor_data.init();
@@ -298,6 +299,12 @@ pub fn update(app: *Application) !bool {
                     return null;
                 }
 
+                /// The lines move all the time, so ask for about 60 frames per second.
+                pub fn redraw(self: zero_graphics.UserInterface.CustomWidget) zero_graphics.UserInterface.CustomWidget.Redraw {
+                    _ = self;
+                    return .{ .after = 16 };
+                }
+
                 pub fn draw(self: zero_graphics.UserInterface.CustomWidget, rectangle: zero_graphics.Rectangle, painter: *Renderer, info: zero_graphics.UserInterface.CustomWidget.DrawInfo) Renderer.DrawError!void {
                     _ = self;
                     _ = info;
@@ -346,6 +353,7 @@ pub fn update(app: *Application) !bool {
             _ = try ui.custom(.{ .x = 370, .y = 200, .width = 80, .height = 80 }, null, .{
                 .draw = CustomWidget.draw,
                 .process_event = CustomWidget.update,
+                .redraw = CustomWidget.redraw,
             });
         }
 
@@ -16,6 +16,7 @@ const zero_graphics = @import("zero-graphics");
 const zero_ui = @import("zero-ui");
 const layout_engine = @import("layout-engine");
 const render_engine = @import("render-engine");
+const LoginWindow = @import("login-window");
 
 const logger = std.log.scoped(.ui_demo);
 
@@ -23,8 +24,10 @@ const core = zero_graphics.CoreApplication.get;
 
 const Application = @This();
 
-core_view: zero_ui.View = undefined,
-widget_pool: zero_ui.MemoryPool(zero_ui.Widget) = undefined,
+/// The login window, generated from `design/ui/login-window.layout`.
+login_window: LoginWindow = .{},
+close_button: zero_ui.Widget = undefined,
+layout_tree: layout_engine.Tree,
 
 renderer2d: zero_graphics.Renderer2D,
 gui_renderer: render_engine.Renderer,
@@ -39,15 +42,15 @@ pub fn init(app: *Application) !void {
     app.* = Application{
         .renderer2d = undefined,
         .gui_renderer = undefined,
+        .layout_tree = layout_engine.Tree.init(core().allocator),
     };
+    errdefer app.layout_tree.deinit();
 
     logger.info("available controls:", .{});
     for (std.enums.values(zero_ui.controls.ClassID)) |class_id| {
         logger.info("- {s}", .{@tagName(class_id)});
     }
 
-    app.printWidgetTree();
-
     app.renderer2d = try core().resources.createRenderer2D();
     errdefer app.renderer2d.deinit();
 
@@ -82,99 +85,53 @@ pub fn init(app: *Application) !void {
     //
     //
 
-    var password_box: *zero_ui.Widget = undefined;
-
-    const ui_data = blk: {
-        var builder = zero_ui.Builder.begin(core().allocator);
-        errdefer builder.cancel();
-
-        _ = try builder.add(.{
-            .Button = .{ .text = "X", .on_click = .{
-                .id = events.close_app,
-            } },
-        });
-        builder.current().setBounds(.{ .x = 10, .y = 10, .width = 30, .height = 30 });
-
-        _ = try builder.add(.{
-            .Panel = .{},
-        });
-        builder.current().setBounds(.{ .x = (480 - 318) / 2, .y = (320 - 284) / 2, .width = 318, .height = 284 });
-
-        {
-            try builder.enter();
-            defer builder.leave();
-
-            _ = try builder.add(.{
-                .Picture = .{
-                    .image = app_logo,
-                },
-            });
-            builder.current().setBounds(.{ .x = 126, .y = 13, .width = 66, .height = 67 });
-
-            _ = try builder.add(.{
-                .Label = .{
-                    .text = "Username:",
-                    .vertical_alignment = .center,
-                    .horizontal_alignment = .right,
-                },
-            });
-            builder.current().setBounds(.{ .x = 41, .y = 95, .width = 75, .height = 42 });
-
-            _ = try builder.add(.{
-                .TextBox = .{},
-            });
-            builder.current().setBounds(.{ .x = 120, .y = 95, .width = 157, .height = 42 });
-
-            _ = try builder.add(.{
-                .Label = .{
-                    .text = "Password:",
-                    .vertical_alignment = .center,
-                    .horizontal_alignment = .right,
-                },
-            });
-            builder.current().setBounds(.{ .x = 41, .y = 153, .width = 75, .height = 42 });
-
-            password_box = try builder.add(.{
-                .TextBox = .{},
-            });
-            builder.current().setBounds(.{ .x = 120, .y = 153, .width = 157, .height = 42 });
-
-            _ = try builder.add(.{
-                .Button = .{ .text = "Cancel", .on_click = .{
-                    .id = events.cancel,
-                } },
-            });
-            builder.current().setBounds(.{ .x = 15, .y = 208, .width = 115, .height = 31 });
-
-            _ = try builder.add(.{
-                .Button = .{ .text = "Login", .on_click = .{
-                    .id = events.login,
-                } },
-            });
-            builder.current().setBounds(.{ .x = 190, .y = 208, .width = 115, .height = 31 });
-        }
+    const login = &app.login_window;
+    login.init();
 
-        break :blk builder.finish();
+    login.widget(.company_logo).control.Picture.image = app_logo;
+    login.widget(.password).control.TextBox.flags.password = true;
+    login.widget(.cancel_button).control.Button.on_click = .{ .id = events.cancel };
+    login.widget(.login_button).control.Button.on_click = .{ .id = events.login };
+
+    // the close button is placed by hand, on top of the template
+    app.close_button = .{
+        .bounds = .{ .position = zero_ui.Point.new(10, 10), .size = zero_ui.Size.new(30, 30) },
+        .control = .{ .Button = .{ .text = "X", .on_click = .{ .id = events.close_app } } },
     };
+    login.view.widgets.append(&app.close_button.siblings);
+
+    try app.layout_tree.build(login.nodes[0]);
 
-    app.core_view = ui_data.view;
-    app.widget_pool = ui_data.memory;
-    errdefer app.widget_pool.deinit();
+    try login.view.init(core().allocator);
+    errdefer login.view.deinit();
 
-    try app.core_view.init(core().allocator);
+    app.updateLayout();
+
+    app.printWidgetTree();
+}
+
+pub fn resize(app: *Application, width: u15, height: u15) !void {
+    _ = width;
+    _ = height;
+    app.updateLayout();
+}
 
-    try password_box.control.TextBox.setText("****");
+/// Layouts the login window into the screen and refreshes the absolute widget positions.
+fn updateLayout(app: *Application) void {
+    app.layout_tree.update(zero_ui.Rectangle.new(zero_ui.Point.zero, core().screen_size));
+    app.login_window.view.updateAbsolutePositions();
 }
 
 pub fn deinit(app: *Application) void {
+    app.login_window.view.deinit();
+    app.layout_tree.deinit();
     app.gui_renderer.deinit();
     app.renderer2d.deinit();
-    app.widget_pool.deinit();
     app.* = undefined;
 }
 
 fn printWidgetTree(app: *Application) void {
-    return printWidgetTreeInner(app, app.core_view.widgets, 0);
+    return printWidgetTreeInner(app, app.login_window.view.widgets, 0);
 }
 fn printWidgetTreeInner(app: *Application, list: zero_ui.Widget.List, depth: usize) void {
     var out = std.io.getStdOut().writer();
@@ -194,19 +151,19 @@ pub fn update(app: *Application) !bool {
     while (core().input.fetch()) |event| {
         switch (event) {
             .quit => return false,
-            .pointer_motion => |pos| app.core_view.pushInput(.{ .mouse_motion = pos }),
-            .pointer_press => |btn| app.core_view.pushInput(.{ .mouse_button_down = btn }),
-            .pointer_release => |btn| app.core_view.pushInput(.{ .mouse_button_up = btn }),
-            .text_input => |input| app.core_view.pushInput(.{ .text_input = input.text }),
+            .pointer_motion => |pos| app.login_window.view.pushInput(.{ .mouse_motion = pos }),
+            .pointer_press => |btn| app.login_window.view.pushInput(.{ .mouse_button_down = btn }),
+            .pointer_release => |btn| app.login_window.view.pushInput(.{ .mouse_button_up = btn }),
+            .text_input => |input| app.login_window.view.pushInput(.{ .text_input = input.text }),
             .key_down => |key| if (key.scancode == .escape) {
                 return false;
             } else {
-                app.core_view.pushInput(.{ .key_down = .{ .scancode = @enumToInt(key.scancode), .key = key.scancode, .modifiers = key.modifiers } });
+                app.login_window.view.pushInput(.{ .key_down = .{ .scancode = @enumToInt(key.scancode), .key = key.scancode, .modifiers = key.modifiers } });
             },
-            .key_up => |key| app.core_view.pushInput(.{ .key_up = .{ .scancode = @enumToInt(key.scancode), .key = key.scancode, .modifiers = key.modifiers } }),
+            .key_up => |key| app.login_window.view.pushInput(.{ .key_up = .{ .scancode = @enumToInt(key.scancode), .key = key.scancode, .modifiers = key.modifiers } }),
         }
 
-        while (app.core_view.pullEvent()) |ui_event| {
+        while (app.login_window.view.pullEvent()) |ui_event| {
             logger.info("received ui event: {}", .{ui_event});
             switch (ui_event.handler.id) {
                 events.close_app => std.log.info("ui event: close_app", .{}),
@@ -227,7 +184,7 @@ pub fn update(app: *Application) !bool {
         .height = 320,
     }, zero_graphics.Color.white);
 
-    try app.gui_renderer.render(app.core_view, core().screen_size);
+    try app.gui_renderer.render(app.login_window.view, core().screen_size);
 
     return true;
 }
@@ -7,6 +7,8 @@ const gl = zero_graphics.gles;
 const Application = @import("application");
 const CoreApplication = @This();
 
+pub const RedrawScheduler = @import("RedrawScheduler.zig");
+
 comptime {
     // verify the application api
     verifyApplicationType(Application);
@@ -19,6 +21,12 @@ screen_size: zero_graphics.Size = zero_graphics.Size.empty,
 resources: zero_graphics.ResourceManager,
 exit_request: bool = false,
 
+/// Decides when the platform loop renders a frame. Applications can declare
+/// `pub const zerog_redraw_mode = .on_demand;` to only render when a redraw is requested.
+scheduler: RedrawScheduler = .{
+    .mode = if (@hasDecl(Application, "zerog_redraw_mode")) Application.zerog_redraw_mode else .continuous,
+},
+
 pub var instance: ?*CoreApplication = null;
 
 /// Returns the core application for a given application
@@ -58,6 +66,22 @@ pub fn exit(app: *CoreApplication) void {
     app.exit_request = true;
 }
 
+/// Renders another frame, even if the application is in `on_demand` redraw mode.
+pub fn requestRedraw(app: *CoreApplication) void {
+    app.scheduler.requestRedraw();
+}
+
+/// Renders another frame after `delay` milliseconds at the latest. Use this for animations and timers
+/// in `on_demand` redraw mode.
+pub fn requestWakeup(app: *CoreApplication, delay: u32) void {
+    app.scheduler.requestWakeup(zero_graphics.milliTimestamp() + delay);
+}
+
+pub fn setRedrawMode(app: *CoreApplication, mode: RedrawScheduler.Mode) void {
+    app.scheduler.mode = mode;
+    app.scheduler.requestRedraw();
+}
+
 pub fn setupGraphics(app: *CoreApplication) !void {
     logger.info("OpenGL Version:  {?s}", .{std.mem.span(gl.getString(gl.VERSION))});
     logger.info("OpenGL Vendor:   {?s}", .{std.mem.span(gl.getString(gl.VENDOR))});
@@ -85,6 +109,7 @@ pub fn teardownGraphics(app: *CoreApplication) void {
 
 pub fn resize(app: *CoreApplication, width: u15, height: u15) !void {
     app.screen_size = .{ .width = width, .height = height };
+    app.scheduler.requestRedraw();
 
     if (@hasDecl(Application, "resize")) {
         try app.application.resize(width, height);
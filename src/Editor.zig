@@ -1,5 +1,6 @@
 const std = @import("std");
 const zero_graphics = @import("zero-graphics.zig");
+const bvh = @import("rendering/bvh.zig");
 
 const Rectangle = zero_graphics.Rectangle;
 const Color = zero_graphics.Color;
@@ -24,6 +25,7 @@ pub const Gizmo = struct {
 const Queue = std.TailQueue(Gizmo);
 const Node = Queue.Node;
 
+allocator: std.mem.Allocator,
 node_arena: std.heap.ArenaAllocator,
 free_gizmos: Queue = .{},
 gizmos: Queue = .{},
@@ -39,13 +41,27 @@ mouse_pos: zero_graphics.Point = undefined,
 
 frame_index: u32 = 0,
 
+/// Handle boxes of all gizmos for picking. The tree is rebuilt when gizmos were
+/// added or removed, and refit when they only moved.
+pick_tree: ?bvh.Bvh = null,
+pick_gizmos: std.ArrayListUnmanaged(*Gizmo) = .{},
+pick_boxes: std.ArrayListUnmanaged(bvh.Aabb) = .{},
+pick_gizmos_changed: bool = true,
+pick_gizmos_moved: bool = false,
+
 pub fn init(allocator: std.mem.Allocator) Editor {
     return Editor{
+        .allocator = allocator,
         .node_arena = std.heap.ArenaAllocator.init(allocator),
     };
 }
 
 pub fn deinit(self: *Editor) void {
+    if (self.pick_tree) |*tree| {
+        tree.deinit();
+    }
+    self.pick_gizmos.deinit(self.allocator);
+    self.pick_boxes.deinit(self.allocator);
     self.node_arena.deinit();
     self.* = undefined;
 }
@@ -60,6 +76,7 @@ pub fn notifyNewCycle(self: *Editor) !void {
             // remove all nodes that were not touched
             // in the last frame
             self.gizmos.remove(node);
+            self.pick_gizmos_changed = true;
 
             node.data = undefined;
 
@@ -77,6 +94,7 @@ fn createGizmo(self: *Editor) !*Gizmo {
         try self.node_arena.allocator().create(Node);
     node.* = .{ .data = undefined };
     self.gizmos.append(node);
+    self.pick_gizmos_changed = true;
     return &node.data;
 }
 
@@ -141,6 +159,9 @@ pub fn editPoint2D(self: *Editor, tag: anytype, position: Point) !?Point {
     }
 
     if (ggr.cached) {
+        if (ggr.gizmo.data.point.x != position.x or ggr.gizmo.data.point.y != position.y) {
+            self.pick_gizmos_moved = true;
+        }
         return if (ggr.gizmo.changed)
             ggr.gizmo.data.point
         else
@@ -162,6 +183,60 @@ pub fn editPoint2D(self: *Editor, tag: anytype, position: Point) !?Point {
 // }
 
 fn handleFromPos(self: *Editor, screen_position: zero_graphics.Point) ?*Gizmo {
+    // without the tree, every handle is tested
+    self.updatePickTree() catch return self.handleFromPosLinear(screen_position);
+
+    const point = bvh.Aabb.fromPoint(.{ @intToFloat(f32, screen_position.x), @intToFloat(f32, screen_position.y), 0 });
+
+    // the gizmo created last is on top
+    var hovered: ?u32 = null;
+    var it = self.pick_tree.?.overlapping(point);
+    while (it.next()) |index| {
+        if (hovered == null or index > hovered.?) {
+            hovered = index;
+        }
+    }
+
+    return if (hovered) |index| self.pick_gizmos.items[index] else null;
+}
+
+fn updatePickTree(self: *Editor) !void {
+    if (self.pick_gizmos_changed or self.pick_tree == null) {
+        self.pick_gizmos.shrinkRetainingCapacity(0);
+        var it = self.gizmos.first;
+        while (it) |node| : (it = node.next) {
+            try self.pick_gizmos.append(self.allocator, &node.data);
+        }
+        try self.pick_boxes.resize(self.allocator, self.pick_gizmos.items.len);
+        self.updatePickBoxes();
+
+        const tree = try bvh.Bvh.build(self.allocator, self.pick_boxes.items);
+        if (self.pick_tree) |*previous| {
+            previous.deinit();
+        }
+        self.pick_tree = tree;
+    } else if (self.pick_gizmos_moved) {
+        self.updatePickBoxes();
+        self.pick_tree.?.refit(self.pick_boxes.items);
+    }
+    self.pick_gizmos_changed = false;
+    self.pick_gizmos_moved = false;
+}
+
+fn updatePickBoxes(self: *Editor) void {
+    for (self.pick_gizmos.items) |gizmo, i| {
+        const rect = switch (gizmo.data) {
+            .point => |point| getEditHandleRectangle(point.x, point.y),
+        };
+        // the rectangle contains whole pixels, the box is inclusive
+        self.pick_boxes.items[i] = bvh.Aabb{
+            .min = .{ @intToFloat(f32, rect.x), @intToFloat(f32, rect.y), 0 },
+            .max = .{ @intToFloat(f32, rect.x) + @intToFloat(f32, rect.width) - 1, @intToFloat(f32, rect.y) + @intToFloat(f32, rect.height) - 1, 0 },
+        };
+    }
+}
+
+fn handleFromPosLinear(self: *Editor, screen_position: zero_graphics.Point) ?*Gizmo {
     var hovered: ?*Gizmo = null;
 
     var it = self.gizmos.first;
@@ -234,6 +309,7 @@ fn processEvent(self: *Editor, event: zero_graphics.Input.Event) !bool {
                         point_gizmo.y = self.drag_data.point.y + dy;
                     },
                 }
+                self.pick_gizmos_moved = true;
                 return true;
             }
 
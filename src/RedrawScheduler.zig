@@ -0,0 +1,208 @@
+//!
+//! Decides when the main loop renders a frame and how long it may sleep in between.
+//!
+//! In `continuous` mode, every iteration of the main loop renders a frame. In `on_demand`
+//! mode, frames are only rendered after `requestRedraw` was called or a wakeup requested with
+//! `requestWakeup` is due, and the loop blocks for input in between.
+//!
+//! All times are in milliseconds on the clock of the event source, so the scheduler can be
+//! driven by a fake clock.
+//!
+
+const std = @import("std");
+
+const RedrawScheduler = @This();
+
+pub const Mode = enum {
+    /// Render as often as possible.
+    continuous,
+
+    /// Only render when something requested it.
+    on_demand,
+};
+
+pub const Statistics = struct {
+    /// Number of iterations that rendered a frame.
+    rendered_frames: u64 = 0,
+
+    /// Number of iterations that were woken up, but didn't need to render.
+    skipped_frames: u64 = 0,
+
+    /// Total time spent blocking for events.
+    idle_time: i64 = 0,
+};
+
+mode: Mode = .continuous,
+
+/// The next iteration renders a frame. The first frame is always rendered.
+redraw_requested: bool = true,
+
+/// The earliest time a timer wants the loop to render again.
+next_wakeup: ?i64 = null,
+
+statistics: Statistics = .{},
+
+/// Makes the next iteration of the main loop render a frame.
+pub fn requestRedraw(scheduler: *RedrawScheduler) void {
+    scheduler.redraw_requested = true;
+}
+
+/// Makes the main loop render a frame at `time` at the latest.
+pub fn requestWakeup(scheduler: *RedrawScheduler, time: i64) void {
+    if (scheduler.next_wakeup) |current| {
+        if (current <= time)
+            return;
+    }
+    scheduler.next_wakeup = time;
+}
+
+/// Returns how long the main loop may block for events at `now`. `null` means until the next event.
+pub fn waitTimeout(scheduler: RedrawScheduler, now: i64) ?u32 {
+    if (scheduler.mode == .continuous or scheduler.redraw_requested)
+        return 0;
+    const wakeup = scheduler.next_wakeup orelse return null;
+    if (wakeup <= now)
+        return 0;
+    return @intCast(u32, std.math.min(wakeup - now, std.math.maxInt(i32)));
+}
+
+/// Waits until `source` has an event or the next frame is due.
+/// `source` must provide these functions:
+/// - `now() i64` returns the current time.
+/// - `poll() bool` returns `true` if an event is available without blocking.
+/// - `wait(timeout: ?u32) bool` blocks until an event is available or the timeout passed.
+/// Returns `true` if an event is available.
+pub fn waitForEvent(scheduler: *RedrawScheduler, source: anytype) bool {
+    const start = source.now();
+    const has_event = if (scheduler.waitTimeout(start)) |timeout|
+        (if (timeout == 0) source.poll() else source.wait(timeout))
+    else
+        source.wait(null);
+    scheduler.statistics.idle_time += source.now() - start;
+    return has_event;
+}
+
+/// Returns `true` if the current iteration of the main loop must render a frame and
+/// consumes the pending requests.
+pub fn beginFrame(scheduler: *RedrawScheduler, now: i64) bool {
+    if (scheduler.next_wakeup) |wakeup| {
+        if (wakeup <= now) {
+            scheduler.next_wakeup = null;
+            scheduler.redraw_requested = true;
+        }
+    }
+
+    const render = (scheduler.mode == .continuous) or scheduler.redraw_requested;
+    scheduler.redraw_requested = false;
+
+    if (render) {
+        scheduler.statistics.rendered_frames += 1;
+    } else {
+        scheduler.statistics.skipped_frames += 1;
+    }
+    return render;
+}
+
+/// An event source with a fake clock that delivers events at fixed times.
+const FakeEventSource = struct {
+    const Event = struct {
+        time: i64,
+        redraw: bool,
+    };
+
+    time: i64 = 0,
+    events: []const Event,
+    next_event: usize = 0,
+    current: ?Event = null,
+
+    pub fn now(source: *FakeEventSource) i64 {
+        return source.time;
+    }
+
+    pub fn poll(source: *FakeEventSource) bool {
+        if (source.next_event < source.events.len and source.events[source.next_event].time <= source.time) {
+            source.current = source.events[source.next_event];
+            source.next_event += 1;
+            return true;
+        }
+        return false;
+    }
+
+    pub fn wait(source: *FakeEventSource, timeout: ?u32) bool {
+        const deadline = if (timeout) |ms| source.time + ms else std.math.maxInt(i64);
+        if (source.next_event < source.events.len and source.events[source.next_event].time <= deadline) {
+            source.time = std.math.max(source.time, source.events[source.next_event].time);
+            return source.poll();
+        }
+        std.debug.assert(timeout != null); // would block forever
+        source.time = deadline;
+        return false;
+    }
+
+    /// Runs the main loop until all events are processed and nothing is scheduled anymore.
+    fn run(source: *FakeEventSource, scheduler: *RedrawScheduler) void {
+        while (source.next_event < source.events.len or scheduler.redraw_requested or scheduler.next_wakeup != null) {
+            var has_event = scheduler.waitForEvent(source);
+            while (has_event) : (has_event = source.poll()) {
+                if (source.current.?.redraw)
+                    scheduler.requestRedraw();
+            }
+            _ = scheduler.beginFrame(source.time);
+        }
+    }
+};
+
+test "redraw scheduler: continuous" {
+    var scheduler = RedrawScheduler{};
+    var i: usize = 0;
+    while (i < 10) : (i += 1) {
+        try std.testing.expectEqual(@as(?u32, 0), scheduler.waitTimeout(0));
+        try std.testing.expect(scheduler.beginFrame(0));
+    }
+    try std.testing.expectEqual(@as(u64, 10), scheduler.statistics.rendered_frames);
+}
+
+test "redraw scheduler: on demand" {
+    var scheduler = RedrawScheduler{ .mode = .on_demand };
+
+    // the first frame is always rendered, then the loop sleeps
+    try std.testing.expectEqual(@as(?u32, 0), scheduler.waitTimeout(0));
+    try std.testing.expect(scheduler.beginFrame(0));
+    try std.testing.expectEqual(@as(?u32, null), scheduler.waitTimeout(0));
+
+    // timers wake up the loop, the earliest one wins
+    scheduler.requestWakeup(500);
+    scheduler.requestWakeup(200);
+    try std.testing.expectEqual(@as(?u32, 150), scheduler.waitTimeout(50));
+    try std.testing.expect(!scheduler.beginFrame(50));
+    try std.testing.expect(scheduler.beginFrame(200));
+    try std.testing.expectEqual(@as(?u32, null), scheduler.waitTimeout(200));
+
+    scheduler.requestRedraw();
+    try std.testing.expectEqual(@as(?u32, 0), scheduler.waitTimeout(300));
+    try std.testing.expect(scheduler.beginFrame(300));
+
+    try std.testing.expectEqual(@as(u64, 3), scheduler.statistics.rendered_frames);
+    try std.testing.expectEqual(@as(u64, 1), scheduler.statistics.skipped_frames);
+}
+
+test "redraw scheduler: fake event source" {
+    var scheduler = RedrawScheduler{ .mode = .on_demand };
+    var source = FakeEventSource{
+        .events = &[_]FakeEventSource.Event{
+            .{ .time = 100, .redraw = true },
+            .{ .time = 100, .redraw = true }, // handled in the same frame
+            .{ .time = 250, .redraw = false }, // wakes the loop, but doesn't need a frame
+            .{ .time = 1000, .redraw = true },
+        },
+    };
+    scheduler.requestWakeup(400);
+
+    source.run(&scheduler);
+
+    // initial frame, input at 100, timer at 400, input at 1000
+    try std.testing.expectEqual(@as(u64, 4), scheduler.statistics.rendered_frames);
+    try std.testing.expectEqual(@as(u64, 1), scheduler.statistics.skipped_frames);
+    try std.testing.expectEqual(@as(i64, 1000), source.time);
+    try std.testing.expectEqual(@as(i64, 1000), scheduler.statistics.idle_time);
+}
@@ -1,4 +1,5 @@
 const std = @import("std");
+const builtin = @import("builtin");
 const types = @import("zero-graphics.zig");
 const logger = std.log.scoped(.user_interface);
 
@@ -9,8 +10,11 @@ const Color = types.Color;
 
 const ResourceManager = @import("rendering/ResourceManager.zig");
 const Renderer = @import("rendering/Renderer2D.zig");
+const HitGrid = @import("ui/core/HitGrid.zig");
+const TextBuffer = @import("ui/core/TextBuffer.zig");
 
 const Texture = ResourceManager.Texture;
+const screenCoord = Renderer.screenCoord;
 
 // layout helpers
 
@@ -130,7 +134,13 @@ pub const Theme = struct {
 
 const has_code_editor = @hasDecl(types, "CodeEditor");
 
-const WidgetID = enum(u32) { _ };
+/// The text box cursor is visible for half of this period in milliseconds.
+const text_box_blink_period = 800;
+
+/// Milliseconds between two ticks of a code editor, which drive its caret blinking.
+const code_editor_tick_period = 100;
+
+const WidgetID = enum(u64) { _ };
 
 const Widget = struct {
     // Control state:
@@ -138,6 +148,21 @@ const Widget = struct {
     control: Control,
     bounds: Rectangle,
 
+    /// The `UserInterface.frame` in which the widget was last declared.
+    frame: u32,
+
+    /// The geometry of the last `render` call and the hash of everything it was generated from.
+    render_cache: RenderCache = .{},
+
+    const RenderCache = struct {
+        /// `null` if the recording is not usable.
+        hash: ?u64 = null,
+        /// `visualHash` of the widget at the end of the last construction pass.
+        /// Only valid while `UserInterface.visual_hashes_valid` is set.
+        next_hash: ?u64 = null,
+        recording: Renderer.Recording = .{},
+    };
+
     const Control = union(enum) {
         unset,
         modal_layer: ModalLayer,
@@ -161,7 +186,7 @@ const Widget = struct {
                 ctrl.text.deinit();
             },
             .text_box => |*ctrl| {
-                ctrl.editor.deinit();
+                ctrl.buffer.deinit();
             },
             .code_editor => |*ctrl| {
                 if (has_code_editor)
@@ -216,27 +241,16 @@ const Widget = struct {
                 control.clickable.clicked = true;
             },
             .text_box => |*control| {
-                const EditorFont = struct {
-                    renderer: *Renderer,
-                    font: *const Renderer.Font,
-
-                    pub fn measureStringWidth(ef: @This(), string: []const u8) u15 {
-                        return ef.renderer.measureString(ef.font, string).width;
-                    }
+                const font = BufferFont{
+                    .renderer = ui.renderer orelse return,
+                    .font = ui.default_font, // TODO: Select correct font for checkbox
+                };
+                const x = @as(i32, point.x) - self.bounds.x + @intCast(i32, control.scroll_offset) - 3; // TODO: Adjust to real padding value
+                control.buffer.setFont(@ptrToInt(font.font));
+                control.cursor = control.buffer.xToOffset(font, control.buffer.lineOf(control.cursor), x) catch |err| {
+                    logger.err("failed to place the text cursor: {s}", .{@errorName(err)});
+                    return;
                 };
-                // TODO: Expose user interface in this function
-                logger.info("click @ {},{}", .{
-                    point.x - self.bounds.x - 7,
-                    point.y - self.bounds.y,
-                });
-                control.editor.setGraphicalCursor(
-                    EditorFont{
-                        .renderer = ui.renderer orelse return,
-                        .font = ui.default_font, // TODO: Select correct font for checkbox
-                    },
-                    point.x - self.bounds.x + control.scroll_offset - 3, // TODO: Adjust to real padding value
-                    point.y - self.bounds.y,
-                );
             },
             else => {},
         }
@@ -349,15 +363,39 @@ const Widget = struct {
         };
         const Event = enum { accepted, enter, leave, cancelled, text_changed };
 
-        editor: TextEditor,
+        buffer: TextBuffer,
         content_hash: StringHash = StringHash.compute(""),
 
+        /// Byte offset of the cursor in `buffer`.
+        cursor: usize = 0,
+
         ctrl_pressed: bool = false,
-        scroll_offset: u15 = 0,
+        scroll_offset: u32 = 0,
 
         events: std.enums.EnumSet(Event) = std.enums.EnumSet(Event){},
 
         config: Config = .{},
+
+        fn setText(box: *TextBox, text: []const u8) !void {
+            try box.buffer.setText(text);
+            box.cursor = box.buffer.len();
+        }
+
+        fn insertText(box: *TextBox, text: []const u8) !void {
+            try box.buffer.insert(box.cursor, text);
+            box.cursor += text.len;
+        }
+
+        fn moveCursor(box: *TextBox, direction: TextBuffer.Direction, unit: TextBuffer.Unit) void {
+            box.cursor = box.buffer.step(box.cursor, direction, unit);
+        }
+
+        fn delete(box: *TextBox, direction: TextBuffer.Direction, unit: TextBuffer.Unit) void {
+            const other = box.buffer.step(box.cursor, direction, unit);
+            const start = std.math.min(box.cursor, other);
+            box.buffer.remove(start, std.math.max(box.cursor, other));
+            box.cursor = start;
+        }
     };
     const CodeEditor = struct {
         const Config = struct {
@@ -375,7 +413,8 @@ const Widget = struct {
         shift_pressed: bool = false,
         alt_pressed: bool = false,
 
-        tick_increment: u32 = 0,
+        /// `milliTimestamp` at which the editor is ticked next.
+        next_tick: i64 = 0,
 
         config: Config = .{},
     };
@@ -431,10 +470,22 @@ const Widget = struct {
             hit_test_visible: bool = true,
         };
 
+        /// Tells the user interface when a custom widget has to be drawn again.
+        pub const Redraw = union(enum) {
+            /// The widget looks the same as in the last frame.
+            none,
+            /// The widget changed and needs a new frame.
+            now,
+            /// The widget changes on its own in the given number of milliseconds, like an animation.
+            after: u32,
+        };
+
         pub const Config = struct {
             hit_test_visible: bool = true,
             draw: ?*const fn (Custom, Rectangle, *Renderer, DrawInfo) Renderer.DrawError!void = null,
             process_event: ?*const fn (Custom, Event) ?usize = null,
+            /// Reports whether the widget needs a new frame. Without it, the widget requests one every frame.
+            redraw: ?*const fn (Custom) Redraw = null,
             /// generic second user data to provide context information for the user data
             context: ?*anyopaque = null,
         };
@@ -481,6 +532,27 @@ retained_widgets: WidgetList = .{},
 /// `WidgetNode.data` contains garbage and must be freshly initialized.
 free_widgets: WidgetList = .{},
 
+/// Maps the ID of every widget in `active_widgets` and `retained_widgets` to its node,
+/// so declaring a widget doesn't need to search the retained widgets.
+widget_index: std.AutoHashMapUnmanaged(WidgetID, *WidgetNode) = .{},
+
+/// Spatial index of `active_widgets` in draw order, rebuilt at the end of each construction pass.
+/// Speeds up finding the widget under the pointer.
+hit_grid: HitGrid.HitGrid(*Widget) = .{},
+
+/// If `false`, `hit_grid` is out of date and hit tests search `active_widgets` instead.
+hit_grid_valid: bool = false,
+
+/// If `true`, every widget's `render_cache.next_hash` is up to date and `render` doesn't hash again.
+/// Cleared by `construct` and `processInput`, as both change what the widgets look like.
+visual_hashes_valid: bool = false,
+
+/// Counts how many widgets were drawn from scratch and how many from their cached geometry in the last `render`.
+render_statistics: RenderStatistics = .{},
+
+/// Counts the construction passes, so IDs that are declared twice in the same pass are detected.
+frame: u32 = 0,
+
 /// The theme that is used to render the UI.
 /// Contains all colors and sizes for widgets.
 theme: *const Theme = &Theme.default,
@@ -527,12 +599,15 @@ pub fn init(allocator: std.mem.Allocator, renderer: ?*Renderer) !UserInterface {
 
 pub fn deinit(self: *UserInterface) void {
     while (self.active_widgets.popFirst()) |node| {
+        self.releaseRenderCache(&node.data);
         node.data.deinit();
     }
     while (self.free_widgets.popFirst()) |node| {
         // node.data.deinit();
         _ = node;
     }
+    self.widget_index.deinit(self.allocator);
+    self.hit_grid.deinit(self.allocator);
 
     self.setRenderer(null) catch unreachable; // can only error when non-null is passed
 
@@ -545,6 +620,11 @@ pub fn setRenderer(self: *UserInterface, new_renderer: ?*Renderer) !void {
         return;
 
     if (self.renderer) |renderer| {
+        var it = self.active_widgets.first;
+        while (it) |node| : (it = node.next) {
+            self.releaseRenderCache(&node.data);
+        }
+
         renderer.resources.destroyTexture(self.icons.checkbox_checked);
         renderer.resources.destroyTexture(self.icons.checkbox_unchecked);
         renderer.resources.destroyTexture(self.icons.radiobutton_checked);
@@ -592,6 +672,14 @@ pub fn setRenderer(self: *UserInterface, new_renderer: ?*Renderer) !void {
     }
 }
 
+/// Drops the cached geometry of `widget`, which references resources of the current renderer.
+fn releaseRenderCache(self: *UserInterface, widget: *Widget) void {
+    if (self.renderer) |renderer| {
+        widget.render_cache.recording.deinit(renderer);
+    }
+    widget.render_cache = .{};
+}
+
 /// Allocates a new WidgetNode, either via the arena or
 /// fetches it from the free_widgets list
 fn allocWidgetNode(self: *UserInterface) !*WidgetNode {
@@ -615,28 +703,35 @@ fn freeWidgetNode(self: *UserInterface, node: *WidgetNode) void {
 /// Fetches a fitting widget from the `retained_widgets` list or creates a new node.
 /// On success, the widget is appended to the `active_widgets` list.
 fn findOrAllocWidget(self: *UserInterface, widget_type: ControlType, id: WidgetID) !*Widget {
-    var it = self.retained_widgets.first;
-    while (it) |node| : (it = node.next) {
-        if (node.data.id == id) {
-            // When this assertion is true, we created the same ID twice
-            // for different widget invocations. This means we must increase the number of bits
-            // in WidgetID and adjust our hash function
-            std.debug.assert(node.data.control == widget_type);
+    // Make sure inserting a new widget cannot fail after the index was probed.
+    try self.widget_index.ensureUnusedCapacity(self.allocator, 1);
+
+    var probe = id;
+    while (self.widget_index.get(probe)) |node| {
+        // The ID was already declared in this pass or belongs to another widget type,
+        // either because the same config was used twice or the hashes collided.
+        // Derive the next ID from it, which is stable as long as the declaration order is.
+        if (node.data.frame == self.frame or node.data.control != widget_type) {
+            probe = nextWidgetId(probe);
+            continue;
+        }
 
-            // Shuffle from one list into the other:
-            self.retained_widgets.remove(node);
-            self.active_widgets.append(node);
+        // Shuffle from one list into the other:
+        self.retained_widgets.remove(node);
+        self.active_widgets.append(node);
+        node.data.frame = self.frame;
 
-            return &node.data;
-        }
+        return &node.data;
     }
 
     const node = try self.allocWidgetNode();
     node.data = Widget{
-        .id = id,
+        .id = probe,
         .control = .unset,
         .bounds = undefined,
+        .frame = self.frame,
     };
+    self.widget_index.putAssumeCapacityNoClobber(probe, node);
     self.active_widgets.append(node);
     return &node.data;
 }
@@ -649,11 +744,11 @@ fn typeId(comptime T: type) usize {
     }.i);
 }
 
-/// Computes a adler32 ID from the
+/// Computes a 64 bit ID from the type of `config` and its `id` field, if any.
 fn widgetId(config: anytype) WidgetID {
     const Config = @TypeOf(config);
 
-    var hash = std.hash.Adler32.init();
+    var hash = std.hash.Wyhash.init(0);
     hash.update(std.mem.asBytes(&typeId(Config)));
     if (@hasField(Config, "id"))
         hash.update(std.mem.asBytes(&config.id));
@@ -661,6 +756,11 @@ fn widgetId(config: anytype) WidgetID {
     return @intToEnum(WidgetID, hash.final());
 }
 
+/// Returns the ID that is tried after `id` was already taken.
+fn nextWidgetId(id: WidgetID) WidgetID {
+    return @intToEnum(WidgetID, std.hash.Wyhash.hash(1, std.mem.asBytes(&@enumToInt(id))));
+}
+
 fn updateWidgetConfig(dst_config: anytype, src_config: anytype) void {
     inline for (std.meta.fields(@TypeOf(src_config))) |fld| {
         if (comptime !std.mem.eql(u8, fld.name, "id")) {
@@ -675,6 +775,8 @@ fn updateWidgetConfig(dst_config: anytype, src_config: anytype) void {
 pub fn construct(self: *UserInterface, screen_size: Size) Builder {
     std.debug.assert(self.mode == .default);
     self.mode = .building;
+    self.frame +%= 1;
+    self.visual_hashes_valid = false;
 
     // Moves all active widgets into the retained storage.
     // Widgets will be pulled from there when reused, otherwise will be destroyed in `.end()`.
@@ -716,10 +818,15 @@ pub const Builder = struct {
             if (self.ui.pressed_widget == &node.data) {
                 self.ui.pressed_widget = null;
             }
+            _ = self.ui.widget_index.remove(node.data.id);
+            self.ui.releaseRenderCache(&node.data);
             node.data.deinit();
             self.ui.freeWidgetNode(node);
         }
 
+        const order_changed = self.ui.updateHitGrid();
+        self.ui.requestRedrawIfChanged(order_changed);
+
         self.* = undefined;
     }
 
@@ -894,7 +1001,8 @@ pub const Builder = struct {
 
         if (info.needs_init) {
             info.control.* = .{
-                .editor = try TextEditor.init(self.ui.allocator, display_string),
+                .buffer = try TextBuffer.init(self.ui.allocator, display_string),
+                .cursor = display_string.len,
                 .content_hash = display_hash,
             };
         } else {
@@ -902,7 +1010,7 @@ pub const Builder = struct {
             // clear text box to default when ESC is pressed or the input string changes
             if ((text_box.content_hash != display_hash) or text_box.events.contains(.cancelled)) {
                 logger.info("updating text box content to {s}", .{display_string});
-                try text_box.editor.setText(display_string);
+                try text_box.setText(display_string);
                 text_box.content_hash = display_hash;
             }
         }
@@ -912,13 +1020,13 @@ pub const Builder = struct {
             return TextBoxEvent.user_clear;
         }
         if (text_box.events.contains(.accepted)) {
-            return TextBoxEvent{ .user_accept = info.control.editor.getText() };
+            return TextBoxEvent{ .user_accept = info.control.buffer.getText() };
         }
         if (text_box.events.contains(.leave)) {
-            return TextBoxEvent{ .focus_lost = info.control.editor.getText() };
+            return TextBoxEvent{ .focus_lost = info.control.buffer.getText() };
         }
         if (text_box.events.contains(.text_changed)) {
-            return TextBoxEvent{ .text_changed = info.control.editor.getText() };
+            return TextBoxEvent{ .text_changed = info.control.buffer.getText() };
         }
 
         return null;
@@ -960,11 +1068,10 @@ pub const Builder = struct {
 
             code_editor.editor.setPosition(rectangle);
 
-            if (code_editor.tick_increment == 0) {
+            const now = types.milliTimestamp();
+            if (now >= code_editor.next_tick) {
                 code_editor.editor.tick();
-                code_editor.tick_increment = 6;
-            } else {
-                code_editor.tick_increment -= 1;
+                code_editor.next_tick = now + code_editor_tick_period;
             }
 
             return &code_editor.editor;
@@ -975,12 +1082,117 @@ pub const Builder = struct {
 pub fn processInput(self: *UserInterface) InputProcessor {
     std.debug.assert(self.mode == .default);
     self.mode = .updating;
+    self.visual_hashes_valid = false;
     return InputProcessor{
         .ui = self,
     };
 }
 
+/// Brings `hit_grid` in sync with `active_widgets`. Widgets that keep their place in the draw order
+/// are only moved when their bounds changed, everything after the first added or removed widget is
+/// inserted again. Returns `true` if widgets were added, removed or reordered.
+fn updateHitGrid(self: *UserInterface) bool {
+    return self.syncHitGrid() catch {
+        logger.warn("out of memory, falling back to linear hit testing", .{});
+        self.hit_grid.clear();
+        self.hit_grid_valid = false;
+        return true;
+    };
+}
+
+fn syncHitGrid(self: *UserInterface) !bool {
+    var changed = false;
+    var index: usize = 0;
+    var it = self.active_widgets.first;
+    while (it) |node| : (it = node.next) {
+        if (index >= self.hit_grid.len() or self.hit_grid.get(index) != &node.data) {
+            changed = true;
+        }
+        const bounds = node.data.bounds;
+        const box = HitGrid.Box.new(bounds.x, bounds.y, bounds.width, bounds.height);
+        try self.hit_grid.sync(self.allocator, index, &node.data, box);
+        index += 1;
+    }
+    if (self.hit_grid.len() > index) {
+        changed = true;
+    }
+    self.hit_grid.shrink(index);
+    self.hit_grid_valid = true;
+    return changed;
+}
+
+/// Computes the `visualHash` of every widget for the next `render` and asks the application for
+/// another frame if the widgets look different than in the last one. Widgets without a hash report
+/// their own state: focused text boxes and custom widgets may only request a wakeup for later.
+fn requestRedrawIfChanged(self: *UserInterface, order_changed: bool) void {
+    const renderer = self.renderer orelse return;
+
+    var changed = order_changed;
+    var wakeup: ?u32 = null;
+    var iterator = self.widgetIterator(.draw_order);
+    while (iterator.next()) |widget| {
+        const is_hovered = (self.hovered_widget == widget);
+        const is_pressed = is_hovered and (self.pressed_widget == widget);
+
+        const hash = self.visualHash(renderer, widget, is_hovered, is_pressed);
+        widget.render_cache.next_hash = hash;
+        if (changed)
+            continue;
+
+        if (hash != null) {
+            changed = !std.meta.eql(widget.render_cache.hash, hash);
+        } else switch (widget.control) {
+            .text_box => if (self.isFocused(widget)) {
+                const half_period = text_box_blink_period / 2;
+                wakeup = minWakeup(wakeup, @intCast(u32, half_period - @mod(types.milliTimestamp(), half_period)));
+            },
+            .code_editor => |*control| {
+                if (has_code_editor) {
+                    changed = control.editor.needsRepaint();
+                    // Only the focused editor has a blinking caret that needs the next tick.
+                    if (self.isFocused(widget)) {
+                        const delay = std.math.max(control.next_tick - types.milliTimestamp(), 0);
+                        wakeup = minWakeup(wakeup, @intCast(u32, delay));
+                    }
+                }
+            },
+            .custom => |control| {
+                const redraw: Widget.Custom.Redraw = if (control.config.redraw) |callback| callback(control) else .now;
+                switch (redraw) {
+                    .none => {},
+                    .now => changed = true,
+                    .after => |delay| wakeup = minWakeup(wakeup, delay),
+                }
+            },
+            else => unreachable,
+        }
+    }
+    self.visual_hashes_valid = true;
+
+    // Hosts without an application, like the unit tests and the benchmarks, have nothing to wake up.
+    if (comptime !@hasDecl(@import("root"), "Application"))
+        return;
+    const app = types.CoreApplication.instance orelse return;
+
+    if (changed) {
+        app.requestRedraw();
+    } else if (wakeup) |delay| {
+        app.requestWakeup(delay);
+    }
+}
+
+fn minWakeup(current: ?u32, delay: u32) u32 {
+    return if (current) |value| std.math.min(value, delay) else delay;
+}
+
+fn acceptHit(_: void, widget: *Widget) bool {
+    return widget.isHitTestVisible();
+}
+
 fn widgetFromPosition(self: *UserInterface, point: Point) ?*Widget {
+    if (self.hit_grid_valid)
+        return self.hit_grid.find(point.x, point.y, {}, acceptHit);
+
     var iter = self.widgetIterator(.event_order);
     while (iter.next()) |widget| {
         if (widget.bounds.contains(point))
@@ -1094,11 +1306,11 @@ pub const InputProcessor = struct {
         }
     }
 
-    fn wordModifier(box: Widget.TextBox) TextEditor.EditUnit {
+    fn wordModifier(box: Widget.TextBox) TextBuffer.Unit {
         return if (box.ctrl_pressed)
-            TextEditor.EditUnit.word
+            TextBuffer.Unit.word
         else
-            TextEditor.EditUnit.letter;
+            TextBuffer.Unit.letter;
     }
 
     pub fn buttonDown(self: Self, button: types.Input.Scancode) !void {
@@ -1128,7 +1340,7 @@ pub const InputProcessor = struct {
                 .escape => control.events.insert(.cancelled),
                 .tab => {
                     if (control.config.accept_tabs) {
-                        try control.editor.insertText("\t");
+                        try control.insertText("\t");
                         control.events.insert(.text_changed);
                     } else {
                         // TODO: move focus
@@ -1136,18 +1348,18 @@ pub const InputProcessor = struct {
                 },
 
                 .backspace => {
-                    control.editor.delete(.left, wordModifier(control.*));
+                    control.delete(.left, wordModifier(control.*));
                     control.events.insert(.text_changed);
                 },
                 .delete => {
-                    control.editor.delete(.right, wordModifier(control.*));
+                    control.delete(.right, wordModifier(control.*));
                     control.events.insert(.text_changed);
                 },
-                .left => control.editor.moveCursor(.left, wordModifier(control.*)),
-                .right => control.editor.moveCursor(.right, wordModifier(control.*)),
+                .left => control.moveCursor(.left, wordModifier(control.*)),
+                .right => control.moveCursor(.right, wordModifier(control.*)),
 
-                .home => control.editor.moveCursor(.left, .line),
-                .end => control.editor.moveCursor(.right, .line),
+                .home => control.moveCursor(.left, .line),
+                .end => control.moveCursor(.right, .line),
                 else => {},
             },
             else => return, // just eat the event by default
@@ -1196,12 +1408,12 @@ pub const InputProcessor = struct {
                 var offset: usize = 0;
                 while (offset < string.len) {
                     if (std.mem.indexOfAnyPos(u8, string, offset, &filtered_chars)) |index| {
-                        try control.editor.insertText(string[offset..index]);
+                        try control.insertText(string[offset..index]);
                         offset = index + 1;
 
                         control.events.insert(.text_changed);
                     } else {
-                        try control.editor.insertText(string[offset..]);
+                        try control.insertText(string[offset..]);
                         offset = string.len;
 
                         control.events.insert(.text_changed);
@@ -1210,7 +1422,7 @@ pub const InputProcessor = struct {
 
                 logger.info("insertText(\"{}\") => \"{}\"", .{
                     std.fmt.fmtSliceEscapeUpper(string),
-                    std.fmt.fmtSliceEscapeUpper(control.editor.getText()),
+                    std.fmt.fmtSliceEscapeUpper(control.buffer.getText()),
                 });
             },
 
@@ -1280,6 +1492,16 @@ pub const InputProcessor = struct {
     };
 };
 
+/// Measures text for a `TextBuffer` with a font of the renderer.
+const BufferFont = struct {
+    renderer: *Renderer,
+    font: *const Renderer.Font,
+
+    pub fn measureString(bf: BufferFont, string: []const u8) u15 {
+        return bf.renderer.measureString(bf.font, string).width;
+    }
+};
+
 fn clampSub(a: u15, b: u15) u15 {
     return if (b < a)
         a - b
@@ -1305,206 +1527,292 @@ pub fn hasFocus(self: UserInterface) bool {
     return (self.focused_widget != null);
 }
 
-pub fn render(self: UserInterface) !void {
+pub const RenderStatistics = struct {
+    regenerated_widgets: u32 = 0,
+    reused_widgets: u32 = 0,
+};
+
+/// Draws all widgets into the renderer. Widgets whose visual inputs did not change since the last call
+/// copy their previously generated geometry instead of drawing it again.
+pub fn render(self: *UserInterface) !void {
     const renderer = self.renderer orelse @panic("usage error");
+    self.render_statistics = .{};
+
     var iterator = self.widgetIterator(.draw_order);
     while (iterator.next()) |widget| {
         const is_hovered = (self.hovered_widget == widget);
         const is_pressed = is_hovered and (self.pressed_widget == widget);
 
-        switch (widget.control) {
-            // unset is only required for allocating fresh nodes and then initialize them properly in the
-            // corresponding widget function
-            .unset => unreachable,
+        const hash = if (self.visual_hashes_valid)
+            widget.render_cache.next_hash
+        else
+            self.visualHash(renderer, widget, is_hovered, is_pressed);
+        if (hash != null and std.meta.eql(widget.render_cache.hash, hash)) {
+            try renderer.replay(widget.render_cache.recording);
+            self.render_statistics.reused_widgets += 1;
+            continue;
+        }
 
-            .modal_layer => |control| {
-                const style = control.config.style orelse self.theme.modal_layer;
-                try renderer.fillRectangle(widget.bounds, style.fill_color);
-            },
+        const start = renderer.mark();
+        try self.renderWidget(renderer, widget, is_hovered, is_pressed);
+        self.render_statistics.regenerated_widgets += 1;
 
-            .button => |control| {
-                const style = control.config.style orelse self.theme.button;
+        widget.render_cache.hash = null;
+        if (hash != null) {
+            try renderer.record(start, &widget.render_cache.recording);
+            widget.render_cache.hash = hash;
+        }
+    }
+}
 
-                const style_info = if (!control.config.enabled)
-                    style.disabled
-                else if (is_pressed)
-                    style.clicked
-                else if (is_hovered)
-                    style.hovered
-                else
-                    style.default;
+/// Computes a hash of everything that affects the geometry of `widget`.
+/// Returns `null` for widgets that are drawn every frame and report changes themselves.
+fn visualHash(self: *const UserInterface, renderer: *Renderer, widget: *const Widget, is_hovered: bool, is_pressed: bool) ?u64 {
+    var hasher = std.hash.Wyhash.init(0);
+    std.hash.autoHash(&hasher, std.meta.activeTag(widget.control));
+    std.hash.autoHash(&hasher, widget.bounds);
+    std.hash.autoHash(&hasher, is_hovered);
+    std.hash.autoHash(&hasher, is_pressed);
+    std.hash.autoHash(&hasher, @bitCast(u32, renderer.unit_to_pixel_ratio));
 
-                try renderer.fillRectangle(widget.bounds, style_info.background);
-                try renderer.drawRectangle(widget.bounds, style_info.border);
+    switch (widget.control) {
+        .unset => unreachable,
 
-                if (control.icon) |icon| {
-                    try renderer.drawTexture(
-                        widget.bounds.centered(style.icon_size, style.icon_size),
-                        icon,
-                        Color.white,
-                    );
-                }
+        // the cursor blinks, the editor and custom widgets draw themselves
+        .text_box, .code_editor, .custom => return null,
 
-                const text = control.text.get();
-                if (text.len > 0) {
-                    const font = control.config.font orelse self.default_font;
-                    const color = control.config.text_color orelse style_info.text_color;
-                    try renderer.drawText(
-                        font,
-                        control.text.get(),
-                        widget.bounds.shrink(2),
-                        .{
-                            .color = color,
-                            .vertical_alignment = control.config.vertical_text_alignment,
-                            .horizontal_alignment = control.config.horizontal_text_alignment,
-                        },
-                    );
-                }
-            },
+        .modal_layer => |control| {
+            std.hash.autoHash(&hasher, control.config.style orelse self.theme.modal_layer);
+        },
+        .button => |control| {
+            std.hash.autoHash(&hasher, control.config);
+            std.hash.autoHash(&hasher, control.config.style orelse self.theme.button);
+            std.hash.autoHash(&hasher, control.config.font orelse self.default_font);
+            std.hash.autoHash(&hasher, control.icon);
+            hasher.update(control.text.get());
+        },
+        .panel => |control| {
+            std.hash.autoHash(&hasher, control.config.style orelse self.theme.panel);
+        },
+        .label => |control| {
+            std.hash.autoHash(&hasher, control.config);
+            std.hash.autoHash(&hasher, control.config.style orelse self.theme.label);
+            std.hash.autoHash(&hasher, control.config.font orelse self.default_font);
+            hasher.update(control.text.get());
+        },
+        .check_box => |control| {
+            std.hash.autoHash(&hasher, control.config.enabled);
+            std.hash.autoHash(&hasher, control.is_checked);
+            std.hash.autoHash(&hasher, self.icons);
+        },
+        .radio_button => |control| {
+            std.hash.autoHash(&hasher, control.config.enabled);
+            std.hash.autoHash(&hasher, control.is_checked);
+            std.hash.autoHash(&hasher, self.icons);
+        },
+        .image => |control| {
+            std.hash.autoHash(&hasher, control.config);
+            std.hash.autoHash(&hasher, control.image);
+        },
+    }
+    return hasher.final();
+}
 
-            .panel => |control| {
-                const style = control.config.style orelse self.theme.panel;
-                try renderer.fillRectangle(widget.bounds, style.background);
-                try renderer.drawRectangle(widget.bounds, style.border);
-            },
+fn renderWidget(self: UserInterface, renderer: *Renderer, widget: *Widget, is_hovered: bool, is_pressed: bool) !void {
+    switch (widget.control) {
+        // unset is only required for allocating fresh nodes and then initialize them properly in the
+        // corresponding widget function
+        .unset => unreachable,
 
-            .text_box => |*control| {
-                const theme = control.config.style orelse self.theme.text_box;
+        .modal_layer => |control| {
+            const style = control.config.style orelse self.theme.modal_layer;
+            try renderer.fillRectangle(widget.bounds, style.fill_color);
+        },
 
-                const style = if (self.isFocused(widget))
-                    theme.focused
-                else
-                    theme.default;
+        .button => |control| {
+            const style = control.config.style orelse self.theme.button;
 
-                try renderer.fillRectangle(widget.bounds, style.background);
-                try renderer.drawRectangle(widget.bounds, style.border);
+            const style_info = if (!control.config.enabled)
+                style.disabled
+            else if (is_pressed)
+                style.clicked
+            else if (is_hovered)
+                style.hovered
+            else
+                style.default;
 
-                const string = control.editor.getText();
-                const font = self.default_font;
-                const string_height = font.getLineHeight();
+            try renderer.fillRectangle(widget.bounds, style_info.background);
+            try renderer.drawRectangle(widget.bounds, style_info.border);
 
-                const CursorInfo = struct {
-                    position: u15,
-                };
+            if (control.icon) |icon| {
+                try renderer.drawTexture(
+                    widget.bounds.centered(style.icon_size, style.icon_size),
+                    icon,
+                    Color.white,
+                );
+            }
 
-                const text_padding = 3;
+            const text = control.text.get();
+            if (text.len > 0) {
+                const font = control.config.font orelse self.default_font;
+                const color = control.config.text_color orelse style_info.text_color;
+                try renderer.drawText(
+                    font,
+                    control.text.get(),
+                    widget.bounds.shrink(2),
+                    .{
+                        .color = color,
+                        .vertical_alignment = control.config.vertical_text_alignment,
+                        .horizontal_alignment = control.config.horizontal_text_alignment,
+                    },
+                );
+            }
+        },
 
-                const cursor_info: CursorInfo = if (self.isFocused(widget)) blk: {
-                    const cursor_prefix = control.editor.getSubString(0, control.editor.cursor);
+        .panel => |control| {
+            const style = control.config.style orelse self.theme.panel;
+            try renderer.fillRectangle(widget.bounds, style.background);
+            try renderer.drawRectangle(widget.bounds, style.border);
+        },
 
-                    const cursor_position = renderer.measureString(font, cursor_prefix).width;
+        .text_box => |*control| {
+            const theme = control.config.style orelse self.theme.text_box;
 
-                    const scroll_padding_l = 48;
-                    const scroll_padding_r = 16;
-                    const scroll_extra_l = 32;
-                    const view_width = widget.bounds.width - 2 * text_padding;
+            const style = if (self.isFocused(widget))
+                theme.focused
+            else
+                theme.default;
 
-                    const l = std.math.min(view_width, scroll_padding_l);
-                    const r = clampSub(view_width, scroll_padding_r);
+            try renderer.fillRectangle(widget.bounds, style.background);
+            try renderer.drawRectangle(widget.bounds, style.border);
 
-                    const civ = clampSub(cursor_position, control.scroll_offset);
+            const font = self.default_font;
+            const string_height = font.getLineHeight();
+            const measure = BufferFont{ .renderer = renderer, .font = font };
 
-                    if (civ < l) {
-                        // TODO: Scroll to the left
-                        control.scroll_offset = clampSub(control.scroll_offset, l - civ + scroll_extra_l);
-                    } else if (civ > r) {
-                        // TODO: Scroll to the right
-                        control.scroll_offset += civ - r;
-                    }
+            const text_padding = 3;
 
-                    break :blk CursorInfo{
-                        .position = cursor_position,
-                    };
-                } else undefined;
+            control.buffer.setFont(@ptrToInt(font));
+            const line = control.buffer.lineOf(control.cursor);
 
-                try renderer.pushClipRectangle(widget.bounds);
+            // the buffer caches the measured line, so placing the cursor doesn't measure the whole text
+            const cursor_position: u32 = if (self.isFocused(widget)) blk: {
+                const position = try control.buffer.offsetToX(measure, control.cursor);
 
+                const scroll_padding_l = 48;
+                const scroll_padding_r = 16;
+                const scroll_extra_l = 32;
+                const view_width: u32 = widget.bounds.width -| 2 * text_padding;
+
+                const l = std.math.min(view_width, scroll_padding_l);
+                const r = view_width -| scroll_padding_r;
+
+                const civ = position -| control.scroll_offset;
+
+                if (civ < l) {
+                    control.scroll_offset = control.scroll_offset -| (l - civ + scroll_extra_l);
+                } else if (civ > r) {
+                    control.scroll_offset += civ - r;
+                }
+
+                break :blk position;
+            } else undefined;
+
+            try renderer.pushClipRectangle(widget.bounds);
+
+            // only the chunks of the line inside the text box are drawn
+            const scroll = @intCast(i32, std.math.min(control.scroll_offset, std.math.maxInt(i32)));
+            const text_x = @as(i32, widget.bounds.x) + text_padding - scroll;
+            const text_y = widget.bounds.y + clampSub(widget.bounds.height, string_height) / 2;
+
+            var chunks = try control.buffer.chunks(measure, line, scroll, scroll + widget.bounds.width);
+            while (chunks.next()) |chunk| {
                 try renderer.drawString(
                     font,
-                    string,
-                    widget.bounds.x + text_padding - control.scroll_offset,
-                    widget.bounds.y + clampSub(widget.bounds.height, string_height) / 2,
+                    chunk.text,
+                    screenCoord(@as(i64, text_x) + chunk.x),
+                    text_y,
                     Color.white,
                 );
+            }
 
-                if (self.isFocused(widget)) {
-                    const blink_period = 800;
-                    const timer = @mod(types.milliTimestamp(), blink_period);
-                    if (timer >= blink_period / 2) {
-                        try renderer.drawLine(
-                            widget.bounds.x + text_padding + cursor_info.position - control.scroll_offset,
-                            widget.bounds.y + clampSub(widget.bounds.height, string_height) / 2,
-                            widget.bounds.x + text_padding + cursor_info.position - control.scroll_offset,
-                            widget.bounds.y + (widget.bounds.height + string_height) / 2,
-                            Color.white,
-                        );
-                    }
+            if (self.isFocused(widget)) {
+                const timer = @mod(types.milliTimestamp(), text_box_blink_period);
+                if (timer >= text_box_blink_period / 2) {
+                    const cursor_x = screenCoord(@as(i64, text_x) + cursor_position);
+                    try renderer.drawLine(
+                        cursor_x,
+                        text_y,
+                        cursor_x,
+                        widget.bounds.y + (widget.bounds.height + string_height) / 2,
+                        Color.white,
+                    );
                 }
+            }
 
-                try renderer.popClipRectangle();
-            },
+            try renderer.popClipRectangle();
+        },
 
-            .code_editor => |*control| {
-                if (has_code_editor)
-                    control.editor.render();
-            },
+        .code_editor => |*control| {
+            if (has_code_editor)
+                control.editor.render();
+        },
 
-            .label => |control| {
-                const style = control.config.style orelse self.theme.label;
+        .label => |control| {
+            const style = control.config.style orelse self.theme.label;
 
-                const font = control.config.font orelse self.default_font;
-                const color = control.config.text_color orelse style.text_color;
-                try renderer.drawText(font, control.text.get(), widget.bounds, .{
-                    .horizontal_alignment = control.config.horizontal_alignment,
-                    .vertical_alignment = control.config.vertical_alignment,
-                    .color = color,
-                });
-            },
-            .check_box => |control| {
-                try renderer.drawTexture(
+            const font = control.config.font orelse self.default_font;
+            const color = control.config.text_color orelse style.text_color;
+            try renderer.drawText(font, control.text.get(), widget.bounds, .{
+                .horizontal_alignment = control.config.horizontal_alignment,
+                .vertical_alignment = control.config.vertical_alignment,
+                .color = color,
+            });
+        },
+        .check_box => |control| {
+            try renderer.drawTexture(
+                widget.bounds,
+                if (control.is_checked)
+                    self.icons.checkbox_checked
+                else
+                    self.icons.checkbox_unchecked,
+                if (control.config.enabled) Color.white else Color.gray(0x80),
+            );
+        },
+        .radio_button => |control| {
+            try renderer.drawTexture(
+                widget.bounds,
+                if (control.is_checked)
+                    self.icons.radiobutton_checked
+                else
+                    self.icons.radiobutton_unchecked,
+                if (control.config.enabled) Color.white else Color.gray(0x80),
+            );
+        },
+        .image => |control| {
+            if (control.config.source_rect) |source_rect| {
+                try renderer.drawPartialTexture(
                     widget.bounds,
-                    if (control.is_checked)
-                        self.icons.checkbox_checked
-                    else
-                        self.icons.checkbox_unchecked,
-                    if (control.config.enabled) Color.white else Color.gray(0x80),
+                    control.image,
+                    source_rect,
+                    control.config.tint orelse types.Color.white,
                 );
-            },
-            .radio_button => |control| {
+            } else {
                 try renderer.drawTexture(
                     widget.bounds,
-                    if (control.is_checked)
-                        self.icons.radiobutton_checked
-                    else
-                        self.icons.radiobutton_unchecked,
-                    if (control.config.enabled) Color.white else Color.gray(0x80),
+                    control.image,
+                    control.config.tint orelse types.Color.white,
                 );
-            },
-            .image => |control| {
-                if (control.config.source_rect) |source_rect| {
-                    try renderer.drawPartialTexture(
-                        widget.bounds,
-                        control.image,
-                        source_rect,
-                        control.config.tint orelse types.Color.white,
-                    );
-                } else {
-                    try renderer.drawTexture(
-                        widget.bounds,
-                        control.image,
-                        control.config.tint orelse types.Color.white,
-                    );
-                }
-            },
-            .custom => |control| {
-                if (control.config.draw) |draw| {
-                    try draw(control, widget.bounds, renderer, .{
-                        .is_hovered = is_hovered,
-                        .is_pressed = is_pressed,
-                    });
-                }
-            },
-        }
+            }
+        },
+        .custom => |control| {
+            if (control.config.draw) |draw| {
+                try draw(control, widget.bounds, renderer, .{
+                    .is_hovered = is_hovered,
+                    .is_pressed = is_pressed,
+                });
+            }
+        },
     }
 }
 
@@ -1625,6 +1933,89 @@ test "widget re-collection" {
     }
 }
 
+test "widget index matches the widget list" {
+    var ui = try init(std.testing.allocator, null);
+    defer ui.deinit();
+
+    const widget_count = 200;
+
+    var round: usize = 0;
+    while (round < 4) : (round += 1) {
+        {
+            var builder = ui.construct(Size{ .width = 1920, .height = 1080 });
+            defer builder.finish();
+
+            // every pass drops some widgets, adds new ones, and declares each ID twice
+            var i: usize = round * 10;
+            while (i < round * 10 + widget_count) : (i += 1) {
+                try builder.panel(Rectangle{ .x = 0, .y = 0, .width = 10, .height = 10 }, .{ .id = i / 2 });
+            }
+        }
+
+        try std.testing.expectEqual(@as(usize, widget_count), getListLength(ui.active_widgets));
+        try std.testing.expectEqual(@as(usize, widget_count), ui.widget_index.count());
+
+        var it = ui.active_widgets.first;
+        while (it) |node| : (it = node.next) {
+            // the first node with that ID in a linear search must be the indexed one
+            var linear = ui.active_widgets.first;
+            while (linear) |candidate| : (linear = candidate.next) {
+                if (candidate.data.id == node.data.id)
+                    break;
+            }
+            try std.testing.expectEqual(@as(?*WidgetNode, node), linear);
+            try std.testing.expectEqual(@as(?*WidgetNode, node), ui.widget_index.get(node.data.id));
+        }
+    }
+}
+
+test "hit grid finds the same widgets as the linear search" {
+    var ui = try init(std.testing.allocator, null);
+    defer ui.deinit();
+
+    const widget_count = 500;
+    const point_count = 200;
+
+    var prng = std.rand.DefaultPrng.init(0x5EED);
+    const random = prng.random();
+
+    {
+        var builder = ui.construct(Size{ .width = 1920, .height = 1080 });
+        defer builder.finish();
+
+        var i: usize = 0;
+        while (i < widget_count) : (i += 1) {
+            try builder.panel(Rectangle{
+                .x = random.intRangeLessThan(i16, 0, 1920),
+                .y = random.intRangeLessThan(i16, 0, 1080),
+                .width = 120,
+                .height = 60,
+            }, .{ .id = i, .hit_test_visible = (i % 4 != 0) });
+        }
+    }
+    try std.testing.expect(ui.hit_grid_valid);
+
+    const points = try std.testing.allocator.alloc(Point, point_count);
+    defer std.testing.allocator.free(points);
+    for (points) |*p| {
+        p.* = Point{
+            .x = random.intRangeLessThan(i16, 0, 1920),
+            .y = random.intRangeLessThan(i16, 0, 1080),
+        };
+    }
+
+    const indexed_results = try std.testing.allocator.alloc(?*Widget, point_count);
+    defer std.testing.allocator.free(indexed_results);
+    for (points) |p, i| {
+        indexed_results[i] = ui.widgetFromPosition(p);
+    }
+
+    ui.hit_grid_valid = false;
+    for (points) |p, i| {
+        try std.testing.expectEqual(indexed_results[i], ui.widgetFromPosition(p));
+    }
+}
+
 /// A dynamic, potentially allocated string buffer that can store texts.
 const StringBuffer = union(enum) {
     const Self = @This();
@@ -7,12 +7,12 @@
 // Generation parameters:
 // API:        GL_ES_VERSION_2_0
 // Profile:    core
-// Extensions: GL_KHR_debug
+// Extensions: GL_KHR_debug, GL_ANGLE_instanced_arrays, GL_EXT_instanced_arrays
 //
 
 //
 // This file was generated with the following command line:
-// generator /home/felix/projects/libraries/zig-opengl/bin/Debug/net6.0/generator.dll OpenGL-Registry/xml/gl.xml /home/felix/projects/libraries/zyclone/vendor/zero-graphics/src/gl_es_2v0.zig GL_ES_VERSION_2_0 GL_KHR_debug
+// generator /home/felix/projects/libraries/zig-opengl/bin/Debug/net6.0/generator.dll OpenGL-Registry/xml/gl.xml /home/felix/projects/libraries/zyclone/vendor/zero-graphics/src/gl_es_2v0.zig GL_ES_VERSION_2_0 GL_KHR_debug GL_ANGLE_instanced_arrays GL_EXT_instanced_arrays
 //
 
 const std = @import("std");
@@ -1118,6 +1118,88 @@ pub fn load(load_ctx: anytype, get_proc_address: fn(@TypeOf(load_ctx), [:0]const
 }
 };
 
+pub const GL_ANGLE_instanced_arrays = struct {
+pub const VERTEX_ATTRIB_ARRAY_DIVISOR_ANGLE = 0x88FE;
+
+
+pub fn drawArraysInstancedANGLE(_mode: GLenum, _first: GLint, _count: GLsizei, _primcount: GLsizei) callconv(.C) void {
+    return (function_pointers.glDrawArraysInstancedANGLE orelse @panic("glDrawArraysInstancedANGLE was not bound."))(_mode, _first, _count, _primcount);
+}
+
+pub fn drawElementsInstancedANGLE(_mode: GLenum, _count: GLsizei, _type: GLenum, _indices: ?*const anyopaque, _primcount: GLsizei) callconv(.C) void {
+    return (function_pointers.glDrawElementsInstancedANGLE orelse @panic("glDrawElementsInstancedANGLE was not bound."))(_mode, _count, _type, _indices, _primcount);
+}
+
+pub fn vertexAttribDivisorANGLE(_index: GLuint, _divisor: GLuint) callconv(.C) void {
+    return (function_pointers.glVertexAttribDivisorANGLE orelse @panic("glVertexAttribDivisorANGLE was not bound."))(_index, _divisor);
+}
+
+pub fn load(load_ctx: anytype, get_proc_address: fn(@TypeOf(load_ctx), [:0]const u8) ?FunctionPointer) !void {
+    var success = true;
+    if(get_proc_address(load_ctx, "glDrawArraysInstancedANGLE")) |proc| {
+        function_pointers.glDrawArraysInstancedANGLE = @ptrCast(@TypeOf(function_pointers.glDrawArraysInstancedANGLE),  proc);
+    } else {
+        log.err("entry point glDrawArraysInstancedANGLE not found!", .{});
+        success = false;
+    }
+    if(get_proc_address(load_ctx, "glDrawElementsInstancedANGLE")) |proc| {
+        function_pointers.glDrawElementsInstancedANGLE = @ptrCast(@TypeOf(function_pointers.glDrawElementsInstancedANGLE),  proc);
+    } else {
+        log.err("entry point glDrawElementsInstancedANGLE not found!", .{});
+        success = false;
+    }
+    if(get_proc_address(load_ctx, "glVertexAttribDivisorANGLE")) |proc| {
+        function_pointers.glVertexAttribDivisorANGLE = @ptrCast(@TypeOf(function_pointers.glVertexAttribDivisorANGLE),  proc);
+    } else {
+        log.err("entry point glVertexAttribDivisorANGLE not found!", .{});
+        success = false;
+    }
+    if(!success)
+        return error.EntryPointNotFound;
+}
+};
+
+pub const GL_EXT_instanced_arrays = struct {
+pub const VERTEX_ATTRIB_ARRAY_DIVISOR_EXT = 0x88FE;
+
+
+pub fn drawArraysInstancedEXT(_mode: GLenum, _start: GLint, _count: GLsizei, _primcount: GLsizei) callconv(.C) void {
+    return (function_pointers.glDrawArraysInstancedEXT orelse @panic("glDrawArraysInstancedEXT was not bound."))(_mode, _start, _count, _primcount);
+}
+
+pub fn drawElementsInstancedEXT(_mode: GLenum, _count: GLsizei, _type: GLenum, _indices: ?*const anyopaque, _primcount: GLsizei) callconv(.C) void {
+    return (function_pointers.glDrawElementsInstancedEXT orelse @panic("glDrawElementsInstancedEXT was not bound."))(_mode, _count, _type, _indices, _primcount);
+}
+
+pub fn vertexAttribDivisorEXT(_index: GLuint, _divisor: GLuint) callconv(.C) void {
+    return (function_pointers.glVertexAttribDivisorEXT orelse @panic("glVertexAttribDivisorEXT was not bound."))(_index, _divisor);
+}
+
+pub fn load(load_ctx: anytype, get_proc_address: fn(@TypeOf(load_ctx), [:0]const u8) ?FunctionPointer) !void {
+    var success = true;
+    if(get_proc_address(load_ctx, "glDrawArraysInstancedEXT")) |proc| {
+        function_pointers.glDrawArraysInstancedEXT = @ptrCast(@TypeOf(function_pointers.glDrawArraysInstancedEXT),  proc);
+    } else {
+        log.err("entry point glDrawArraysInstancedEXT not found!", .{});
+        success = false;
+    }
+    if(get_proc_address(load_ctx, "glDrawElementsInstancedEXT")) |proc| {
+        function_pointers.glDrawElementsInstancedEXT = @ptrCast(@TypeOf(function_pointers.glDrawElementsInstancedEXT),  proc);
+    } else {
+        log.err("entry point glDrawElementsInstancedEXT not found!", .{});
+        success = false;
+    }
+    if(get_proc_address(load_ctx, "glVertexAttribDivisorEXT")) |proc| {
+        function_pointers.glVertexAttribDivisorEXT = @ptrCast(@TypeOf(function_pointers.glVertexAttribDivisorEXT),  proc);
+    } else {
+        log.err("entry point glVertexAttribDivisorEXT not found!", .{});
+        success = false;
+    }
+    if(!success)
+        return error.EntryPointNotFound;
+}
+};
+
 // Loader API:
 pub fn load(load_ctx: anytype, get_proc_address: fn(@TypeOf(load_ctx), [:0]const u8) ?FunctionPointer) !void {
     var success = true;
@@ -2131,6 +2213,12 @@ const function_signatures = struct {
     const glObjectPtrLabelKHR = fn(_ptr: ?*const anyopaque, _length: GLsizei, _label: [*c]const GLchar) callconv(.C) void;
     const glGetObjectPtrLabelKHR = fn(_ptr: ?*const anyopaque, _bufSize: GLsizei, _length: [*c]GLsizei, _label: [*c]GLchar) callconv(.C) void;
     const glGetPointervKHR = fn(_pname: GLenum, _params: ?*?*anyopaque) callconv(.C) void;
+    const glDrawArraysInstancedANGLE = fn(_mode: GLenum, _first: GLint, _count: GLsizei, _primcount: GLsizei) callconv(.C) void;
+    const glDrawElementsInstancedANGLE = fn(_mode: GLenum, _count: GLsizei, _type: GLenum, _indices: ?*const anyopaque, _primcount: GLsizei) callconv(.C) void;
+    const glVertexAttribDivisorANGLE = fn(_index: GLuint, _divisor: GLuint) callconv(.C) void;
+    const glDrawArraysInstancedEXT = fn(_mode: GLenum, _start: GLint, _count: GLsizei, _primcount: GLsizei) callconv(.C) void;
+    const glDrawElementsInstancedEXT = fn(_mode: GLenum, _count: GLsizei, _type: GLenum, _indices: ?*const anyopaque, _primcount: GLsizei) callconv(.C) void;
+    const glVertexAttribDivisorEXT = fn(_index: GLuint, _divisor: GLuint) callconv(.C) void;
 };
 
 const function_pointers = struct {
@@ -2287,6 +2375,12 @@ const function_pointers = struct {
     var glObjectPtrLabelKHR: ?FnPtr(function_signatures.glObjectPtrLabelKHR) = null;
     var glGetObjectPtrLabelKHR: ?FnPtr(function_signatures.glGetObjectPtrLabelKHR) = null;
     var glGetPointervKHR: ?FnPtr(function_signatures.glGetPointervKHR) = null;
+    var glDrawArraysInstancedANGLE: ?FnPtr(function_signatures.glDrawArraysInstancedANGLE) = null;
+    var glDrawElementsInstancedANGLE: ?FnPtr(function_signatures.glDrawElementsInstancedANGLE) = null;
+    var glVertexAttribDivisorANGLE: ?FnPtr(function_signatures.glVertexAttribDivisorANGLE) = null;
+    var glDrawArraysInstancedEXT: ?FnPtr(function_signatures.glDrawArraysInstancedEXT) = null;
+    var glDrawElementsInstancedEXT: ?FnPtr(function_signatures.glDrawElementsInstancedEXT) = null;
+    var glVertexAttribDivisorEXT: ?FnPtr(function_signatures.glVertexAttribDivisorEXT) = null;
 };
 
 test {
@@ -218,9 +218,18 @@ pub fn main() !void {
         try app.resize(@intCast(u15, width), @intCast(u15, height));
     }
 
+    var last_statistics_log = milliTimestamp();
+
     while (true) {
         var event: c.SDL_Event = undefined;
-        while (c.SDL_PollEvent(&event) != 0) {
+        var event_source = SdlEventSource{ .event = &event };
+
+        // In on_demand redraw mode, this blocks until input arrives or a timer is due.
+        var has_event = app.scheduler.waitForEvent(&event_source);
+        while (has_event) : (has_event = event_source.poll()) {
+            if (eventNeedsRedraw(event)) {
+                app.requestRedraw();
+            }
             switch (event.type) {
                 c.SDL_QUIT => {
                     try input_queue.pushEvent(.quit);
@@ -295,11 +304,60 @@ pub fn main() !void {
         const still_running = app.update() catch |e| return logAppError("update", @errorReturnTrace(), e);
         if (still_running == false)
             break;
-        app.render() catch |e| return logAppError("render", @errorReturnTrace(), e);
-        c.SDL_GL_SwapWindow(window);
+
+        const now = milliTimestamp();
+        if (app.scheduler.beginFrame(now)) {
+            app.render() catch |e| return logAppError("render", @errorReturnTrace(), e);
+            c.SDL_GL_SwapWindow(window);
+        }
+
+        if (app.scheduler.mode == .on_demand and now - last_statistics_log >= 10_000) {
+            const stats = app.scheduler.statistics;
+            logger.debug("frames: {} rendered, {} skipped, {} ms idle", .{ stats.rendered_frames, stats.skipped_frames, stats.idle_time });
+            last_statistics_log = now;
+        }
     }
 }
 
+/// Adapts the SDL event queue for `RedrawScheduler.waitForEvent`.
+const SdlEventSource = struct {
+    event: *c.SDL_Event,
+
+    pub fn now(source: *SdlEventSource) i64 {
+        _ = source;
+        return milliTimestamp();
+    }
+
+    pub fn poll(source: *SdlEventSource) bool {
+        return c.SDL_PollEvent(source.event) != 0;
+    }
+
+    pub fn wait(source: *SdlEventSource, timeout: ?u32) bool {
+        if (timeout) |ms| {
+            return c.SDL_WaitEventTimeout(source.event, @intCast(c_int, ms)) != 0;
+        }
+        return c.SDL_WaitEvent(source.event) != 0;
+    }
+};
+
+/// Returns `true` for events that may change what is on the screen.
+fn eventNeedsRedraw(event: c.SDL_Event) bool {
+    return switch (event.type) {
+        c.SDL_QUIT,
+        c.SDL_MOUSEMOTION,
+        c.SDL_MOUSEBUTTONDOWN,
+        c.SDL_MOUSEBUTTONUP,
+        c.SDL_KEYDOWN,
+        c.SDL_KEYUP,
+        c.SDL_TEXTINPUT,
+        => true,
+        c.SDL_WINDOWEVENT => event.window.event == c.SDL_WINDOWEVENT_SIZE_CHANGED or
+            event.window.event == c.SDL_WINDOWEVENT_EXPOSED or
+            event.window.event == c.SDL_WINDOWEVENT_SHOWN,
+        else => false,
+    };
+}
+
 fn translateSdlScancode(scancode: c.SDL_Scancode) ?zerog.Input.Scancode {
     const SC = zerog.Input.Scancode;
     return switch (scancode) {
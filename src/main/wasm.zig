@@ -518,6 +518,7 @@ const WebGL = struct {
     pub extern "webgl" fn genVertexArrays(_n: gles.GLsizei, _arrays: [*c]gles.GLuint) void;
     pub extern "webgl" fn drawArrays(type: c_uint, offset: c_uint, count: c_int) void;
     pub extern "webgl" fn drawElements(mode: gles.GLenum, count: gles.GLsizei, type: gles.GLenum, offset: ?*const anyopaque) void;
+    pub extern "webgl" fn drawElementsInstanced(mode: gles.GLenum, count: gles.GLsizei, type: gles.GLenum, offset: ?*const anyopaque, instance_count: gles.GLsizei) void;
     pub extern "webgl" fn enable(x: c_uint) void;
     pub extern "webgl" fn enableVertexAttribArray(x: c_uint) void;
     pub extern "webgl" fn framebufferTexture2D(target: gles.GLenum, attachment: gles.GLenum, textarget: gles.GLenum, texture: gles.GLuint, level: gles.GLint) void;
@@ -549,6 +550,7 @@ const WebGL = struct {
     pub extern "webgl" fn uniformMatrix4fv(location_id: c_int, data_len: c_int, transpose: c_uint, data_ptr: [*]const f32) void;
     pub extern "webgl" fn useProgram(program_id: c_uint) void;
     pub extern "webgl" fn vertexAttribPointer(attrib_location: c_uint, size: c_uint, type: c_uint, normalize: c_uint, stride: c_uint, offset: ?*const anyopaque) void;
+    pub extern "webgl" fn vertexAttribDivisor(index: gles.GLuint, divisor: gles.GLuint) void;
     pub extern "webgl" fn viewport(x: c_int, y: c_int, width: c_int, height: c_int) void;
     pub extern "webgl" fn scissor(x: gles.GLint, y: gles.GLint, width: gles.GLsizei, height: gles.GLsizei) void;
 
@@ -20,8 +20,6 @@ const Rectangle = types.Rectangle;
 const Size = types.Size;
 const Point = types.Point;
 
-const Vertex = types.ResourceManager.Vertex;
-
 pub const Vec3 = [3]f32;
 pub const Mat4 = [4][4]f32;
 
@@ -29,6 +27,12 @@ pub const DrawError = error{OutOfMemory};
 pub const CreateFontError = error{ OutOfMemory, InvalidFontFile };
 pub const InitError = error{ OutOfMemory, GraphicsApiFailure } || ResourceManager.CreateResourceDataError;
 
+/// Vertex attributes used in this renderer
+const vertex_attributes = .{
+    .vPosition = 0,
+    .vColor = 1,
+};
+
 const Uniforms = struct {
     uViewProjMatrix: gl.GLint,
 };
@@ -37,10 +41,24 @@ shader_program: *ResourceManager.Shader,
 
 vertex_buffer: *ResourceManager.Buffer,
 
-/// list of CCW triangles that will be rendered 
+/// list of lines and CCW triangles that will be rendered
 vertices: std.ArrayList(Vertex),
 draw_calls: std.ArrayList(DrawCall),
 
+/// Shapes that are drawn by every call to `render` until they expire, see `beginRetained`.
+retained_shapes: std.ArrayList(RetainedShape),
+
+/// All retained shapes concatenated, rebuilt and uploaded into `retained_buffer` when
+/// `retained_dirty` is set.
+retained_vertices: std.ArrayList(Vertex),
+retained_draw_calls: std.ArrayList(DrawCall),
+retained_buffer: *ResourceManager.Buffer,
+retained_dirty: bool = false,
+
+/// Start of the retained shape that is currently recorded.
+recording: ?Recording = null,
+next_retained_handle: u32 = 0,
+
 allocator: std.mem.Allocator,
 
 resources: *ResourceManager,
@@ -48,14 +66,13 @@ resources: *ResourceManager,
 pub fn init(resources: *ResourceManager, allocator: std.mem.Allocator) InitError!Self {
     const vertex_source =
         \\attribute vec3 vPosition;
-        \\attribute vec3 vNormal;
-        \\attribute vec2 vUV;
+        \\attribute vec4 vColor;
         \\uniform mat4 uViewProjMatrix;
         \\varying vec4 aColor;
         \\void main()
         \\{
         \\  gl_Position = uViewProjMatrix * vec4(vPosition, 1.0);
-        \\  aColor = vec4(vNormal, vUV.x);
+        \\  aColor = vColor;
         \\}
     ;
     const fragment_source =
@@ -70,19 +87,27 @@ pub fn init(resources: *ResourceManager, allocator: std.mem.Allocator) InitError
     const shader_program = try resources.createShader(ResourceManager.BasicShader{
         .vertex_shader = vertex_source,
         .fragment_shader = fragment_source,
-        .attributes = glesh.attributes(types.ResourceManager.Geometry.attributes),
+        .attributes = glesh.attributes(vertex_attributes),
     });
     errdefer resources.destroyShader(shader_program);
 
     const vertex_buffer = try resources.createBuffer(ResourceManager.EmptyBuffer{});
     errdefer resources.destroyBuffer(vertex_buffer);
 
+    const retained_buffer = try resources.createBuffer(ResourceManager.EmptyBuffer{});
+    errdefer resources.destroyBuffer(retained_buffer);
+
     var self = Self{
         .resources = resources,
         .shader_program = shader_program,
         .vertices = std.ArrayList(Vertex).init(allocator),
         .vertex_buffer = vertex_buffer,
 
+        .retained_shapes = std.ArrayList(RetainedShape).init(allocator),
+        .retained_vertices = std.ArrayList(Vertex).init(allocator),
+        .retained_draw_calls = std.ArrayList(DrawCall).init(allocator),
+        .retained_buffer = retained_buffer,
+
         .allocator = allocator,
         .draw_calls = std.ArrayList(DrawCall).init(allocator),
     };
@@ -92,35 +117,47 @@ pub fn init(resources: *ResourceManager, allocator: std.mem.Allocator) InitError
 
 pub fn deinit(self: *Self) void {
     self.reset();
+    self.clearRetained();
 
     self.resources.destroyBuffer(self.vertex_buffer);
+    self.resources.destroyBuffer(self.retained_buffer);
     self.resources.destroyShader(self.shader_program);
     self.draw_calls.deinit();
     self.vertices.deinit();
+    self.retained_shapes.deinit();
+    self.retained_vertices.deinit();
+    self.retained_draw_calls.deinit();
     self.* = undefined;
 }
 
 /// Resets the state of the renderer and prepares a fresh new frame.
+/// Retained shapes are kept, a shape that is still recorded is discarded.
 pub fn reset(self: *Self) void {
     self.draw_calls.shrinkRetainingCapacity(0);
     self.vertices.shrinkRetainingCapacity(0);
+    self.recording = null;
 }
 
 /// Renders the currently contained data to the screen.
-pub fn render(self: Self, viewProjectionMatrix: Mat4) void {
-    glesh.enableAttributes(types.ResourceManager.Geometry.attributes);
-    defer glesh.disableAttributes(types.ResourceManager.Geometry.attributes);
+/// Each call counts towards the lifetime of the retained shapes.
+pub fn render(self: *Self, viewProjectionMatrix: Mat4) void {
+    std.debug.assert(self.recording == null);
+
+    self.expireRetained();
+    if (self.retained_dirty) {
+        self.rebuildRetained() catch {
+            logger.warn("out of memory, skipping retained debug shapes", .{});
+            self.retained_vertices.shrinkRetainingCapacity(0);
+            self.retained_draw_calls.shrinkRetainingCapacity(0);
+        };
+    }
+
+    glesh.enableAttributes(vertex_attributes);
+    defer glesh.disableAttributes(vertex_attributes);
 
     gl.enable(gl.DEPTH_TEST);
     gl.disable(gl.BLEND);
 
-    gl.bindBuffer(gl.ARRAY_BUFFER, self.vertex_buffer.instance.?);
-    gl.bufferData(gl.ARRAY_BUFFER, @intCast(gl.GLsizeiptr, @sizeOf(Vertex) * self.vertices.items.len), self.vertices.items.ptr, gl.STATIC_DRAW);
-
-    gl.vertexAttribPointer(types.ResourceManager.Geometry.attributes.vPosition, 3, gl.FLOAT, gl.FALSE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "x")));
-    gl.vertexAttribPointer(types.ResourceManager.Geometry.attributes.vNormal, 3, gl.FLOAT, gl.TRUE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "nx")));
-    gl.vertexAttribPointer(types.ResourceManager.Geometry.attributes.vUV, 2, gl.FLOAT, gl.FALSE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "u")));
-
     var uniforms = glesh.fetchUniforms(self.shader_program.instance.?, Uniforms);
 
     gl.useProgram(self.shader_program.instance.?);
@@ -131,7 +168,28 @@ pub fn render(self: Self, viewProjectionMatrix: Mat4) void {
     gl.polygonOffset(0.0, 15.0);
     defer gl.polygonOffset(0.0, 0.0);
 
-    for (self.draw_calls.items) |draw_call| {
+    // the retained buffer is only uploaded when a shape was added or removed
+    gl.bindBuffer(gl.ARRAY_BUFFER, self.retained_buffer.instance.?);
+    if (self.retained_dirty) {
+        gl.bufferData(gl.ARRAY_BUFFER, @intCast(gl.GLsizeiptr, @sizeOf(Vertex) * self.retained_vertices.items.len), self.retained_vertices.items.ptr, gl.STATIC_DRAW);
+        self.retained_dirty = false;
+    }
+    drawCalls(self.retained_draw_calls.items);
+
+    gl.bindBuffer(gl.ARRAY_BUFFER, self.vertex_buffer.instance.?);
+    gl.bufferData(gl.ARRAY_BUFFER, @intCast(gl.GLsizeiptr, @sizeOf(Vertex) * self.vertices.items.len), self.vertices.items.ptr, gl.STREAM_DRAW);
+    drawCalls(self.draw_calls.items);
+}
+
+/// Draws `draw_calls` from the bound vertex buffer.
+fn drawCalls(draw_calls: []const DrawCall) void {
+    if (draw_calls.len == 0)
+        return;
+
+    gl.vertexAttribPointer(vertex_attributes.vPosition, 3, gl.FLOAT, gl.FALSE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "x")));
+    gl.vertexAttribPointer(vertex_attributes.vColor, 4, gl.UNSIGNED_BYTE, gl.TRUE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "r")));
+
+    for (draw_calls) |draw_call| {
         gl.drawArrays(
             draw_call.primitive_type,
             @intCast(gl.GLsizei, draw_call.offset),
@@ -140,16 +198,26 @@ pub fn render(self: Self, viewProjectionMatrix: Mat4) void {
     }
 }
 
+pub const Vertex = extern struct {
+    x: f32,
+    y: f32,
+    z: f32,
+
+    r: u8,
+    g: u8,
+    b: u8,
+    a: u8,
+};
+
 fn vertex(pos: Vec3, color: Color) Vertex {
     return Vertex{
         .x = pos[0],
         .y = pos[1],
         .z = pos[2],
-        .u = @intToFloat(f32, color.a) / 255.0,
-        .v = 0,
-        .nx = @intToFloat(f32, color.r) / 255.0,
-        .ny = @intToFloat(f32, color.g) / 255.0,
-        .nz = @intToFloat(f32, color.b) / 255.0,
+        .r = color.r,
+        .g = color.g,
+        .b = color.b,
+        .a = color.a,
     };
 }
 
@@ -165,17 +233,31 @@ fn endDrawCall(self: *Self, dc: DrawCall) !void {
     var dc_copy = dc;
     dc_copy.count = self.vertices.items.len - dc.offset;
     if (dc_copy.count > 0) {
-        // TODO: Implement draw call merging
-        try self.draw_calls.append(dc_copy);
+        // calls before the recorded shape must not swallow its vertices
+        const first = if (self.recording) |recording| recording.draw_calls else 0;
+        try appendMerged(&self.draw_calls, first, dc_copy);
     }
 }
 
+/// Appends `dc` to `draw_calls`, or extends the last one if it has the same primitive
+/// type and ends where `dc` starts. Only calls from index `first` on are extended.
+fn appendMerged(draw_calls: *std.ArrayList(DrawCall), first: usize, dc: DrawCall) !void {
+    if (draw_calls.items.len > first) {
+        const last = &draw_calls.items[draw_calls.items.len - 1];
+        if (last.primitive_type == dc.primitive_type and last.offset + last.count == dc.offset) {
+            last.count += dc.count;
+            return;
+        }
+    }
+    try draw_calls.append(dc);
+}
+
 fn resetDrawCall(self: *Self, dc: DrawCall) void {
     self.vertices.shrinkRetainingCapacity(dc.offset);
 }
 
 pub fn fillTriangle(self: *Self, v0: Vec3, v1: Vec3, v2: Vec3, color: Color) !void {
-    var dc = self.beginDrawCall(gl.TRIANGLE_STRIP);
+    var dc = self.beginDrawCall(gl.TRIANGLES);
     errdefer self.resetDrawCall(dc);
 
     try self.vertices.append(vertex(v0, color));
@@ -186,7 +268,7 @@ pub fn fillTriangle(self: *Self, v0: Vec3, v1: Vec3, v2: Vec3, color: Color) !vo
 }
 
 pub fn drawLine(self: *Self, v0: Vec3, v1: Vec3, color: Color) !void {
-    var dc = self.beginDrawCall(gl.LINE_STRIP);
+    var dc = self.beginDrawCall(gl.LINES);
     errdefer self.resetDrawCall(dc);
 
     try self.vertices.append(vertex(v0, color));
@@ -196,7 +278,7 @@ pub fn drawLine(self: *Self, v0: Vec3, v1: Vec3, color: Color) !void {
 }
 
 pub fn drawTriangle(self: *Self, v0: Vec3, v1: Vec3, v2: Vec3, color: Color) !void {
-    var dc = self.beginDrawCall(gl.LINE_STRIP);
+    var dc = self.beginDrawCall(gl.LINES);
     errdefer self.resetDrawCall(dc);
 
     try self.vertices.append(vertex(v0, color));
@@ -209,6 +291,315 @@ pub fn drawTriangle(self: *Self, v0: Vec3, v1: Vec3, v2: Vec3, color: Color) !vo
     try self.endDrawCall(dc);
 }
 
+/// Draws the edges of the axis aligned box from `min` to `max`.
+pub fn drawBox(self: *Self, min: Vec3, max: Vec3, color: Color) !void {
+    try self.drawOrientedBox(.{
+        .{ 0.5 * (max[0] - min[0]), 0, 0, 0 },
+        .{ 0, 0.5 * (max[1] - min[1]), 0, 0 },
+        .{ 0, 0, 0.5 * (max[2] - min[2]), 0 },
+        .{ 0.5 * (max[0] + min[0]), 0.5 * (max[1] + min[1]), 0.5 * (max[2] + min[2]), 1 },
+    }, color);
+}
+
+/// Draws the edges of the cube from -1 to 1, transformed by `transform`.
+pub fn drawOrientedBox(self: *Self, transform: Mat4, color: Color) !void {
+    try self.drawShape(&shapes.box, transform, color);
+}
+
+/// Draws a sphere as three circles around its axes.
+pub fn drawSphere(self: *Self, center: Vec3, radius: f32, color: Color) !void {
+    try self.drawShape(&shapes.sphere, .{
+        .{ radius, 0, 0, 0 },
+        .{ 0, radius, 0, 0 },
+        .{ 0, 0, radius, 0 },
+        .{ center[0], center[1], center[2], 1 },
+    }, color);
+}
+
+/// Draws a grid of `shapes.grid_cells`² cells from -1 to 1 in the XZ plane, transformed by `transform`.
+pub fn drawGrid(self: *Self, transform: Mat4, color: Color) !void {
+    try self.drawShape(&shapes.grid, transform, color);
+}
+
+/// Draws the unit X, Y and Z axes of `transform` in red, green and blue.
+pub fn drawAxes(self: *Self, transform: Mat4) !void {
+    try self.drawShape(&shapes.axis_x, transform, Color.rgb(0xFF, 0x00, 0x00));
+    try self.drawShape(&shapes.axis_y, transform, Color.rgb(0x00, 0xFF, 0x00));
+    try self.drawShape(&shapes.axis_z, transform, Color.rgb(0x00, 0x00, 0xFF));
+}
+
+/// Draws the edges of the view frustum of the camera with the given `view_projection` matrix.
+/// Nothing is drawn if the matrix is not invertible.
+pub fn drawFrustum(self: *Self, view_projection: Mat4, color: Color) !void {
+    const inverse = invert(view_projection) orelse return;
+    try self.drawShape(&shapes.box, inverse, color);
+}
+
+/// Draws the line list `points`, each point transformed by `transform` including the perspective divide.
+fn drawShape(self: *Self, points: []const Vec3, transform: Mat4, color: Color) !void {
+    var dc = self.beginDrawCall(gl.LINES);
+    errdefer self.resetDrawCall(dc);
+
+    try self.vertices.ensureUnusedCapacity(points.len);
+    for (points) |point| {
+        self.vertices.appendAssumeCapacity(vertex(transformPoint(transform, point), color));
+    }
+
+    try self.endDrawCall(dc);
+}
+
+fn transformPoint(m: Mat4, p: Vec3) Vec3 {
+    var result: [4]f32 = undefined;
+    for (result) |*v, i| {
+        v.* = m[0][i] * p[0] + m[1][i] * p[1] + m[2][i] * p[2] + m[3][i];
+    }
+    return .{ result[0] / result[3], result[1] / result[3], result[2] / result[3] };
+}
+
+/// Returns the inverse of `m` or null if it is singular.
+fn invert(m: Mat4) ?Mat4 {
+    const a = @bitCast([16]f32, m);
+    var inv: [16]f32 = undefined;
+
+    inv[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+    inv[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+    inv[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+    inv[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+    inv[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+    inv[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+    inv[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+    inv[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+    inv[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+    inv[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+    inv[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+    inv[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+    inv[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+    inv[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+    inv[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+    inv[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+    const det = a[0] * inv[0] + a[1] * inv[4] + a[2] * inv[8] + a[3] * inv[12];
+    if (det == 0)
+        return null;
+
+    for (inv) |*v| {
+        v.* /= det;
+    }
+    return @bitCast(Mat4, inv);
+}
+
+/// Line lists of the unit shapes, generated at compile time.
+pub const shapes = struct {
+    /// Number of segments of each circle of `sphere`.
+    pub const circle_segments = 32;
+    /// Number of cells along each side of `grid`.
+    pub const grid_cells = 10;
+
+    /// The 12 edges of the cube from -1 to 1.
+    pub const box = blk: {
+        var lines: [24]Vec3 = undefined;
+        var n = 0;
+        var i = 0;
+        while (i < 8) : (i += 1) {
+            for ([3]comptime_int{ 1, 2, 4 }) |bit| {
+                if ((i & bit) == 0) {
+                    lines[n] = corner(i);
+                    lines[n + 1] = corner(i | bit);
+                    n += 2;
+                }
+            }
+        }
+        break :blk lines;
+    };
+
+    fn corner(i: comptime_int) Vec3 {
+        return .{
+            if (i & 1 != 0) 1 else -1,
+            if (i & 2 != 0) 1 else -1,
+            if (i & 4 != 0) 1 else -1,
+        };
+    }
+
+    /// Three circles of radius 1 around the origin, one in each axis plane.
+    pub const sphere = blk: {
+        @setEvalBranchQuota(10_000);
+        var lines: [3 * 2 * circle_segments]Vec3 = undefined;
+        for ([3]comptime_int{ 0, 1, 2 }) |axis| {
+            var s = 0;
+            while (s < circle_segments) : (s += 1) {
+                for ([2]comptime_int{ 0, 1 }) |end| {
+                    const angle = 2.0 * std.math.pi * @as(f32, s + end) / circle_segments;
+                    var p = Vec3{ 0, 0, 0 };
+                    p[(axis + 1) % 3] = @cos(angle);
+                    p[(axis + 2) % 3] = @sin(angle);
+                    lines[2 * (axis * circle_segments + s) + end] = p;
+                }
+            }
+        }
+        break :blk lines;
+    };
+
+    /// Lines from -1 to 1 along X and Z in the XZ plane.
+    pub const grid = blk: {
+        var lines: [4 * (grid_cells + 1)]Vec3 = undefined;
+        var i = 0;
+        while (i <= grid_cells) : (i += 1) {
+            const t = -1.0 + 2.0 * @as(f32, i) / grid_cells;
+            lines[4 * i + 0] = .{ t, 0, -1 };
+            lines[4 * i + 1] = .{ t, 0, 1 };
+            lines[4 * i + 2] = .{ -1, 0, t };
+            lines[4 * i + 3] = .{ 1, 0, t };
+        }
+        break :blk lines;
+    };
+
+    pub const axis_x = [2]Vec3{ .{ 0, 0, 0 }, .{ 1, 0, 0 } };
+    pub const axis_y = [2]Vec3{ .{ 0, 0, 0 }, .{ 0, 1, 0 } };
+    pub const axis_z = [2]Vec3{ .{ 0, 0, 0 }, .{ 0, 0, 1 } };
+};
+
+/// How long a retained shape is drawn.
+pub const Lifetime = union(enum) {
+    /// The shape is drawn by this many calls to `render`.
+    frames: u32,
+    /// The shape is drawn until this many seconds have passed.
+    seconds: f32,
+    /// The shape is drawn until it is removed with `removeRetained`.
+    forever,
+};
+
+/// Identifies a retained shape.
+pub const RetainedHandle = enum(u32) { _ };
+
+const RetainedShape = struct {
+    handle: RetainedHandle,
+    /// remaining calls to `render`
+    frames: ?u32,
+    /// `types.milliTimestamp` after which the shape expires
+    deadline: ?i64,
+    /// draw call offsets are relative to `vertices`
+    vertices: []Vertex,
+    draw_calls: []DrawCall,
+};
+
+const Recording = struct {
+    vertices: usize,
+    draw_calls: usize,
+};
+
+/// Starts recording a retained shape. Everything drawn until `endRetained` is kept and
+/// drawn by each call to `render` without being submitted again, which is best for static
+/// debug geometry like level bounds or navigation meshes.
+pub fn beginRetained(self: *Self) void {
+    std.debug.assert(self.recording == null);
+    self.recording = Recording{
+        .vertices = self.vertices.items.len,
+        .draw_calls = self.draw_calls.items.len,
+    };
+}
+
+/// Finishes the shape started by `beginRetained`. It is drawn for the given `lifetime`.
+pub fn endRetained(self: *Self, lifetime: Lifetime) !RetainedHandle {
+    const recording = self.recording.?;
+
+    const vertices = try self.allocator.dupe(Vertex, self.vertices.items[recording.vertices..]);
+    errdefer self.allocator.free(vertices);
+
+    const draw_calls = try self.allocator.dupe(DrawCall, self.draw_calls.items[recording.draw_calls..]);
+    errdefer self.allocator.free(draw_calls);
+    for (draw_calls) |*dc| {
+        dc.offset -= recording.vertices;
+    }
+
+    const handle = @intToEnum(RetainedHandle, self.next_retained_handle);
+    try self.retained_shapes.append(RetainedShape{
+        .handle = handle,
+        .frames = if (lifetime == .frames) lifetime.frames else null,
+        .deadline = if (lifetime == .seconds)
+            types.milliTimestamp() + @floatToInt(i64, 1000.0 * lifetime.seconds)
+        else
+            null,
+        .vertices = vertices,
+        .draw_calls = draw_calls,
+    });
+    self.next_retained_handle +%= 1;
+    self.retained_dirty = true;
+
+    self.vertices.shrinkRetainingCapacity(recording.vertices);
+    self.draw_calls.shrinkRetainingCapacity(recording.draw_calls);
+    self.recording = null;
+
+    return handle;
+}
+
+/// Removes a retained shape before it expires. Does nothing if it already expired.
+pub fn removeRetained(self: *Self, handle: RetainedHandle) void {
+    for (self.retained_shapes.items) |shape, i| {
+        if (shape.handle == handle) {
+            self.freeShape(self.retained_shapes.swapRemove(i));
+            self.retained_dirty = true;
+            return;
+        }
+    }
+}
+
+/// Removes all retained shapes.
+pub fn clearRetained(self: *Self) void {
+    for (self.retained_shapes.items) |shape| {
+        self.freeShape(shape);
+    }
+    self.retained_shapes.shrinkRetainingCapacity(0);
+    self.retained_dirty = true;
+}
+
+fn freeShape(self: *Self, shape: RetainedShape) void {
+    self.allocator.free(shape.vertices);
+    self.allocator.free(shape.draw_calls);
+}
+
+/// Counts down the frame lifetimes and removes all expired shapes.
+fn expireRetained(self: *Self) void {
+    if (self.retained_shapes.items.len == 0)
+        return;
+
+    const now = types.milliTimestamp();
+    var i: usize = 0;
+    while (i < self.retained_shapes.items.len) {
+        const shape = &self.retained_shapes.items[i];
+        var expired = false;
+        if (shape.frames) |*frames| {
+            expired = (frames.* == 0);
+            frames.* -|= 1;
+        }
+        if (shape.deadline) |deadline| {
+            expired = expired or (now >= deadline);
+        }
+
+        if (expired) {
+            self.freeShape(self.retained_shapes.swapRemove(i));
+            self.retained_dirty = true;
+        } else {
+            i += 1;
+        }
+    }
+}
+
+/// Concatenates all retained shapes into `retained_vertices` and merges their draw calls.
+fn rebuildRetained(self: *Self) !void {
+    self.retained_vertices.shrinkRetainingCapacity(0);
+    self.retained_draw_calls.shrinkRetainingCapacity(0);
+
+    for (self.retained_shapes.items) |shape| {
+        const offset = self.retained_vertices.items.len;
+        try self.retained_vertices.appendSlice(shape.vertices);
+        for (shape.draw_calls) |dc| {
+            var moved = dc;
+            moved.offset += offset;
+            try appendMerged(&self.retained_draw_calls, 0, moved);
+        }
+    }
+}
+
 const DrawCall = struct {
     offset: usize,
     count: usize,
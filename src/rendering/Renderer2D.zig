@@ -342,6 +342,12 @@ fn getGlyphInternal(self: *Self, font: *Font, codepoint: u21) !Glyph {
     return gop.value_ptr.*;
 }
 
+/// Clamps a coordinate of content that may be scrolled far outside of the screen
+/// to the range the draw functions accept.
+pub fn screenCoord(value: i64) i16 {
+    return @intCast(i16, std.math.clamp(value, std.math.minInt(i16), std.math.maxInt(i16)));
+}
+
 fn scaleInt(ival: isize, scale: f32) i16 {
     return @intCast(i16, @floatToInt(isize, @round(@intToFloat(f32, ival) * scale)));
 }
@@ -558,6 +564,113 @@ pub fn reset(self: *Self) void {
     self.vertices.shrinkRetainingCapacity(0);
 }
 
+/// A position in the stream of draw calls, see `mark` and `record`.
+pub const Mark = struct {
+    draw_calls: usize,
+    vertices: usize,
+};
+
+/// A copy of the draw calls and vertices emitted between a `mark` and `record`.
+/// It can be appended to later frames with `replay` without generating the geometry again.
+/// Keeps all referenced textures alive until it is cleared.
+pub const Recording = struct {
+    draw_calls: std.ArrayListUnmanaged(DrawCall) = .{},
+    vertices: std.ArrayListUnmanaged(Vertex) = .{},
+
+    /// Releases the referenced textures, but keeps the memory.
+    pub fn clear(recording: *Recording, renderer: *Self) void {
+        for (recording.draw_calls.items) |draw_call| {
+            if (draw_call == .draw_vertices) {
+                if (draw_call.draw_vertices.texture) |tex| {
+                    renderer.resources.destroyTexture(tex);
+                }
+            }
+        }
+        recording.draw_calls.shrinkRetainingCapacity(0);
+        recording.vertices.shrinkRetainingCapacity(0);
+    }
+
+    pub fn deinit(recording: *Recording, renderer: *Self) void {
+        recording.clear(renderer);
+        recording.draw_calls.deinit(renderer.allocator);
+        recording.vertices.deinit(renderer.allocator);
+        recording.* = undefined;
+    }
+};
+
+/// Returns the current end of the draw call stream.
+pub fn mark(self: Self) Mark {
+    return Mark{
+        .draw_calls = self.draw_calls.items.len,
+        .vertices = self.vertices.items.len,
+    };
+}
+
+/// Replaces the contents of `recording` with everything that was drawn since `start`.
+pub fn record(self: *Self, start: Mark, recording: *Recording) DrawError!void {
+    recording.clear(self);
+
+    try recording.vertices.appendSlice(self.allocator, self.vertices.items[start.vertices..]);
+
+    // The first triangles may have been merged into the draw call before `start`.
+    if (start.draw_calls > 0 and self.draw_calls.items[start.draw_calls - 1] == .draw_vertices) {
+        var head = self.draw_calls.items[start.draw_calls - 1].draw_vertices;
+        if (head.offset + head.count > start.vertices) {
+            head.count = head.offset + head.count - start.vertices;
+            head.offset = 0;
+            try recording.draw_calls.append(self.allocator, DrawCall{ .draw_vertices = head });
+            if (head.texture) |tex| {
+                self.resources.retainTexture(tex);
+            }
+        }
+    }
+
+    for (self.draw_calls.items[start.draw_calls..]) |draw_call| {
+        var copy = draw_call;
+        if (copy == .draw_vertices) {
+            copy.draw_vertices.offset -= start.vertices;
+        }
+        try recording.draw_calls.append(self.allocator, copy);
+        if (copy == .draw_vertices) {
+            if (copy.draw_vertices.texture) |tex| {
+                self.resources.retainTexture(tex);
+            }
+        }
+    }
+}
+
+/// Appends the draw calls and vertices stored in `recording`.
+pub fn replay(self: *Self, recording: Recording) DrawError!void {
+    const base = self.vertices.items.len;
+    try self.vertices.appendSlice(recording.vertices.items);
+    try self.draw_calls.ensureUnusedCapacity(recording.draw_calls.items.len);
+
+    for (recording.draw_calls.items) |draw_call, i| {
+        var copy = draw_call;
+        if (copy == .draw_vertices) {
+            const vertices = copy.draw_vertices;
+
+            // continue the previous draw call if the state matches
+            if (i == 0 and self.draw_calls.items.len > 0 and self.draw_calls.items[self.draw_calls.items.len - 1] == .draw_vertices) {
+                const previous = &self.draw_calls.items[self.draw_calls.items.len - 1].draw_vertices;
+                if (previous.texture == vertices.texture and
+                    previous.offset + previous.count == base and
+                    cmpRotation(previous.rot_radians, previous.rot_about, vertices.rot_radians, vertices.rot_about))
+                {
+                    previous.count += vertices.count;
+                    continue;
+                }
+            }
+
+            copy.draw_vertices.offset += base;
+            if (vertices.texture) |tex| {
+                self.resources.retainTexture(tex);
+            }
+        }
+        self.draw_calls.appendAssumeCapacity(copy);
+    }
+}
+
 /// Renders the currently contained data to the screen.
 pub fn render(self: Self, screen_size: Size) void {
     glesh.enableAttributes(vertex_attributes);
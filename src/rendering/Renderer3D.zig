@@ -7,6 +7,10 @@ const glesh = @import("gles-helper.zig");
 
 const ResourceManager = @import("ResourceManager.zig");
 const ResourcePool = @import("resource_pool.zig").ResourcePool;
+const skinning = @import("skinning.zig");
+
+pub const Frustum = @import("frustum.zig").Frustum;
+pub const occlusion = @import("occlusion.zig");
 
 const zigimg = @import("zigimg");
 
@@ -23,12 +27,49 @@ const Point = types.Point;
 const Mat4 = [4][4]f32;
 const Mat3 = [3][3]f32;
 
-pub const DrawError = error{OutOfMemory};
+pub const DrawError = error{ OutOfMemory, NotSkinned, InvalidPalette };
 pub const InitError = ResourceManager.CreateResourceDataError || error{ OutOfMemory, GraphicsApiFailure };
 
 const attributes = Geometry.attributes;
 
+const skinned_attributes = .{
+    .vPosition = attributes.vPosition,
+    .vNormal = attributes.vNormal,
+    .vUV = attributes.vUV,
+    .vBoneIndices = Geometry.skin_attributes.vBoneIndices,
+    .vBoneWeights = Geometry.skin_attributes.vBoneWeights,
+};
+
+/// Columns of the per instance world matrix of the instanced static shader.
+const instance_attributes = .{
+    .vWorld0 = 3,
+    .vWorld1 = 4,
+    .vWorld2 = 5,
+    .vWorld3 = 6,
+};
+
+const instanced_attributes = .{
+    .vPosition = attributes.vPosition,
+    .vNormal = attributes.vNormal,
+    .vUV = attributes.vUV,
+    .vWorld0 = instance_attributes.vWorld0,
+    .vWorld1 = instance_attributes.vWorld1,
+    .vWorld2 = instance_attributes.vWorld2,
+    .vWorld3 = instance_attributes.vWorld3,
+};
+
+/// Skinned geometries with more bones are skinned on the CPU. Each bone takes three
+/// of the 128 vertex uniform vectors GLES 2 guarantees.
+pub const max_gpu_bones = 32;
+
 static_geometry_shader: *ResourceManager.Shader,
+skinned_geometry_shader: *ResourceManager.Shader,
+
+/// Instanced drawing of static geometry, null if the GPU has neither core nor extension instancing.
+instancing: ?Instancing,
+
+/// When set and supported, all instances of a mesh are drawn with a single draw call.
+use_instancing: bool = true,
 
 /// list of CCW triangles that will be rendered
 draw_calls: std.ArrayList(DrawCall),
@@ -39,7 +80,76 @@ resources: *ResourceManager,
 
 white_texture: *Texture,
 
-sprite_quad: *Geometry,
+/// Sprites and billboards of the current frame in submission order, see `spriteSortKey`.
+sprite_items: std.ArrayList(DrawItem),
+
+/// Corners of all visible sprites and billboards, expanded on the CPU and streamed into
+/// `sprite_vertex_buffer`, so each run of quads with the same texture is a single draw call.
+sprite_vertices: std.ArrayList(Vertex),
+sprite_vertex_buffer: *ResourceManager.Buffer,
+
+/// Two triangles for each quad of the longest sprite run, streamed into `sprite_index_buffer`.
+sprite_indices: std.ArrayList(u16),
+sprite_index_buffer: *ResourceManager.Buffer,
+
+/// Matrix palettes of all skinned draw calls in this frame.
+bone_palettes: std.ArrayList(Mat4),
+
+/// Target of the CPU skinning path, streamed into `skinning_buffer`.
+skinned_vertices: std.ArrayList(Vertex),
+skinning_buffer: *ResourceManager.Buffer,
+
+/// Number of threads used to skin geometries with more than `max_gpu_bones` bones.
+skinning_thread_count: usize = 4,
+
+/// The maximum geometric error of a level of detail, projected to the screen, as a fraction
+/// of the viewport height. Coarser levels are selected as long as they stay below this error.
+lod_error_threshold: f32 = 1.0 / 512.0,
+
+/// Relative margin around `lod_error_threshold` in which a geometry keeps its previous
+/// level of detail, so objects near the threshold don't flicker between two levels.
+lod_hysteresis: f32 = 0.25,
+
+/// Triangle counts of the last call to `render`.
+lod_statistics: LodStatistics = .{},
+
+/// When set, `render` skips geometries and meshes whose bounding sphere is outside the view frustum.
+frustum_culling: bool = true,
+
+/// When set, geometries hidden behind occluders are skipped, see `enableOcclusionCulling`.
+occlusion_buffer: ?occlusion.DepthBuffer = null,
+
+/// Occluder proxies of geometries, see `setOccluderProxy`.
+occluder_proxies: std.AutoHashMapUnmanaged(*Geometry, occlusion.Proxy) = .{},
+
+/// Culling results of the last call to `render`.
+culling_statistics: CullingStatistics = .{},
+
+/// World space bounding spheres and frustum containment of all draw calls, filled by `cullDrawCalls`.
+cull_spheres: std.MultiArrayList(CullSphere) = .{},
+cull_visibility: std.ArrayListUnmanaged(Frustum.Containment) = .{},
+
+/// State changes of the last call to `render`.
+submission_statistics: SubmissionStatistics = .{},
+
+/// Visible meshes of the current frame in submission order, see `sortKey`.
+draw_items: std.ArrayList(DrawItem),
+sort_scratch: std.ArrayList(DrawItem),
+
+/// Per frame ids of the geometries and textures in the sort keys.
+sort_geometry_ids: std.AutoHashMapUnmanaged(*Geometry, u32) = .{},
+sort_texture_ids: std.AutoHashMapUnmanaged(*Texture, u32) = .{},
+
+/// World matrices of all draw items, streamed into `Instancing.buffer`.
+instance_matrices: std.ArrayList(Mat4),
+
+/// Counts how often each geometry was drawn without an id in the current frame. Only a geometry
+/// that is drawn once this way can be found again in `lod_history`.
+anonymous_draws: std.AutoHashMapUnmanaged(*Geometry, u32) = .{},
+
+/// The level of detail each geometry instance was drawn with in the previous and the current frame.
+lod_history: std.AutoHashMapUnmanaged(LodKey, u8) = .{},
+next_lod_history: std.AutoHashMapUnmanaged(LodKey, u8) = .{},
 
 pub fn init(resources: *ResourceManager, allocator: std.mem.Allocator) InitError!Self {
     const static_vertex_source =
@@ -48,12 +158,88 @@ pub fn init(resources: *ResourceManager, allocator: std.mem.Allocator) InitError
         \\attribute vec2 vUV;
         \\uniform mat4 uWorldMatrix;
         \\uniform mat4 uViewProjMatrix;
+        \\uniform mat4 uDequantize;
+        \\uniform bool uOctahedralNormals;
+        \\varying vec2 aUV;
+        \\varying vec3 aNormal;
+        \\vec3 decodeNormal(vec3 n)
+        \\{
+        \\   if (!uOctahedralNormals)
+        \\     return normalize(n);
+        \\   vec3 o = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+        \\   if (o.z < 0.0)
+        \\     o.xy = (1.0 - abs(o.yx)) * vec2(o.x >= 0.0 ? 1.0 : -1.0, o.y >= 0.0 ? 1.0 : -1.0);
+        \\   return normalize(o);
+        \\}
+        \\void main()
+        \\{
+        \\   gl_Position = uViewProjMatrix * uWorldMatrix * uDequantize * vec4(vPosition, 1.0);
+        \\   aNormal = normalize(mat3(uWorldMatrix) * decodeNormal(vNormal));
+        \\   aUV = vUV;
+        \\}
+    ;
+    const instanced_vertex_source =
+        \\attribute vec3 vPosition;
+        \\attribute vec3 vNormal;
+        \\attribute vec2 vUV;
+        \\attribute vec4 vWorld0;
+        \\attribute vec4 vWorld1;
+        \\attribute vec4 vWorld2;
+        \\attribute vec4 vWorld3;
+        \\uniform mat4 uViewProjMatrix;
+        \\uniform mat4 uDequantize;
+        \\uniform bool uOctahedralNormals;
+        \\varying vec2 aUV;
+        \\varying vec3 aNormal;
+        \\vec3 decodeNormal(vec3 n)
+        \\{
+        \\   if (!uOctahedralNormals)
+        \\     return normalize(n);
+        \\   vec3 o = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+        \\   if (o.z < 0.0)
+        \\     o.xy = (1.0 - abs(o.yx)) * vec2(o.x >= 0.0 ? 1.0 : -1.0, o.y >= 0.0 ? 1.0 : -1.0);
+        \\   return normalize(o);
+        \\}
+        \\void main()
+        \\{
+        \\   mat4 world = mat4(vWorld0, vWorld1, vWorld2, vWorld3);
+        \\   gl_Position = uViewProjMatrix * world * uDequantize * vec4(vPosition, 1.0);
+        \\   aNormal = normalize(mat3(world) * decodeNormal(vNormal));
+        \\   aUV = vUV;
+        \\}
+    ;
+    const skinned_vertex_source =
+        \\attribute vec3 vPosition;
+        \\attribute vec3 vNormal;
+        \\attribute vec2 vUV;
+        \\attribute vec4 vBoneIndices;
+        \\attribute vec4 vBoneWeights;
+        \\uniform mat4 uWorldMatrix;
+        \\uniform mat4 uViewProjMatrix;
+        \\uniform vec4 uBones[3 * 32]; // rows of the 4x3 bone matrices
         \\varying vec2 aUV;
         \\varying vec3 aNormal;
+        \\mat4 boneMatrix(float index)
+        \\{
+        \\   int i = 3 * int(index);
+        \\   vec4 r0 = uBones[i + 0];
+        \\   vec4 r1 = uBones[i + 1];
+        \\   vec4 r2 = uBones[i + 2];
+        \\   return mat4(
+        \\     r0.x, r1.x, r2.x, 0.0,
+        \\     r0.y, r1.y, r2.y, 0.0,
+        \\     r0.z, r1.z, r2.z, 0.0,
+        \\     r0.w, r1.w, r2.w, 1.0
+        \\   );
+        \\}
         \\void main()
         \\{
-        \\   gl_Position = uViewProjMatrix * uWorldMatrix * vec4(vPosition, 1.0);
-        \\   aNormal = normalize(mat3(uWorldMatrix) * normalize(vNormal));
+        \\   mat4 skin = vBoneWeights.x * boneMatrix(vBoneIndices.x)
+        \\             + vBoneWeights.y * boneMatrix(vBoneIndices.y)
+        \\             + vBoneWeights.z * boneMatrix(vBoneIndices.z)
+        \\             + vBoneWeights.w * boneMatrix(vBoneIndices.w);
+        \\   gl_Position = uViewProjMatrix * uWorldMatrix * skin * vec4(vPosition, 1.0);
+        \\   aNormal = normalize(mat3(uWorldMatrix) * (skin * vec4(vNormal, 0.0)).xyz);
         \\   aUV = vUV;
         \\}
     ;
@@ -63,6 +249,7 @@ pub fn init(resources: *ResourceManager, allocator: std.mem.Allocator) InitError
         \\varying vec3 aNormal;
         \\uniform sampler2D uTexture;
         \\uniform mat3 uTexTransform;
+        \\uniform float uAlphaThreshold;
         \\const vec3 light_color_a = vec3(0.8); // vec3(0.86, 0.77, 0.38); // 0xdcc663, direct sun
         \\const vec3 light_color_b = vec3(0.5); // vec3(0.25, 0.44, 0.43); // 0x40716f, indirect
         \\void main()
@@ -77,7 +264,7 @@ pub fn init(resources: *ResourceManager, allocator: std.mem.Allocator) InitError
         \\   vec2 uv = (uTexTransform * vec3(aUV, 1.0)).xy;
         \\
         \\   gl_FragColor = texture2D(uTexture, uv);
-        \\   if(gl_FragColor.a < 0.5)
+        \\   if(gl_FragColor.a < uAlphaThreshold)
         \\     discard;
         \\   gl_FragColor.rgb *= lighting;
         \\}
@@ -92,15 +279,64 @@ pub fn init(resources: *ResourceManager, allocator: std.mem.Allocator) InitError
     });
     errdefer resources.destroyShader(static_geometry_shader);
 
+    var skinned_geometry_shader = try resources.createShader(ResourceManager.BasicShader{
+        .vertex_shader = skinned_vertex_source,
+        .fragment_shader = static_alphatest_fragment_source,
+        .attributes = glesh.attributes(skinned_attributes),
+    });
+    errdefer resources.destroyShader(skinned_geometry_shader);
+
+    const skinning_buffer = try resources.createBuffer(ResourceManager.EmptyBuffer{});
+    errdefer resources.destroyBuffer(skinning_buffer);
+
+    var instancing: ?Instancing = null;
+    const instanced_arrays = glesh.InstancedArrays.load();
+    if (instanced_arrays != .none) {
+        const instanced_geometry_shader = try resources.createShader(ResourceManager.BasicShader{
+            .vertex_shader = instanced_vertex_source,
+            .fragment_shader = static_alphatest_fragment_source,
+            .attributes = glesh.attributes(instanced_attributes),
+        });
+        errdefer resources.destroyShader(instanced_geometry_shader);
+
+        instancing = Instancing{
+            .arrays = instanced_arrays,
+            .shader = instanced_geometry_shader,
+            .buffer = try resources.createBuffer(ResourceManager.EmptyBuffer{}),
+        };
+    }
+    errdefer if (instancing) |inst| {
+        resources.destroyShader(inst.shader);
+        resources.destroyBuffer(inst.buffer);
+    };
+
+    const sprite_vertex_buffer = try resources.createBuffer(ResourceManager.EmptyBuffer{});
+    errdefer resources.destroyBuffer(sprite_vertex_buffer);
+
+    const sprite_index_buffer = try resources.createBuffer(ResourceManager.EmptyBuffer{});
+    errdefer resources.destroyBuffer(sprite_index_buffer);
+
     var self = Self{
         .allocator = allocator,
         .resources = resources,
 
         .static_geometry_shader = static_geometry_shader,
+        .skinned_geometry_shader = skinned_geometry_shader,
+        .instancing = instancing,
 
         .draw_calls = std.ArrayList(DrawCall).init(allocator),
+        .bone_palettes = std.ArrayList(Mat4).init(allocator),
+        .skinned_vertices = std.ArrayList(Vertex).init(allocator),
+        .skinning_buffer = skinning_buffer,
+        .draw_items = std.ArrayList(DrawItem).init(allocator),
+        .sort_scratch = std.ArrayList(DrawItem).init(allocator),
+        .instance_matrices = std.ArrayList(Mat4).init(allocator),
+        .sprite_items = std.ArrayList(DrawItem).init(allocator),
+        .sprite_vertices = std.ArrayList(Vertex).init(allocator),
+        .sprite_vertex_buffer = sprite_vertex_buffer,
+        .sprite_indices = std.ArrayList(u16).init(allocator),
+        .sprite_index_buffer = sprite_index_buffer,
         .white_texture = undefined,
-        .sprite_quad = undefined,
     };
 
     self.white_texture = try self.resources.createTexture(.@"3d", ResourceManager.FlatTexture{
@@ -109,35 +345,46 @@ pub fn init(resources: *ResourceManager, allocator: std.mem.Allocator) InitError
         .color = .{ .r = 0xFF, .g = 0xFF, .b = 0xFF },
     });
 
-    self.sprite_quad = try self.resources.createGeometry(ResourceManager.StaticGeometry{
-        .vertices = &[4]Vertex{
-            Vertex{ .x = -0.5, .y = -0.5, .z = 0.0, .nx = 0, .ny = 0, .nz = -1, .u = 0, .v = 0 },
-            Vertex{ .x = 0.5, .y = -0.5, .z = 0.0, .nx = 0, .ny = 0, .nz = -1, .u = 1, .v = 0 },
-            Vertex{ .x = -0.5, .y = 0.5, .z = 0.0, .nx = 0, .ny = 0, .nz = -1, .u = 0, .v = 1 },
-            Vertex{ .x = 0.5, .y = 0.5, .z = 0.0, .nx = 0, .ny = 0, .nz = -1, .u = 1, .v = 1 },
-        },
-        .indices = &[_]u16{},
-        .meshes = &[0]Mesh{},
-    });
-
     return self;
 }
 
 pub fn deinit(self: *Self) void {
     self.reset();
     self.resources.destroyShader(self.static_geometry_shader);
+    self.resources.destroyShader(self.skinned_geometry_shader);
+    self.resources.destroyBuffer(self.skinning_buffer);
+    self.resources.destroyBuffer(self.sprite_vertex_buffer);
+    self.resources.destroyBuffer(self.sprite_index_buffer);
+    if (self.instancing) |instancing| {
+        self.resources.destroyShader(instancing.shader);
+        self.resources.destroyBuffer(instancing.buffer);
+    }
     self.draw_calls.deinit();
+    self.bone_palettes.deinit();
+    self.skinned_vertices.deinit();
+    self.anonymous_draws.deinit(self.allocator);
+    self.lod_history.deinit(self.allocator);
+    self.next_lod_history.deinit(self.allocator);
+    self.cull_spheres.deinit(self.allocator);
+    self.cull_visibility.deinit(self.allocator);
+    self.disableOcclusionCulling();
+    self.occluder_proxies.deinit(self.allocator);
+    self.draw_items.deinit();
+    self.sort_scratch.deinit();
+    self.instance_matrices.deinit();
+    self.sprite_items.deinit();
+    self.sprite_vertices.deinit();
+    self.sprite_indices.deinit();
+    self.sort_geometry_ids.deinit(self.allocator);
+    self.sort_texture_ids.deinit(self.allocator);
     self.* = undefined;
 }
 
-const Uniforms = struct {
-    // vertex shader
-    uWorldMatrix: gles.GLint,
-    uViewProjMatrix: gles.GLint,
-
-    // fragment shader
-    uTexture: gles.GLint,
-    uTexTransform: gles.GLint,
+const Instancing = struct {
+    arrays: glesh.InstancedArrays,
+    shader: *ResourceManager.Shader,
+    /// Stores the world matrices of all draw items of the current frame.
+    buffer: *ResourceManager.Buffer,
 };
 
 /// Resets the state of the renderer and prepares a fresh new frame.
@@ -146,20 +393,47 @@ pub fn reset(self: *Self) void {
     for (self.draw_calls.items) |draw_call| {
         switch (draw_call) {
             .sprite => |draw_sprite| self.resources.destroyTexture(draw_sprite.sprite),
+            .billboard => |draw_billboard| self.resources.destroyTexture(draw_billboard.sprite),
             .geometry => |draw_geom| self.resources.destroyGeometry(draw_geom.geometry),
+            .skinned => |draw_skinned| self.resources.destroyGeometry(draw_skinned.geometry),
         }
     }
     self.draw_calls.shrinkRetainingCapacity(0);
+    self.bone_palettes.shrinkRetainingCapacity(0);
+    self.anonymous_draws.clearRetainingCapacity();
 }
 
 /// Draws the given `geometry` with the given world `transform`.
+/// If the geometry has levels of detail, `render` selects one based on its projected size.
+/// The selection only keeps the previous level near the threshold if this is the only anonymous
+/// draw of `geometry` in the frame, use `drawGeometryInstance` to draw it more often.
 pub fn drawGeometry(self: *Self, geometry: *Geometry, transform: Mat4) !void {
+    const count = try self.anonymous_draws.getOrPut(self.allocator, geometry);
+    if (!count.found_existing) {
+        count.value_ptr.* = 0;
+    }
+    errdefer count.value_ptr.* -= 1;
+    count.value_ptr.* += 1;
+
+    try self.addGeometryDrawCall(geometry, transform, null);
+}
+
+/// Draws the given `geometry` with the given world `transform`, like `drawGeometry`.
+/// `id` identifies the drawn object across frames, for example an entity index, so its level
+/// of detail doesn't flicker near the threshold, no matter in which order the objects are drawn.
+/// Each `id` must be used only once per `geometry` and frame.
+pub fn drawGeometryInstance(self: *Self, geometry: *Geometry, transform: Mat4, id: u64) !void {
+    try self.addGeometryDrawCall(geometry, transform, id);
+}
+
+fn addGeometryDrawCall(self: *Self, geometry: *Geometry, transform: Mat4, id: ?u64) !void {
     const dc = try self.draw_calls.addOne();
     errdefer _ = self.draw_calls.pop(); // remove the draw call in case of error
 
     dc.* = DrawCall{ .geometry = .{
         .geometry = geometry,
         .transform = transform,
+        .id = id,
     } };
 
     // we need to keep the geometry alive until someone calls `reset` on the renderer.
@@ -168,6 +442,31 @@ pub fn drawGeometry(self: *Self, geometry: *Geometry, transform: Mat4) !void {
     self.resources.retainGeometry(geometry);
 }
 
+/// Draws the skinned `geometry` with the given world `transform`, deformed by the
+/// skinning matrices in `palette`, see `skinning.Pose.computePalette`.
+/// Geometries with up to `max_gpu_bones` bones are skinned on the GPU, others on the CPU.
+pub fn drawSkinnedGeometry(self: *Self, geometry: *Geometry, transform: Mat4, palette: []const Mat4) !void {
+    const skin = geometry.skin orelse return error.NotSkinned;
+    if (palette.len != skin.bones.len)
+        return error.InvalidPalette;
+
+    const palette_offset = self.bone_palettes.items.len;
+    try self.bone_palettes.appendSlice(palette);
+    errdefer self.bone_palettes.shrinkRetainingCapacity(palette_offset);
+
+    const dc = try self.draw_calls.addOne();
+    errdefer _ = self.draw_calls.pop(); // remove the draw call in case of error
+
+    dc.* = DrawCall{ .skinned = .{
+        .geometry = geometry,
+        .transform = transform,
+        .palette_offset = palette_offset,
+    } };
+
+    // we need to keep the geometry alive until someone calls `reset` on the renderer.
+    self.resources.retainGeometry(geometry);
+}
+
 /// Draws a portion `rectangle` of the given `sprite` with the given world `transform`.
 /// The sprite will be aligned on the XY axis, where X is the U axis of the
 /// texture, and Y is the V axis.
@@ -203,8 +502,90 @@ pub fn drawSprite(self: *Self, sprite: *Texture, transform: Mat4) !void {
     }, transform);
 }
 
+/// How a billboard is turned towards the camera.
+pub const BillboardAlignment = union(enum) {
+    /// The billboard is parallel to the image plane.
+    camera,
+    /// The billboard only rotates around this world space axis, which is its up direction.
+    /// Useful for trees and grass that must stay upright.
+    axis: [3]f32,
+};
+
+pub const Billboard = struct {
+    /// World space center of the billboard.
+    position: [3]f32,
+    /// World space width and height of the billboard.
+    size: [2]f32,
+    alignment: BillboardAlignment = .camera,
+    /// Alpha blended billboards are drawn after everything else, sorted back to front.
+    /// Others are alpha tested.
+    blend: bool = false,
+};
+
+/// Draws a portion `rectangle` of the given `sprite` as a `billboard` that faces the camera.
+/// The X axis of the sprite points to the right on the screen and the Y axis up.
+pub fn drawPartialBillboard(self: *Self, sprite: *Texture, rectangle: Rectangle, billboard: Billboard) !void {
+    const dc = try self.draw_calls.addOne();
+    errdefer _ = self.draw_calls.pop(); // remove the draw call in case of error
+
+    dc.* = DrawCall{ .billboard = .{
+        .sprite = sprite,
+        .rectangle = rectangle,
+        .billboard = billboard,
+    } };
+
+    // we need to keep the texture alive until someone calls `reset` on the renderer.
+    self.resources.retainTexture(sprite);
+}
+
+/// Draws the given `sprite` as a `billboard` that faces the camera.
+/// The X axis of the sprite points to the right on the screen and the Y axis up.
+pub fn drawBillboard(self: *Self, sprite: *Texture, billboard: Billboard) !void {
+    try self.drawPartialBillboard(sprite, Rectangle{
+        .x = 0,
+        .y = 0,
+        .width = sprite.width,
+        .height = sprite.height,
+    }, billboard);
+}
+
 /// Renders the currently contained data to the screen.
-pub fn render(self: Self, viewProjectionMatrix: [4][4]f32) void {
+/// All visible meshes are sorted by their `sortKey` first, so meshes sharing a shader,
+/// geometry and texture are submitted back to back and redundant state changes are skipped.
+/// Sprites and billboards are drawn last, batched by texture, see `drawSprites`.
+pub fn render(self: *Self, viewProjectionMatrix: [4][4]f32) void {
+    self.lod_statistics = .{};
+    self.culling_statistics = .{};
+    self.submission_statistics = .{};
+    defer self.swapLodHistory();
+
+    const frustum = Frustum.fromMatrix(viewProjectionMatrix);
+    const visibility = self.cullDrawCalls(frustum);
+    const occlusion_buffer = self.rasterizeOccluders(viewProjectionMatrix, visibility);
+
+    self.buildDrawItems(viewProjectionMatrix, frustum, visibility, occlusion_buffer) catch {
+        logger.warn("out of memory, skipping frame", .{});
+        return;
+    };
+    self.sort_scratch.resize(self.draw_items.items.len) catch {
+        logger.warn("out of memory, skipping frame", .{});
+        return;
+    };
+    radixSort(self.draw_items.items, self.sort_scratch.items);
+
+    self.buildSpriteItems(viewProjectionMatrix, frustum) catch {
+        logger.warn("out of memory, skipping frame", .{});
+        return;
+    };
+
+    const instanced = self.use_instancing and self.instancing != null;
+    if (instanced) {
+        self.uploadInstances() catch {
+            logger.warn("out of memory, skipping frame", .{});
+            return;
+        };
+    }
+
     glesh.enableAttributes(attributes);
     defer glesh.disableAttributes(attributes);
 
@@ -213,80 +594,1015 @@ pub fn render(self: Self, viewProjectionMatrix: [4][4]f32) void {
 
     gles.depthFunc(gles.LEQUAL);
 
-    var uniforms = glesh.fetchUniforms(self.static_geometry_shader.instance.?, Uniforms);
+    gles.activeTexture(gles.TEXTURE0);
 
-    gles.useProgram(self.static_geometry_shader.instance.?);
-    gles.uniform1i(uniforms.uTexture, 0);
-    gles.uniformMatrix4fv(uniforms.uViewProjMatrix, 1, gles.FALSE, @ptrCast([*]const f32, &viewProjectionMatrix));
+    var state = SubmitState{ .view_projection = viewProjectionMatrix };
+    defer self.setProgram(&state, .none);
 
-    gles.activeTexture(gles.TEXTURE0);
+    const items = self.draw_items.items;
+    var i: usize = 0;
+    while (i < items.len) {
+        const item = items[i];
+        const program: Program = switch (item.shaderKind()) {
+            .geometry => if (instanced) Program.instanced else Program.static,
+            .static => .static,
+            .skinned => .skinned,
+        };
+        self.setProgram(&state, program);
 
-    for (self.draw_calls.items) |draw_call| {
+        switch (self.draw_calls.items[item.draw_call]) {
+            .geometry => |draw_geom| {
+                const mesh = draw_geom.geometry.levelMeshes(item.level)[item.mesh];
+                self.bindStaticGeometry(&state, draw_geom.geometry);
+
+                if (program == .instanced) {
+                    // all following instances of the same mesh are drawn at once
+                    var end = i + 1;
+                    while (end < items.len and self.sameMesh(items[end], item)) : (end += 1) {}
+
+                    self.drawInstanced(&state, mesh, i, end - i);
+                    i = end;
+                } else {
+                    if (state.world_draw_call != item.draw_call) {
+                        gles.uniformMatrix4fv(state.uniforms.uWorldMatrix, 1, gles.FALSE, @ptrCast([*]const f32, &draw_geom.transform));
+                        state.world_draw_call = item.draw_call;
+                    }
+                    self.drawMesh(&state, mesh);
+                    i += 1;
+                }
+            },
+
+            .skinned => |draw_skinned| {
+                if (program == .skinned) {
+                    self.drawGpuSkinned(&state, draw_skinned);
+                } else {
+                    self.drawCpuSkinned(&state, draw_skinned);
+                }
+                i += 1;
+            },
+
+            // batched in `drawSprites`
+            .sprite, .billboard => unreachable,
+        }
+    }
+
+    self.drawSprites(&state);
+}
+
+/// State changes of a frame, showing how much the sorted submission saved.
+pub const SubmissionStatistics = struct {
+    /// Number of draw calls issued to OpenGL.
+    draws: usize = 0,
+    /// Number of those draw calls that were instanced.
+    instanced_draws: usize = 0,
+    /// Number of meshes that were drawn as part of the instanced draw call of another mesh.
+    merged_draws: usize = 0,
+    /// Number of shader program changes.
+    program_switches: usize = 0,
+    /// Number of vertex and index buffer binds.
+    geometry_binds: usize = 0,
+    /// Number of buffer binds that were skipped as the geometry was already bound.
+    geometry_binds_saved: usize = 0,
+    /// Number of texture binds.
+    texture_binds: usize = 0,
+    /// Number of texture binds that were skipped as the texture was already bound.
+    texture_binds_saved: usize = 0,
+    /// Number of sprites and billboards drawn as part of a sprite batch.
+    batched_sprites: usize = 0,
+    /// Number of draw calls issued for sprite batches.
+    sprite_draws: usize = 0,
+};
+
+/// The shader a draw item is drawn with. Ordered by submission.
+const ShaderKind = enum(u2) {
+    /// static geometry, drawn instanced if supported
+    geometry = 0,
+    /// CPU skinned geometry, drawn with the static shader and per draw uniforms
+    static = 1,
+    /// GPU skinned geometry
+    skinned = 2,
+};
+
+/// A single mesh, skinned geometry or sprite that passed culling.
+const DrawItem = struct {
+    key: u64,
+    /// index into `draw_calls`
+    draw_call: u32,
+    /// index of the mesh in the level of detail `level`. Only used for geometry draw calls.
+    mesh: u32 = 0,
+    level: u8 = 0,
+
+    fn shaderKind(self: DrawItem) ShaderKind {
+        return @intToEnum(ShaderKind, @truncate(u2, self.key >> 60));
+    }
+};
+
+/// Computes the key draw items are sorted by. From the most to the least significant bits:
+/// - 2 bits pass, zero for meshes, see `spriteSortKey` for the others
+/// - 2 bits `ShaderKind`
+/// - 16 bits geometry id
+/// - 12 bits texture id
+/// - 4 bits level of detail and 12 bits mesh index, so instances of the same mesh end up next to each other
+/// - 16 bits view depth, so equal state is drawn front to back
+/// Ids wrap around when a frame has more geometries or textures than fit, which only costs some binds.
+/// Levels past 15 and meshes past 4095 share the key of the last one that fits, so their instances
+/// may interleave and are drawn in more than one call.
+fn sortKey(shader: ShaderKind, geometry_id: u32, texture_id: u32, level: usize, mesh: usize, depth: f32) u64 {
+    // The upper bits of a positive float sort like the float itself.
+    const depth_bits: u64 = if (depth > 0) @bitCast(u32, depth) >> 16 else 0;
+    const variant: u64 = (@as(u64, std.math.min(level, 0xF)) << 12) | std.math.min(mesh, 0xFFF);
+    return (@as(u64, @enumToInt(shader)) << 60) |
+        (@as(u64, geometry_id & 0xFFFF) << 44) |
+        (@as(u64, texture_id & 0xFFF) << 32) |
+        (variant << 16) |
+        depth_bits;
+}
+
+/// Computes the key sprite items are sorted by. Alpha tested sprites use pass 1 and sort like
+/// static meshes, by texture and then front to back. Alpha blended sprites use pass 2 and sort
+/// back to front by their full 32 bit depth, then by texture.
+fn spriteSortKey(texture_id: u32, depth: f32, blend: bool) u64 {
+    if (!blend) {
+        return (1 << 62) | sortKey(.static, 0, texture_id, 0, 0, depth);
+    }
+    const depth_bits: u32 = if (depth > 0) @bitCast(u32, depth) else 0;
+    return (2 << 62) | (@as(u64, ~depth_bits) << 16) | @as(u64, texture_id & 0xFFFF);
+}
+
+/// Returns a small number for `ptr` that is unique within the current frame.
+fn denseId(self: *Self, comptime T: type, ids: *std.AutoHashMapUnmanaged(*T, u32), ptr: *T) !u32 {
+    const entry = try ids.getOrPut(self.allocator, ptr);
+    if (!entry.found_existing) {
+        entry.value_ptr.* = @intCast(u32, ids.count() - 1);
+    }
+    return entry.value_ptr.*;
+}
+
+/// Fills `draw_items` with all visible meshes and skinned geometries and
+/// selects the level of detail of each geometry draw call.
+fn buildDrawItems(self: *Self, view_projection: Mat4, frustum: Frustum, visibility: ?[]const Frustum.Containment, occlusion_buffer: ?*const occlusion.DepthBuffer) !void {
+    self.draw_items.shrinkRetainingCapacity(0);
+    self.sort_geometry_ids.clearRetainingCapacity();
+    self.sort_texture_ids.clearRetainingCapacity();
+
+    for (self.draw_calls.items) |draw_call, index| {
+        const draw_call_index = @intCast(u32, index);
         switch (draw_call) {
             .geometry => |draw_geom| {
-                draw_geom.geometry.bind();
-
-                const tex_id = Mat3{
-                    .{ 1, 0, 0 },
-                    .{ 0, 1, 0 },
-                    .{ 0, 0, 1 },
-                };
-
-                gles.uniformMatrix3fv(uniforms.uTexTransform, 1, gles.FALSE, @ptrCast([*]const f32, &tex_id));
-                gles.uniformMatrix4fv(uniforms.uWorldMatrix, 1, gles.FALSE, @ptrCast([*]const f32, &draw_geom.transform));
-
-                for (draw_geom.geometry.meshes) |mesh| {
-                    const tex_handle = mesh.texture orelse self.white_texture;
-
-                    gles.bindTexture(gles.TEXTURE_2D, tex_handle.instance.?);
-                    gles.drawElements(
-                        gles.TRIANGLES,
-                        @intCast(gles.GLsizei, mesh.count),
-                        gles.UNSIGNED_SHORT,
-                        @intToPtr(?*const anyopaque, @sizeOf(u16) * mesh.offset),
-                    );
+                const geometry = draw_geom.geometry;
+                const containment = if (visibility) |visible| visible[index] else .inside;
+                if (containment == .outside) {
+                    self.culling_statistics.culled_geometries += 1;
+                    self.culling_statistics.culled_meshes += geometry.meshes.len;
+                    continue;
+                }
+                if (occlusion_buffer) |buffer| {
+                    if (!buffer.isBoxVisible(geometry.bounds.min, geometry.bounds.max, draw_geom.transform, view_projection)) {
+                        self.culling_statistics.occluded_geometries += 1;
+                        self.culling_statistics.culled_meshes += geometry.meshes.len;
+                        continue;
+                    }
+                }
+
+                const level = self.selectLevel(draw_geom, view_projection);
+                self.lod_statistics.add(geometry.*, level);
+
+                const geometry_id = try self.denseId(Geometry, &self.sort_geometry_ids, geometry);
+                const depth = viewDepth(view_projection, transformPoint(draw_geom.transform, geometry.bounds.sphere.center));
+
+                const meshes = geometry.levelMeshes(level);
+                for (meshes) |mesh, i| {
+                    // a partially visible geometry tests each mesh on its own
+                    if (containment == .intersecting and meshes.len > 1 and !isVisible(frustum, geometry.mesh_bounds[i].sphere, draw_geom.transform)) {
+                        self.culling_statistics.culled_meshes += 1;
+                        continue;
+                    }
+                    self.culling_statistics.drawn_meshes += 1;
+
+                    const texture_id = try self.denseId(Texture, &self.sort_texture_ids, mesh.texture orelse self.white_texture);
+                    try self.draw_items.append(DrawItem{
+                        .key = sortKey(.geometry, geometry_id, texture_id, level, i, depth),
+                        .draw_call = draw_call_index,
+                        .mesh = @intCast(u32, i),
+                        .level = @intCast(u8, level),
+                    });
                 }
             },
 
-            .sprite => |draw_sprite| {
-                self.sprite_quad.bind();
+            .skinned => |draw_skinned| {
+                const shader: ShaderKind = if (draw_skinned.geometry.skin.?.bones.len <= max_gpu_bones) .skinned else .static;
+                const geometry_id = try self.denseId(Geometry, &self.sort_geometry_ids, draw_skinned.geometry);
+                const depth = viewDepth(view_projection, transformPoint(draw_skinned.transform, .{ 0, 0, 0 }));
+                try self.draw_items.append(DrawItem{
+                    .key = sortKey(shader, geometry_id, 0, 0, 0, depth),
+                    .draw_call = draw_call_index,
+                });
+            },
 
+            // see `buildSpriteItems`
+            .sprite, .billboard => {},
+        }
+    }
+}
+
+/// Fills `sprite_items` with all sprites and billboards in the view frustum and sorts them
+/// by their `spriteSortKey`.
+fn buildSpriteItems(self: *Self, view_projection: Mat4, frustum: Frustum) !void {
+    self.sprite_items.shrinkRetainingCapacity(0);
+
+    for (self.draw_calls.items) |draw_call, index| {
+        var center: [3]f32 = undefined;
+        var radius: f32 = undefined;
+        var blend = false;
+        switch (draw_call) {
+            .sprite => |draw_sprite| {
                 const w = @intToFloat(f32, draw_sprite.rectangle.width);
                 const h = @intToFloat(f32, draw_sprite.rectangle.height);
+                center = transformPoint(draw_sprite.transform, .{ 0, 0, 0 });
+                radius = 0.5 * @sqrt(w * w + h * h) * maxScale(draw_sprite.transform);
+            },
+            .billboard => |draw_billboard| {
+                const size = draw_billboard.billboard.size;
+                center = draw_billboard.billboard.position;
+                radius = 0.5 * @sqrt(size[0] * size[0] + size[1] * size[1]);
+                blend = draw_billboard.billboard.blend;
+            },
+            .geometry, .skinned => continue,
+        }
 
-                const scale_mat: Mat4 = .{
-                    .{ w, 0, 0, 0 },
-                    .{ 0, h, 0, 0 },
-                    .{ 0, 0, 1, 0 },
-                    .{ 0, 0, 0, 1 },
-                };
+        if (self.frustum_culling and !frustum.containsSphere(center, radius)) {
+            self.culling_statistics.culled_sprites += 1;
+            continue;
+        }
 
-                const final_mat = matMul(scale_mat, draw_sprite.transform);
+        const texture_id = try self.denseId(Texture, &self.sort_texture_ids, spriteTexture(draw_call));
+        try self.sprite_items.append(DrawItem{
+            .key = spriteSortKey(texture_id, viewDepth(view_projection, center), blend),
+            .draw_call = @intCast(u32, index),
+        });
+    }
 
-                const sx = w / @intToFloat(f32, draw_sprite.sprite.width);
-                const sy = h / @intToFloat(f32, draw_sprite.sprite.height);
-                const dx = @intToFloat(f32, draw_sprite.rectangle.x) / @intToFloat(f32, draw_sprite.sprite.width);
-                const dy = @intToFloat(f32, draw_sprite.rectangle.y) / @intToFloat(f32, draw_sprite.sprite.height);
+    try self.sort_scratch.resize(self.sprite_items.items.len);
+    radixSort(self.sprite_items.items, self.sort_scratch.items);
+}
 
-                const tex_transform = Mat3{
-                    .{ sx, 0, 0 },
-                    .{ 0, sy, 0 },
-                    .{ dx, dy, 1 },
-                };
+fn spriteTexture(draw_call: DrawCall) *Texture {
+    return switch (draw_call) {
+        .sprite => |draw_sprite| draw_sprite.sprite,
+        .billboard => |draw_billboard| draw_billboard.sprite,
+        .geometry, .skinned => unreachable,
+    };
+}
 
-                gles.uniformMatrix3fv(uniforms.uTexTransform, 1, gles.FALSE, @ptrCast([*]const f32, &tex_transform));
-                gles.uniformMatrix4fv(uniforms.uWorldMatrix, 1, gles.FALSE, @ptrCast([*]const f32, &final_mat));
-                gles.bindTexture(gles.TEXTURE_2D, draw_sprite.sprite.instance.?);
+/// Sorts `items` by their key with a stable LSD radix sort over bytes.
+/// `scratch` must have the same length as `items`.
+fn radixSort(items: []DrawItem, scratch: []DrawItem) void {
+    std.debug.assert(items.len == scratch.len);
+    if (items.len < 2)
+        return;
 
-                gles.drawArrays(gles.TRIANGLE_STRIP, 0, 4);
-            },
+    var src = items;
+    var dst = scratch;
+    var shift: u6 = 0;
+    while (true) : (shift += 8) {
+        var counts = [_]usize{0} ** 256;
+        for (src) |item| {
+            counts[@truncate(u8, item.key >> shift)] += 1;
         }
+
+        // Most bytes are equal for all items, e.g. the pass and shader bits,
+        // so those passes can be skipped.
+        if (counts[@truncate(u8, src[0].key >> shift)] != src.len) {
+            var total: usize = 0;
+            for (counts) |*count| {
+                const n = count.*;
+                count.* = total;
+                total += n;
+            }
+            for (src) |item| {
+                const digit = @truncate(u8, item.key >> shift);
+                dst[counts[digit]] = item;
+                counts[digit] += 1;
+            }
+            std.mem.swap([]DrawItem, &src, &dst);
+        }
+
+        if (shift == 56)
+            break;
+    }
+
+    if (src.ptr != items.ptr) {
+        std.mem.copy(DrawItem, items, src);
+    }
+}
+
+/// Returns true if `a` and `b` draw the same mesh of the same geometry and can be instanced.
+fn sameMesh(self: Self, a: DrawItem, b: DrawItem) bool {
+    if (a.shaderKind() != .geometry or a.mesh != b.mesh or a.level != b.level)
+        return false;
+    return self.draw_calls.items[a.draw_call].geometry.geometry == self.draw_calls.items[b.draw_call].geometry.geometry;
+}
+
+/// Streams the world matrices of all sorted draw items into the instance buffer,
+/// so each run of instances reads a contiguous range of it.
+fn uploadInstances(self: *Self) !void {
+    const items = self.draw_items.items;
+    if (items.len == 0)
+        return;
+
+    try self.instance_matrices.resize(items.len);
+    for (items) |item, i| {
+        self.instance_matrices.items[i] = switch (self.draw_calls.items[item.draw_call]) {
+            .geometry => |draw_geom| draw_geom.transform,
+            .skinned => identity_matrix,
+            .sprite, .billboard => unreachable,
+        };
     }
+
+    gles.bindBuffer(gles.ARRAY_BUFFER, self.instancing.?.buffer.instance.?);
+    gles.bufferData(gles.ARRAY_BUFFER, @intCast(gles.GLsizeiptr, @sizeOf(Mat4) * items.len), self.instance_matrices.items.ptr, gles.STREAM_DRAW);
+}
+
+const Program = enum { none, static, instanced, skinned };
+
+const Uniforms = struct {
+    // vertex shader
+    uWorldMatrix: gles.GLint,
+    uViewProjMatrix: gles.GLint,
+    uDequantize: gles.GLint,
+    uOctahedralNormals: gles.GLint,
+    uBones: gles.GLint,
+
+    // fragment shader
+    uTexture: gles.GLint,
+    uTexTransform: gles.GLint,
+    uAlphaThreshold: gles.GLint,
+};
+
+/// Fragments below this alpha are discarded, unless they are alpha blended.
+const alpha_test_threshold = 0.5;
+
+/// The OpenGL state `render` has set up so far.
+const SubmitState = struct {
+    view_projection: Mat4,
+    program: Program = .none,
+    uniforms: Uniforms = undefined,
+    /// the geometry whose buffers and dequantization uniforms are bound
+    geometry: ?*const Geometry = null,
+    texture: ?gles.GLuint = null,
+    /// the draw call whose transform is in uWorldMatrix
+    world_draw_call: ?u32 = null,
+};
+
+fn setProgram(self: *Self, state: *SubmitState, program: Program) void {
+    if (state.program == program)
+        return;
+
+    switch (state.program) {
+        .instanced => {
+            for (glesh.attributes(instance_attributes)) |attr| {
+                self.instancing.?.arrays.vertexAttribDivisor(attr.index, 0);
+            }
+            glesh.disableAttributes(instance_attributes);
+        },
+        .skinned => glesh.disableAttributes(Geometry.skin_attributes),
+        .static, .none => {},
+    }
+
+    state.program = program;
+    state.geometry = null;
+    state.world_draw_call = null;
+
+    const shader = switch (program) {
+        .none => return,
+        .static => self.static_geometry_shader,
+        .instanced => self.instancing.?.shader,
+        .skinned => self.skinned_geometry_shader,
+    };
+    self.submission_statistics.program_switches += 1;
+
+    switch (program) {
+        .instanced => {
+            glesh.enableAttributes(instance_attributes);
+            for (glesh.attributes(instance_attributes)) |attr| {
+                self.instancing.?.arrays.vertexAttribDivisor(attr.index, 1);
+            }
+        },
+        .skinned => glesh.enableAttributes(Geometry.skin_attributes),
+        .static, .none => {},
+    }
+
+    state.uniforms = glesh.fetchUniforms(shader.instance.?, Uniforms);
+
+    gles.useProgram(shader.instance.?);
+    gles.uniform1i(state.uniforms.uTexture, 0);
+    gles.uniform1f(state.uniforms.uAlphaThreshold, alpha_test_threshold);
+    gles.uniformMatrix4fv(state.uniforms.uViewProjMatrix, 1, gles.FALSE, @ptrCast([*]const f32, &state.view_projection));
+    if (program == .skinned) {
+        gles.uniformMatrix3fv(state.uniforms.uTexTransform, 1, gles.FALSE, @ptrCast([*]const f32, &identity_matrix3));
+    }
+}
+
+/// Binds the buffers of a static `geometry` and sets its dequantization uniforms,
+/// unless it is already bound.
+fn bindStaticGeometry(self: *Self, state: *SubmitState, geometry: *const Geometry) void {
+    if (state.geometry == geometry) {
+        self.submission_statistics.geometry_binds_saved += 1;
+        return;
+    }
+    self.submission_statistics.geometry_binds += 1;
+    state.geometry = geometry;
+
+    geometry.bind();
+
+    // quantized texture coordinates are restored by the texture transform
+    const tex_transform = geometry.uvDequantizationMatrix();
+    const dequantize = geometry.dequantizationMatrix();
+
+    gles.uniformMatrix3fv(state.uniforms.uTexTransform, 1, gles.FALSE, @ptrCast([*]const f32, &tex_transform));
+    gles.uniformMatrix4fv(state.uniforms.uDequantize, 1, gles.FALSE, @ptrCast([*]const f32, &dequantize));
+    gles.uniform1i(state.uniforms.uOctahedralNormals, @boolToInt(geometry.quantized != null));
+}
+
+fn bindTexture(self: *Self, state: *SubmitState, texture: *Texture) void {
+    const handle = texture.instance.?;
+    if (state.texture == handle) {
+        self.submission_statistics.texture_binds_saved += 1;
+        return;
+    }
+    self.submission_statistics.texture_binds += 1;
+    state.texture = handle;
+    gles.bindTexture(gles.TEXTURE_2D, handle);
+}
+
+/// Draws `mesh` once for each of the `count` sorted draw items starting at `first`.
+fn drawInstanced(self: *Self, state: *SubmitState, mesh: Mesh, first: usize, count: usize) void {
+    const instancing = self.instancing.?;
+
+    self.bindTexture(state, mesh.texture orelse self.white_texture);
+
+    // each attribute is one column of the world matrix
+    gles.bindBuffer(gles.ARRAY_BUFFER, instancing.buffer.instance.?);
+    for (glesh.attributes(instance_attributes)) |attr, column| {
+        const offset = @sizeOf(Mat4) * first + @sizeOf([4]f32) * column;
+        gles.vertexAttribPointer(attr.index, 4, gles.FLOAT, gles.FALSE, @sizeOf(Mat4), @intToPtr(?*const anyopaque, offset));
+    }
+
+    instancing.arrays.drawElementsInstanced(
+        gles.TRIANGLES,
+        @intCast(gles.GLsizei, mesh.count),
+        gles.UNSIGNED_SHORT,
+        @intToPtr(?*const anyopaque, @sizeOf(u16) * mesh.offset),
+        @intCast(gles.GLsizei, count),
+    );
+
+    self.submission_statistics.draws += 1;
+    self.submission_statistics.instanced_draws += 1;
+    self.submission_statistics.merged_draws += count - 1;
+}
+
+fn drawCpuSkinned(self: *Self, state: *SubmitState, draw_skinned: DrawCall.DrawSkinned) void {
+    const geometry = draw_skinned.geometry;
+    self.skinned_vertices.resize(geometry.vertices.len) catch {
+        logger.warn("out of memory, skipping skinned geometry", .{});
+        return;
+    };
+    skinning.skinVerticesParallel(
+        geometry.skin.?,
+        self.getPalette(draw_skinned),
+        geometry.vertices,
+        self.skinned_vertices.items,
+        self.skinning_thread_count,
+    );
+
+    // the attributes now point into the skinning buffer
+    state.geometry = null;
+    state.world_draw_call = null;
+    self.submission_statistics.geometry_binds += 1;
+
+    gles.bindBuffer(gles.ARRAY_BUFFER, self.skinning_buffer.instance.?);
+    gles.bufferData(gles.ARRAY_BUFFER, @intCast(gles.GLsizeiptr, @sizeOf(Vertex) * self.skinned_vertices.items.len), self.skinned_vertices.items.ptr, gles.STREAM_DRAW);
+    gles.vertexAttribPointer(attributes.vPosition, 3, gles.FLOAT, gles.FALSE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "x")));
+    gles.vertexAttribPointer(attributes.vNormal, 3, gles.FLOAT, gles.TRUE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "nx")));
+    gles.vertexAttribPointer(attributes.vUV, 2, gles.FLOAT, gles.FALSE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "u")));
+    gles.bindBuffer(gles.ELEMENT_ARRAY_BUFFER, geometry.index_buffer.?);
+
+    gles.uniformMatrix3fv(state.uniforms.uTexTransform, 1, gles.FALSE, @ptrCast([*]const f32, &identity_matrix3));
+    gles.uniformMatrix4fv(state.uniforms.uWorldMatrix, 1, gles.FALSE, @ptrCast([*]const f32, &draw_skinned.transform));
+    gles.uniformMatrix4fv(state.uniforms.uDequantize, 1, gles.FALSE, @ptrCast([*]const f32, &identity_matrix));
+    gles.uniform1i(state.uniforms.uOctahedralNormals, 0);
+
+    self.drawMeshes(state, geometry.meshes);
+}
+
+fn drawGpuSkinned(self: *Self, state: *SubmitState, draw_skinned: DrawCall.DrawSkinned) void {
+    const geometry = draw_skinned.geometry;
+
+    // the shader expects the first three rows of each matrix
+    var bone_rows: [3 * max_gpu_bones][4]f32 = undefined;
+    const palette = self.getPalette(draw_skinned);
+    for (palette) |matrix, b| {
+        inline for ([_]comptime_int{ 0, 1, 2 }) |row| {
+            bone_rows[3 * b + row] = .{ matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row] };
+        }
+    }
+
+    if (state.geometry == geometry) {
+        self.submission_statistics.geometry_binds_saved += 1;
+    } else {
+        self.submission_statistics.geometry_binds += 1;
+        state.geometry = geometry;
+        geometry.bind();
+        geometry.bindSkin();
+    }
+
+    gles.uniformMatrix4fv(state.uniforms.uWorldMatrix, 1, gles.FALSE, @ptrCast([*]const f32, &draw_skinned.transform));
+    gles.uniform4fv(state.uniforms.uBones, @intCast(gles.GLsizei, 3 * palette.len), @ptrCast([*]const f32, &bone_rows));
+
+    self.drawMeshes(state, geometry.meshes);
+}
+
+/// Sprite runs with more quads are split into several draw calls, as indices are 16 bit.
+const max_batch_sprites = (std.math.maxInt(u16) + 1) / 4;
+
+/// Expands all sorted sprite items into world space quads and draws each run of items
+/// with the same texture and blending with a single draw call.
+fn drawSprites(self: *Self, state: *SubmitState) void {
+    const items = self.sprite_items.items;
+    if (items.len == 0)
+        return;
+
+    const index_count = 6 * std.math.min(items.len, max_batch_sprites);
+    self.expandSprites(state.view_projection, index_count) catch {
+        logger.warn("out of memory, skipping sprites", .{});
+        return;
+    };
+    self.submission_statistics.batched_sprites = items.len;
+
+    self.setProgram(state, .static);
+
+    // the attributes now point into the sprite buffer
+    state.geometry = null;
+    state.world_draw_call = null;
+    self.submission_statistics.geometry_binds += 1;
+
+    gles.bindBuffer(gles.ARRAY_BUFFER, self.sprite_vertex_buffer.instance.?);
+    gles.bufferData(gles.ARRAY_BUFFER, @intCast(gles.GLsizeiptr, @sizeOf(Vertex) * self.sprite_vertices.items.len), self.sprite_vertices.items.ptr, gles.STREAM_DRAW);
+    gles.bindBuffer(gles.ELEMENT_ARRAY_BUFFER, self.sprite_index_buffer.instance.?);
+    gles.bufferData(gles.ELEMENT_ARRAY_BUFFER, @intCast(gles.GLsizeiptr, @sizeOf(u16) * index_count), self.sprite_indices.items.ptr, gles.STREAM_DRAW);
+
+    // the quads are already in world space
+    gles.uniformMatrix3fv(state.uniforms.uTexTransform, 1, gles.FALSE, @ptrCast([*]const f32, &identity_matrix3));
+    gles.uniformMatrix4fv(state.uniforms.uWorldMatrix, 1, gles.FALSE, @ptrCast([*]const f32, &identity_matrix));
+    gles.uniformMatrix4fv(state.uniforms.uDequantize, 1, gles.FALSE, @ptrCast([*]const f32, &identity_matrix));
+    gles.uniform1i(state.uniforms.uOctahedralNormals, 0);
+
+    // blended items are sorted last, so blending is enabled at most once
+    var blending = false;
+    defer if (blending) {
+        gles.disable(gles.BLEND);
+        gles.depthMask(gles.TRUE);
+        gles.uniform1f(state.uniforms.uAlphaThreshold, alpha_test_threshold);
+    };
+
+    var first: usize = 0;
+    while (first < items.len) {
+        const texture = spriteTexture(self.draw_calls.items[items[first].draw_call]);
+        const blend = isBlendedSprite(items[first]);
+
+        var end = first + 1;
+        while (end < items.len and end - first < max_batch_sprites and
+            isBlendedSprite(items[end]) == blend and
+            spriteTexture(self.draw_calls.items[items[end].draw_call]) == texture) : (end += 1)
+        {}
+
+        if (blend and !blending) {
+            blending = true;
+            gles.enable(gles.BLEND);
+            gles.blendFunc(gles.SRC_ALPHA, gles.ONE_MINUS_SRC_ALPHA);
+            gles.depthMask(gles.FALSE);
+            gles.uniform1f(state.uniforms.uAlphaThreshold, 1.0 / 255.0);
+        }
+
+        const offset = 4 * @sizeOf(Vertex) * first;
+        gles.vertexAttribPointer(attributes.vPosition, 3, gles.FLOAT, gles.FALSE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, offset + @offsetOf(Vertex, "x")));
+        gles.vertexAttribPointer(attributes.vNormal, 3, gles.FLOAT, gles.TRUE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, offset + @offsetOf(Vertex, "nx")));
+        gles.vertexAttribPointer(attributes.vUV, 2, gles.FLOAT, gles.FALSE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, offset + @offsetOf(Vertex, "u")));
+        self.bindTexture(state, texture);
+
+        gles.drawElements(gles.TRIANGLES, @intCast(gles.GLsizei, 6 * (end - first)), gles.UNSIGNED_SHORT, null);
+        self.submission_statistics.draws += 1;
+        self.submission_statistics.sprite_draws += 1;
+
+        first = end;
+    }
+}
+
+fn isBlendedSprite(item: DrawItem) bool {
+    return (item.key >> 62) == 2;
+}
+
+/// Writes the corners of all sorted sprite items into `sprite_vertices` and makes
+/// sure `sprite_indices` holds at least `index_count` indices.
+fn expandSprites(self: *Self, view_projection: Mat4, index_count: usize) !void {
+    const items = self.sprite_items.items;
+    try self.sprite_vertices.resize(4 * items.len);
+
+    // two triangles per quad, the same for every run
+    if (self.sprite_indices.items.len < index_count) {
+        var quad = self.sprite_indices.items.len / 6;
+        try self.sprite_indices.resize(index_count);
+        while (quad < index_count / 6) : (quad += 1) {
+            const v = @intCast(u16, 4 * quad);
+            self.sprite_indices.items[6 * quad ..][0..6].* = .{ v, v + 1, v + 2, v + 2, v + 1, v + 3 };
+        }
+    }
+
+    const camera = CameraAxes.fromMatrix(view_projection);
+    const vertices = self.sprite_vertices.items;
+    for (items) |item, i| {
+        const quad = vertices[4 * i ..][0..4];
+        switch (self.draw_calls.items[item.draw_call]) {
+            .sprite => |draw_sprite| expandSprite(quad, draw_sprite),
+            .billboard => |draw_billboard| expandBillboard(quad, draw_billboard, camera),
+            .geometry, .skinned => unreachable,
+        }
+    }
+}
+
+const Vec4 = @Vector(4, f32);
+
+/// World space directions of the screen axes, the normalized first two rows of the view projection matrix.
+const CameraAxes = struct {
+    right: Vec4,
+    up: Vec4,
+
+    fn fromMatrix(m: Mat4) CameraAxes {
+        return CameraAxes{
+            .right = normalize3(.{ m[0][0], m[1][0], m[2][0], 0 }),
+            .up = normalize3(.{ m[0][1], m[1][1], m[2][1], 0 }),
+        };
+    }
+};
+
+/// The sprite spans the XY plane of its transform, scaled to its size in pixels.
+fn expandSprite(quad: *[4]Vertex, draw_sprite: DrawCall.DrawSprite) void {
+    const transform = draw_sprite.transform;
+    const half_width = 0.5 * @intToFloat(f32, draw_sprite.rectangle.width);
+    const half_height = 0.5 * @intToFloat(f32, draw_sprite.rectangle.height);
+
+    const right = @as(Vec4, transform[0]) * @splat(4, half_width);
+    const up = @as(Vec4, transform[1]) * @splat(4, half_height);
+    const normal = -normalize3(transform[2]);
+
+    writeQuad(quad, transform[3], right, up, normal, spriteUvs(draw_sprite.sprite, draw_sprite.rectangle));
+}
+
+fn expandBillboard(quad: *[4]Vertex, draw_billboard: DrawCall.DrawBillboard, camera: CameraAxes) void {
+    const billboard = draw_billboard.billboard;
+
+    var right = camera.right;
+    var up = camera.up;
+    switch (billboard.alignment) {
+        .camera => {},
+        .axis => |axis| {
+            up = normalize3(.{ axis[0], axis[1], axis[2], 0 });
+            // the screen right direction, projected onto the plane the billboard turns in
+            const projected = camera.right - up * @splat(4, dot3(camera.right, up));
+            right = if (dot3(projected, projected) > 1e-6)
+                normalize3(projected)
+            else
+                normalize3(cross3(up, camera.up));
+        },
+    }
+
+    const p = billboard.position;
+    writeQuad(
+        quad,
+        .{ p[0], p[1], p[2], 1 },
+        right * @splat(4, 0.5 * billboard.size[0]),
+        up * @splat(4, 0.5 * billboard.size[1]),
+        -normalize3(cross3(right, up)),
+        spriteUvs(draw_billboard.sprite, draw_billboard.rectangle),
+    );
+}
+
+/// Returns the left, bottom, right and top texture coordinate of `rectangle` in `sprite`.
+fn spriteUvs(sprite: *const Texture, rectangle: Rectangle) [4]f32 {
+    const w = @intToFloat(f32, sprite.width);
+    const h = @intToFloat(f32, sprite.height);
+    const u0 = @intToFloat(f32, rectangle.x) / w;
+    const v0 = @intToFloat(f32, rectangle.y) / h;
+    return .{ u0, v0, u0 + @intToFloat(f32, rectangle.width) / w, v0 + @intToFloat(f32, rectangle.height) / h };
+}
+
+/// Writes the corners of the quad around `center` that is spanned by the half extents
+/// `right` and `up`, in the order of `sprite_indices`.
+fn writeQuad(quad: *[4]Vertex, center: Vec4, right: Vec4, up: Vec4, normal: Vec4, uvs: [4]f32) void {
+    const corners = [4]Vec4{ center - right - up, center + right - up, center - right + up, center + right + up };
+    const us = [4]f32{ uvs[0], uvs[2], uvs[0], uvs[2] };
+    const vs = [4]f32{ uvs[1], uvs[1], uvs[3], uvs[3] };
+    for (quad) |*vertex, i| {
+        const corner: [4]f32 = corners[i];
+        vertex.* = Vertex{
+            .x = corner[0],
+            .y = corner[1],
+            .z = corner[2],
+            .nx = normal[0],
+            .ny = normal[1],
+            .nz = normal[2],
+            .u = us[i],
+            .v = vs[i],
+        };
+    }
+}
+
+fn dot3(a: Vec4, b: Vec4) f32 {
+    return @reduce(.Add, a * b * Vec4{ 1, 1, 1, 0 });
+}
+
+fn cross3(a: Vec4, b: Vec4) Vec4 {
+    const a_yzx = @shuffle(f32, a, undefined, [4]i32{ 1, 2, 0, 3 });
+    const b_yzx = @shuffle(f32, b, undefined, [4]i32{ 1, 2, 0, 3 });
+    const c = a * b_yzx - a_yzx * b;
+    return @shuffle(f32, c, undefined, [4]i32{ 1, 2, 0, 3 });
+}
+
+/// Normalizes the xyz part of `v` and clears w.
+fn normalize3(v: Vec4) Vec4 {
+    const xyz = v * Vec4{ 1, 1, 1, 0 };
+    const len = @sqrt(dot3(xyz, xyz));
+    return if (len > 0) xyz / @splat(4, len) else xyz;
+}
+
+fn getPalette(self: Self, draw_skinned: DrawCall.DrawSkinned) []const Mat4 {
+    const bone_count = draw_skinned.geometry.skin.?.bones.len;
+    return self.bone_palettes.items[draw_skinned.palette_offset..][0..bone_count];
+}
+
+fn drawMeshes(self: *Self, state: *SubmitState, meshes: []const Mesh) void {
+    for (meshes) |mesh| {
+        self.drawMesh(state, mesh);
+    }
+}
+
+fn drawMesh(self: *Self, state: *SubmitState, mesh: Mesh) void {
+    self.bindTexture(state, mesh.texture orelse self.white_texture);
+    gles.drawElements(
+        gles.TRIANGLES,
+        @intCast(gles.GLsizei, mesh.count),
+        gles.UNSIGNED_SHORT,
+        @intToPtr(?*const anyopaque, @sizeOf(u16) * mesh.offset),
+    );
+    self.submission_statistics.draws += 1;
+}
+
+pub const CullingStatistics = struct {
+    /// Number of geometries that were completely outside the view frustum.
+    culled_geometries: usize = 0,
+    /// Number of geometries that were hidden behind occluders.
+    occluded_geometries: usize = 0,
+    /// Number of meshes that were skipped, including those of culled geometries.
+    culled_meshes: usize = 0,
+    /// Number of meshes that were drawn.
+    drawn_meshes: usize = 0,
+    /// Number of sprites and billboards that were completely outside the view frustum.
+    culled_sprites: usize = 0,
+};
+
+const CullSphere = struct {
+    x: f32,
+    y: f32,
+    z: f32,
+    radius: f32,
+};
+
+/// Tests the bounding spheres of all geometry draw calls against `frustum` in one batch.
+/// Returns the containment of each draw call, or null if everything must be drawn.
+/// Skinned geometries are always visible, as they have no precomputed bounds for their
+/// final shape. Sprites and billboards are culled one by one in `buildSpriteItems`.
+fn cullDrawCalls(self: *Self, frustum: Frustum) ?[]const Frustum.Containment {
+    if (!self.frustum_culling)
+        return null;
+
+    const count = self.draw_calls.items.len;
+    self.cull_spheres.resize(self.allocator, count) catch return null;
+    self.cull_visibility.resize(self.allocator, count) catch return null;
+
+    for (self.draw_calls.items) |draw_call, i| {
+        const sphere = switch (draw_call) {
+            .geometry => |draw_geom| worldSphere(draw_geom.geometry.bounds.sphere, draw_geom.transform),
+            .skinned, .sprite, .billboard => CullSphere{ .x = 0, .y = 0, .z = 0, .radius = std.math.inf(f32) },
+        };
+        self.cull_spheres.set(i, sphere);
+    }
+
+    frustum.cullSpheres(
+        self.cull_spheres.items(.x),
+        self.cull_spheres.items(.y),
+        self.cull_spheres.items(.z),
+        self.cull_spheres.items(.radius),
+        self.cull_visibility.items,
+    );
+    return self.cull_visibility.items;
+}
+
+/// Enables occlusion culling with a depth buffer of `width`×`height` pixels. Only geometries
+/// with an occluder proxy hide others, see `setOccluderProxy`.
+/// `width` must be a multiple of `occlusion.DepthBuffer.lanes`.
+pub fn enableOcclusionCulling(self: *Self, width: usize, height: usize) !void {
+    self.disableOcclusionCulling();
+    self.occlusion_buffer = try occlusion.DepthBuffer.init(self.allocator, width, height);
+}
+
+pub fn disableOcclusionCulling(self: *Self) void {
+    if (self.occlusion_buffer) |*buffer| {
+        buffer.deinit();
+    }
+    self.occlusion_buffer = null;
+}
+
+/// Makes every draw of `geometry` an occluder, represented by `proxy`. The proxy must be contained
+/// in the geometry and stay valid until it is replaced. Pass null to remove it, which must
+/// happen before the geometry is destroyed.
+pub fn setOccluderProxy(self: *Self, geometry: *Geometry, proxy: ?occlusion.Proxy) !void {
+    if (proxy) |value| {
+        try self.occluder_proxies.put(self.allocator, geometry, value);
+    } else {
+        _ = self.occluder_proxies.remove(geometry);
+    }
+}
+
+/// Rasterizes the proxies of all geometries in the view frustum. Returns the depth
+/// buffer to test against, or null if nothing can be occluded this frame.
+fn rasterizeOccluders(self: *Self, view_projection: Mat4, visibility: ?[]const Frustum.Containment) ?*const occlusion.DepthBuffer {
+    const buffer = if (self.occlusion_buffer) |*buffer| buffer else return null;
+    buffer.clear();
+    if (self.occluder_proxies.count() == 0)
+        return null;
+
+    for (self.draw_calls.items) |draw_call, index| {
+        const draw_geom = switch (draw_call) {
+            .geometry => |geometry| geometry,
+            .skinned, .sprite, .billboard => continue,
+        };
+        if (visibility) |visible| {
+            if (visible[index] == .outside)
+                continue;
+        }
+        const proxy = self.occluder_proxies.get(draw_geom.geometry) orelse continue;
+        buffer.addOccluder(.{ .proxy = proxy, .transform = draw_geom.transform }, view_projection) catch {
+            logger.warn("out of memory, skipping occlusion culling", .{});
+            return null;
+        };
+    }
+
+    buffer.rasterize();
+    return buffer;
+}
+
+fn worldSphere(sphere: ResourceManager.BoundingSphere, transform: Mat4) CullSphere {
+    const center = transformPoint(transform, sphere.center);
+    return CullSphere{
+        .x = center[0],
+        .y = center[1],
+        .z = center[2],
+        .radius = sphere.radius * maxScale(transform),
+    };
+}
+
+fn isVisible(frustum: Frustum, sphere: ResourceManager.BoundingSphere, transform: Mat4) bool {
+    const world = worldSphere(sphere, transform);
+    return frustum.containsSphere(.{ world.x, world.y, world.z }, world.radius);
+}
+
+/// Triangle counts of a frame, showing how much the levels of detail saved.
+pub const LodStatistics = struct {
+    /// Number of triangles that were actually drawn.
+    drawn_triangles: usize = 0,
+    /// Number of triangles that would have been drawn at full detail.
+    full_detail_triangles: usize = 0,
+    /// Number of geometries drawn with a simplified level of detail.
+    reduced_geometries: usize = 0,
+
+    fn add(self: *LodStatistics, geometry: Geometry, level: usize) void {
+        for (geometry.meshes) |mesh| {
+            self.full_detail_triangles += mesh.count / 3;
+        }
+        for (geometry.levelMeshes(level)) |mesh| {
+            self.drawn_triangles += mesh.count / 3;
+        }
+        if (level > 0) {
+            self.reduced_geometries += 1;
+        }
+    }
+
+    /// Returns the number of triangles that were not drawn thanks to the levels of detail.
+    pub fn savedTriangles(self: LodStatistics) usize {
+        return self.full_detail_triangles - self.drawn_triangles;
+    }
+};
+
+const LodKey = struct {
+    geometry: *Geometry,
+    /// `null` for the single anonymous draw of `geometry`.
+    id: ?u64,
+};
+
+/// Identifies `draw_geom` across frames, or returns `null` if it can't be told apart from other
+/// anonymous draws of the same geometry.
+fn lodKey(self: Self, draw_geom: DrawCall.DrawGeometry) ?LodKey {
+    if (draw_geom.id == null and self.anonymous_draws.get(draw_geom.geometry).? > 1)
+        return null;
+    return LodKey{ .geometry = draw_geom.geometry, .id = draw_geom.id };
+}
+
+/// Selects the coarsest level of detail of `draw_geom` whose projected error stays below the threshold.
+fn selectLevel(self: *Self, draw_geom: DrawCall.DrawGeometry, view_projection: Mat4) usize {
+    const geometry = draw_geom.geometry;
+    if (geometry.lods.len == 0)
+        return 0;
+
+    const scale = projectedErrorScale(geometry.bounds.sphere, draw_geom.transform, view_projection);
+
+    var level = coarsestLevel(geometry.*, scale, self.lod_error_threshold);
+    const key = self.lodKey(draw_geom) orelse return level;
+    if (self.lod_history.get(key)) |previous_level| {
+        const previous = std.math.min(@as(usize, previous_level), geometry.lods.len);
+        if (level > previous) {
+            // only get coarser when clearly below the threshold
+            level = std.math.max(previous, coarsestLevel(geometry.*, scale, self.lod_error_threshold * (1.0 - self.lod_hysteresis)));
+        } else if (level < previous) {
+            // only get finer when clearly above the threshold
+            if (scale * geometry.levelError(previous) <= self.lod_error_threshold * (1.0 + self.lod_hysteresis))
+                level = previous;
+        }
+    }
+
+    // Failing to record the level only loses the hysteresis for this instance.
+    self.next_lod_history.put(self.allocator, key, @intCast(u8, std.math.min(level, std.math.maxInt(u8)))) catch {};
+
+    return level;
+}
+
+fn coarsestLevel(geometry: Geometry, scale: f32, threshold: f32) usize {
+    var level = geometry.levelCount() - 1;
+    while (level > 0) : (level -= 1) {
+        if (scale * geometry.levelError(level) <= threshold)
+            return level;
+    }
+    return 0;
+}
+
+/// Returns the factor that converts an error in model units at the center of `sphere`
+/// into a fraction of the viewport height.
+fn projectedErrorScale(sphere: ResourceManager.BoundingSphere, transform: Mat4, view_projection: Mat4) f32 {
+    const clip_w = viewDepth(view_projection, transformPoint(transform, sphere.center));
+
+    // The camera is inside the geometry or it is behind the camera, so keep full detail.
+    if (clip_w <= sphere.radius * maxScale(transform))
+        return std.math.inf(f32);
+
+    // The length of the second row of the view projection matrix is the vertical
+    // projection scale. The viewport height spans 2 units in NDC.
+    const row_y = [3]f32{ view_projection[0][1], view_projection[1][1], view_projection[2][1] };
+    const projection_scale = @sqrt(row_y[0] * row_y[0] + row_y[1] * row_y[1] + row_y[2] * row_y[2]);
+
+    return 0.5 * projection_scale * maxScale(transform) / clip_w;
+}
+
+/// Returns the clip space w of the world space point `p`, its distance along the view direction.
+fn viewDepth(view_projection: Mat4, p: [3]f32) f32 {
+    return view_projection[0][3] * p[0] + view_projection[1][3] * p[1] + view_projection[2][3] * p[2] + view_projection[3][3];
+}
+
+fn transformPoint(m: Mat4, p: [3]f32) [3]f32 {
+    var result: [3]f32 = undefined;
+    for (result) |*v, i| {
+        v.* = m[0][i] * p[0] + m[1][i] * p[1] + m[2][i] * p[2] + m[3][i];
+    }
+    return result;
+}
+
+/// Returns the largest scale factor of the axes of `m`.
+fn maxScale(m: Mat4) f32 {
+    var result: f32 = 0;
+    for (m[0..3]) |column| {
+        result = std.math.max(result, @sqrt(column[0] * column[0] + column[1] * column[1] + column[2] * column[2]));
+    }
+    return result;
+}
+
+fn swapLodHistory(self: *Self) void {
+    std.mem.swap(std.AutoHashMapUnmanaged(LodKey, u8), &self.lod_history, &self.next_lod_history);
+    self.next_lod_history.clearRetainingCapacity();
 }
 
 const DrawCall = union(enum) {
     geometry: DrawGeometry,
+    skinned: DrawSkinned,
     sprite: DrawSprite,
+    billboard: DrawBillboard,
 
     const DrawSprite = struct {
         transform: Mat4,
@@ -294,12 +1610,40 @@ const DrawCall = union(enum) {
         sprite: *Texture,
     };
 
+    const DrawBillboard = struct {
+        billboard: Billboard,
+        rectangle: types.Rectangle,
+        sprite: *Texture,
+    };
+
     const DrawGeometry = struct {
         transform: Mat4,
         geometry: *Geometry,
+        /// identifies the drawn object across frames, see `drawGeometryInstance`
+        id: ?u64,
+    };
+
+    const DrawSkinned = struct {
+        transform: Mat4,
+        geometry: *Geometry,
+        /// index of the first matrix in `bone_palettes`
+        palette_offset: usize,
     };
 };
 
+const identity_matrix = Mat4{
+    .{ 1, 0, 0, 0 },
+    .{ 0, 1, 0, 0 },
+    .{ 0, 0, 1, 0 },
+    .{ 0, 0, 0, 1 },
+};
+
+const identity_matrix3 = Mat3{
+    .{ 1, 0, 0 },
+    .{ 0, 1, 0 },
+    .{ 0, 0, 1 },
+};
+
 pub fn matMul(a: Mat4, b: Mat4) Mat4 {
     var result: Mat4 = undefined;
     inline for ([_]comptime_int{ 0, 1, 2, 3 }) |row| {
@@ -313,3 +1657,57 @@ pub fn matMul(a: Mat4, b: Mat4) Mat4 {
     }
     return result;
 }
+
+test "sortKey groups by state, then mesh, then depth" {
+    // every mesh of a geometry gets its own run, even past 16 meshes
+    var mesh: usize = 1;
+    while (mesh < 0xFFF) : (mesh += 1) {
+        try std.testing.expect(sortKey(.geometry, 7, 3, 0, mesh - 1, 100.0) < sortKey(.geometry, 7, 3, 0, mesh, 1.0));
+    }
+    try std.testing.expect(sortKey(.geometry, 7, 3, 0, 15, 1.0) != sortKey(.geometry, 7, 3, 1, 15, 1.0));
+    try std.testing.expect(sortKey(.geometry, 7, 3, 0, 0xFFF, 1.0) < sortKey(.geometry, 7, 3, 1, 0, 1.0));
+
+    // front to back within the same state
+    try std.testing.expect(sortKey(.geometry, 7, 3, 2, 5, 1.0) < sortKey(.geometry, 7, 3, 2, 5, 2.0));
+    try std.testing.expect(sortKey(.geometry, 7, 3, 2, 5, -1.0) <= sortKey(.geometry, 7, 3, 2, 5, 0.5));
+
+    // state dominates the depth
+    try std.testing.expect(sortKey(.geometry, 7, 3, 0, 0, 1000.0) < sortKey(.geometry, 7, 4, 0, 0, 1.0));
+    try std.testing.expect(sortKey(.geometry, 7, 3, 0, 0, 1000.0) < sortKey(.geometry, 8, 0, 0, 0, 1.0));
+    try std.testing.expect(sortKey(.geometry, 0xFFFF, 0xFFF, 0xF, 0xFFF, 1000.0) < sortKey(.static, 0, 0, 0, 0, 1.0));
+
+    // levels and meshes that don't fit share the last key
+    try std.testing.expectEqual(sortKey(.geometry, 7, 3, 0xF, 9, 1.0), sortKey(.geometry, 7, 3, 100, 9, 1.0));
+    try std.testing.expectEqual(sortKey(.geometry, 7, 3, 1, 0xFFF, 1.0), sortKey(.geometry, 7, 3, 1, 10_000, 1.0));
+}
+
+fn drawItemKeyLessThan(context: void, a: DrawItem, b: DrawItem) bool {
+    _ = context;
+    return a.key < b.key;
+}
+
+test "radixSort sorts stably by key" {
+    var prng = std.rand.DefaultPrng.init(0x5EED);
+    const random = prng.random();
+
+    var items: [1000]DrawItem = undefined;
+    var scratch: [1000]DrawItem = undefined;
+    for ([_]usize{ 0, 1, 2, 17, items.len }) |len| {
+        for (items[0..len]) |*item, i| {
+            // few distinct keys with differences in every byte, so there are many ties
+            const key = random.uintLessThan(u64, 16);
+            item.* = DrawItem{ .key = key * 0x0101_0101_0101_0101, .draw_call = @intCast(u32, i) };
+        }
+
+        var expected: [1000]DrawItem = undefined;
+        std.mem.copy(DrawItem, &expected, items[0..len]);
+        // insertion sort is stable, so ties stay in `draw_call` order
+        std.sort.insertionSort(DrawItem, expected[0..len], {}, drawItemKeyLessThan);
+
+        radixSort(items[0..len], scratch[0..len]);
+        for (items[0..len]) |item, i| {
+            try std.testing.expectEqual(expected[i].key, item.key);
+            try std.testing.expectEqual(expected[i].draw_call, item.draw_call);
+        }
+    }
+}
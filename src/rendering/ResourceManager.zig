@@ -2,6 +2,7 @@
 //! This provides textures, geometries, animations, ... for the use over several
 //! different renderers.
 const std = @import("std");
+const builtin = @import("builtin");
 const zigimg = @import("zigimg");
 const zero_graphics = @import("../zero-graphics.zig");
 
@@ -775,6 +776,129 @@ pub const Vertex = extern struct {
     }
 };
 
+/// A compact vertex with quantized attributes. See `VertexQuantization` for how the values
+/// map back to a `Vertex`.
+pub const QuantizedVertex = extern struct {
+    // position normalized into the bounding box of the geometry
+    x: u16,
+    y: u16,
+    z: u16,
+    // keeps the following attributes 4 byte aligned
+    _pad0: u16 = 0,
+
+    // octahedral encoded normal
+    nx: i16,
+    ny: i16,
+
+    // texture coordinates normalized into the uv bounds of the geometry
+    u: u16,
+    v: u16,
+
+    comptime {
+        if (@sizeOf(QuantizedVertex) != 16) @compileError("QuantizedVertex must have 16 byte!");
+    }
+};
+
+/// The value ranges `QuantizedVertex` attributes are normalized against.
+pub const VertexQuantization = struct {
+    const z3d = @import("z3d-format.zig");
+
+    position_min: [3]f32,
+    position_max: [3]f32,
+    uv_min: [2]f32,
+    uv_max: [2]f32,
+
+    /// Returns the matrix that transforms a normalized position into local space.
+    pub fn positionMatrix(self: VertexQuantization) [4][4]f32 {
+        const min = self.position_min;
+        const max = self.position_max;
+        return [4][4]f32{
+            .{ max[0] - min[0], 0, 0, 0 },
+            .{ 0, max[1] - min[1], 0, 0 },
+            .{ 0, 0, max[2] - min[2], 0 },
+            .{ min[0], min[1], min[2], 1 },
+        };
+    }
+
+    /// Returns the matrix that transforms normalized texture coordinates into the original ones.
+    pub fn uvMatrix(self: VertexQuantization) [3][3]f32 {
+        const min = self.uv_min;
+        const max = self.uv_max;
+        return [3][3]f32{
+            .{ max[0] - min[0], 0, 0 },
+            .{ 0, max[1] - min[1], 0 },
+            .{ min[0], min[1], 1 },
+        };
+    }
+
+    /// Decodes a single vertex on the CPU.
+    pub fn dequantize(self: VertexQuantization, vertex: QuantizedVertex) Vertex {
+        const src = z3d.quantized_static_model.decodeVertex(self.bounds(), z3d.quantized_static_model.Vertex{
+            .x = vertex.x,
+            .y = vertex.y,
+            .z = vertex.z,
+            .nx = vertex.nx,
+            .ny = vertex.ny,
+            .u = vertex.u,
+            .v = vertex.v,
+        });
+        return Vertex.init(.{ src.x, src.y, src.z }, .{ src.nx, src.ny, src.nz }, .{ src.u, src.v });
+    }
+
+    fn bounds(self: VertexQuantization) z3d.quantized_static_model.Bounds {
+        return .{
+            .position_min = self.position_min,
+            .position_max = self.position_max,
+            .uv_min = self.uv_min,
+            .uv_max = self.uv_max,
+        };
+    }
+};
+
+/// Vertices stored in the compact `QuantizedVertex` layout.
+pub const QuantizedVertices = struct {
+    vertices: []const QuantizedVertex,
+    quantization: VertexQuantization,
+};
+
+/// The bone influences of a vertex in a skinned geometry.
+pub const SkinVertex = extern struct {
+    bone_indices: [4]u8,
+    /// normalized weights, they sum up to 255
+    bone_weights: [4]u8,
+};
+
+/// A bone of the skeleton of a skinned geometry.
+pub const Bone = struct {
+    name: [60]u8, // NUL padded
+    /// Index of the parent bone, which is always smaller than the index of this bone.
+    parent: ?usize,
+    /// Transforms from model space into the space of the bone in bind pose.
+    inverse_bind_matrix: [4][4]f32,
+    /// Bind pose transform relative to the parent bone.
+    local_transform: [4][4]f32,
+
+    pub fn getName(self: *const Bone) []const u8 {
+        return std.mem.sliceTo(&self.name, 0);
+    }
+};
+
+/// Skinning information of a geometry. The bones are ordered so that parents come before their children.
+pub const Skin = struct {
+    /// Same length as the vertices of the geometry.
+    vertices: []const SkinVertex,
+    bones: []const Bone,
+
+    /// Returns the index of the bone called `name`.
+    pub fn findBone(self: Skin, name: []const u8) ?usize {
+        for (self.bones) |*bone, i| {
+            if (std.mem.eql(u8, bone.getName(), name))
+                return i;
+        }
+        return null;
+    }
+};
+
 /// A group of faces in a `Geometry` that shares the same texture. Each
 /// `Geometry` has at least one mesh.
 pub const Mesh = struct {
@@ -786,34 +910,157 @@ pub const Mesh = struct {
     texture: ?*Texture,
 };
 
+/// A simplified version of all meshes in a `Geometry`.
+pub const LevelOfDetail = struct {
+    /// Maximum geometric deviation from the full detail meshes in model units.
+    max_error: f32,
+    /// Same length as `Geometry.meshes`; the textures are shared with those meshes.
+    meshes: []const Mesh,
+};
+
+/// A sphere in model space.
+pub const BoundingSphere = struct {
+    center: [3]f32,
+    radius: f32,
+};
+
+/// Bounding volumes of a geometry or a mesh in model space.
+pub const Bounds = struct {
+    const z3d = @import("z3d-format.zig");
+
+    /// axis aligned bounding box
+    min: [3]f32,
+    max: [3]f32,
+    sphere: BoundingSphere,
+
+    /// Computes the bounds of the vertices referenced by `indices`, or of all vertices if `indices` is null.
+    fn compute(data: GeometryData, indices: ?[]const u16) Bounds {
+        const positions = VertexPositions{ .data = data, .indices = indices };
+        const count = if (indices) |list| list.len else if (data.quantized) |quantized| quantized.vertices.len else data.vertices.len;
+        return fromTable(z3d.bounds_table.Bounds.compute(positions, count));
+    }
+
+    fn fromTable(bounds: z3d.bounds_table.Bounds) Bounds {
+        return Bounds{
+            .min = bounds.min,
+            .max = bounds.max,
+            .sphere = BoundingSphere{ .center = bounds.center, .radius = bounds.radius },
+        };
+    }
+
+    const VertexPositions = struct {
+        data: GeometryData,
+        indices: ?[]const u16,
+
+        pub fn position(self: VertexPositions, i: usize) [3]f32 {
+            const index = if (self.indices) |indices| indices[i] else i;
+            const vertex = if (self.data.quantized) |quantized|
+                quantized.quantization.dequantize(quantized.vertices[index])
+            else
+                self.data.vertices[index];
+            return .{ vertex.x, vertex.y, vertex.z };
+        }
+    };
+};
+
 pub const GeometryData = struct {
-    vertices: []Vertex,
-    indices: []u16,
+    vertices: []const Vertex,
+    indices: []const u16,
     meshes: []Mesh,
+    /// Simplified levels of detail, ordered from most to least detailed.
+    lods: []const LevelOfDetail = &[0]LevelOfDetail{},
+    /// When set, these vertices are used and `vertices` is empty.
+    quantized: ?QuantizedVertices = null,
+    /// When set, the geometry can be animated.
+    skin: ?Skin = null,
+    /// Bounds of all vertices. Computed by `createGeometry` if not given.
+    bounds: ?Bounds = null,
+    /// Same length as `meshes`. Computed by `createGeometry` if not given.
+    mesh_bounds: ?[]const Bounds = null,
+    /// When set, the vertices and indices are owned by the data source and will not be freed.
+    borrowed: bool = false,
 
     pub fn deinit(self: *@This(), rm: *ResourceManager) void {
-        rm.allocator.free(self.vertices);
-        rm.allocator.free(self.indices);
+        if (!self.borrowed) {
+            if (self.quantized) |quantized| {
+                rm.allocator.free(quantized.vertices);
+            }
+            rm.allocator.free(self.vertices);
+            rm.allocator.free(self.indices);
+        }
+        for (self.lods) |lod| {
+            rm.allocator.free(lod.meshes);
+        }
+        rm.allocator.free(self.lods);
         rm.allocator.free(self.meshes);
+        if (self.skin) |skin| {
+            rm.allocator.free(skin.vertices);
+            rm.allocator.free(skin.bones);
+        }
+        if (self.mesh_bounds) |mesh_bounds| {
+            rm.allocator.free(mesh_bounds);
+        }
         self.* = undefined;
     }
+
+    /// Computes the bounds the data source didn't provide.
+    fn completeBounds(self: *@This(), rm: *ResourceManager) !void {
+        if (self.mesh_bounds == null) {
+            const mesh_bounds = try rm.allocator.alloc(Bounds, self.meshes.len);
+            for (mesh_bounds) |*bounds, i| {
+                const mesh = self.meshes[i];
+                bounds.* = Bounds.compute(self.*, self.indices[mesh.offset..][0..mesh.count]);
+            }
+            self.mesh_bounds = mesh_bounds;
+        }
+        if (self.bounds == null) {
+            self.bounds = Bounds.compute(self.*, null);
+        }
+    }
 };
 
 /// A 3D model with one or more textures.
 pub const Geometry = struct {
-    /// Vertex attributes used in this renderer
+    /// Vertex attributes used in this renderer.
+    /// The format of the attributes depends on the vertex format of the geometry:
+    /// - `vPosition`: 3×f32 or 3×u16 normalized, see `dequantizationMatrix`
+    /// - `vNormal`: 3×f32 or 2×i16 normalized with octahedral encoding
+    /// - `vUV`: 2×f32 or 2×u16 normalized, see `uvDequantizationMatrix`
     pub const attributes = .{
         .vPosition = 0,
         .vNormal = 1,
         .vUV = 2,
     };
 
+    /// Additional vertex attributes of skinned geometries, see `bindSkin`.
+    /// - `vBoneIndices`: 4×u8
+    /// - `vBoneWeights`: 4×u8 normalized
+    pub const skin_attributes = .{
+        .vBoneIndices = 3,
+        .vBoneWeights = 4,
+    };
+
     vertex_buffer: ?gl.GLuint,
     index_buffer: ?gl.GLuint,
+    /// Stores the `SkinVertex` data of skinned geometries.
+    skin_buffer: ?gl.GLuint,
 
-    vertices: []Vertex,
-    indices: []u16,
+    vertices: []const Vertex,
+    indices: []const u16,
     meshes: []Mesh,
+    /// Simplified levels of detail, ordered from most to least detailed.
+    lods: []const LevelOfDetail,
+    /// Encloses all vertices in model space.
+    bounds: Bounds,
+    /// Same length as `meshes`. Encloses the faces of each mesh in model space.
+    /// The meshes of the levels of detail share these bounds.
+    mesh_bounds: []const Bounds,
+    /// When set, the geometry uses quantized vertices and `vertices` is empty.
+    quantized: ?QuantizedVertices,
+    /// When set, the geometry can be animated.
+    skin: ?Skin,
+    /// When set, `vertices`, `indices` and `quantized` are owned by the data source.
+    borrowed: bool,
 
     source: DataSource(GeometryData),
 
@@ -826,7 +1073,13 @@ pub const Geometry = struct {
         gl.genBuffers(bufs.len, &bufs);
         errdefer gl.deleteBuffers(bufs.len, &bufs);
 
-        if (geometry.vertices.len > 0) {
+        if (geometry.quantized) |quantized| {
+            if (quantized.vertices.len > 0) {
+                gl.bindBuffer(gl.ARRAY_BUFFER, bufs[0]);
+                gl.bufferData(gl.ARRAY_BUFFER, @intCast(gl.GLsizei, @sizeOf(QuantizedVertex) * quantized.vertices.len), quantized.vertices.ptr, gl.STATIC_DRAW);
+                gl.bindBuffer(gl.ARRAY_BUFFER, 0);
+            }
+        } else if (geometry.vertices.len > 0) {
             gl.bindBuffer(gl.ARRAY_BUFFER, bufs[0]);
             gl.bufferData(gl.ARRAY_BUFFER, @intCast(gl.GLsizei, @sizeOf(Vertex) * geometry.vertices.len), geometry.vertices.ptr, gl.STATIC_DRAW);
             gl.bindBuffer(gl.ARRAY_BUFFER, 0);
@@ -838,6 +1091,15 @@ pub const Geometry = struct {
             gl.bindBuffer(gl.ELEMENT_ARRAY_BUFFER, 0);
         }
 
+        if (geometry.skin) |skin| {
+            var skin_buffer: gl.GLuint = undefined;
+            gl.genBuffers(1, &skin_buffer);
+            gl.bindBuffer(gl.ARRAY_BUFFER, skin_buffer);
+            gl.bufferData(gl.ARRAY_BUFFER, @intCast(gl.GLsizei, @sizeOf(SkinVertex) * skin.vertices.len), skin.vertices.ptr, gl.STATIC_DRAW);
+            gl.bindBuffer(gl.ARRAY_BUFFER, 0);
+            geometry.skin_buffer = skin_buffer;
+        }
+
         geometry.vertex_buffer = bufs[0];
         geometry.index_buffer = bufs[1];
     }
@@ -850,17 +1112,98 @@ pub const Geometry = struct {
         var bufs = [2]gl.GLuint{ geometry.vertex_buffer.?, geometry.index_buffer.? };
         gl.deleteBuffers(bufs.len, &bufs);
 
+        if (geometry.skin_buffer) |skin_buffer| {
+            gl.deleteBuffers(1, &skin_buffer);
+        }
+
         geometry.vertex_buffer = null;
         geometry.index_buffer = null;
+        geometry.skin_buffer = null;
     }
 
     pub fn bind(self: Geometry) void {
         gl.bindBuffer(gl.ARRAY_BUFFER, self.vertex_buffer.?);
-        gl.vertexAttribPointer(attributes.vPosition, 3, gl.FLOAT, gl.FALSE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "x")));
-        gl.vertexAttribPointer(attributes.vNormal, 3, gl.FLOAT, gl.TRUE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "nx")));
-        gl.vertexAttribPointer(attributes.vUV, 2, gl.FLOAT, gl.FALSE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "u")));
+        if (self.quantized != null) {
+            gl.vertexAttribPointer(attributes.vPosition, 3, gl.UNSIGNED_SHORT, gl.TRUE, @sizeOf(QuantizedVertex), @intToPtr(?*const anyopaque, @offsetOf(QuantizedVertex, "x")));
+            gl.vertexAttribPointer(attributes.vNormal, 2, gl.SHORT, gl.TRUE, @sizeOf(QuantizedVertex), @intToPtr(?*const anyopaque, @offsetOf(QuantizedVertex, "nx")));
+            gl.vertexAttribPointer(attributes.vUV, 2, gl.UNSIGNED_SHORT, gl.TRUE, @sizeOf(QuantizedVertex), @intToPtr(?*const anyopaque, @offsetOf(QuantizedVertex, "u")));
+        } else {
+            gl.vertexAttribPointer(attributes.vPosition, 3, gl.FLOAT, gl.FALSE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "x")));
+            gl.vertexAttribPointer(attributes.vNormal, 3, gl.FLOAT, gl.TRUE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "nx")));
+            gl.vertexAttribPointer(attributes.vUV, 2, gl.FLOAT, gl.FALSE, @sizeOf(Vertex), @intToPtr(?*const anyopaque, @offsetOf(Vertex, "u")));
+        }
         gl.bindBuffer(gl.ELEMENT_ARRAY_BUFFER, self.index_buffer.?);
     }
+
+    /// Sets up `skin_attributes` for a skinned geometry. Must be called after `bind`.
+    pub fn bindSkin(self: Geometry) void {
+        gl.bindBuffer(gl.ARRAY_BUFFER, self.skin_buffer.?);
+        gl.vertexAttribPointer(skin_attributes.vBoneIndices, 4, gl.UNSIGNED_BYTE, gl.FALSE, @sizeOf(SkinVertex), @intToPtr(?*const anyopaque, @offsetOf(SkinVertex, "bone_indices")));
+        gl.vertexAttribPointer(skin_attributes.vBoneWeights, 4, gl.UNSIGNED_BYTE, gl.TRUE, @sizeOf(SkinVertex), @intToPtr(?*const anyopaque, @offsetOf(SkinVertex, "bone_weights")));
+        gl.bindBuffer(gl.ARRAY_BUFFER, self.vertex_buffer.?);
+    }
+
+    /// Returns the matrix that transforms `vPosition` into local space.
+    pub fn dequantizationMatrix(self: Geometry) [4][4]f32 {
+        return if (self.quantized) |quantized|
+            quantized.quantization.positionMatrix()
+        else
+            [4][4]f32{
+                .{ 1, 0, 0, 0 },
+                .{ 0, 1, 0, 0 },
+                .{ 0, 0, 1, 0 },
+                .{ 0, 0, 0, 1 },
+            };
+    }
+
+    /// Returns the matrix that transforms `vUV` into texture coordinates.
+    pub fn uvDequantizationMatrix(self: Geometry) [3][3]f32 {
+        return if (self.quantized) |quantized|
+            quantized.quantization.uvMatrix()
+        else
+            [3][3]f32{
+                .{ 1, 0, 0 },
+                .{ 0, 1, 0 },
+                .{ 0, 0, 1 },
+            };
+    }
+
+    /// Returns the number of detail levels including the full detail meshes.
+    pub fn levelCount(self: Geometry) usize {
+        return 1 + self.lods.len;
+    }
+
+    /// Returns the meshes of detail level `level`, where 0 is the full detail.
+    pub fn levelMeshes(self: Geometry, level: usize) []const Mesh {
+        return if (level == 0)
+            self.meshes
+        else
+            self.lods[level - 1].meshes;
+    }
+
+    /// Returns the maximum geometric error of detail level `level` in model units.
+    pub fn levelError(self: Geometry, level: usize) f32 {
+        return if (level == 0)
+            0.0
+        else
+            self.lods[level - 1].max_error;
+    }
+
+    /// Returns the number of vertices in the geometry.
+    pub fn vertexCount(self: Geometry) usize {
+        return if (self.quantized) |quantized|
+            quantized.vertices.len
+        else
+            self.vertices.len;
+    }
+
+    /// Returns the vertex at `index`, decoding it if necessary.
+    pub fn getVertex(self: Geometry, index: usize) Vertex {
+        return if (self.quantized) |quantized|
+            quantized.quantization.dequantize(quantized.vertices[index])
+        else
+            self.vertices[index];
+    }
 };
 
 pub fn createGeometry(self: *ResourceManager, data_source: anytype) !*Geometry {
@@ -870,12 +1213,21 @@ pub fn createGeometry(self: *ResourceManager, data_source: anytype) !*Geometry {
     var data = try source.create(self);
     errdefer data.deinit(self);
 
+    try data.completeBounds(self);
+
     const geometry = try self.geometries.allocate(Geometry{
         .vertex_buffer = null,
         .index_buffer = null,
+        .skin_buffer = null,
         .vertices = data.vertices,
         .indices = data.indices,
         .meshes = data.meshes,
+        .lods = data.lods,
+        .bounds = data.bounds.?,
+        .mesh_bounds = data.mesh_bounds.?,
+        .quantized = data.quantized,
+        .skin = data.skin,
+        .borrowed = data.borrowed,
         .source = source,
     });
     errdefer self.geometries.release(self, geometry);
@@ -914,9 +1266,23 @@ fn destroyGeometryInternal(ctx: *ResourceManager, geometry: *Geometry) void {
         }
     }
 
-    ctx.allocator.free(geometry.indices);
-    ctx.allocator.free(geometry.vertices);
+    if (!geometry.borrowed) {
+        if (geometry.quantized) |quantized| {
+            ctx.allocator.free(quantized.vertices);
+        }
+        ctx.allocator.free(geometry.indices);
+        ctx.allocator.free(geometry.vertices);
+    }
+    for (geometry.lods) |lod| {
+        ctx.allocator.free(lod.meshes);
+    }
+    ctx.allocator.free(geometry.lods);
     ctx.allocator.free(geometry.meshes);
+    ctx.allocator.free(geometry.mesh_bounds);
+    if (geometry.skin) |skin| {
+        ctx.allocator.free(skin.vertices);
+        ctx.allocator.free(skin.bones);
+    }
 
     geometry.source.deinit(ctx);
     geometry.* = undefined;
@@ -988,6 +1354,10 @@ pub fn Z3DGeometry(comptime TextureLoader: ?type) type {
 
         data: []const u8,
         loader: ?ActualTextureLoader = null,
+        /// When set, the geometry references the vertices and indices in `data` instead
+        /// of copying them, if the host is little-endian and the data is suitably aligned.
+        /// `data` must then stay valid until the geometry is destroyed.
+        borrow_data: bool = false,
 
         noinline fn launder(x: usize) usize {
             return x;
@@ -1003,93 +1373,712 @@ pub fn Z3DGeometry(comptime TextureLoader: ?type) type {
 
             if (!std.mem.eql(u8, &common_header.magic, &z3d.magic_number))
                 return error.InvalidFormat;
-            if (std.mem.littleToNative(u16, common_header.version) != 1)
+            const version = std.mem.littleToNative(u16, common_header.version);
+
+            switch (common_header.type) {
+                .static => switch (version) {
+                    1 => return try self.createStatic(rm, z3d.static_model),
+                    z3d.quantized_static_model.version => return try self.createStatic(rm, z3d.quantized_static_model),
+                    else => return error.InvalidFormat,
+                },
+                .dynamic => switch (version) {
+                    1 => return try self.createDynamic(rm),
+                    else => return error.InvalidFormat,
+                },
+                _ => return error.InvalidFormat,
+            }
+        }
+
+        fn createStatic(self: @This(), rm: *ResourceManager, comptime model: type) CreateResourceDataError!GeometryData {
+            const GpuVertex = if (model == z3d.quantized_static_model) QuantizedVertex else Vertex;
+            comptime {
+                if (@sizeOf(model.Vertex) != @sizeOf(GpuVertex)) @compileError("z3d vertex layout must match the gpu layout");
+            }
+
+            const geometry_data = self.data;
+
+            if (geometry_data.len < launder(@sizeOf(model.Header)))
                 return error.InvalidFormat;
 
-            var loader_arena = std.heap.ArenaAllocator.init(rm.allocator);
-            defer loader_arena.deinit();
+            const header = @ptrCast(*align(1) const model.Header, &geometry_data[0]);
+            const vertex_count = std.mem.littleToNative(u32, header.vertex_count);
+            const index_count = std.mem.littleToNative(u32, header.index_count);
+            const mesh_count = std.mem.littleToNative(u32, header.mesh_count);
+            if (vertex_count == 0)
+                return error.InvalidFormat;
+            if (index_count == 0)
+                return error.InvalidFormat;
+            if (mesh_count == 0)
+                return error.InvalidFormat;
 
-            switch (common_header.type) {
-                .static => {
-                    const header = @ptrCast(*align(1) const z3d.static_model.Header, &geometry_data[0]);
-                    const vertex_count = std.mem.littleToNative(u32, header.vertex_count);
-                    const index_count = std.mem.littleToNative(u32, header.index_count);
-                    const mesh_count = std.mem.littleToNative(u32, header.mesh_count);
-                    if (vertex_count == 0)
-                        return error.InvalidFormat;
-                    if (index_count == 0)
-                        return error.InvalidFormat;
-                    if (mesh_count == 0)
+            const vertex_offset = @sizeOf(model.Header);
+            const index_offset = vertex_offset + @as(usize, @sizeOf(model.Vertex)) * vertex_count;
+            const mesh_offset = index_offset + @as(usize, @sizeOf(model.Index)) * index_count;
+            const file_size = mesh_offset + @as(usize, @sizeOf(model.Mesh)) * mesh_count;
+            if (geometry_data.len < file_size)
+                return error.InvalidFormat;
+
+            const src_meshes = @ptrCast([*]align(1) const model.Mesh, &geometry_data[mesh_offset]);
+            for (src_meshes[0..mesh_count]) |src_mesh| {
+                const offset = std.mem.littleToNative(u32, src_mesh.offset);
+                const length = std.mem.littleToNative(u32, src_mesh.length);
+                if (@as(u64, offset) + length > index_count)
+                    return error.InvalidFormat;
+            }
+
+            // The on-disk layout is exactly what we upload, so when we may keep a
+            // reference to the data and it is aligned, we skip the copy entirely.
+            const borrow = self.borrow_data and
+                builtin.cpu.arch.endian() == .Little and
+                std.mem.isAligned(@ptrToInt(geometry_data.ptr) + vertex_offset, @alignOf(GpuVertex)) and
+                std.mem.isAligned(@ptrToInt(geometry_data.ptr) + index_offset, @alignOf(u16));
+
+            const vertices: []const GpuVertex = if (borrow)
+                @ptrCast([*]const GpuVertex, @alignCast(@alignOf(GpuVertex), &geometry_data[vertex_offset]))[0..vertex_count]
+            else
+                try copyVertices(rm, model, @ptrCast([*]align(1) const model.Vertex, &geometry_data[vertex_offset])[0..vertex_count]);
+            errdefer if (!borrow) rm.allocator.free(vertices);
+
+            const indices: []const u16 = if (borrow)
+                @ptrCast([*]const u16, @alignCast(@alignOf(u16), &geometry_data[index_offset]))[0..index_count]
+            else
+                try copyIndices(rm, @ptrCast([*]align(1) const model.Index, &geometry_data[index_offset])[0..index_count]);
+            errdefer if (!borrow) rm.allocator.free(indices);
+            try checkIndices(indices, vertex_count);
+
+            const dst_meshes = try self.loadMeshes(rm, src_meshes[0..mesh_count]);
+            errdefer freeMeshes(rm, dst_meshes);
+
+            const trailer = geometry_data[file_size..];
+
+            const lods = try loadLevels(rm, findTable(trailer, mesh_count, z3d.lod_table.magic), dst_meshes, index_count);
+            errdefer freeLevels(rm, lods);
+
+            const bounds = try loadBounds(rm, findTable(trailer, mesh_count, z3d.bounds_table.magic), mesh_count);
+            errdefer if (bounds) |table| rm.allocator.free(table.meshes);
+
+            if (model == z3d.quantized_static_model) {
+                return GeometryData{
+                    .vertices = &[0]Vertex{},
+                    .indices = indices,
+                    .meshes = dst_meshes,
+                    .lods = lods,
+                    .bounds = if (bounds) |table| table.model else null,
+                    .mesh_bounds = if (bounds) |table| table.meshes else null,
+                    .quantized = QuantizedVertices{
+                        .vertices = vertices,
+                        .quantization = VertexQuantization{
+                            .position_min = littleToNativeFloats(3, header.position_min),
+                            .position_max = littleToNativeFloats(3, header.position_max),
+                            .uv_min = littleToNativeFloats(2, header.uv_min),
+                            .uv_max = littleToNativeFloats(2, header.uv_max),
+                        },
+                    },
+                    .borrowed = borrow,
+                };
+            } else {
+                return GeometryData{
+                    .vertices = vertices,
+                    .indices = indices,
+                    .meshes = dst_meshes,
+                    .lods = lods,
+                    .bounds = if (bounds) |table| table.model else null,
+                    .mesh_bounds = if (bounds) |table| table.meshes else null,
+                    .borrowed = borrow,
+                };
+            }
+        }
+
+        fn createDynamic(self: @This(), rm: *ResourceManager) CreateResourceDataError!GeometryData {
+            const model = z3d.dynamic_model;
+            const geometry_data = self.data;
+
+            if (geometry_data.len < launder(@sizeOf(model.Header)))
+                return error.InvalidFormat;
+
+            const header = @ptrCast(*align(1) const model.Header, &geometry_data[0]);
+            const vertex_count = std.mem.littleToNative(u32, header.vertex_count);
+            const index_count = std.mem.littleToNative(u32, header.index_count);
+            const mesh_count = std.mem.littleToNative(u32, header.mesh_count);
+            const bone_count = std.mem.littleToNative(u32, header.bone_count);
+            if (vertex_count == 0 or index_count == 0 or mesh_count == 0 or bone_count == 0)
+                return error.InvalidFormat;
+            if (bone_count > model.max_bones)
+                return error.InvalidFormat;
+
+            const vertex_offset = @sizeOf(model.Header);
+            const index_offset = vertex_offset + @as(usize, @sizeOf(model.Vertex)) * vertex_count;
+            const mesh_offset = index_offset + @as(usize, @sizeOf(model.Index)) * index_count;
+            const bone_offset = mesh_offset + @as(usize, @sizeOf(model.Mesh)) * mesh_count;
+            const file_size = bone_offset + @as(usize, @sizeOf(model.Bone)) * bone_count;
+            if (geometry_data.len < file_size)
+                return error.InvalidFormat;
+
+            const src_vertices = @ptrCast([*]align(1) const model.Vertex, &geometry_data[vertex_offset])[0..vertex_count];
+            const src_meshes = @ptrCast([*]align(1) const model.Mesh, &geometry_data[mesh_offset])[0..mesh_count];
+            const src_bones = @ptrCast([*]align(1) const model.Bone, &geometry_data[bone_offset])[0..bone_count];
+
+            for (src_meshes) |src_mesh| {
+                const offset = std.mem.littleToNative(u32, src_mesh.offset);
+                const length = std.mem.littleToNative(u32, src_mesh.length);
+                if (@as(u64, offset) + length > index_count)
+                    return error.InvalidFormat;
+            }
+
+            // The skinning data goes into its own buffer, so the regular vertices
+            // keep the layout of static geometry.
+            const vertices = try rm.allocator.alloc(Vertex, vertex_count);
+            errdefer rm.allocator.free(vertices);
+            const skin_vertices = try rm.allocator.alloc(SkinVertex, vertex_count);
+            errdefer rm.allocator.free(skin_vertices);
+
+            for (src_vertices) |src, i| {
+                vertices[i] = Vertex{
+                    .x = littleToNativeFloat(src.x),
+                    .y = littleToNativeFloat(src.y),
+                    .z = littleToNativeFloat(src.z),
+                    .nx = littleToNativeFloat(src.nx),
+                    .ny = littleToNativeFloat(src.ny),
+                    .nz = littleToNativeFloat(src.nz),
+                    .u = littleToNativeFloat(src.u),
+                    .v = littleToNativeFloat(src.v),
+                };
+                for (src.bone_indices) |bone| {
+                    if (bone >= bone_count)
                         return error.InvalidFormat;
+                }
+                skin_vertices[i] = SkinVertex{
+                    .bone_indices = src.bone_indices,
+                    .bone_weights = src.bone_weights,
+                };
+            }
 
-                    const vertex_offset = 24;
-                    const index_offset = vertex_offset + 32 * vertex_count;
-                    const mesh_offset = index_offset + 2 * index_count;
-
-                    const src_vertices = @ptrCast([*]align(1) const z3d.static_model.Vertex, &geometry_data[vertex_offset]);
-                    const src_indices = @ptrCast([*]align(1) const z3d.static_model.Index, &geometry_data[index_offset]);
-                    const src_meshes = @ptrCast([*]align(1) const z3d.static_model.Mesh, &geometry_data[mesh_offset]);
-
-                    const dst_vertices = try rm.allocator.alloc(Vertex, vertex_count);
-                    errdefer rm.allocator.free(dst_vertices);
-                    const dst_indices = try rm.allocator.alloc(u16, index_count);
-                    errdefer rm.allocator.free(dst_indices);
-                    const dst_meshes = try rm.allocator.alloc(Mesh, mesh_count);
-                    errdefer rm.allocator.free(dst_meshes);
-
-                    for (dst_vertices) |*vtx, i| {
-                        const src = src_vertices[i];
-                        vtx.* = Vertex{
-                            .x = src.x,
-                            .y = src.y,
-                            .z = src.z,
-                            .nx = src.nx,
-                            .ny = src.ny,
-                            .nz = src.nz,
-                            .u = src.u,
-                            .v = src.v,
-                        };
-                    }
-                    for (dst_indices) |*idx, i| {
-                        idx.* = std.mem.littleToNative(u16, src_indices[i]);
-                    }
+            const indices = try copyIndices(rm, @ptrCast([*]align(1) const model.Index, &geometry_data[index_offset])[0..index_count]);
+            errdefer rm.allocator.free(indices);
+            try checkIndices(indices, vertex_count);
+
+            const bones = try rm.allocator.alloc(Bone, bone_count);
+            errdefer rm.allocator.free(bones);
+
+            for (bones) |*bone, i| {
+                const src = src_bones[i];
+                const parent = std.mem.littleToNative(u32, src.parent);
+                if (parent != model.no_parent and parent >= i)
+                    return error.InvalidFormat;
+                bone.* = Bone{
+                    .name = src.name,
+                    .parent = if (parent == model.no_parent) null else parent,
+                    .inverse_bind_matrix = littleToNativeMatrix(src.inverse_bind_matrix),
+                    .local_transform = littleToNativeMatrix(src.local_transform),
+                };
+            }
 
-                    for (dst_meshes) |*mesh, i| {
-                        const src_mesh = src_meshes[i];
-                        mesh.* = Mesh{
-                            .offset = std.mem.littleToNative(u32, src_mesh.offset),
-                            .count = std.mem.littleToNative(u32, src_mesh.length),
-                            .texture = null,
-                        };
-
-                        const texture_file_len = std.mem.indexOfScalar(u8, &src_mesh.texture_file, 0) orelse src_mesh.texture_file.len;
-                        const texture_file = src_mesh.texture_file[0..texture_file_len];
-
-                        if (texture_file.len > 0) {
-                            if (comptime TextureLoader != null) {
-                                if (self.loader) |loader| {
-                                    mesh.texture = try loader.load(rm, texture_file);
-                                    //
-                                } else {
-                                    logger.warn("Z3D file contains textures, but no texture loader was given. The texture '{s}' is missing.", .{texture_file});
-                                }
-                            } else {
-                                logger.warn("Z3D file contains textures, but the texture loader cannot load textures. The texture '{s}' is missing.", .{texture_file});
-                            }
+            const dst_meshes = try self.loadMeshes(rm, src_meshes);
+            errdefer freeMeshes(rm, dst_meshes);
+
+            const bounds = try loadBounds(rm, findTable(geometry_data[file_size..], mesh_count, z3d.bounds_table.magic), mesh_count);
+            errdefer if (bounds) |table| rm.allocator.free(table.meshes);
+
+            return GeometryData{
+                .vertices = vertices,
+                .indices = indices,
+                .meshes = dst_meshes,
+                .bounds = if (bounds) |table| table.model else null,
+                .mesh_bounds = if (bounds) |table| table.meshes else null,
+                .skin = Skin{
+                    .vertices = skin_vertices,
+                    .bones = bones,
+                },
+            };
+        }
+
+        fn loadMeshes(self: @This(), rm: *ResourceManager, src_meshes: []align(1) const z3d.static_model.Mesh) ![]Mesh {
+            const dst_meshes = try rm.allocator.alloc(Mesh, src_meshes.len);
+            errdefer rm.allocator.free(dst_meshes);
+            var loaded: usize = 0;
+            errdefer releaseTextures(rm, dst_meshes[0..loaded]);
+
+            for (dst_meshes) |*mesh, i| {
+                const src_mesh = src_meshes[i];
+                mesh.* = Mesh{
+                    .offset = std.mem.littleToNative(u32, src_mesh.offset),
+                    .count = std.mem.littleToNative(u32, src_mesh.length),
+                    .texture = null,
+                };
+
+                const texture_file_len = std.mem.indexOfScalar(u8, &src_mesh.texture_file, 0) orelse src_mesh.texture_file.len;
+                const texture_file = src_mesh.texture_file[0..texture_file_len];
+
+                if (texture_file.len > 0) {
+                    if (comptime TextureLoader != null) {
+                        if (self.loader) |loader| {
+                            mesh.texture = try loader.load(rm, texture_file);
+                            //
+                        } else {
+                            logger.warn("Z3D file contains textures, but no texture loader was given. The texture '{s}' is missing.", .{texture_file});
                         }
+                    } else {
+                        logger.warn("Z3D file contains textures, but the texture loader cannot load textures. The texture '{s}' is missing.", .{texture_file});
                     }
+                }
+                loaded += 1;
+            }
 
-                    return GeometryData{
-                        .vertices = dst_vertices,
-                        .indices = dst_indices,
-                        .meshes = dst_meshes,
+            return dst_meshes;
+        }
+
+        /// Releases the mesh list returned by `loadMeshes` together with its textures.
+        fn freeMeshes(rm: *ResourceManager, meshes: []Mesh) void {
+            releaseTextures(rm, meshes);
+            rm.allocator.free(meshes);
+        }
+
+        fn releaseTextures(rm: *ResourceManager, meshes: []const Mesh) void {
+            for (meshes) |mesh| {
+                if (mesh.texture) |texture| {
+                    rm.destroyTexture(texture);
+                }
+            }
+        }
+
+        /// Returns the optional table starting with `magic` from the tables that follow the
+        /// regular model data, or an empty slice if there is none.
+        fn findTable(trailer: []const u8, mesh_count: usize, magic: [4]u8) []const u8 {
+            var rest = trailer;
+            while (rest.len >= 8) {
+                const table_magic = rest[0..4].*;
+                if (std.mem.eql(u8, &table_magic, &magic))
+                    return rest;
+
+                const table_size = if (std.mem.eql(u8, &table_magic, &z3d.lod_table.magic))
+                    z3d.lod_table.size(std.mem.readIntLittle(u32, rest[4..8]), mesh_count)
+                else if (std.mem.eql(u8, &table_magic, &z3d.bounds_table.magic))
+                    z3d.bounds_table.size(mesh_count)
+                else
+                    break; // we can't skip tables we don't know
+                if (rest.len < table_size)
+                    break;
+                rest = rest[table_size..];
+            }
+            return &[0]u8{};
+        }
+
+        const BoundsTable = struct {
+            model: Bounds,
+            meshes: []const Bounds,
+        };
+
+        /// Loads the optional bounds table.
+        fn loadBounds(rm: *ResourceManager, table: []const u8, mesh_count: usize) !?BoundsTable {
+            if (table.len < @sizeOf(z3d.bounds_table.Header))
+                return null;
+
+            const header = @ptrCast(*align(1) const z3d.bounds_table.Header, &table[0]);
+            if (!std.mem.eql(u8, &header.magic, &z3d.bounds_table.magic))
+                return null;
+            if (std.mem.littleToNative(u32, header.mesh_count) != mesh_count)
+                return error.InvalidFormat;
+            if (table.len < z3d.bounds_table.size(mesh_count))
+                return error.InvalidFormat;
+
+            const src_bounds = @ptrCast([*]align(1) const z3d.bounds_table.Bounds, &table[@sizeOf(z3d.bounds_table.Header)]);
+
+            const meshes = try rm.allocator.alloc(Bounds, mesh_count);
+            for (meshes) |*bounds, i| {
+                bounds.* = Bounds.fromTable(littleToNativeBounds(src_bounds[1 + i]));
+            }
+
+            return BoundsTable{
+                .model = Bounds.fromTable(littleToNativeBounds(src_bounds[0])),
+                .meshes = meshes,
+            };
+        }
+
+        fn littleToNativeBounds(bounds: z3d.bounds_table.Bounds) z3d.bounds_table.Bounds {
+            return z3d.bounds_table.Bounds{
+                .min = littleToNativeFloats(3, bounds.min),
+                .max = littleToNativeFloats(3, bounds.max),
+                .center = littleToNativeFloats(3, bounds.center),
+                .radius = littleToNativeFloat(bounds.radius),
+            };
+        }
+
+        /// Loads the optional level of detail table that follows the mesh list.
+        fn loadLevels(rm: *ResourceManager, table: []const u8, meshes: []const Mesh, index_count: usize) ![]const LevelOfDetail {
+            if (table.len < @sizeOf(z3d.lod_table.Header))
+                return &[0]LevelOfDetail{};
+
+            const header = @ptrCast(*align(1) const z3d.lod_table.Header, &table[0]);
+            if (!std.mem.eql(u8, &header.magic, &z3d.lod_table.magic))
+                return &[0]LevelOfDetail{};
+
+            const level_count = std.mem.littleToNative(u32, header.level_count);
+            if (table.len < z3d.lod_table.size(level_count, meshes.len))
+                return error.InvalidFormat;
+
+            const src_levels = @ptrCast([*]align(1) const z3d.lod_table.Level, &table[@sizeOf(z3d.lod_table.Header)]);
+            const src_ranges = @ptrCast([*]align(1) const z3d.lod_table.Range, &table[@sizeOf(z3d.lod_table.Header) + @sizeOf(z3d.lod_table.Level) * level_count]);
+
+            const lods = try rm.allocator.alloc(LevelOfDetail, level_count);
+            var loaded: usize = 0;
+            errdefer {
+                for (lods[0..loaded]) |lod| {
+                    rm.allocator.free(lod.meshes);
+                }
+                rm.allocator.free(lods);
+            }
+
+            while (loaded < level_count) : (loaded += 1) {
+                const lod_meshes = try rm.allocator.alloc(Mesh, meshes.len);
+                errdefer rm.allocator.free(lod_meshes);
+
+                for (lod_meshes) |*mesh, i| {
+                    const range = src_ranges[loaded * meshes.len + i];
+                    const offset = std.mem.littleToNative(u32, range.offset);
+                    const length = std.mem.littleToNative(u32, range.length);
+                    if (@as(u64, offset) + length > index_count)
+                        return error.InvalidFormat;
+                    mesh.* = Mesh{
+                        .offset = offset,
+                        .count = length,
+                        .texture = meshes[i].texture,
                     };
-                },
-                .dynamic => @panic("dynamic model loading not supported yet!"),
-                _ => return error.InvalidFormat,
+                }
+
+                lods[loaded] = LevelOfDetail{
+                    .max_error = littleToNativeFloat(src_levels[loaded].max_error),
+                    .meshes = lod_meshes,
+                };
+            }
+
+            return lods;
+        }
+
+        fn freeLevels(rm: *ResourceManager, lods: []const LevelOfDetail) void {
+            for (lods) |lod| {
+                rm.allocator.free(lod.meshes);
+            }
+            rm.allocator.free(lods);
+        }
+
+        fn copyVertices(rm: *ResourceManager, comptime model: type, src_vertices: []align(1) const model.Vertex) ![]const (if (model == z3d.quantized_static_model) QuantizedVertex else Vertex) {
+            if (model == z3d.quantized_static_model) {
+                const dst_vertices = try rm.allocator.alloc(QuantizedVertex, src_vertices.len);
+                for (dst_vertices) |*vtx, i| {
+                    const src = src_vertices[i];
+                    vtx.* = QuantizedVertex{
+                        .x = std.mem.littleToNative(u16, src.x),
+                        .y = std.mem.littleToNative(u16, src.y),
+                        .z = std.mem.littleToNative(u16, src.z),
+                        .nx = std.mem.littleToNative(i16, src.nx),
+                        .ny = std.mem.littleToNative(i16, src.ny),
+                        .u = std.mem.littleToNative(u16, src.u),
+                        .v = std.mem.littleToNative(u16, src.v),
+                    };
+                }
+                return dst_vertices;
+            } else {
+                const dst_vertices = try rm.allocator.alloc(Vertex, src_vertices.len);
+                for (dst_vertices) |*vtx, i| {
+                    const src = src_vertices[i];
+                    vtx.* = Vertex{
+                        .x = littleToNativeFloat(src.x),
+                        .y = littleToNativeFloat(src.y),
+                        .z = littleToNativeFloat(src.z),
+                        .nx = littleToNativeFloat(src.nx),
+                        .ny = littleToNativeFloat(src.ny),
+                        .nz = littleToNativeFloat(src.nz),
+                        .u = littleToNativeFloat(src.u),
+                        .v = littleToNativeFloat(src.v),
+                    };
+                }
+                return dst_vertices;
+            }
+        }
+
+        fn copyIndices(rm: *ResourceManager, src_indices: []align(1) const u16) ![]const u16 {
+            const dst_indices = try rm.allocator.alloc(u16, src_indices.len);
+            for (dst_indices) |*idx, i| {
+                idx.* = std.mem.littleToNative(u16, src_indices[i]);
+            }
+            return dst_indices;
+        }
+
+        /// Rejects indices past the vertex list, so a damaged file can't make the bounds
+        /// computation or the GPU read outside of the vertices.
+        fn checkIndices(indices: []const u16, vertex_count: usize) !void {
+            for (indices) |index| {
+                if (index >= vertex_count)
+                    return error.InvalidFormat;
             }
         }
+
+        /// z3d files store floats with the byte order of a little endian `u32`.
+        fn littleToNativeFloat(value: f32) f32 {
+            return @bitCast(f32, std.mem.littleToNative(u32, @bitCast(u32, value)));
+        }
+
+        fn littleToNativeFloats(comptime n: usize, values: [n]f32) [n]f32 {
+            var result: [n]f32 = undefined;
+            for (result) |*v, i| {
+                v.* = littleToNativeFloat(values[i]);
+            }
+            return result;
+        }
+
+        fn littleToNativeMatrix(matrix: [4][4]f32) [4][4]f32 {
+            var result: [4][4]f32 = undefined;
+            for (result) |*row, i| {
+                row.* = littleToNativeFloats(4, matrix[i]);
+            }
+            return result;
+        }
+    };
+}
+
+test "z3d loading (copy vs. zero-copy)" {
+    const z3d = @import("z3d-format.zig");
+
+    const vertex_count = 16;
+    const index_count = 3 * 20;
+
+    const vertex_offset = @sizeOf(z3d.static_model.Header);
+    const index_offset = vertex_offset + @sizeOf(z3d.static_model.Vertex) * vertex_count;
+    const mesh_offset = index_offset + @sizeOf(z3d.static_model.Index) * index_count;
+    const file_size = mesh_offset + @sizeOf(z3d.static_model.Mesh);
+
+    const data = try std.testing.allocator.alignedAlloc(u8, 16, file_size);
+    defer std.testing.allocator.free(data);
+    std.mem.set(u8, data, 0);
+
+    @ptrCast(*align(1) z3d.static_model.Header, &data[0]).* = z3d.static_model.Header{
+        .common = z3d.CommonHeader{ .type = .static },
+        .vertex_count = std.mem.nativeToLittle(u32, vertex_count),
+        .index_count = std.mem.nativeToLittle(u32, index_count),
+        .mesh_count = std.mem.nativeToLittle(u32, 1),
+    };
+    for (std.mem.bytesAsSlice(z3d.static_model.Index, data[index_offset..mesh_offset])) |*index, i| {
+        index.* = std.mem.nativeToLittle(u16, @intCast(u16, i % vertex_count));
+    }
+    @ptrCast(*align(1) z3d.static_model.Mesh, &data[mesh_offset]).* = z3d.static_model.Mesh{
+        .offset = 0,
+        .length = std.mem.nativeToLittle(u32, index_count),
+        .texture_file = [1]u8{0} ** 120,
     };
+
+    var rm = ResourceManager.init(std.testing.allocator);
+    defer rm.deinit();
+
+    inline for ([_]bool{ false, true }) |borrow| {
+        const geometry = try rm.createGeometry(Z3DGeometry(null){
+            .data = data,
+            .borrow_data = borrow,
+        });
+        defer rm.destroyGeometry(geometry);
+
+        const expect_borrowed = borrow and builtin.cpu.arch.endian() == .Little;
+        try std.testing.expectEqual(expect_borrowed, geometry.borrowed);
+        try std.testing.expectEqual(expect_borrowed, @ptrToInt(geometry.indices.ptr) == @ptrToInt(&data[index_offset]));
+        try std.testing.expectEqual(@as(usize, vertex_count), geometry.vertices.len);
+        try std.testing.expectEqual(@as(usize, index_count), geometry.indices.len);
+        for (geometry.indices) |index, i| {
+            try std.testing.expectEqual(@intCast(u16, i % vertex_count), index);
+        }
+    }
+}
+
+fn nativeToLittleFloats(comptime n: usize, values: [n]f32) [n]f32 {
+    var result: [n]f32 = undefined;
+    for (result) |*v, i| {
+        v.* = @bitCast(f32, std.mem.nativeToLittle(u32, @bitCast(u32, values[i])));
+    }
+    return result;
+}
+
+test "z3d loading: quantization ranges of a v2 model" {
+    const z3d = @import("z3d-format.zig");
+    const model = z3d.quantized_static_model;
+
+    const vertex_count = 4;
+    const index_count = 6;
+
+    const vertex_offset = @sizeOf(model.Header);
+    const index_offset = vertex_offset + @sizeOf(model.Vertex) * vertex_count;
+    const mesh_offset = index_offset + @sizeOf(model.Index) * index_count;
+    const file_size = mesh_offset + @sizeOf(model.Mesh);
+
+    const data = try std.testing.allocator.alignedAlloc(u8, 16, file_size);
+    defer std.testing.allocator.free(data);
+    std.mem.set(u8, data, 0);
+
+    const position_min = [3]f32{ -1.5, 0.25, -1000.0 };
+    const position_max = [3]f32{ 2.5, 8.0, 1000.0 };
+    const uv_min = [2]f32{ -0.5, 0.0 };
+    const uv_max = [2]f32{ 3.0, 1.0 };
+
+    @ptrCast(*align(1) model.Header, &data[0]).* = model.Header{
+        .common = z3d.CommonHeader{ .version = std.mem.nativeToLittle(u16, model.version), .type = .static },
+        .vertex_count = std.mem.nativeToLittle(u32, vertex_count),
+        .index_count = std.mem.nativeToLittle(u32, index_count),
+        .mesh_count = std.mem.nativeToLittle(u32, 1),
+        .position_min = nativeToLittleFloats(3, position_min),
+        .position_max = nativeToLittleFloats(3, position_max),
+        .uv_min = nativeToLittleFloats(2, uv_min),
+        .uv_max = nativeToLittleFloats(2, uv_max),
+    };
+    for (std.mem.bytesAsSlice(model.Index, data[index_offset..mesh_offset])) |*index, i| {
+        index.* = std.mem.nativeToLittle(u16, @intCast(u16, i % vertex_count));
+    }
+    @ptrCast(*align(1) model.Mesh, &data[mesh_offset]).* = model.Mesh{
+        .offset = 0,
+        .length = std.mem.nativeToLittle(u32, index_count),
+        .texture_file = [1]u8{0} ** 120,
+    };
+
+    var rm = ResourceManager.init(std.testing.allocator);
+    defer rm.deinit();
+
+    inline for ([_]bool{ false, true }) |borrow| {
+        const geometry = try rm.createGeometry(Z3DGeometry(null){
+            .data = data,
+            .borrow_data = borrow,
+        });
+        defer rm.destroyGeometry(geometry);
+
+        const quantization = geometry.quantized.?.quantization;
+        try std.testing.expectEqual(position_min, quantization.position_min);
+        try std.testing.expectEqual(position_max, quantization.position_max);
+        try std.testing.expectEqual(uv_min, quantization.uv_min);
+        try std.testing.expectEqual(uv_max, quantization.uv_max);
+    }
+}
+
+test "z3d loading: vertices and bones of a dynamic model" {
+    const z3d = @import("z3d-format.zig");
+    const model = z3d.dynamic_model;
+
+    const vertex_count = 3;
+    const index_count = 3;
+
+    const vertex_offset = @sizeOf(model.Header);
+    const index_offset = vertex_offset + @sizeOf(model.Vertex) * vertex_count;
+    const mesh_offset = index_offset + @sizeOf(model.Index) * index_count;
+    const bone_offset = mesh_offset + @sizeOf(model.Mesh);
+    const file_size = bone_offset + @sizeOf(model.Bone);
+
+    const data = try std.testing.allocator.alignedAlloc(u8, 16, file_size);
+    defer std.testing.allocator.free(data);
+    std.mem.set(u8, data, 0);
+
+    @ptrCast(*align(1) model.Header, &data[0]).* = model.Header{
+        .common = z3d.CommonHeader{ .type = .dynamic },
+        .vertex_count = std.mem.nativeToLittle(u32, vertex_count),
+        .index_count = std.mem.nativeToLittle(u32, index_count),
+        .mesh_count = std.mem.nativeToLittle(u32, 1),
+        .bone_count = std.mem.nativeToLittle(u32, 1),
+    };
+    for (std.mem.bytesAsSlice(model.Vertex, data[vertex_offset..index_offset])) |*vertex, i| {
+        const f = @intToFloat(f32, i);
+        const position = nativeToLittleFloats(3, .{ f, f + 0.5, -f });
+        const uv = nativeToLittleFloats(2, .{ 0.25 * f, 1.0 - 0.25 * f });
+        vertex.* = model.Vertex{
+            .x = position[0],
+            .y = position[1],
+            .z = position[2],
+            .nx = 0,
+            .ny = 0,
+            .nz = 0,
+            .u = uv[0],
+            .v = uv[1],
+            .bone_indices = .{ 0, 0, 0, 0 },
+            .bone_weights = .{ 255, 0, 0, 0 },
+        };
+    }
+    for (std.mem.bytesAsSlice(model.Index, data[index_offset..mesh_offset])) |*index, i| {
+        index.* = std.mem.nativeToLittle(u16, @intCast(u16, i));
+    }
+    @ptrCast(*align(1) model.Mesh, &data[mesh_offset]).* = model.Mesh{
+        .offset = 0,
+        .length = std.mem.nativeToLittle(u32, index_count),
+        .texture_file = [1]u8{0} ** 120,
+    };
+
+    var matrix: [4][4]f32 = undefined;
+    for (matrix) |*column, i| {
+        column.* = nativeToLittleFloats(4, .{ 1.5 * @intToFloat(f32, i), 2.0, -3.25, 100.0 });
+    }
+    @ptrCast(*align(1) model.Bone, &data[bone_offset]).* = model.Bone{
+        .name = [1]u8{0} ** 60,
+        .parent = std.mem.nativeToLittle(u32, model.no_parent),
+        .inverse_bind_matrix = matrix,
+        .local_transform = matrix,
+    };
+
+    var rm = ResourceManager.init(std.testing.allocator);
+    defer rm.deinit();
+
+    const geometry = try rm.createGeometry(Z3DGeometry(null){ .data = data });
+    defer rm.destroyGeometry(geometry);
+
+    for (geometry.vertices) |vertex, i| {
+        const f = @intToFloat(f32, i);
+        try std.testing.expectEqual(f, vertex.x);
+        try std.testing.expectEqual(f + 0.5, vertex.y);
+        try std.testing.expectEqual(-f, vertex.z);
+        try std.testing.expectEqual(0.25 * f, vertex.u);
+        try std.testing.expectEqual(1.0 - 0.25 * f, vertex.v);
+    }
+
+    const bone = geometry.skin.?.bones[0];
+    try std.testing.expectEqual(@as(?usize, null), bone.parent);
+    for (bone.inverse_bind_matrix) |column, i| {
+        const expected = [4]f32{ 1.5 * @intToFloat(f32, i), 2.0, -3.25, 100.0 };
+        try std.testing.expectEqual(expected, column);
+        try std.testing.expectEqual(expected, bone.local_transform[i]);
+    }
+}
+
+test "z3d loading: indices past the vertex list are rejected" {
+    const z3d = @import("z3d-format.zig");
+
+    const vertex_count = 4;
+    const index_count = 6;
+
+    const vertex_offset = @sizeOf(z3d.static_model.Header);
+    const index_offset = vertex_offset + @sizeOf(z3d.static_model.Vertex) * vertex_count;
+    const mesh_offset = index_offset + @sizeOf(z3d.static_model.Index) * index_count;
+    const file_size = mesh_offset + @sizeOf(z3d.static_model.Mesh);
+
+    const data = try std.testing.allocator.alignedAlloc(u8, 16, file_size);
+    defer std.testing.allocator.free(data);
+    std.mem.set(u8, data, 0);
+
+    @ptrCast(*align(1) z3d.static_model.Header, &data[0]).* = z3d.static_model.Header{
+        .common = z3d.CommonHeader{ .type = .static },
+        .vertex_count = std.mem.nativeToLittle(u32, vertex_count),
+        .index_count = std.mem.nativeToLittle(u32, index_count),
+        .mesh_count = std.mem.nativeToLittle(u32, 1),
+    };
+    const indices = std.mem.bytesAsSlice(z3d.static_model.Index, data[index_offset..mesh_offset]);
+    for (indices) |*index, i| {
+        index.* = std.mem.nativeToLittle(u16, @intCast(u16, i % vertex_count));
+    }
+    indices[index_count - 1] = std.mem.nativeToLittle(u16, vertex_count);
+    @ptrCast(*align(1) z3d.static_model.Mesh, &data[mesh_offset]).* = z3d.static_model.Mesh{
+        .offset = 0,
+        .length = std.mem.nativeToLittle(u32, index_count),
+        .texture_file = [1]u8{0} ** 120,
+    };
+
+    var rm = ResourceManager.init(std.testing.allocator);
+    defer rm.deinit();
+
+    inline for ([_]bool{ false, true }) |borrow| {
+        try std.testing.expectError(error.InvalidFormat, rm.createGeometry(Z3DGeometry(null){
+            .data = data,
+            .borrow_data = borrow,
+        }));
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,530 @@
+//! Merges many small static geometries into a few shared geometries.
+//!
+//! Each added geometry is transformed into world space on the CPU and packed into a chunk.
+//! A chunk is a single `Geometry` with at most 65536 vertices, so it can still be drawn with
+//! 16 bit indices, and one mesh per texture. Drawing a batch with `Renderer3D` then costs one
+//! buffer bind per chunk and one draw per texture instead of one of each per item.
+//!
+//! Items can be moved or removed later. `build` only transforms items that changed and only
+//! recreates the chunks that contain them.
+//! Levels of detail of the source geometries are not used.
+const std = @import("std");
+const ResourceManager = @import("ResourceManager.zig");
+const Renderer3D = @import("Renderer3D.zig");
+const parallel = @import("parallel.zig");
+
+const Self = @This();
+
+const Geometry = ResourceManager.Geometry;
+const Texture = ResourceManager.Texture;
+const Vertex = ResourceManager.Vertex;
+const Mesh = ResourceManager.Mesh;
+const Mat4 = [4][4]f32;
+
+/// Maximum number of vertices in a chunk, limited by the 16 bit indices.
+pub const max_chunk_vertices = std.math.maxInt(u16) + 1;
+
+pub const AddError = error{ OutOfMemory, NotStatic, GeometryTooLarge };
+
+/// Identifies an item of the batch.
+pub const Handle = enum(u32) { _ };
+
+allocator: std.mem.Allocator,
+resources: *ResourceManager,
+
+/// All items of the batch, removed items are null.
+items: std.ArrayListUnmanaged(?Item) = .{},
+free_items: std.ArrayListUnmanaged(u32) = .{},
+
+chunks: std.ArrayListUnmanaged(Chunk) = .{},
+
+/// Number of threads used to transform the vertices of changed items.
+thread_count: usize = 4,
+
+const Item = struct {
+    geometry: *Geometry,
+    transform: Mat4,
+    chunk: u32,
+    /// index of the first vertex in the chunk
+    vertex_offset: u32 = 0,
+    /// The transform mirrors the geometry, so the triangle winding must be flipped.
+    mirrored: bool = false,
+    /// The vertices must be transformed again.
+    dirty: bool = true,
+};
+
+const Chunk = struct {
+    /// indices into `items`
+    items: std.ArrayListUnmanaged(u32) = .{},
+    /// sum of the vertex counts of all items
+    vertex_count: usize = 0,
+    /// world space vertices of all items, in the order of `items`
+    vertices: std.ArrayListUnmanaged(Vertex) = .{},
+    indices: std.ArrayListUnmanaged(u16) = .{},
+    meshes: std.ArrayListUnmanaged(Mesh) = .{},
+    geometry: ?*Geometry = null,
+    /// Items were added or removed, so the vertex offsets have to be computed again.
+    layout_changed: bool = true,
+    /// The geometry is out of date.
+    dirty: bool = true,
+
+    fn deinit(self: *Chunk, allocator: std.mem.Allocator) void {
+        self.items.deinit(allocator);
+        self.vertices.deinit(allocator);
+        self.indices.deinit(allocator);
+        self.meshes.deinit(allocator);
+        self.* = undefined;
+    }
+};
+
+pub fn init(resources: *ResourceManager, allocator: std.mem.Allocator) Self {
+    return Self{
+        .allocator = allocator,
+        .resources = resources,
+    };
+}
+
+pub fn deinit(self: *Self) void {
+    for (self.items.items) |maybe_item| {
+        if (maybe_item) |item| {
+            self.resources.destroyGeometry(item.geometry);
+        }
+    }
+    for (self.chunks.items) |*chunk| {
+        if (chunk.geometry) |geometry| {
+            self.resources.destroyGeometry(geometry);
+        }
+        chunk.deinit(self.allocator);
+    }
+    self.items.deinit(self.allocator);
+    self.free_items.deinit(self.allocator);
+    self.chunks.deinit(self.allocator);
+    self.* = undefined;
+}
+
+/// Adds `geometry` with the world `transform` to the batch. The geometry is kept alive until
+/// the item is removed. Takes effect with the next call to `build`.
+pub fn add(self: *Self, geometry: *Geometry, transform: Mat4) AddError!Handle {
+    if (geometry.skin != null)
+        return error.NotStatic;
+    const vertex_count = geometry.vertexCount();
+    if (vertex_count > max_chunk_vertices)
+        return error.GeometryTooLarge;
+
+    const chunk_index = try self.findChunk(vertex_count);
+    const chunk = &self.chunks.items[chunk_index];
+
+    try self.items.ensureUnusedCapacity(self.allocator, 1);
+    try chunk.items.ensureUnusedCapacity(self.allocator, 1);
+
+    const index = self.free_items.popOrNull() orelse blk: {
+        self.items.appendAssumeCapacity(null);
+        break :blk @intCast(u32, self.items.items.len - 1);
+    };
+    self.items.items[index] = Item{
+        .geometry = geometry,
+        .transform = transform,
+        .chunk = @intCast(u32, chunk_index),
+    };
+
+    chunk.items.appendAssumeCapacity(index);
+    chunk.vertex_count += vertex_count;
+    chunk.layout_changed = true;
+    chunk.dirty = true;
+
+    self.resources.retainGeometry(geometry);
+    return @intToEnum(Handle, index);
+}
+
+/// Moves the item to the world `transform`. Takes effect with the next call to `build`.
+pub fn update(self: *Self, handle: Handle, transform: Mat4) void {
+    const item = self.getItem(handle);
+    item.transform = transform;
+    item.dirty = true;
+    self.chunks.items[item.chunk].dirty = true;
+}
+
+/// Removes the item from the batch. Takes effect with the next call to `build`.
+pub fn remove(self: *Self, handle: Handle) void {
+    const index = @enumToInt(handle);
+    const item = self.getItem(handle).*;
+    const chunk = &self.chunks.items[item.chunk];
+
+    for (chunk.items.items) |chunk_item, i| {
+        if (chunk_item == index) {
+            _ = chunk.items.orderedRemove(i);
+            break;
+        }
+    } else unreachable;
+    chunk.vertex_count -= item.geometry.vertexCount();
+    chunk.layout_changed = true;
+    chunk.dirty = true;
+
+    self.resources.destroyGeometry(item.geometry);
+    self.items.items[index] = null;
+
+    // Failing to recycle the slot only wastes it.
+    self.free_items.append(self.allocator, index) catch {};
+}
+
+fn getItem(self: *Self, handle: Handle) *Item {
+    return &(self.items.items[@enumToInt(handle)].?);
+}
+
+/// Returns the first chunk with room for `vertex_count` more vertices.
+fn findChunk(self: *Self, vertex_count: usize) !usize {
+    for (self.chunks.items) |chunk, i| {
+        if (chunk.vertex_count + vertex_count <= max_chunk_vertices)
+            return i;
+    }
+    try self.chunks.append(self.allocator, Chunk{});
+    return self.chunks.items.len - 1;
+}
+
+/// Brings the geometries of all chunks up to date with the added, updated and removed items.
+pub fn build(self: *Self) !void {
+    for (self.chunks.items) |*chunk| {
+        if (chunk.dirty) {
+            try self.buildChunk(chunk);
+        }
+    }
+}
+
+/// Draws all chunks with `renderer`. `build` must have been called after the last change.
+pub fn draw(self: Self, renderer: *Renderer3D) Renderer3D.DrawError!void {
+    for (self.chunks.items) |chunk| {
+        if (chunk.geometry) |geometry| {
+            try renderer.drawGeometry(geometry, identity_matrix);
+        }
+    }
+}
+
+/// Returns the number of geometries `draw` submits.
+pub fn chunkCount(self: Self) usize {
+    var count: usize = 0;
+    for (self.chunks.items) |chunk| {
+        count += @boolToInt(chunk.geometry != null);
+    }
+    return count;
+}
+
+fn buildChunk(self: *Self, chunk: *Chunk) !void {
+    if (chunk.layout_changed) {
+        try chunk.vertices.resize(self.allocator, chunk.vertex_count);
+
+        var offset: u32 = 0;
+        for (chunk.items.items) |index| {
+            const item = &self.items.items[index].?;
+            if (item.vertex_offset != offset) {
+                item.vertex_offset = offset;
+                item.dirty = true;
+            }
+            offset += @intCast(u32, item.geometry.vertexCount());
+        }
+    }
+
+    try self.transformItems(chunk.*);
+    try self.buildIndices(chunk);
+
+    const geometry = if (chunk.meshes.items.len > 0)
+        try self.resources.createGeometry(ResourceManager.StaticGeometry{
+            .vertices = chunk.vertices.items,
+            .indices = chunk.indices.items,
+            .meshes = chunk.meshes.items,
+        })
+    else
+        null;
+
+    // A renderer may still hold the previous geometry for the current frame, it keeps its own reference.
+    if (chunk.geometry) |previous| {
+        self.resources.destroyGeometry(previous);
+    }
+    chunk.geometry = geometry;
+    chunk.layout_changed = false;
+    chunk.dirty = false;
+}
+
+const TransformJob = struct {
+    geometry: *const Geometry,
+    transform: Mat4,
+    dst: []Vertex,
+    /// position of the first vertex among the vertices of all jobs
+    first: usize,
+};
+
+/// Transforms the vertices of all dirty items of `chunk` into the chunk, spread over `thread_count` threads.
+fn transformItems(self: *Self, chunk: Chunk) !void {
+    var jobs = std.ArrayList(TransformJob).init(self.allocator);
+    defer jobs.deinit();
+
+    var total_vertices: usize = 0;
+    for (chunk.items.items) |index| {
+        const item = &self.items.items[index].?;
+        if (!item.dirty)
+            continue;
+        item.dirty = false;
+        item.mirrored = determinant3(item.transform) < 0;
+
+        const count = item.geometry.vertexCount();
+        try jobs.append(TransformJob{
+            .geometry = item.geometry,
+            .transform = item.transform,
+            .dst = chunk.vertices.items[item.vertex_offset..][0..count],
+            .first = total_vertices,
+        });
+        total_vertices += count;
+    }
+
+    // The vertices of all jobs are split evenly, so a large item may be shared by several threads.
+    parallel.forEachRange(total_vertices, self.thread_count, min_vertices_per_thread, @as([]const TransformJob, jobs.items), transformJobs);
+}
+
+const min_vertices_per_thread = 4096;
+
+/// Transforms the vertices `begin..end` of the concatenated `jobs`.
+fn transformJobs(jobs: []const TransformJob, begin: usize, end: usize) void {
+    for (jobs) |job| {
+        const job_end = job.first + job.dst.len;
+        if (job_end <= begin)
+            continue;
+        if (job.first >= end)
+            break;
+
+        const first = std.math.max(begin, job.first) - job.first;
+        const last = std.math.min(end, job_end) - job.first;
+        transformVertices(job.geometry.*, job.transform, first, job.dst[first..last]);
+    }
+}
+
+/// Transforms the vertices of `geometry` from `first_vertex` on into `dst`.
+fn transformVertices(geometry: Geometry, transform: Mat4, first_vertex: usize, dst: []Vertex) void {
+    const Vec4 = @Vector(4, f32);
+
+    const c0: Vec4 = transform[0];
+    const c1: Vec4 = transform[1];
+    const c2: Vec4 = transform[2];
+    const c3: Vec4 = transform[3];
+
+    // Normals are transformed with the inverse transpose, whose columns are the cross
+    // products of the matrix columns scaled by the determinant. The scale vanishes when
+    // normalizing, but its sign must be kept.
+    const sign: f32 = if (determinant3(transform) < 0) -1.0 else 1.0;
+    const n0 = @splat(4, sign) * cross(c1, c2);
+    const n1 = @splat(4, sign) * cross(c2, c0);
+    const n2 = @splat(4, sign) * cross(c0, c1);
+
+    for (dst) |*out, i| {
+        const vertex = geometry.getVertex(first_vertex + i);
+
+        const position = c0 * @splat(4, vertex.x) + c1 * @splat(4, vertex.y) + c2 * @splat(4, vertex.z) + c3;
+        const normal = n0 * @splat(4, vertex.nx) + n1 * @splat(4, vertex.ny) + n2 * @splat(4, vertex.nz);
+        const normal_length = @sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        const normal_scale = if (normal_length > 0) 1.0 / normal_length else 0.0;
+
+        out.* = Vertex{
+            .x = position[0],
+            .y = position[1],
+            .z = position[2],
+            .nx = normal[0] * normal_scale,
+            .ny = normal[1] * normal_scale,
+            .nz = normal[2] * normal_scale,
+            .u = vertex.u,
+            .v = vertex.v,
+        };
+    }
+}
+
+fn cross(a: @Vector(4, f32), b: @Vector(4, f32)) @Vector(4, f32) {
+    return .{
+        a[1] * b[2] - a[2] * b[1],
+        a[2] * b[0] - a[0] * b[2],
+        a[0] * b[1] - a[1] * b[0],
+        0,
+    };
+}
+
+fn determinant3(m: Mat4) f32 {
+    return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+        m[1][0] * (m[0][1] * m[2][2] - m[0][2] * m[2][1]) +
+        m[2][0] * (m[0][1] * m[1][2] - m[0][2] * m[1][1]);
+}
+
+/// Collects the indices of all items, grouped into one mesh per texture.
+fn buildIndices(self: *Self, chunk: *Chunk) !void {
+    chunk.indices.shrinkRetainingCapacity(0);
+    chunk.meshes.shrinkRetainingCapacity(0);
+
+    var textures = std.ArrayList(?*Texture).init(self.allocator);
+    defer textures.deinit();
+    for (chunk.items.items) |index| {
+        for (self.items.items[index].?.geometry.meshes) |mesh| {
+            if (std.mem.indexOfScalar(?*Texture, textures.items, mesh.texture) == null) {
+                try textures.append(mesh.texture);
+            }
+        }
+    }
+
+    for (textures.items) |texture| {
+        const offset = chunk.indices.items.len;
+        for (chunk.items.items) |index| {
+            const item = self.items.items[index].?;
+            const base = @intCast(u16, item.vertex_offset);
+            for (item.geometry.meshes) |mesh| {
+                if (mesh.texture != texture)
+                    continue;
+
+                const src = item.geometry.indices[mesh.offset..][0..mesh.count];
+                try chunk.indices.ensureUnusedCapacity(self.allocator, src.len);
+                var i: usize = 0;
+                while (i + 3 <= src.len) : (i += 3) {
+                    // mirrored items keep facing outwards by flipping the winding
+                    const second = if (item.mirrored) src[i + 2] else src[i + 1];
+                    const third = if (item.mirrored) src[i + 1] else src[i + 2];
+                    chunk.indices.appendAssumeCapacity(base + src[i]);
+                    chunk.indices.appendAssumeCapacity(base + second);
+                    chunk.indices.appendAssumeCapacity(base + third);
+                }
+            }
+        }
+        try chunk.meshes.append(self.allocator, Mesh{
+            .offset = offset,
+            .count = chunk.indices.items.len - offset,
+            .texture = texture,
+        });
+    }
+}
+
+const identity_matrix = Mat4{
+    .{ 1, 0, 0, 0 },
+    .{ 0, 1, 0, 0 },
+    .{ 0, 0, 1, 0 },
+    .{ 0, 0, 0, 1 },
+};
+
+fn translation(x: f32, y: f32, z: f32) Mat4 {
+    var m = identity_matrix;
+    m[3] = .{ x, y, z, 1 };
+    return m;
+}
+
+test "static batch: merging, winding and index offsets" {
+    var rm = ResourceManager.init(std.testing.allocator);
+    defer rm.deinit();
+
+    const white = try rm.createTexture(.@"3d", ResourceManager.FlatTexture{ .width = 1, .height = 1, .color = .{ .r = 255, .g = 255, .b = 255 } });
+    defer rm.destroyTexture(white);
+    const black = try rm.createTexture(.@"3d", ResourceManager.FlatTexture{ .width = 1, .height = 1, .color = .{ .r = 0, .g = 0, .b = 0 } });
+    defer rm.destroyTexture(black);
+
+    const triangle = try rm.createGeometry(ResourceManager.StaticGeometry{
+        .vertices = &[_]Vertex{
+            Vertex.init(.{ 0, 0, 0 }, .{ 0, 0, 1 }, .{ 0, 0 }),
+            Vertex.init(.{ 1, 0, 0 }, .{ 0, 0, 1 }, .{ 1, 0 }),
+            Vertex.init(.{ 0, 1, 0 }, .{ 0, 0, 1 }, .{ 0, 1 }),
+        },
+        .indices = &[_]u16{ 0, 1, 2 },
+        .meshes = &[_]Mesh{.{ .offset = 0, .count = 3, .texture = white }},
+    });
+    defer rm.destroyGeometry(triangle);
+
+    const quad = try rm.createGeometry(ResourceManager.StaticGeometry{
+        .vertices = &[_]Vertex{
+            Vertex.init(.{ 0, 0, 0 }, .{ 0, 0, 1 }, .{ 0, 0 }),
+            Vertex.init(.{ 1, 0, 0 }, .{ 0, 0, 1 }, .{ 1, 0 }),
+            Vertex.init(.{ 0, 1, 0 }, .{ 0, 0, 1 }, .{ 0, 1 }),
+            Vertex.init(.{ 1, 1, 0 }, .{ 0, 0, 1 }, .{ 1, 1 }),
+        },
+        .indices = &[_]u16{ 0, 1, 2, 2, 1, 3 },
+        .meshes = &[_]Mesh{
+            .{ .offset = 0, .count = 3, .texture = white },
+            .{ .offset = 3, .count = 3, .texture = black },
+        },
+    });
+    defer rm.destroyGeometry(quad);
+
+    var batch = init(&rm, std.testing.allocator);
+    defer batch.deinit();
+
+    _ = try batch.add(triangle, translation(10, 0, 0));
+    _ = try batch.add(quad, identity_matrix);
+    var mirror = identity_matrix;
+    mirror[0][0] = -1;
+    _ = try batch.add(triangle, mirror);
+
+    try batch.build();
+    try std.testing.expectEqual(@as(usize, 1), batch.chunkCount());
+
+    const geometry = batch.chunks.items[0].geometry.?;
+    try std.testing.expectEqual(@as(usize, 10), geometry.vertices.len);
+    try std.testing.expectEqual(@as(u32, 0), batch.items.items[0].?.vertex_offset);
+    try std.testing.expectEqual(@as(u32, 3), batch.items.items[1].?.vertex_offset);
+    try std.testing.expectEqual(@as(u32, 7), batch.items.items[2].?.vertex_offset);
+
+    // one mesh per texture, the mirrored triangle has its winding flipped
+    try std.testing.expectEqual(@as(usize, 2), geometry.meshes.len);
+    try std.testing.expectEqual(@as(?*Texture, white), geometry.meshes[0].texture);
+    try std.testing.expectEqual(@as(?*Texture, black), geometry.meshes[1].texture);
+    try std.testing.expectEqualSlices(u16, &[_]u16{ 0, 1, 2, 3, 4, 5, 7, 9, 8 }, geometry.indices[geometry.meshes[0].offset..][0..geometry.meshes[0].count]);
+    try std.testing.expectEqualSlices(u16, &[_]u16{ 5, 4, 6 }, geometry.indices[geometry.meshes[1].offset..][0..geometry.meshes[1].count]);
+
+    // vertices are in world space, mirroring along x keeps the normals along z
+    try std.testing.expectEqual(@as(f32, 11), geometry.vertices[1].x);
+    try std.testing.expectEqual(@as(f32, 1), geometry.vertices[6].y);
+    try std.testing.expectEqual(@as(f32, -1), geometry.vertices[8].x);
+    try std.testing.expectEqual(@as(f32, 1), geometry.vertices[7].nz);
+}
+
+test "static batch: transforms split over threads and rebuilt after changes" {
+    var rm = ResourceManager.init(std.testing.allocator);
+    defer rm.deinit();
+
+    // large enough that the ranges of the threads start and end inside items
+    const vertex_count = 3 * min_vertices_per_thread + 5;
+    const vertices = try std.testing.allocator.alloc(Vertex, vertex_count);
+    defer std.testing.allocator.free(vertices);
+    for (vertices) |*vertex, i| {
+        vertex.* = Vertex.init(.{ @intToFloat(f32, i), 0, 0 }, .{ 0, 1, 0 }, .{ 0, 0 });
+    }
+
+    const geometry = try rm.createGeometry(ResourceManager.StaticGeometry{
+        .vertices = vertices,
+        .indices = &[_]u16{ 0, 1, 2 },
+        .meshes = &[_]Mesh{.{ .offset = 0, .count = 3, .texture = null }},
+    });
+    defer rm.destroyGeometry(geometry);
+
+    var batch = init(&rm, std.testing.allocator);
+    defer batch.deinit();
+    batch.thread_count = 4;
+
+    const first = try batch.add(geometry, translation(0, 1, 0));
+    const second = try batch.add(geometry, translation(0, 2, 0));
+    const third = try batch.add(geometry, translation(0, 3, 0));
+    try batch.build();
+
+    const Check = struct {
+        fn items(b: Self, expected_y: []const f32) !void {
+            const chunk = b.chunks.items[0];
+            try std.testing.expectEqual(expected_y.len * vertex_count, chunk.geometry.?.vertices.len);
+            for (expected_y) |y, item| {
+                for (chunk.geometry.?.vertices[item * vertex_count ..][0..vertex_count]) |vertex, i| {
+                    try std.testing.expectEqual(@intToFloat(f32, i), vertex.x);
+                    try std.testing.expectEqual(y, vertex.y);
+                }
+            }
+        }
+    };
+
+    try Check.items(batch, &[_]f32{ 1, 2, 3 });
+
+    batch.update(second, translation(0, 5, 0));
+    try batch.build();
+    try Check.items(batch, &[_]f32{ 1, 5, 3 });
+
+    // removing the first item moves the others to the front of the chunk
+    batch.remove(first);
+    try batch.build();
+    try std.testing.expectEqual(@as(u32, 0), batch.getItem(second).vertex_offset);
+    try std.testing.expectEqual(@as(u32, vertex_count), batch.getItem(third).vertex_offset);
+    try Check.items(batch, &[_]f32{ 5, 3 });
+}
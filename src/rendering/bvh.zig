@@ -0,0 +1,640 @@
+//! Bounding volume hierarchy for ray casts and overlap queries.
+//!
+//! - `Bvh` is built over a list of axis aligned boxes with the surface area heuristic and can
+//!   be refit when the boxes move. Nodes are 32 bytes and both children of a node are stored
+//!   next to each other, so a traversal touches few cache lines.
+//! - `TriangleMesh` uses a `Bvh` over the triangles of a geometry for picking.
+//!
+//! Nothing here touches OpenGL, see `tools/bvh-bench.zig` for a headless benchmark.
+const std = @import("std");
+const Frustum = @import("frustum.zig").Frustum;
+
+pub const Aabb = struct {
+    min: [3]f32,
+    max: [3]f32,
+
+    pub const empty = Aabb{
+        .min = .{ std.math.inf(f32), std.math.inf(f32), std.math.inf(f32) },
+        .max = .{ -std.math.inf(f32), -std.math.inf(f32), -std.math.inf(f32) },
+    };
+
+    pub fn fromPoint(point: [3]f32) Aabb {
+        return Aabb{ .min = point, .max = point };
+    }
+
+    pub fn merge(a: Aabb, b: Aabb) Aabb {
+        var result: Aabb = undefined;
+        for (result.min) |*v, i| {
+            v.* = std.math.min(a.min[i], b.min[i]);
+            result.max[i] = std.math.max(a.max[i], b.max[i]);
+        }
+        return result;
+    }
+
+    pub fn grow(self: Aabb, point: [3]f32) Aabb {
+        return self.merge(fromPoint(point));
+    }
+
+    pub fn center(self: Aabb) [3]f32 {
+        return .{
+            0.5 * (self.min[0] + self.max[0]),
+            0.5 * (self.min[1] + self.max[1]),
+            0.5 * (self.min[2] + self.max[2]),
+        };
+    }
+
+    /// Returns half the surface area, which is all the surface area heuristic needs.
+    pub fn halfArea(self: Aabb) f32 {
+        const dx = self.max[0] - self.min[0];
+        const dy = self.max[1] - self.min[1];
+        const dz = self.max[2] - self.min[2];
+        if (dx < 0 or dy < 0 or dz < 0)
+            return 0;
+        return dx * dy + dy * dz + dz * dx;
+    }
+
+    pub fn overlapsBox(self: Aabb, min: [3]f32, max: [3]f32) bool {
+        for (self.min) |_, i| {
+            if (self.max[i] < min[i] or self.min[i] > max[i])
+                return false;
+        }
+        return true;
+    }
+};
+
+pub const Ray = struct {
+    origin: [3]f32,
+    /// doesn't need to be normalized, distances are measured in multiples of it
+    direction: [3]f32,
+
+    pub fn at(self: Ray, distance: f32) [3]f32 {
+        return .{
+            self.origin[0] + distance * self.direction[0],
+            self.origin[1] + distance * self.direction[1],
+            self.origin[2] + distance * self.direction[2],
+        };
+    }
+};
+
+pub const Hit = struct {
+    primitive: u32,
+    distance: f32,
+};
+
+pub const Bvh = struct {
+    /// Primitives per leaf at which the build stops splitting.
+    pub const min_leaf_size = 2;
+    /// Leaves never hold more primitives than this.
+    pub const max_leaf_size = 16;
+    /// Deepest possible path from the root to a leaf.
+    pub const max_depth = 64;
+    /// Traversal stacks hold at most one entry per level plus one.
+    const stack_size = max_depth + 2;
+
+    const bin_count = 12;
+    /// cost of visiting a node relative to testing a primitive
+    const traversal_cost = 1.0;
+
+    pub const Node = extern struct {
+        min: [3]f32,
+        /// Leaves: index of the first primitive in `primitives`.
+        /// Inner nodes: index of the left child, the right child follows it.
+        first: u32,
+        max: [3]f32,
+        /// Number of primitives of a leaf, 0 for inner nodes.
+        count: u32,
+
+        comptime {
+            if (@sizeOf(Node) != 32) @compileError("Node must have 32 byte!");
+        }
+
+        pub fn isLeaf(self: Node) bool {
+            return self.count > 0;
+        }
+
+        fn setBounds(self: *Node, box: Aabb) void {
+            self.min = box.min;
+            self.max = box.max;
+        }
+    };
+
+    allocator: std.mem.Allocator,
+    /// The root is the first node. Children are always stored after their parent.
+    nodes: std.ArrayListUnmanaged(Node),
+    /// Indices of the boxes the tree was built from, in leaf order.
+    primitives: []u32,
+
+    /// Builds a hierarchy over `boxes`. The primitives in queries are indices into `boxes`.
+    pub fn build(allocator: std.mem.Allocator, boxes: []const Aabb) !Bvh {
+        var nodes = std.ArrayListUnmanaged(Node){};
+        errdefer nodes.deinit(allocator);
+        try nodes.ensureTotalCapacity(allocator, std.math.max(1, 2 * boxes.len));
+
+        const primitives = try allocator.alloc(u32, boxes.len);
+        errdefer allocator.free(primitives);
+        for (primitives) |*p, i| {
+            p.* = @intCast(u32, i);
+        }
+
+        const centers = try allocator.alloc([3]f32, boxes.len);
+        defer allocator.free(centers);
+        for (centers) |*c, i| {
+            c.* = boxes[i].center();
+        }
+
+        const Range = struct {
+            node: u32,
+            first: u32,
+            count: u32,
+            depth: u32,
+        };
+        var stack: [stack_size]Range = undefined;
+        var stack_len: usize = 1;
+        stack[0] = .{ .node = 0, .first = 0, .count = @intCast(u32, boxes.len), .depth = 0 };
+        nodes.appendAssumeCapacity(undefined);
+
+        while (stack_len > 0) {
+            stack_len -= 1;
+            const range = stack[stack_len];
+            const items = primitives[range.first..][0..range.count];
+
+            var node_bounds = Aabb.empty;
+            for (items) |p| {
+                node_bounds = node_bounds.merge(boxes[p]);
+            }
+            const node = &nodes.items[range.node];
+            node.setBounds(node_bounds);
+
+            const split = if (range.count <= min_leaf_size)
+                null
+            else if (range.depth >= max_depth / 2)
+                // keep the depth bounded for degenerate input
+                range.count / 2
+            else
+                splitSah(items, boxes, centers, node_bounds);
+
+            if (split) |left_count| {
+                const left = @intCast(u32, nodes.items.len);
+                node.first = left;
+                node.count = 0;
+                nodes.appendAssumeCapacity(undefined);
+                nodes.appendAssumeCapacity(undefined);
+
+                stack[stack_len] = .{ .node = left, .first = range.first, .count = left_count, .depth = range.depth + 1 };
+                stack[stack_len + 1] = .{ .node = left + 1, .first = range.first + left_count, .count = range.count - left_count, .depth = range.depth + 1 };
+                stack_len += 2;
+            } else {
+                node.first = range.first;
+                node.count = range.count;
+            }
+        }
+
+        // an empty tree has a single empty leaf
+        if (boxes.len == 0) {
+            nodes.items[0].setBounds(Aabb.empty);
+        }
+
+        return Bvh{
+            .allocator = allocator,
+            .nodes = nodes,
+            .primitives = primitives,
+        };
+    }
+
+    /// Partitions `items` with the cheapest binned split and returns the size of the left half,
+    /// or null if a leaf is cheaper.
+    fn splitSah(items: []u32, boxes: []const Aabb, centers: []const [3]f32, node_bounds: Aabb) ?u32 {
+        var center_bounds = Aabb.empty;
+        for (items) |p| {
+            center_bounds = center_bounds.grow(centers[p]);
+        }
+
+        const Bin = struct {
+            bounds: Aabb = Aabb.empty,
+            count: u32 = 0,
+        };
+
+        var best_cost: f32 = std.math.inf(f32);
+        var best_axis: usize = 0;
+        var best_split: usize = 0;
+
+        for ([3]usize{ 0, 1, 2 }) |axis| {
+            const lo = center_bounds.min[axis];
+            const extent = center_bounds.max[axis] - lo;
+            if (extent <= 0)
+                continue;
+            const scale = bin_count / extent;
+
+            var bins = [_]Bin{.{}} ** bin_count;
+            for (items) |p| {
+                const b = binIndex(centers[p][axis], lo, scale);
+                bins[b].bounds = bins[b].bounds.merge(boxes[p]);
+                bins[b].count += 1;
+            }
+
+            // sweep from the right to get the area and count right of each split
+            var right_area: [bin_count - 1]f32 = undefined;
+            var right_count: [bin_count - 1]u32 = undefined;
+            var accumulated = Bin{};
+            var i: usize = bin_count - 1;
+            while (i > 0) : (i -= 1) {
+                accumulated.bounds = accumulated.bounds.merge(bins[i].bounds);
+                accumulated.count += bins[i].count;
+                right_area[i - 1] = accumulated.bounds.halfArea();
+                right_count[i - 1] = accumulated.count;
+            }
+
+            accumulated = Bin{};
+            for (bins[0 .. bin_count - 1]) |bin, split| {
+                accumulated.bounds = accumulated.bounds.merge(bin.bounds);
+                accumulated.count += bin.count;
+                if (accumulated.count == 0 or right_count[split] == 0)
+                    continue;
+                const cost = accumulated.bounds.halfArea() * @intToFloat(f32, accumulated.count) +
+                    right_area[split] * @intToFloat(f32, right_count[split]);
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = split;
+                }
+            }
+        }
+
+        const area = node_bounds.halfArea();
+        const leaf_cost = @intToFloat(f32, items.len);
+        if (best_cost == std.math.inf(f32)) {
+            // all centers are equal, so only the leaf size limit can force a split
+            return if (items.len > max_leaf_size) @intCast(u32, items.len / 2) else null;
+        }
+        if (area > 0 and traversal_cost + best_cost / area >= leaf_cost and items.len <= max_leaf_size)
+            return null;
+
+        // partition in place
+        const lo = center_bounds.min[best_axis];
+        const scale = bin_count / (center_bounds.max[best_axis] - lo);
+        var left: usize = 0;
+        var right: usize = items.len;
+        while (left < right) {
+            if (binIndex(centers[items[left]][best_axis], lo, scale) <= best_split) {
+                left += 1;
+            } else {
+                right -= 1;
+                std.mem.swap(u32, &items[left], &items[right]);
+            }
+        }
+        return @intCast(u32, left);
+    }
+
+    fn binIndex(value: f32, lo: f32, scale: f32) usize {
+        const b = @floatToInt(usize, std.math.max(0, (value - lo) * scale));
+        return std.math.min(b, bin_count - 1);
+    }
+
+    pub fn deinit(self: *Bvh) void {
+        self.nodes.deinit(self.allocator);
+        self.allocator.free(self.primitives);
+        self.* = undefined;
+    }
+
+    /// Updates the node bounds after the boxes moved. The structure of the tree is kept,
+    /// so queries get slower when the boxes moved far; build a new tree then.
+    /// `boxes` must have the same length as the list the tree was built from.
+    pub fn refit(self: *Bvh, boxes: []const Aabb) void {
+        std.debug.assert(boxes.len == self.primitives.len);
+        var i = self.nodes.items.len;
+        while (i > 0) {
+            i -= 1;
+            const node = &self.nodes.items[i];
+            var node_bounds = Aabb.empty;
+            if (node.isLeaf()) {
+                for (self.primitives[node.first..][0..node.count]) |p| {
+                    node_bounds = node_bounds.merge(boxes[p]);
+                }
+            } else {
+                for (self.nodes.items[node.first..][0..2]) |child| {
+                    node_bounds = node_bounds.merge(Aabb{ .min = child.min, .max = child.max });
+                }
+            }
+            node.setBounds(node_bounds);
+        }
+    }
+
+    pub fn totalBounds(self: Bvh) Aabb {
+        const root = self.nodes.items[0];
+        return Aabb{ .min = root.min, .max = root.max };
+    }
+
+    /// Returns the primitives whose box overlaps `volume`. `volume` must have a
+    /// `fn overlapsBox(self, min: [3]f32, max: [3]f32) bool`, like `Aabb` and `Frustum`.
+    pub fn overlapping(self: *const Bvh, volume: anytype) OverlapIterator(@TypeOf(volume)) {
+        var it = OverlapIterator(@TypeOf(volume)){
+            .bvh = self,
+            .volume = volume,
+        };
+        if (self.primitives.len > 0) {
+            it.stack[0] = 0;
+            it.stack_len = 1;
+        }
+        return it;
+    }
+
+    pub fn OverlapIterator(comptime Volume: type) type {
+        return struct {
+            const Iterator = @This();
+
+            bvh: *const Bvh,
+            volume: Volume,
+            stack: [stack_size]u32 = undefined,
+            stack_len: usize = 0,
+            /// remaining primitives of the current leaf
+            leaf: []const u32 = &[0]u32{},
+
+            pub fn next(it: *Iterator) ?u32 {
+                while (true) {
+                    if (it.leaf.len > 0) {
+                        const p = it.leaf[0];
+                        it.leaf = it.leaf[1..];
+                        return p;
+                    }
+                    if (it.stack_len == 0)
+                        return null;
+
+                    it.stack_len -= 1;
+                    const node = it.bvh.nodes.items[it.stack[it.stack_len]];
+                    if (!it.volume.overlapsBox(node.min, node.max))
+                        continue;
+                    if (node.isLeaf()) {
+                        it.leaf = it.bvh.primitives[node.first..][0..node.count];
+                    } else {
+                        it.stack[it.stack_len] = node.first + 1;
+                        it.stack[it.stack_len + 1] = node.first;
+                        it.stack_len += 2;
+                    }
+                }
+            }
+        };
+    }
+
+    /// Returns the primitive hit first by `ray` within `max_distance`. `context` must have a
+    /// `fn intersect(self, primitive: u32, ray: Ray, max_distance: f32) ?f32` that returns
+    /// the distance to the primitive, if it is hit closer than `max_distance`.
+    pub fn raycast(self: Bvh, ray: Ray, max_distance: f32, context: anytype) ?Hit {
+        if (self.primitives.len == 0)
+            return null;
+
+        var inverse_direction: [3]f32 = undefined;
+        for (inverse_direction) |*v, i| {
+            v.* = 1.0 / ray.direction[i];
+        }
+
+        var closest: ?Hit = null;
+        var limit = max_distance;
+
+        var stack: [stack_size]u32 = undefined;
+        var stack_len: usize = 1;
+        stack[0] = 0;
+        while (stack_len > 0) {
+            stack_len -= 1;
+            const node = self.nodes.items[stack[stack_len]];
+            if (node.isLeaf()) {
+                for (self.primitives[node.first..][0..node.count]) |p| {
+                    if (context.intersect(p, ray, limit)) |distance| {
+                        limit = distance;
+                        closest = Hit{ .primitive = p, .distance = distance };
+                    }
+                }
+                continue;
+            }
+
+            // visit the nearer child first, so the farther one is likely skipped
+            const left = self.nodes.items[node.first];
+            const right = self.nodes.items[node.first + 1];
+            const left_distance = intersectBox(left, ray.origin, inverse_direction, limit);
+            const right_distance = intersectBox(right, ray.origin, inverse_direction, limit);
+            if (left_distance != null and right_distance != null) {
+                const left_first = left_distance.? <= right_distance.?;
+                stack[stack_len] = if (left_first) node.first + 1 else node.first;
+                stack[stack_len + 1] = if (left_first) node.first else node.first + 1;
+                stack_len += 2;
+            } else if (left_distance != null) {
+                stack[stack_len] = node.first;
+                stack_len += 1;
+            } else if (right_distance != null) {
+                stack[stack_len] = node.first + 1;
+                stack_len += 1;
+            }
+        }
+        return closest;
+    }
+
+    /// Returns the distance at which the ray enters the box of `node`, or null if it misses it.
+    fn intersectBox(node: Node, origin: [3]f32, inverse_direction: [3]f32, max_distance: f32) ?f32 {
+        var near: f32 = 0;
+        var far = max_distance;
+        for (origin) |o, i| {
+            const t1 = (node.min[i] - o) * inverse_direction[i];
+            const t2 = (node.max[i] - o) * inverse_direction[i];
+            near = std.math.max(near, std.math.min(t1, t2));
+            far = std.math.min(far, std.math.max(t1, t2));
+        }
+        return if (near <= far) near else null;
+    }
+};
+
+/// Ray picking against the triangles of a geometry.
+pub const TriangleMesh = struct {
+    allocator: std.mem.Allocator,
+    bvh: Bvh,
+    positions: []const [3]f32,
+    /// triangle list
+    indices: []const u16,
+
+    pub const TriangleHit = struct {
+        /// index of the triangle, its first index is at `3 * triangle`
+        triangle: u32,
+        distance: f32,
+        /// barycentric coordinates of the hit point relative to the second and third vertex
+        u: f32,
+        v: f32,
+    };
+
+    /// Copies `positions` and `indices` and builds the hierarchy over the triangles.
+    pub fn init(allocator: std.mem.Allocator, positions: []const [3]f32, indices: []const u16) !TriangleMesh {
+        const own_positions = try allocator.dupe([3]f32, positions);
+        errdefer allocator.free(own_positions);
+        const own_indices = try allocator.dupe(u16, indices);
+        errdefer allocator.free(own_indices);
+        return try initOwned(allocator, own_positions, own_indices);
+    }
+
+    /// Builds the picking structure for a `ResourceManager.Geometry` or `ResourceManager.GeometryData`.
+    /// Quantized vertices are decoded.
+    pub fn fromGeometry(allocator: std.mem.Allocator, geometry: anytype) !TriangleMesh {
+        const count = if (geometry.quantized) |quantized| quantized.vertices.len else geometry.vertices.len;
+        const positions = try allocator.alloc([3]f32, count);
+        errdefer allocator.free(positions);
+        for (positions) |*position, i| {
+            const vertex = if (geometry.quantized) |quantized|
+                quantized.quantization.dequantize(quantized.vertices[i])
+            else
+                geometry.vertices[i];
+            position.* = .{ vertex.x, vertex.y, vertex.z };
+        }
+
+        const indices = try allocator.dupe(u16, geometry.indices);
+        errdefer allocator.free(indices);
+
+        return try initOwned(allocator, positions, indices);
+    }
+
+    fn initOwned(allocator: std.mem.Allocator, positions: []const [3]f32, indices: []const u16) !TriangleMesh {
+        const boxes = try allocator.alloc(Aabb, indices.len / 3);
+        defer allocator.free(boxes);
+        for (boxes) |*box, i| {
+            box.* = Aabb.fromPoint(positions[indices[3 * i + 0]])
+                .grow(positions[indices[3 * i + 1]])
+                .grow(positions[indices[3 * i + 2]]);
+        }
+
+        return TriangleMesh{
+            .allocator = allocator,
+            .bvh = try Bvh.build(allocator, boxes),
+            .positions = positions,
+            .indices = indices,
+        };
+    }
+
+    pub fn deinit(self: *TriangleMesh) void {
+        self.bvh.deinit();
+        self.allocator.free(self.positions);
+        self.allocator.free(self.indices);
+        self.* = undefined;
+    }
+
+    /// Returns the closest triangle hit by `ray` within `max_distance`. Both sides of a triangle can be hit.
+    pub fn raycast(self: TriangleMesh, ray: Ray, max_distance: f32) ?TriangleHit {
+        const hit = self.bvh.raycast(ray, max_distance, self) orelse return null;
+        const result = self.intersectTriangle(hit.primitive, ray).?;
+        return TriangleHit{
+            .triangle = hit.primitive,
+            .distance = hit.distance,
+            .u = result.u,
+            .v = result.v,
+        };
+    }
+
+    pub fn intersect(self: TriangleMesh, triangle: u32, ray: Ray, max_distance: f32) ?f32 {
+        const result = self.intersectTriangle(triangle, ray) orelse return null;
+        return if (result.distance < max_distance) result.distance else null;
+    }
+
+    const Intersection = struct {
+        distance: f32,
+        u: f32,
+        v: f32,
+    };
+
+    /// Möller–Trumbore ray triangle intersection.
+    fn intersectTriangle(self: TriangleMesh, triangle: u32, ray: Ray) ?Intersection {
+        const p0 = self.positions[self.indices[3 * triangle + 0]];
+        const p1 = self.positions[self.indices[3 * triangle + 1]];
+        const p2 = self.positions[self.indices[3 * triangle + 2]];
+
+        const e1 = sub(p1, p0);
+        const e2 = sub(p2, p0);
+        const p = cross(ray.direction, e2);
+        const det = dot(e1, p);
+        if (@fabs(det) < 1e-12)
+            return null;
+        const inv_det = 1.0 / det;
+
+        const t = sub(ray.origin, p0);
+        const u = dot(t, p) * inv_det;
+        if (u < 0 or u > 1)
+            return null;
+
+        const q = cross(t, e1);
+        const v = dot(ray.direction, q) * inv_det;
+        if (v < 0 or u + v > 1)
+            return null;
+
+        const distance = dot(e2, q) * inv_det;
+        if (distance < 0)
+            return null;
+        return Intersection{ .distance = distance, .u = u, .v = v };
+    }
+};
+
+fn sub(a: [3]f32, b: [3]f32) [3]f32 {
+    return .{ a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+}
+
+fn dot(a: [3]f32, b: [3]f32) f32 {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+fn cross(a: [3]f32, b: [3]f32) [3]f32 {
+    return .{
+        a[1] * b[2] - a[2] * b[1],
+        a[2] * b[0] - a[0] * b[2],
+        a[0] * b[1] - a[1] * b[0],
+    };
+}
+
+test "bvh queries match brute force" {
+    var prng = std.rand.DefaultPrng.init(1234);
+    const random = prng.random();
+
+    var boxes: [500]Aabb = undefined;
+    for (boxes) |*box| {
+        const x = random.float(f32) * 100;
+        const y = random.float(f32) * 100;
+        const z = random.float(f32) * 100;
+        box.* = Aabb{ .min = .{ x, y, z }, .max = .{ x + random.float(f32) * 5, y + random.float(f32) * 5, z + random.float(f32) * 5 } };
+    }
+
+    var tree = try Bvh.build(std.testing.allocator, &boxes);
+    defer tree.deinit();
+
+    const query = Aabb{ .min = .{ 20, 20, 20 }, .max = .{ 40, 60, 30 } };
+    var found = [_]bool{false} ** boxes.len;
+    var it = tree.overlapping(query);
+    while (it.next()) |p| {
+        try std.testing.expect(!found[p]);
+        found[p] = true;
+    }
+    for (boxes) |box, i| {
+        try std.testing.expectEqual(query.overlapsBox(box.min, box.max), found[i]);
+    }
+
+    // moving all boxes keeps the queries correct
+    for (boxes) |*box| {
+        box.min[0] += 50;
+        box.max[0] += 50;
+    }
+    tree.refit(&boxes);
+    std.mem.set(bool, &found, false);
+    it = tree.overlapping(query);
+    while (it.next()) |p| {
+        found[p] = true;
+    }
+    for (boxes) |box, i| {
+        try std.testing.expectEqual(query.overlapsBox(box.min, box.max), found[i]);
+    }
+}
+
+test "triangle mesh picking" {
+    // two quads at z = 0 and z = 1
+    var mesh = try TriangleMesh.init(std.testing.allocator, &[_][3]f32{
+        .{ -1, -1, 0 }, .{ 1, -1, 0 }, .{ 1, 1, 0 }, .{ -1, 1, 0 },
+        .{ -1, -1, 1 }, .{ 1, -1, 1 }, .{ 1, 1, 1 }, .{ -1, 1, 1 },
+    }, &[_]u16{ 0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7 });
+    defer mesh.deinit();
+
+    const hit = mesh.raycast(.{ .origin = .{ 0.5, 0.25, 5 }, .direction = .{ 0, 0, -1 } }, std.math.inf(f32)).?;
+    try std.testing.expect(hit.triangle >= 2);
+    try std.testing.expectApproxEqAbs(@as(f32, 4), hit.distance, 1e-5);
+
+    try std.testing.expect(mesh.raycast(.{ .origin = .{ 0.5, 0.25, 5 }, .direction = .{ 0, 0, -1 } }, 3.5) == null);
+    try std.testing.expect(mesh.raycast(.{ .origin = .{ 2, 0, 5 }, .direction = .{ 0, 0, -1 } }, std.math.inf(f32)) == null);
+}
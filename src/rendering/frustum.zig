@@ -0,0 +1,144 @@
+const std = @import("std");
+
+const Mat4 = [4][4]f32;
+
+/// The six clipping planes of a view projection matrix.
+pub const Frustum = struct {
+    /// Number of spheres tested at once by `cullSpheres`.
+    pub const lanes = 8;
+    const Vec = @Vector(lanes, f32);
+
+    /// How much of a bounding volume lies in the frustum.
+    pub const Containment = enum(u8) {
+        outside,
+        /// Partially inside, so the parts of the volume must be tested on their own.
+        intersecting,
+        inside,
+    };
+
+    /// left, right, bottom, top, near, far. `xyz` is the normalized inward facing
+    /// plane normal and `w` the distance to the origin.
+    planes: [6][4]f32,
+
+    /// Extracts the planes from the column major `view_projection` matrix.
+    pub fn fromMatrix(view_projection: Mat4) Frustum {
+        const m = view_projection;
+        var rows: [4][4]f32 = undefined;
+        for (rows) |*row, r| {
+            row.* = .{ m[0][r], m[1][r], m[2][r], m[3][r] };
+        }
+
+        var frustum: Frustum = undefined;
+        for (frustum.planes) |*plane, i| {
+            const axis = rows[i / 2];
+            const sign: f32 = if (i % 2 == 0) 1.0 else -1.0;
+            for (plane) |*v, j| {
+                v.* = rows[3][j] + sign * axis[j];
+            }
+            const len = @sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            if (len > 0) {
+                for (plane) |*v| {
+                    v.* /= len;
+                }
+            }
+        }
+        return frustum;
+    }
+
+    /// Returns true if the sphere is at least partially inside the frustum.
+    pub fn containsSphere(self: Frustum, center: [3]f32, radius: f32) bool {
+        return self.classifySphere(center, radius) != .outside;
+    }
+
+    /// Returns whether the sphere is outside, partially inside or completely inside the frustum.
+    pub fn classifySphere(self: Frustum, center: [3]f32, radius: f32) Containment {
+        var result = Containment.inside;
+        for (self.planes) |plane| {
+            const distance = plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3];
+            if (distance < -radius)
+                return .outside;
+            if (distance < radius)
+                result = .intersecting;
+        }
+        return result;
+    }
+
+    /// Returns true if the axis aligned box from `min` to `max` is at least partially inside the frustum.
+    /// Boxes close to a frustum corner may be reported as inside although they are not.
+    pub fn overlapsBox(self: Frustum, min: [3]f32, max: [3]f32) bool {
+        for (self.planes) |plane| {
+            // the corner furthest along the plane normal
+            var distance = plane[3];
+            for ([3]usize{ 0, 1, 2 }) |axis| {
+                distance += plane[axis] * if (plane[axis] >= 0) max[axis] else min[axis];
+            }
+            if (distance < 0)
+                return false;
+        }
+        return true;
+    }
+
+    /// Tests a list of spheres given as structure of arrays and stores how much of each
+    /// sphere is inside the frustum into `containment`, like `classifySphere`.
+    /// All slices must have the same length.
+    pub fn cullSpheres(self: Frustum, x: []const f32, y: []const f32, z: []const f32, radius: []const f32, containment: []Containment) void {
+        std.debug.assert(x.len == containment.len);
+        std.debug.assert(y.len == containment.len);
+        std.debug.assert(z.len == containment.len);
+        std.debug.assert(radius.len == containment.len);
+
+        const zero = @splat(lanes, @as(u8, 0));
+        const one = @splat(lanes, @as(u8, 1));
+
+        var i: usize = 0;
+        while (i + lanes <= containment.len) : (i += lanes) {
+            const cx: Vec = x[i..][0..lanes].*;
+            const cy: Vec = y[i..][0..lanes].*;
+            const cz: Vec = z[i..][0..lanes].*;
+            const r: Vec = radius[i..][0..lanes].*;
+
+            // the smallest signed distance of the sphere center to any plane
+            var distance = @splat(lanes, std.math.inf(f32));
+            for (self.planes) |plane| {
+                const d = cx * @splat(lanes, plane[0]) + cy * @splat(lanes, plane[1]) + cz * @splat(lanes, plane[2]) + @splat(lanes, plane[3]);
+                distance = @select(f32, d < distance, d, distance);
+            }
+
+            // counts the tests passed, in the order of `Containment`
+            const touches = @select(u8, distance >= -r, one, zero);
+            const encloses = @select(u8, distance >= r, one, zero);
+            const result: [lanes]u8 = touches + encloses;
+            for (result) |value, lane| {
+                containment[i + lane] = @intToEnum(Containment, value);
+            }
+        }
+        while (i < containment.len) : (i += 1) {
+            containment[i] = self.classifySphere(.{ x[i], y[i], z[i] }, radius[i]);
+        }
+    }
+};
+
+test "frustum sphere culling" {
+    // an orthographic projection of the cube from -1 to 1
+    const frustum = Frustum.fromMatrix(.{
+        .{ 1, 0, 0, 0 },
+        .{ 0, 1, 0, 0 },
+        .{ 0, 0, 1, 0 },
+        .{ 0, 0, 0, 1 },
+    });
+
+    const x = [_]f32{ 0, 3, 1.5, 0, 0, -2.5, 0, 0, 0, 3 };
+    const y = [_]f32{ 0, 0, 0, 2.5, -1.2, 0, 0, 0, 0, 0 };
+    const z = [_]f32{ 0, 0, 0, 0, 0, 0, 4, -1.9, 0, 0 };
+    const r = [_]f32{ 0.1, 1, 1, 1, 0.5, 1, 1, 1, 100, 1 };
+    const expected = [_]Frustum.Containment{ .inside, .outside, .intersecting, .outside, .intersecting, .outside, .outside, .intersecting, .intersecting, .outside };
+
+    var containment: [x.len]Frustum.Containment = undefined;
+    frustum.cullSpheres(&x, &y, &z, &r, &containment);
+
+    for (expected) |e, i| {
+        try std.testing.expectEqual(e, containment[i]);
+        try std.testing.expectEqual(e, frustum.classifySphere(.{ x[i], y[i], z[i] }, r[i]));
+        try std.testing.expectEqual(e != .outside, frustum.containsSphere(.{ x[i], y[i], z[i] }, r[i]));
+    }
+}
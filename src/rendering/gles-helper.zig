@@ -57,6 +57,96 @@ pub fn enableDebugOutput() !void {
     zero_graphics.gles.enable(debug.DEBUG_OUTPUT_KHR);
 }
 
+/// The API used for instanced drawing. GLES 3.0 and WebGL 2 have it in core, GLES 2.0
+/// contexts dispatch to either `ANGLE_instanced_arrays` or `EXT_instanced_arrays`.
+pub const InstancedArrays = enum {
+    none,
+    core,
+    angle,
+    ext,
+
+    /// Detects and loads the best available instancing API.
+    pub fn load() InstancedArrays {
+        if (hasCoreInstancing()) {
+            if (core_instancing.load()) {
+                return .core;
+            }
+        }
+        const exts = queryExtensions(&[_][]const u8{ "ANGLE_instanced_arrays", "EXT_instanced_arrays" });
+        if (exts.ANGLE_instanced_arrays) {
+            if (gles.GL_ANGLE_instanced_arrays.load({}, zero_graphics.loadOpenGlFunction)) |_| {
+                return .angle;
+            } else |_| {}
+        }
+        if (exts.EXT_instanced_arrays) {
+            if (gles.GL_EXT_instanced_arrays.load({}, zero_graphics.loadOpenGlFunction)) |_| {
+                return .ext;
+            } else |_| {}
+        }
+        return .none;
+    }
+
+    pub fn vertexAttribDivisor(self: InstancedArrays, index: gles.GLuint, divisor: gles.GLuint) void {
+        switch (self) {
+            .none => unreachable,
+            .core => core_instancing.vertexAttribDivisor.?(index, divisor),
+            .angle => gles.GL_ANGLE_instanced_arrays.vertexAttribDivisorANGLE(index, divisor),
+            .ext => gles.GL_EXT_instanced_arrays.vertexAttribDivisorEXT(index, divisor),
+        }
+    }
+
+    pub fn drawElementsInstanced(self: InstancedArrays, mode: gles.GLenum, count: gles.GLsizei, index_type: gles.GLenum, indices: ?*const anyopaque, instance_count: gles.GLsizei) void {
+        switch (self) {
+            .none => unreachable,
+            .core => core_instancing.drawElementsInstanced.?(mode, count, index_type, indices, instance_count),
+            .angle => gles.GL_ANGLE_instanced_arrays.drawElementsInstancedANGLE(mode, count, index_type, indices, instance_count),
+            .ext => gles.GL_EXT_instanced_arrays.drawElementsInstancedEXT(mode, count, index_type, indices, instance_count),
+        }
+    }
+};
+
+/// Returns true if the context has instancing without an extension. The web frontend always
+/// creates a WebGL 2 context, native contexts report "OpenGL ES 3.x" or later in their version.
+fn hasCoreInstancing() bool {
+    if (builtin.cpu.arch == .wasm32)
+        return true;
+    const version = std.mem.span(gles.getString(gles.VERSION)) orelse return false;
+    const prefix = "OpenGL ES ";
+    return std.mem.startsWith(u8, version, prefix) and
+        version.len > prefix.len and
+        version[prefix.len] >= '3' and version[prefix.len] <= '9';
+}
+
+fn FnPtr(comptime Fn: type) type {
+    return if (builtin.zig_backend != .stage1)
+        *const Fn
+    else
+        Fn;
+}
+
+/// The GLES 3.0 instancing entry points. The generated bindings only cover GLES 2.0, so these
+/// are loaded here.
+const core_instancing = struct {
+    var vertexAttribDivisor: ?FnPtr(fn (_index: gles.GLuint, _divisor: gles.GLuint) callconv(.C) void) = null;
+    var drawElementsInstanced: ?FnPtr(fn (_mode: gles.GLenum, _count: gles.GLsizei, _type: gles.GLenum, _indices: ?*const anyopaque, _instancecount: gles.GLsizei) callconv(.C) void) = null;
+
+    fn load() bool {
+        if (zero_graphics.loadOpenGlFunction({}, "glVertexAttribDivisor")) |proc| {
+            vertexAttribDivisor = @ptrCast(@TypeOf(vertexAttribDivisor), proc);
+        } else {
+            logger.err("entry point glVertexAttribDivisor not found!", .{});
+            return false;
+        }
+        if (zero_graphics.loadOpenGlFunction({}, "glDrawElementsInstanced")) |proc| {
+            drawElementsInstanced = @ptrCast(@TypeOf(drawElementsInstanced), proc);
+        } else {
+            logger.err("entry point glDrawElementsInstanced not found!", .{});
+            return false;
+        }
+        return true;
+    }
+};
+
 fn glesDebugProc(
     source: zero_graphics.gles.GLenum,
     msg_type: zero_graphics.gles.GLenum,
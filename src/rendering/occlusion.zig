@@ -0,0 +1,359 @@
+//! Software occlusion culling.
+//!
+//! Occluders are low-poly proxies of large geometries. They are rasterized into a small
+//! depth buffer on the CPU, which is then reduced into a hierarchical-Z pyramid that stores
+//! the farthest depth of each region. A bounding box is hidden if its nearest point is
+//! behind the farthest occluder depth in the screen region it covers.
+//!
+//! Nothing here touches OpenGL, so it can be tested with `zig test` without a window.
+const std = @import("std");
+const parallel = @import("parallel.zig");
+
+const Mat4 = [4][4]f32;
+
+/// A low-poly mesh that is fully contained in the geometry it stands in for.
+pub const Proxy = struct {
+    positions: []const [3]f32,
+    /// triangle list
+    indices: []const u16,
+};
+
+/// A proxy placed in the world.
+pub const Occluder = struct {
+    proxy: Proxy,
+    transform: Mat4,
+};
+
+pub const DepthBuffer = struct {
+    /// Number of pixels rasterized at once.
+    pub const lanes = 8;
+    const Vec = @Vector(lanes, f32);
+
+    /// Vertices closer to the camera than this are not rasterized.
+    const near_w = 1e-4;
+
+    allocator: std.mem.Allocator,
+    width: usize,
+    height: usize,
+
+    /// Level 0 is the depth buffer itself, each following level stores the maximum
+    /// of 2×2 texels of the previous one.
+    levels: []Level,
+
+    /// Screen space triangles of the current occluders.
+    triangles: std.ArrayListUnmanaged(Triangle) = .{},
+
+    /// Number of threads used by `rasterize`.
+    thread_count: usize = 4,
+
+    pub const Level = struct {
+        width: usize,
+        height: usize,
+        /// depth from 0 (near) to 1 (far), row major from the top left
+        depth: []f32,
+
+        fn get(self: Level, x: usize, y: usize) f32 {
+            return self.depth[y * self.width + x];
+        }
+    };
+
+    const Triangle = struct {
+        x: [3]f32,
+        y: [3]f32,
+        z: [3]f32,
+    };
+
+    /// `width` must be a multiple of `lanes`.
+    pub fn init(allocator: std.mem.Allocator, width: usize, height: usize) !DepthBuffer {
+        std.debug.assert(width > 0 and width % lanes == 0);
+        std.debug.assert(height > 0);
+
+        var level_count: usize = 1;
+        {
+            var w = width;
+            var h = height;
+            while (w > 1 or h > 1) : (level_count += 1) {
+                w = (w + 1) / 2;
+                h = (h + 1) / 2;
+            }
+        }
+
+        const levels = try allocator.alloc(Level, level_count);
+        errdefer allocator.free(levels);
+
+        var allocated: usize = 0;
+        errdefer for (levels[0..allocated]) |level| {
+            allocator.free(level.depth);
+        };
+
+        var w = width;
+        var h = height;
+        for (levels) |*level| {
+            level.* = Level{
+                .width = w,
+                .height = h,
+                .depth = try allocator.alloc(f32, w * h),
+            };
+            allocated += 1;
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+        }
+
+        var buffer = DepthBuffer{
+            .allocator = allocator,
+            .width = width,
+            .height = height,
+            .levels = levels,
+        };
+        buffer.clear();
+        return buffer;
+    }
+
+    pub fn deinit(self: *DepthBuffer) void {
+        for (self.levels) |level| {
+            self.allocator.free(level.depth);
+        }
+        self.allocator.free(self.levels);
+        self.triangles.deinit(self.allocator);
+        self.* = undefined;
+    }
+
+    /// Resets the buffer to the far plane, so nothing is occluded.
+    pub fn clear(self: *DepthBuffer) void {
+        for (self.levels) |level| {
+            std.mem.set(f32, level.depth, 1.0);
+        }
+        self.triangles.shrinkRetainingCapacity(0);
+    }
+
+    /// Projects the triangles of `occluder` to the screen. Triangles crossing the near plane are
+    /// skipped, which only makes the culling less effective.
+    pub fn addOccluder(self: *DepthBuffer, occluder: Occluder, view_projection: Mat4) !void {
+        const proxy = occluder.proxy;
+        const width = @intToFloat(f32, self.width);
+        const height = @intToFloat(f32, self.height);
+
+        var i: usize = 0;
+        triangles: while (i + 3 <= proxy.indices.len) : (i += 3) {
+            var triangle: Triangle = undefined;
+            for ([3]usize{ 0, 1, 2 }) |corner| {
+                const world = transformPoint(occluder.transform, proxy.positions[proxy.indices[i + corner]]);
+                const clip = projectPoint(view_projection, world);
+                if (clip[3] <= near_w)
+                    continue :triangles;
+                triangle.x[corner] = (clip[0] / clip[3] * 0.5 + 0.5) * width;
+                triangle.y[corner] = (0.5 - clip[1] / clip[3] * 0.5) * height;
+                triangle.z[corner] = clip[2] / clip[3] * 0.5 + 0.5;
+            }
+
+            // skip triangles without area or beyond the far plane
+            if (@fabs(edge(triangle, 0, 1, triangle.x[2], triangle.y[2])) < 1e-6)
+                continue;
+            if (triangle.z[0] > 1 and triangle.z[1] > 1 and triangle.z[2] > 1)
+                continue;
+            try self.triangles.append(self.allocator, triangle);
+        }
+    }
+
+    /// Rasterizes all added occluders and builds the depth pyramid. The screen is split into
+    /// horizontal bands that are rasterized on `thread_count` threads.
+    pub fn rasterize(self: *DepthBuffer) void {
+        parallel.forEachRange(self.height, self.thread_count, min_rows_per_thread, self, rasterizeBand);
+        self.buildPyramid();
+    }
+
+    const min_rows_per_thread = 16;
+
+    fn rasterizeBand(self: *DepthBuffer, row_begin: usize, row_end: usize) void {
+        const depth = self.levels[0].depth;
+        const lane_offsets = comptime blk: {
+            var offsets: [lanes]f32 = undefined;
+            for (offsets) |*v, i| {
+                v.* = @intToFloat(f32, i) + 0.5;
+            }
+            break :blk offsets;
+        };
+
+        for (self.triangles.items) |original| {
+            // make the winding counter clockwise on screen, so all edge functions are positive inside
+            var t = original;
+            var area = edge(t, 0, 1, t.x[2], t.y[2]);
+            if (area < 0) {
+                std.mem.swap(f32, &t.x[1], &t.x[2]);
+                std.mem.swap(f32, &t.y[1], &t.y[2]);
+                std.mem.swap(f32, &t.z[1], &t.z[2]);
+                area = -area;
+            }
+
+            const min_x = std.math.max(0, @floor(std.math.min(t.x[0], std.math.min(t.x[1], t.x[2]))));
+            const max_x = std.math.min(@intToFloat(f32, self.width), @ceil(std.math.max(t.x[0], std.math.max(t.x[1], t.x[2]))));
+            const min_y = std.math.max(@intToFloat(f32, row_begin), @floor(std.math.min(t.y[0], std.math.min(t.y[1], t.y[2]))));
+            const max_y = std.math.min(@intToFloat(f32, row_end), @ceil(std.math.max(t.y[0], std.math.max(t.y[1], t.y[2]))));
+            if (min_x >= max_x or min_y >= max_y)
+                continue;
+
+            const inv_area = 1.0 / area;
+            const x_begin = (@floatToInt(usize, min_x) / lanes) * lanes;
+            const x_end = @floatToInt(usize, max_x);
+
+            var y = @floatToInt(usize, min_y);
+            while (y < @floatToInt(usize, max_y)) : (y += 1) {
+                const py = @splat(lanes, @intToFloat(f32, y) + 0.5);
+                var x = x_begin;
+                while (x < x_end) : (x += lanes) {
+                    const px = @splat(lanes, @intToFloat(f32, x)) + @as(Vec, lane_offsets);
+
+                    // barycentric weights of the pixel centers
+                    const w0 = edgeVec(t, 1, 2, px, py);
+                    const w1 = edgeVec(t, 2, 0, px, py);
+                    const w2 = edgeVec(t, 0, 1, px, py);
+                    var min_weight = @select(f32, w0 < w1, w0, w1);
+                    min_weight = @select(f32, min_weight < w2, min_weight, w2);
+
+                    const z = (w0 * @splat(lanes, t.z[0]) + w1 * @splat(lanes, t.z[1]) + w2 * @splat(lanes, t.z[2])) * @splat(lanes, inv_area);
+
+                    const row = depth[y * self.width + x ..][0..lanes];
+                    const old: Vec = row.*;
+                    const closer = @select(f32, z < old, z, old);
+                    row.* = @select(f32, min_weight >= @splat(lanes, @as(f32, 0)), closer, old);
+                }
+            }
+        }
+    }
+
+    fn buildPyramid(self: *DepthBuffer) void {
+        for (self.levels[1..]) |*level, i| {
+            const src = self.levels[i];
+            var y: usize = 0;
+            while (y < level.height) : (y += 1) {
+                const y0 = 2 * y;
+                const y1 = std.math.min(y0 + 1, src.height - 1);
+                var x: usize = 0;
+                while (x < level.width) : (x += 1) {
+                    const x0 = 2 * x;
+                    const x1 = std.math.min(x0 + 1, src.width - 1);
+                    level.depth[y * level.width + x] = std.math.max(
+                        std.math.max(src.get(x0, y0), src.get(x1, y0)),
+                        std.math.max(src.get(x0, y1), src.get(x1, y1)),
+                    );
+                }
+            }
+        }
+    }
+
+    /// Returns false if the box from `min` to `max` in model space, placed in the world by
+    /// `transform`, is completely hidden behind the rasterized occluders.
+    pub fn isBoxVisible(self: DepthBuffer, min: [3]f32, max: [3]f32, transform: Mat4, view_projection: Mat4) bool {
+        var screen_min = [2]f32{ std.math.inf(f32), std.math.inf(f32) };
+        var screen_max = [2]f32{ -std.math.inf(f32), -std.math.inf(f32) };
+        var nearest: f32 = std.math.inf(f32);
+
+        for ([8]usize{ 0, 1, 2, 3, 4, 5, 6, 7 }) |corner| {
+            const local = [3]f32{
+                if (corner & 1 != 0) max[0] else min[0],
+                if (corner & 2 != 0) max[1] else min[1],
+                if (corner & 4 != 0) max[2] else min[2],
+            };
+            const clip = projectPoint(view_projection, transformPoint(transform, local));
+
+            // the box reaches behind the camera
+            if (clip[3] <= near_w)
+                return true;
+
+            const sx = (clip[0] / clip[3] * 0.5 + 0.5) * @intToFloat(f32, self.width);
+            const sy = (0.5 - clip[1] / clip[3] * 0.5) * @intToFloat(f32, self.height);
+            screen_min[0] = std.math.min(screen_min[0], sx);
+            screen_min[1] = std.math.min(screen_min[1], sy);
+            screen_max[0] = std.math.max(screen_max[0], sx);
+            screen_max[1] = std.math.max(screen_max[1], sy);
+            nearest = std.math.min(nearest, clip[2] / clip[3] * 0.5 + 0.5);
+        }
+
+        const x0 = std.math.clamp(screen_min[0], 0, @intToFloat(f32, self.width - 1));
+        const y0 = std.math.clamp(screen_min[1], 0, @intToFloat(f32, self.height - 1));
+        const x1 = std.math.clamp(screen_max[0], 0, @intToFloat(f32, self.width - 1));
+        const y1 = std.math.clamp(screen_max[1], 0, @intToFloat(f32, self.height - 1));
+
+        var left = @floatToInt(usize, x0);
+        var top = @floatToInt(usize, y0);
+        var right = @floatToInt(usize, x1);
+        var bottom = @floatToInt(usize, y1);
+
+        // use the level on which the box covers at most 2×2 texels
+        var level_index: usize = 0;
+        while (level_index + 1 < self.levels.len and (right - left > 1 or bottom - top > 1)) : (level_index += 1) {
+            left /= 2;
+            top /= 2;
+            right /= 2;
+            bottom /= 2;
+        }
+        const level = self.levels[level_index];
+
+        var farthest: f32 = 0;
+        var y = top;
+        while (y <= bottom) : (y += 1) {
+            var x = left;
+            while (x <= right) : (x += 1) {
+                farthest = std.math.max(farthest, level.get(x, y));
+            }
+        }
+        return nearest <= farthest;
+    }
+};
+
+fn edge(t: DepthBuffer.Triangle, comptime a: usize, comptime b: usize, px: f32, py: f32) f32 {
+    return (t.x[b] - t.x[a]) * (py - t.y[a]) - (t.y[b] - t.y[a]) * (px - t.x[a]);
+}
+
+fn edgeVec(t: DepthBuffer.Triangle, comptime a: usize, comptime b: usize, px: DepthBuffer.Vec, py: DepthBuffer.Vec) DepthBuffer.Vec {
+    const lanes = DepthBuffer.lanes;
+    return @splat(lanes, t.x[b] - t.x[a]) * (py - @splat(lanes, t.y[a])) -
+        @splat(lanes, t.y[b] - t.y[a]) * (px - @splat(lanes, t.x[a]));
+}
+
+fn transformPoint(m: Mat4, p: [3]f32) [3]f32 {
+    var result: [3]f32 = undefined;
+    for (result) |*v, i| {
+        v.* = m[0][i] * p[0] + m[1][i] * p[1] + m[2][i] * p[2] + m[3][i];
+    }
+    return result;
+}
+
+fn projectPoint(m: Mat4, p: [3]f32) [4]f32 {
+    var result: [4]f32 = undefined;
+    for (result) |*v, i| {
+        v.* = m[0][i] * p[0] + m[1][i] * p[1] + m[2][i] * p[2] + m[3][i];
+    }
+    return result;
+}
+
+test "occlusion culling behind a wall" {
+    var buffer = try DepthBuffer.init(std.testing.allocator, 64, 64);
+    defer buffer.deinit();
+
+    // an orthographic projection of the cube from -1 to 1, z = -1 is the near plane
+    const view_projection = Mat4{
+        .{ 1, 0, 0, 0 },
+        .{ 0, 1, 0, 0 },
+        .{ 0, 0, 1, 0 },
+        .{ 0, 0, 0, 1 },
+    };
+    const identity = view_projection;
+
+    // a wall covering the left half of the screen at z = 0
+    const wall = Proxy{
+        .positions = &[_][3]f32{ .{ -1, -1, 0 }, .{ 0, -1, 0 }, .{ 0, 1, 0 }, .{ -1, 1, 0 } },
+        .indices = &[_]u16{ 0, 1, 2, 0, 2, 3 },
+    };
+    try buffer.addOccluder(.{ .proxy = wall, .transform = identity }, view_projection);
+    buffer.rasterize();
+
+    // behind the wall
+    try std.testing.expect(!buffer.isBoxVisible(.{ -0.8, -0.5, 0.2 }, .{ -0.2, 0.5, 0.6 }, identity, view_projection));
+    // in front of the wall
+    try std.testing.expect(buffer.isBoxVisible(.{ -0.8, -0.5, -0.6 }, .{ -0.2, 0.5, -0.2 }, identity, view_projection));
+    // behind, but beside the wall
+    try std.testing.expect(buffer.isBoxVisible(.{ 0.2, -0.5, 0.2 }, .{ 0.8, 0.5, 0.6 }, identity, view_projection));
+    // behind, but reaching out of the wall
+    try std.testing.expect(buffer.isBoxVisible(.{ -0.5, -0.5, 0.2 }, .{ 0.5, 0.5, 0.6 }, identity, view_projection));
+}
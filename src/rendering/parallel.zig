@@ -0,0 +1,161 @@
+//! Spreads data parallel work over a small pool of worker threads.
+//!
+//! Used where a frame has a single large loop over independent elements, like skinning
+//! vertices or rasterizing rows. The workers are started on first use and then reused
+//! for every later call, so a frame doesn't pay for spawning threads.
+const std = @import("std");
+const builtin = @import("builtin");
+
+/// Upper bound for the number of threads `forEachRange` uses, including the calling one.
+pub const max_threads = 16;
+
+/// Splits `0..count` into up to `thread_count` contiguous ranges of at least `min_per_thread`
+/// elements and calls `func(context, begin, end)` once for each of them. The last range runs on
+/// the calling thread, all others on pooled worker threads. Returns when all ranges are done.
+///
+/// When no worker can be started, or the pool is busy with a call from another thread, the
+/// remaining ranges run on the calling thread instead, so the work is always done, just not
+/// necessarily in parallel. Single threaded builds always run everything on the calling thread.
+pub fn forEachRange(
+    count: usize,
+    thread_count: usize,
+    min_per_thread: usize,
+    context: anytype,
+    comptime func: fn (@TypeOf(context), usize, usize) void,
+) void {
+    if (builtin.single_threaded) {
+        func(context, 0, count);
+    } else {
+        forEachRangePooled(count, thread_count, min_per_thread, context, func);
+    }
+}
+
+fn forEachRangePooled(
+    count: usize,
+    thread_count: usize,
+    min_per_thread: usize,
+    context: anytype,
+    comptime func: fn (@TypeOf(context), usize, usize) void,
+) void {
+    const range_count = std.math.clamp(std.math.min(thread_count, count / std.math.max(min_per_thread, 1)), 1, max_threads);
+    if (range_count == 1 or !pool.mutex.tryLock()) {
+        func(context, 0, count);
+        return;
+    }
+    defer pool.mutex.unlock();
+
+    const Context = @TypeOf(context);
+    const Erased = struct {
+        fn run(ptr: *const anyopaque, begin: usize, end: usize) void {
+            func(@ptrCast(*const Context, @alignCast(@alignOf(Context), ptr)).*, begin, end);
+        }
+    };
+
+    const range_size = (count + range_count - 1) / range_count;
+
+    var started: usize = 0;
+    while (started < range_count - 1) : (started += 1) {
+        const worker = pool.getWorker(started) orelse break;
+        const begin = std.math.min(started * range_size, count);
+        worker.job = Job{
+            .run = Erased.run,
+            .context = &context,
+            .begin = begin,
+            .end = std.math.min(begin + range_size, count),
+        };
+        worker.done.reset();
+        worker.start.set();
+    }
+
+    // The ranges no worker took are contiguous, so they run here in one call.
+    func(context, std.math.min(started * range_size, count), count);
+
+    for (pool.workers[0..started]) |*worker| {
+        worker.done.wait();
+    }
+}
+
+const Job = struct {
+    run: *const fn (*const anyopaque, usize, usize) void,
+    context: *const anyopaque,
+    begin: usize,
+    end: usize,
+};
+
+const Worker = struct {
+    start: std.Thread.ResetEvent = .{},
+    done: std.Thread.ResetEvent = .{},
+    job: ?Job = null,
+
+    fn main(worker: *Worker) void {
+        while (true) {
+            worker.start.wait();
+            worker.start.reset();
+            const job = worker.job.?;
+            job.run(job.context, job.begin, job.end);
+            worker.done.set();
+        }
+    }
+};
+
+/// The workers live until the process exits. `mutex` is held by the call that currently
+/// distributes work, so the workers are only ever fed by one thread.
+const pool = struct {
+    var mutex: std.Thread.Mutex = .{};
+    var workers: [max_threads - 1]Worker = undefined;
+    var worker_count: usize = 0;
+
+    /// Returns the worker at `index`, starting it if needed. Workers are requested in order,
+    /// so `index` is at most `worker_count`.
+    fn getWorker(index: usize) ?*Worker {
+        std.debug.assert(index <= worker_count);
+        if (index < worker_count)
+            return &workers[index];
+
+        workers[index] = Worker{};
+        const thread = std.Thread.spawn(.{}, Worker.main, .{&workers[index]}) catch return null;
+        thread.detach();
+        worker_count += 1;
+        return &workers[index];
+    }
+};
+
+const TestContext = struct {
+    visits: []u8,
+};
+
+fn countVisits(context: TestContext, begin: usize, end: usize) void {
+    for (context.visits[begin..end]) |*visit| {
+        visit.* += 1;
+    }
+}
+
+test "forEachRange visits every element once" {
+    var visits: [1000]u8 = undefined;
+    for ([_]usize{ 0, 1, 7, 999, 1000 }) |count| {
+        for ([_]usize{ 1, 3, 4, 64 }) |thread_count| {
+            std.mem.set(u8, &visits, 0);
+            forEachRange(count, thread_count, 10, TestContext{ .visits = &visits }, countVisits);
+            for (visits) |visit, i| {
+                try std.testing.expectEqual(@as(u8, @boolToInt(i < count)), visit);
+            }
+        }
+    }
+}
+
+test "forEachRange reuses its workers" {
+    if (builtin.single_threaded) return error.SkipZigTest;
+
+    var visits: [1000]u8 = undefined;
+    forEachRange(visits.len, 4, 10, TestContext{ .visits = &visits }, countVisits);
+    const worker_count = pool.worker_count;
+    try std.testing.expect(worker_count <= max_threads - 1);
+
+    var round: usize = 0;
+    while (round < 100) : (round += 1) {
+        std.mem.set(u8, &visits, 0);
+        forEachRange(visits.len, 4, 10, TestContext{ .visits = &visits }, countVisits);
+        try std.testing.expect(std.mem.allEqual(u8, &visits, 1));
+    }
+    try std.testing.expectEqual(worker_count, pool.worker_count);
+}
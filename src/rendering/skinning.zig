@@ -0,0 +1,500 @@
+//! Skeletal animation for skinned geometries.
+//!
+//! - `Animation` loads a zani file and samples it into a `Pose`.
+//! - `Pose` stores the local transform of each bone, can be blended and
+//!   converted into a matrix palette.
+//! - `skinVertices` and `skinVerticesParallel` apply a matrix palette to the vertices
+//!   on the CPU. `Renderer3D.drawSkinnedGeometry` does the same on the GPU.
+const std = @import("std");
+const ResourceManager = @import("ResourceManager.zig");
+const zani = @import("zani-format.zig");
+const parallel = @import("parallel.zig");
+
+const Vertex = ResourceManager.Vertex;
+const Skin = ResourceManager.Skin;
+const SkinVertex = ResourceManager.SkinVertex;
+const Mat4 = [4][4]f32;
+
+/// A decomposed affine transform.
+pub const Transform = struct {
+    translation: [3]f32 = .{ 0, 0, 0 },
+    /// unit quaternion as x, y, z, w
+    rotation: [4]f32 = .{ 0, 0, 0, 1 },
+    scale: [3]f32 = .{ 1, 1, 1 },
+
+    /// Decomposes a matrix without shear into translation, rotation and scale.
+    pub fn fromMatrix(m: Mat4) Transform {
+        var scale: [3]f32 = undefined;
+        var r: [3][3]f32 = undefined;
+        for (scale) |*s, col| {
+            s.* = @sqrt(m[col][0] * m[col][0] + m[col][1] * m[col][1] + m[col][2] * m[col][2]);
+            for (r[col]) |*v, row| {
+                v.* = if (s.* != 0) m[col][row] / s.* else 0;
+            }
+        }
+
+        // r[col][row], so r[1][0] is the element in row 0, column 1
+        var q: [4]f32 = undefined;
+        const trace = r[0][0] + r[1][1] + r[2][2];
+        if (trace > 0) {
+            const s = 0.5 / @sqrt(trace + 1.0);
+            q = .{ (r[1][2] - r[2][1]) * s, (r[2][0] - r[0][2]) * s, (r[0][1] - r[1][0]) * s, 0.25 / s };
+        } else if (r[0][0] > r[1][1] and r[0][0] > r[2][2]) {
+            const s = 2.0 * @sqrt(1.0 + r[0][0] - r[1][1] - r[2][2]);
+            q = .{ 0.25 * s, (r[1][0] + r[0][1]) / s, (r[2][0] + r[0][2]) / s, (r[1][2] - r[2][1]) / s };
+        } else if (r[1][1] > r[2][2]) {
+            const s = 2.0 * @sqrt(1.0 + r[1][1] - r[0][0] - r[2][2]);
+            q = .{ (r[1][0] + r[0][1]) / s, 0.25 * s, (r[2][1] + r[1][2]) / s, (r[2][0] - r[0][2]) / s };
+        } else {
+            const s = 2.0 * @sqrt(1.0 + r[2][2] - r[0][0] - r[1][1]);
+            q = .{ (r[2][0] + r[0][2]) / s, (r[2][1] + r[1][2]) / s, 0.25 * s, (r[0][1] - r[1][0]) / s };
+        }
+
+        return Transform{
+            .translation = .{ m[3][0], m[3][1], m[3][2] },
+            .rotation = normalizeQuaternion(q),
+            .scale = scale,
+        };
+    }
+
+    pub fn toMatrix(self: Transform) Mat4 {
+        const x = self.rotation[0];
+        const y = self.rotation[1];
+        const z = self.rotation[2];
+        const w = self.rotation[3];
+        const s = self.scale;
+        const t = self.translation;
+        return Mat4{
+            .{ s[0] * (1 - 2 * (y * y + z * z)), s[0] * 2 * (x * y + z * w), s[0] * 2 * (x * z - y * w), 0 },
+            .{ s[1] * 2 * (x * y - z * w), s[1] * (1 - 2 * (x * x + z * z)), s[1] * 2 * (y * z + x * w), 0 },
+            .{ s[2] * 2 * (x * z + y * w), s[2] * 2 * (y * z - x * w), s[2] * (1 - 2 * (x * x + y * y)), 0 },
+            .{ t[0], t[1], t[2], 1 },
+        };
+    }
+
+    /// Interpolates between `a` (`t = 0`) and `b` (`t = 1`).
+    pub fn blend(a: Transform, b: Transform, t: f32) Transform {
+        return Transform{
+            .translation = lerp3(a.translation, b.translation, t),
+            .rotation = nlerp(a.rotation, b.rotation, t),
+            .scale = lerp3(a.scale, b.scale, t),
+        };
+    }
+};
+
+/// The local transforms of all bones of a skeleton.
+pub const Pose = struct {
+    transforms: []Transform,
+
+    /// Creates a pose in the bind pose of `skin`.
+    pub fn init(allocator: std.mem.Allocator, skin: Skin) !Pose {
+        const pose = Pose{ .transforms = try allocator.alloc(Transform, skin.bones.len) };
+        pose.setBindPose(skin);
+        return pose;
+    }
+
+    pub fn deinit(self: *Pose, allocator: std.mem.Allocator) void {
+        allocator.free(self.transforms);
+        self.* = undefined;
+    }
+
+    pub fn setBindPose(self: Pose, skin: Skin) void {
+        for (self.transforms) |*transform, i| {
+            transform.* = Transform.fromMatrix(skin.bones[i].local_transform);
+        }
+    }
+
+    /// Sets this pose to the blend of `a` (`t = 0`) and `b` (`t = 1`). All poses must belong to the same skeleton.
+    pub fn blend(self: Pose, a: Pose, b: Pose, t: f32) void {
+        std.debug.assert(a.transforms.len == self.transforms.len);
+        std.debug.assert(b.transforms.len == self.transforms.len);
+        for (self.transforms) |*transform, i| {
+            transform.* = Transform.blend(a.transforms[i], b.transforms[i], t);
+        }
+    }
+
+    /// Computes the skinning matrices, which transform a vertex from bind pose into this pose.
+    pub fn computePalette(self: Pose, skin: Skin, palette: []Mat4) void {
+        std.debug.assert(palette.len == skin.bones.len);
+
+        // Parents are always stored before their children, so the global transforms
+        // can be computed in a single pass. `palette` holds them until the end.
+        for (skin.bones) |bone, i| {
+            const local = self.transforms[i].toMatrix();
+            palette[i] = if (bone.parent) |parent|
+                mul(palette[parent], local)
+            else
+                local;
+        }
+        for (skin.bones) |bone, i| {
+            palette[i] = mul(palette[i], bone.inverse_bind_matrix);
+        }
+    }
+};
+
+/// A skeletal animation loaded from a zani file.
+pub const Animation = struct {
+    pub const VectorKey = zani.VectorKey;
+    pub const QuaternionKey = zani.QuaternionKey;
+
+    pub const Channel = struct {
+        bone_name: [52]u8, // NUL padded
+        positions: []const VectorKey,
+        rotations: []const QuaternionKey,
+        scales: []const VectorKey,
+
+        pub fn getBoneName(self: *const Channel) []const u8 {
+            return std.mem.sliceTo(&self.bone_name, 0);
+        }
+    };
+
+    /// Connects the channels of an animation to the bones of a skin.
+    pub const Binding = struct {
+        /// channel index for each bone
+        channels: []?usize,
+        /// used for bones without a channel
+        bind_pose: []Transform,
+
+        pub fn deinit(self: *Binding, allocator: std.mem.Allocator) void {
+            allocator.free(self.channels);
+            allocator.free(self.bind_pose);
+            self.* = undefined;
+        }
+    };
+
+    /// length in seconds
+    duration: f32,
+    channels: []Channel,
+
+    vector_keys: []VectorKey,
+    quaternion_keys: []QuaternionKey,
+
+    pub fn load(allocator: std.mem.Allocator, data: []const u8) !Animation {
+        if (data.len < @sizeOf(zani.Header))
+            return error.InvalidFormat;
+
+        const header = @ptrCast(*align(1) const zani.Header, &data[0]);
+        if (!std.mem.eql(u8, &header.magic, &zani.magic_number))
+            return error.InvalidFormat;
+        if (std.mem.littleToNative(u16, header.version) != zani.version)
+            return error.InvalidFormat;
+
+        const channel_count = std.mem.littleToNative(u32, header.channel_count);
+
+        // Validate the file and count the keys, so all keys fit into two allocations.
+        var vector_key_count: usize = 0;
+        var quaternion_key_count: usize = 0;
+        {
+            var offset: usize = @sizeOf(zani.Header);
+            var i: usize = 0;
+            while (i < channel_count) : (i += 1) {
+                if (data.len < offset + @sizeOf(zani.Channel))
+                    return error.InvalidFormat;
+                const channel = @ptrCast(*align(1) const zani.Channel, &data[offset]);
+                offset += channel.size();
+                if (data.len < offset)
+                    return error.InvalidFormat;
+                vector_key_count += std.mem.littleToNative(u32, channel.position_count) + std.mem.littleToNative(u32, channel.scale_count);
+                quaternion_key_count += std.mem.littleToNative(u32, channel.rotation_count);
+            }
+        }
+
+        const channels = try allocator.alloc(Channel, channel_count);
+        errdefer allocator.free(channels);
+        const vector_keys = try allocator.alloc(VectorKey, vector_key_count);
+        errdefer allocator.free(vector_keys);
+        const quaternion_keys = try allocator.alloc(QuaternionKey, quaternion_key_count);
+        errdefer allocator.free(quaternion_keys);
+
+        var offset: usize = @sizeOf(zani.Header);
+        var vector_offset: usize = 0;
+        var quaternion_offset: usize = 0;
+        for (channels) |*channel| {
+            const src = @ptrCast(*align(1) const zani.Channel, &data[offset]);
+            offset += @sizeOf(zani.Channel);
+
+            const positions = copyKeys(VectorKey, data, &offset, vector_keys[vector_offset..], std.mem.littleToNative(u32, src.position_count));
+            vector_offset += positions.len;
+            const rotations = copyKeys(QuaternionKey, data, &offset, quaternion_keys[quaternion_offset..], std.mem.littleToNative(u32, src.rotation_count));
+            quaternion_offset += rotations.len;
+            const scales = copyKeys(VectorKey, data, &offset, vector_keys[vector_offset..], std.mem.littleToNative(u32, src.scale_count));
+            vector_offset += scales.len;
+
+            channel.* = Channel{
+                .bone_name = src.bone_name,
+                .positions = positions,
+                .rotations = rotations,
+                .scales = scales,
+            };
+        }
+
+        return Animation{
+            .duration = header.duration,
+            .channels = channels,
+            .vector_keys = vector_keys,
+            .quaternion_keys = quaternion_keys,
+        };
+    }
+
+    fn copyKeys(comptime Key: type, data: []const u8, offset: *usize, dst: []Key, count: usize) []const Key {
+        const src = @ptrCast([*]align(1) const Key, &data[offset.*])[0..count];
+        for (dst[0..count]) |*key, i| {
+            key.* = src[i];
+        }
+        offset.* += @sizeOf(Key) * count;
+        return dst[0..count];
+    }
+
+    pub fn deinit(self: *Animation, allocator: std.mem.Allocator) void {
+        allocator.free(self.channels);
+        allocator.free(self.vector_keys);
+        allocator.free(self.quaternion_keys);
+        self.* = undefined;
+    }
+
+    /// Looks up the channel of each bone in `skin`. Channels without a bone are ignored.
+    pub fn bind(self: Animation, allocator: std.mem.Allocator, skin: Skin) !Binding {
+        const channels = try allocator.alloc(?usize, skin.bones.len);
+        errdefer allocator.free(channels);
+        const bind_pose = try allocator.alloc(Transform, skin.bones.len);
+        errdefer allocator.free(bind_pose);
+
+        for (skin.bones) |*bone, i| {
+            channels[i] = null;
+            for (self.channels) |*channel, c| {
+                if (std.mem.eql(u8, channel.getBoneName(), bone.getName())) {
+                    channels[i] = c;
+                    break;
+                }
+            }
+            bind_pose[i] = Transform.fromMatrix(bone.local_transform);
+        }
+
+        return Binding{
+            .channels = channels,
+            .bind_pose = bind_pose,
+        };
+    }
+
+    /// Samples the animation at `time` seconds into `pose`. The animation loops.
+    pub fn sample(self: Animation, binding: Binding, time: f32, pose: Pose) void {
+        std.debug.assert(binding.channels.len == pose.transforms.len);
+
+        const t = if (self.duration > 0) @mod(time, self.duration) else 0;
+
+        for (pose.transforms) |*transform, i| {
+            const bind_pose = binding.bind_pose[i];
+            const channel = self.channels[binding.channels[i] orelse {
+                transform.* = bind_pose;
+                continue;
+            }];
+            transform.* = Transform{
+                .translation = sampleVector(channel.positions, t) orelse bind_pose.translation,
+                .rotation = sampleQuaternion(channel.rotations, t) orelse bind_pose.rotation,
+                .scale = sampleVector(channel.scales, t) orelse bind_pose.scale,
+            };
+        }
+    }
+
+    /// Returns the index of the last key at or before `t`.
+    fn findKey(comptime Key: type, keys: []const Key, t: f32) usize {
+        var low: usize = 0;
+        var high: usize = keys.len;
+        while (high - low > 1) {
+            const mid = low + (high - low) / 2;
+            if (keys[mid].time <= t) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    fn keyFactor(t0: f32, t1: f32, t: f32) f32 {
+        if (t1 <= t0)
+            return 0;
+        return std.math.clamp((t - t0) / (t1 - t0), 0.0, 1.0);
+    }
+
+    fn sampleVector(keys: []const VectorKey, t: f32) ?[3]f32 {
+        if (keys.len == 0)
+            return null;
+        const i = findKey(VectorKey, keys, t);
+        if (i + 1 >= keys.len)
+            return keys[i].value;
+        return lerp3(keys[i].value, keys[i + 1].value, keyFactor(keys[i].time, keys[i + 1].time, t));
+    }
+
+    fn sampleQuaternion(keys: []const QuaternionKey, t: f32) ?[4]f32 {
+        if (keys.len == 0)
+            return null;
+        const i = findKey(QuaternionKey, keys, t);
+        if (i + 1 >= keys.len)
+            return keys[i].value;
+        return nlerp(keys[i].value, keys[i + 1].value, keyFactor(keys[i].time, keys[i + 1].time, t));
+    }
+};
+
+/// Transforms `src` with the matrix `palette` into `dst`. `src`, `dst` and `skin.vertices` must have the same length.
+pub fn skinVertices(skin: Skin, palette: []const Mat4, src: []const Vertex, dst: []Vertex) void {
+    std.debug.assert(src.len == dst.len);
+    std.debug.assert(skin.vertices.len == src.len);
+    skinRange(skin.vertices, palette, src, dst);
+}
+
+/// Vertices below this count are not distributed over several threads.
+const min_vertices_per_thread = 4096;
+
+/// Same as `skinVertices`, but distributes the work over up to `thread_count` threads including the calling one.
+pub fn skinVerticesParallel(skin: Skin, palette: []const Mat4, src: []const Vertex, dst: []Vertex, thread_count: usize) void {
+    std.debug.assert(src.len == dst.len);
+    std.debug.assert(skin.vertices.len == src.len);
+
+    const job = SkinJob{ .influences = skin.vertices, .palette = palette, .src = src, .dst = dst };
+    parallel.forEachRange(src.len, thread_count, min_vertices_per_thread, job, SkinJob.run);
+}
+
+const SkinJob = struct {
+    influences: []const SkinVertex,
+    palette: []const Mat4,
+    src: []const Vertex,
+    dst: []Vertex,
+
+    fn run(job: SkinJob, begin: usize, end: usize) void {
+        skinRange(job.influences[begin..end], job.palette, job.src[begin..end], job.dst[begin..end]);
+    }
+};
+
+fn skinRange(influences: []const SkinVertex, palette: []const Mat4, src: []const Vertex, dst: []Vertex) void {
+    const Vec4 = @Vector(4, f32);
+    const zero = @splat(4, @as(f32, 0));
+
+    for (src) |vertex, i| {
+        const influence = influences[i];
+
+        // blend the columns of the bone matrices
+        var c0: Vec4 = zero;
+        var c1: Vec4 = zero;
+        var c2: Vec4 = zero;
+        var c3: Vec4 = zero;
+        inline for ([_]comptime_int{ 0, 1, 2, 3 }) |k| {
+            const weight = @splat(4, @intToFloat(f32, influence.bone_weights[k]) * (1.0 / 255.0));
+            const bone = &palette[influence.bone_indices[k]];
+            c0 += weight * @as(Vec4, bone[0]);
+            c1 += weight * @as(Vec4, bone[1]);
+            c2 += weight * @as(Vec4, bone[2]);
+            c3 += weight * @as(Vec4, bone[3]);
+        }
+
+        const position = c0 * @splat(4, vertex.x) + c1 * @splat(4, vertex.y) + c2 * @splat(4, vertex.z) + c3;
+        const normal = c0 * @splat(4, vertex.nx) + c1 * @splat(4, vertex.ny) + c2 * @splat(4, vertex.nz);
+        const normal_length = @sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        const normal_scale = if (normal_length > 0) 1.0 / normal_length else 0.0;
+
+        dst[i] = Vertex{
+            .x = position[0],
+            .y = position[1],
+            .z = position[2],
+            .nx = normal[0] * normal_scale,
+            .ny = normal[1] * normal_scale,
+            .nz = normal[2] * normal_scale,
+            .u = vertex.u,
+            .v = vertex.v,
+        };
+    }
+}
+
+fn mul(a: Mat4, b: Mat4) Mat4 {
+    // column major: result[col] = a * b[col]
+    var result: Mat4 = undefined;
+    inline for ([_]comptime_int{ 0, 1, 2, 3 }) |col| {
+        inline for ([_]comptime_int{ 0, 1, 2, 3 }) |row| {
+            var sum: f32 = 0.0;
+            inline for ([_]comptime_int{ 0, 1, 2, 3 }) |i| {
+                sum += a[i][row] * b[col][i];
+            }
+            result[col][row] = sum;
+        }
+    }
+    return result;
+}
+
+fn lerp3(a: [3]f32, b: [3]f32, t: f32) [3]f32 {
+    return .{
+        a[0] + (b[0] - a[0]) * t,
+        a[1] + (b[1] - a[1]) * t,
+        a[2] + (b[2] - a[2]) * t,
+    };
+}
+
+/// Normalized linear interpolation along the shorter arc.
+fn nlerp(a: [4]f32, b: [4]f32, t: f32) [4]f32 {
+    const dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    const sign: f32 = if (dot < 0) -1.0 else 1.0;
+    var result: [4]f32 = undefined;
+    for (result) |*v, i| {
+        v.* = a[i] + (sign * b[i] - a[i]) * t;
+    }
+    return normalizeQuaternion(result);
+}
+
+fn normalizeQuaternion(q: [4]f32) [4]f32 {
+    const len = @sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (len == 0)
+        return .{ 0, 0, 0, 1 };
+    return .{ q[0] / len, q[1] / len, q[2] / len, q[3] / len };
+}
+
+test "transform matrix roundtrip" {
+    const transform = Transform{
+        .translation = .{ 1, -2, 3 },
+        .rotation = normalizeQuaternion(.{ 0.3, -0.5, 0.1, 0.8 }),
+        .scale = .{ 2, 0.5, 1 },
+    };
+    const decoded = Transform.fromMatrix(transform.toMatrix());
+    for (transform.translation) |v, i| try std.testing.expectApproxEqAbs(v, decoded.translation[i], 1e-5);
+    for (transform.rotation) |v, i| try std.testing.expectApproxEqAbs(v, decoded.rotation[i], 1e-5);
+    for (transform.scale) |v, i| try std.testing.expectApproxEqAbs(v, decoded.scale[i], 1e-5);
+}
+
+test "identity palette keeps positions" {
+    const vertex_count = 1000;
+    const bone_count = 8;
+
+    const allocator = std.testing.allocator;
+
+    var prng = std.rand.DefaultPrng.init(0);
+    const random = prng.random();
+
+    const src = try allocator.alloc(Vertex, vertex_count);
+    defer allocator.free(src);
+    const dst = try allocator.alloc(Vertex, vertex_count);
+    defer allocator.free(dst);
+    const influences = try allocator.alloc(SkinVertex, vertex_count);
+    defer allocator.free(influences);
+
+    for (src) |*vertex, i| {
+        vertex.* = Vertex.init(.{ random.float(f32), random.float(f32), random.float(f32) }, .{ 0, 1, 0 }, .{ 0, 0 });
+        const a = random.uintLessThan(u8, bone_count);
+        const b = random.uintLessThan(u8, bone_count);
+        const w = random.int(u8);
+        influences[i] = SkinVertex{
+            .bone_indices = .{ a, b, 0, 0 },
+            .bone_weights = .{ w, 255 - w, 0, 0 },
+        };
+    }
+
+    var palette: [bone_count]Mat4 = undefined;
+    for (palette) |*matrix| {
+        matrix.* = (Transform{}).toMatrix();
+    }
+
+    const skin = Skin{ .vertices = influences, .bones = &[0]ResourceManager.Bone{} };
+    skinVertices(skin, &palette, src, dst);
+    for (src) |vertex, i| {
+        try std.testing.expectApproxEqAbs(vertex.x, dst[i].x, 1e-5);
+        try std.testing.expectApproxEqAbs(vertex.y, dst[i].y, 1e-5);
+        try std.testing.expectApproxEqAbs(vertex.z, dst[i].z, 1e-5);
+    }
+}
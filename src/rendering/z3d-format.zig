@@ -50,3 +50,349 @@ pub const static_model = struct {
         texture_file: [120]u8, // NUL padded
     };
 };
+
+/// A skinned model. It has the layout of `static_model`, but every vertex is bound to up
+/// to four bones, and the skeleton follows the mesh list.
+pub const dynamic_model = struct {
+    comptime {
+        if (@sizeOf(Header) != 24) @compileError("Header must have 24 byte!");
+        if (@sizeOf(Vertex) != 40) @compileError("Vertex must have 40 byte!");
+        if (@sizeOf(Bone) != 192) @compileError("Bone must have 192 byte!");
+    }
+
+    /// The value of `Bone.parent` for root bones.
+    pub const no_parent = 0xFFFF_FFFF;
+
+    /// Bone indices are stored in a byte.
+    pub const max_bones = 256;
+
+    // size: 24
+    pub const Header = extern struct {
+        common: CommonHeader,
+        vertex_count: u32,
+        index_count: u32,
+        mesh_count: u32,
+        bone_count: u32,
+    };
+
+    // size: 40
+    pub const Vertex = extern struct {
+        x: f32,
+        y: f32,
+        z: f32,
+        nx: f32,
+        ny: f32,
+        nz: f32,
+        u: f32,
+        v: f32,
+        bone_indices: [4]u8,
+        bone_weights: [4]u8, // normalized, sum up to 255
+    };
+
+    // size: 2
+    pub const Index = static_model.Index;
+
+    // size: 128
+    pub const Mesh = static_model.Mesh;
+
+    // size: 192
+    pub const Bone = extern struct {
+        name: [60]u8, // NUL padded
+        /// Index of the parent bone, which is always smaller than the index of the bone, or `no_parent`.
+        parent: u32,
+        /// Transforms from model space into the space of the bone in bind pose. Column major.
+        inverse_bind_matrix: [4][4]f32,
+        /// Bind pose transform relative to the parent bone. Column major.
+        local_transform: [4][4]f32,
+    };
+};
+
+/// Version 2 of the static model. It has the same layout as `static_model`, but stores
+/// quantized vertices:
+/// - positions are normalized into the bounding box stored in the header
+/// - normals are octahedral encoded
+/// - texture coordinates are normalized into the uv bounds stored in the header
+pub const quantized_static_model = struct {
+    pub const version = 2;
+
+    comptime {
+        if (@sizeOf(Header) != 64) @compileError("Header must have 64 byte!");
+        if (@sizeOf(Vertex) != 16) @compileError("Vertex must have 16 byte!");
+    }
+
+    // size: 64
+    pub const Header = extern struct {
+        common: CommonHeader,
+        vertex_count: u32,
+        index_count: u32,
+        mesh_count: u32,
+        _pad1: u32 = undefined,
+        position_min: [3]f32,
+        position_max: [3]f32,
+        uv_min: [2]f32,
+        uv_max: [2]f32,
+    };
+
+    // size: 16
+    pub const Vertex = extern struct {
+        x: u16,
+        y: u16,
+        z: u16,
+        _pad0: u16 = 0,
+        nx: i16,
+        ny: i16,
+        u: u16,
+        v: u16,
+    };
+
+    // size: 2
+    pub const Index = static_model.Index;
+
+    // size: 128
+    pub const Mesh = static_model.Mesh;
+
+    /// The value ranges vertices are quantized against.
+    pub const Bounds = struct {
+        position_min: [3]f32,
+        position_max: [3]f32,
+        uv_min: [2]f32,
+        uv_max: [2]f32,
+
+        pub fn compute(vertices: []const static_model.Vertex) Bounds {
+            var bounds = Bounds{
+                .position_min = [3]f32{ std.math.f32_max, std.math.f32_max, std.math.f32_max },
+                .position_max = [3]f32{ -std.math.f32_max, -std.math.f32_max, -std.math.f32_max },
+                .uv_min = [2]f32{ std.math.f32_max, std.math.f32_max },
+                .uv_max = [2]f32{ -std.math.f32_max, -std.math.f32_max },
+            };
+            for (vertices) |vtx| {
+                const pos = [3]f32{ vtx.x, vtx.y, vtx.z };
+                const uv = [2]f32{ vtx.u, vtx.v };
+                for (pos) |p, i| {
+                    bounds.position_min[i] = std.math.min(bounds.position_min[i], p);
+                    bounds.position_max[i] = std.math.max(bounds.position_max[i], p);
+                }
+                for (uv) |t, i| {
+                    bounds.uv_min[i] = std.math.min(bounds.uv_min[i], t);
+                    bounds.uv_max[i] = std.math.max(bounds.uv_max[i], t);
+                }
+            }
+            if (vertices.len == 0) {
+                bounds.position_min = [3]f32{ 0, 0, 0 };
+                bounds.position_max = [3]f32{ 0, 0, 0 };
+                bounds.uv_min = [2]f32{ 0, 0 };
+                bounds.uv_max = [2]f32{ 0, 0 };
+            }
+            return bounds;
+        }
+    };
+
+    pub fn encodeVertex(bounds: Bounds, vertex: static_model.Vertex) Vertex {
+        const normal = encodeOctahedral(.{ vertex.nx, vertex.ny, vertex.nz });
+        return Vertex{
+            .x = encodeUnorm16(vertex.x, bounds.position_min[0], bounds.position_max[0]),
+            .y = encodeUnorm16(vertex.y, bounds.position_min[1], bounds.position_max[1]),
+            .z = encodeUnorm16(vertex.z, bounds.position_min[2], bounds.position_max[2]),
+            .nx = normal[0],
+            .ny = normal[1],
+            .u = encodeUnorm16(vertex.u, bounds.uv_min[0], bounds.uv_max[0]),
+            .v = encodeUnorm16(vertex.v, bounds.uv_min[1], bounds.uv_max[1]),
+        };
+    }
+
+    pub fn decodeVertex(bounds: Bounds, vertex: Vertex) static_model.Vertex {
+        const normal = decodeOctahedral(.{ vertex.nx, vertex.ny });
+        return static_model.Vertex{
+            .x = decodeUnorm16(vertex.x, bounds.position_min[0], bounds.position_max[0]),
+            .y = decodeUnorm16(vertex.y, bounds.position_min[1], bounds.position_max[1]),
+            .z = decodeUnorm16(vertex.z, bounds.position_min[2], bounds.position_max[2]),
+            .nx = normal[0],
+            .ny = normal[1],
+            .nz = normal[2],
+            .u = decodeUnorm16(vertex.u, bounds.uv_min[0], bounds.uv_max[0]),
+            .v = decodeUnorm16(vertex.v, bounds.uv_min[1], bounds.uv_max[1]),
+        };
+    }
+
+    fn encodeUnorm16(value: f32, min: f32, max: f32) u16 {
+        if (max <= min) return 0;
+        const f = std.math.clamp((value - min) / (max - min), 0.0, 1.0);
+        return @floatToInt(u16, @round(65535.0 * f));
+    }
+
+    fn decodeUnorm16(value: u16, min: f32, max: f32) f32 {
+        return min + (max - min) * (@intToFloat(f32, value) / 65535.0);
+    }
+
+    // Signed normalized values follow the OpenGL ES 2.0 conversion rule f = (2c + 1) / (2^16 - 1),
+    // so the GPU decodes exactly what we encode here.
+    fn encodeSnorm16(value: f32) i16 {
+        const f = std.math.clamp(value, -1.0, 1.0);
+        return @floatToInt(i16, std.math.clamp(@round((65535.0 * f - 1.0) / 2.0), -32768.0, 32767.0));
+    }
+
+    fn decodeSnorm16(value: i16) f32 {
+        return (2.0 * @intToFloat(f32, value) + 1.0) / 65535.0;
+    }
+
+    fn signNotZero(v: f32) f32 {
+        return if (v >= 0.0) 1.0 else -1.0;
+    }
+
+    /// Encodes a unit vector with an octahedral projection into two components.
+    pub fn encodeOctahedral(normal: [3]f32) [2]i16 {
+        const l1 = @fabs(normal[0]) + @fabs(normal[1]) + @fabs(normal[2]);
+        if (l1 == 0.0)
+            return [2]i16{ 0, 0 };
+
+        var x = normal[0] / l1;
+        var y = normal[1] / l1;
+        if (normal[2] < 0.0) {
+            const ox = x;
+            x = (1.0 - @fabs(y)) * signNotZero(ox);
+            y = (1.0 - @fabs(ox)) * signNotZero(y);
+        }
+        return [2]i16{ encodeSnorm16(x), encodeSnorm16(y) };
+    }
+
+    /// Decodes a vector encoded with `encodeOctahedral`.
+    pub fn decodeOctahedral(encoded: [2]i16) [3]f32 {
+        var x = decodeSnorm16(encoded[0]);
+        var y = decodeSnorm16(encoded[1]);
+        const z = 1.0 - @fabs(x) - @fabs(y);
+        if (z < 0.0) {
+            const ox = x;
+            x = (1.0 - @fabs(y)) * signNotZero(ox);
+            y = (1.0 - @fabs(ox)) * signNotZero(y);
+        }
+        const len = @sqrt(x * x + y * y + z * z);
+        return [3]f32{ x / len, y / len, z / len };
+    }
+};
+
+/// Optional level of detail table for static models. It is appended after the mesh
+/// list, so loaders that don't know it just draw the full detail meshes.
+/// The index ranges of all levels point into the regular index list.
+pub const lod_table = struct {
+    pub const magic = [4]u8{ 'Z', 'L', 'O', 'D' };
+
+    comptime {
+        if (@sizeOf(Header) != 8) @compileError("Header must have 8 byte!");
+        if (@sizeOf(Level) != 8) @compileError("Level must have 8 byte!");
+        if (@sizeOf(Range) != 8) @compileError("Range must have 8 byte!");
+    }
+
+    // size: 8
+    pub const Header = extern struct {
+        magic: [4]u8 = magic,
+        level_count: u32,
+    };
+
+    // size: 8
+    pub const Level = extern struct {
+        /// Maximum geometric deviation from the full detail mesh in model units.
+        max_error: f32,
+        _pad0: u32 = undefined,
+    };
+
+    // size: 8
+    pub const Range = extern struct {
+        offset: u32,
+        length: u32,
+    };
+
+    /// Returns the size of a table with `level_count` levels for `mesh_count` meshes.
+    pub fn size(level_count: usize, mesh_count: usize) usize {
+        return @sizeOf(Header) + level_count * @sizeOf(Level) + level_count * mesh_count * @sizeOf(Range);
+    }
+};
+
+/// Optional table of bounding volumes in model space. It is appended after the level of
+/// detail table if there is one, otherwise after the mesh list (static models) or the
+/// bone list (dynamic models). Dynamic models store the bounds of the bind pose.
+pub const bounds_table = struct {
+    pub const magic = [4]u8{ 'Z', 'B', 'N', 'D' };
+
+    comptime {
+        if (@sizeOf(Header) != 8) @compileError("Header must have 8 byte!");
+        if (@sizeOf(Bounds) != 40) @compileError("Bounds must have 40 byte!");
+    }
+
+    // size: 8
+    pub const Header = extern struct {
+        magic: [4]u8 = magic,
+        mesh_count: u32,
+    };
+
+    // size: 40
+    pub const Bounds = extern struct {
+        min: [3]f32,
+        max: [3]f32,
+        center: [3]f32,
+        radius: f32,
+
+        /// Computes the bounds of `count` points, where `context.position(i)` returns the `i`th point.
+        /// The sphere is centered on the box, which is cheap and close to minimal for most meshes.
+        pub fn compute(context: anytype, count: usize) Bounds {
+            if (count == 0) {
+                return Bounds{ .min = .{ 0, 0, 0 }, .max = .{ 0, 0, 0 }, .center = .{ 0, 0, 0 }, .radius = 0 };
+            }
+
+            var bounds = Bounds{
+                .min = context.position(0),
+                .max = context.position(0),
+                .center = undefined,
+                .radius = 0,
+            };
+            var i: usize = 1;
+            while (i < count) : (i += 1) {
+                const pos = context.position(i);
+                for (pos) |v, j| {
+                    bounds.min[j] = std.math.min(bounds.min[j], v);
+                    bounds.max[j] = std.math.max(bounds.max[j], v);
+                }
+            }
+
+            for (bounds.center) |*c, j| {
+                c.* = 0.5 * (bounds.min[j] + bounds.max[j]);
+            }
+
+            var radius_sq: f32 = 0;
+            i = 0;
+            while (i < count) : (i += 1) {
+                const pos = context.position(i);
+                const d = [3]f32{ pos[0] - bounds.center[0], pos[1] - bounds.center[1], pos[2] - bounds.center[2] };
+                radius_sq = std.math.max(radius_sq, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            }
+            bounds.radius = @sqrt(radius_sq);
+
+            return bounds;
+        }
+    };
+
+    /// Returns the size of a table for `mesh_count` meshes. The first entry bounds the
+    /// whole model, followed by one entry per mesh.
+    pub fn size(mesh_count: usize) usize {
+        return @sizeOf(Header) + (mesh_count + 1) * @sizeOf(Bounds);
+    }
+};
+
+test "quantized vertex roundtrip" {
+    const vertices = [_]static_model.Vertex{
+        .{ .x = -1, .y = 2, .z = 0.5, .nx = 0, .ny = 0, .nz = -1, .u = 0, .v = 1 },
+        .{ .x = 3, .y = -4, .z = 0, .nx = 0.6, .ny = 0, .nz = 0.8, .u = 2, .v = -1 },
+    };
+    const bounds = quantized_static_model.Bounds.compute(&vertices);
+
+    for (vertices) |src| {
+        const dst = quantized_static_model.decodeVertex(bounds, quantized_static_model.encodeVertex(bounds, src));
+        try std.testing.expectApproxEqAbs(src.x, dst.x, 1e-3);
+        try std.testing.expectApproxEqAbs(src.y, dst.y, 1e-3);
+        try std.testing.expectApproxEqAbs(src.z, dst.z, 1e-3);
+        try std.testing.expectApproxEqAbs(src.nx, dst.nx, 1e-3);
+        try std.testing.expectApproxEqAbs(src.ny, dst.ny, 1e-3);
+        try std.testing.expectApproxEqAbs(src.nz, dst.nz, 1e-3);
+        try std.testing.expectApproxEqAbs(src.u, dst.u, 1e-3);
+        try std.testing.expectApproxEqAbs(src.v, dst.v, 1e-3);
+    }
+}
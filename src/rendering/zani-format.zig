@@ -0,0 +1,54 @@
+//! The zani animation format. See `documentation/zani.md`.
+const std = @import("std");
+
+pub const magic_number = [4]u8{ 'Z', 'A', 'N', 'I' };
+pub const version = 1;
+
+comptime {
+    if (@sizeOf(Header) != 16) @compileError("Header must have 16 byte!");
+    if (@sizeOf(Channel) != 64) @compileError("Channel must have 64 byte!");
+    if (@sizeOf(VectorKey) != 16) @compileError("VectorKey must have 16 byte!");
+    if (@sizeOf(QuaternionKey) != 20) @compileError("QuaternionKey must have 20 byte!");
+}
+
+// size: 16
+pub const Header = extern struct {
+    magic: [4]u8 = magic_number,
+    version: u16 = std.mem.nativeToLittle(u16, version),
+    _pad0: u16 = undefined,
+    /// length of the animation in seconds
+    duration: f32,
+    channel_count: u32,
+};
+
+/// Each channel is followed by its position, rotation and scale keys.
+// size: 64
+pub const Channel = extern struct {
+    bone_name: [52]u8, // NUL padded
+    position_count: u32,
+    rotation_count: u32,
+    scale_count: u32,
+
+    /// Returns the number of bytes the channel and its keys occupy in the file.
+    pub fn size(self: Channel) usize {
+        return @sizeOf(Channel) +
+            @sizeOf(VectorKey) * @as(usize, std.mem.littleToNative(u32, self.position_count)) +
+            @sizeOf(QuaternionKey) * @as(usize, std.mem.littleToNative(u32, self.rotation_count)) +
+            @sizeOf(VectorKey) * @as(usize, std.mem.littleToNative(u32, self.scale_count));
+    }
+};
+
+// size: 16
+pub const VectorKey = extern struct {
+    /// time in seconds
+    time: f32,
+    value: [3]f32,
+};
+
+// size: 20
+pub const QuaternionKey = extern struct {
+    /// time in seconds
+    time: f32,
+    /// x, y, z, w
+    value: [4]f32,
+};
@@ -21,6 +21,24 @@ const c = struct {
         height: f32,
     };
     pub const ZigColor = u32;
+    pub const ZigDrawCommand = extern struct {
+        kind: u32,
+        color: ZigColor,
+        rect: ZigRect,
+        font: ?*ZigFont,
+        text_offset: u32,
+        text_length: u32,
+    };
+    pub const ZigDrawList = extern struct {
+        commands: ?[*]const ZigDrawCommand,
+        command_count: usize,
+        text: ?[*]const u8,
+        text_length: usize,
+    };
+    pub const DRAW_FILL_RECTANGLE: u32 = 0;
+    pub const DRAW_RECTANGLE: u32 = 1;
+    pub const DRAW_STRING: u32 = 2;
+    pub const DRAW_SET_CLIP: u32 = 3;
     pub const ZigEditorInterface = extern struct {
         createFont: ?*const fn (*ZigEditorInterface, [*:0]const u8, f32) callconv(.C) ?*ZigFont,
         destroyFont: ?*const fn (*ZigEditorInterface, ?*ZigFont) callconv(.C) void,
@@ -30,10 +48,9 @@ const c = struct {
         getFontCharWidth: ?*const fn (*ZigEditorInterface, ?*ZigFont, u32) callconv(.C) f32,
         measureStringWidth: ?*const fn (*ZigEditorInterface, ?*ZigFont, [*]const u8, usize) callconv(.C) f32,
         measureCharPositions: ?*const fn (*ZigEditorInterface, ?*ZigFont, [*]const u8, usize, [*]f32) callconv(.C) void,
-        drawString: ?*const fn (*ZigEditorInterface, *const ZigRect, ?*ZigFont, ZigColor, [*]const u8, usize) callconv(.C) void,
-        drawRectangle: ?*const fn (*ZigEditorInterface, *const ZigRect, ZigColor) callconv(.C) void,
-        fillRectangle: ?*const fn (*ZigEditorInterface, *const ZigRect, ZigColor) callconv(.C) void,
-        setClipRect: ?*const fn (*ZigEditorInterface, *const ZigRect) callconv(.C) void,
+        getFontAdvanceTable: ?*const fn (*ZigEditorInterface, ?*ZigFont, [*]f32) callconv(.C) void,
+        measureCodepoints: ?*const fn (*ZigEditorInterface, ?*ZigFont, [*]const u32, usize, [*]f32) callconv(.C) void,
+        renderDrawList: ?*const fn (*ZigEditorInterface, *const ZigDrawList) callconv(.C) void,
         setClipboardContent: ?*const fn (*ZigEditorInterface, [*]const u8, usize) callconv(.C) void,
         getClipboardContent: ?*const fn (*ZigEditorInterface, [*]u8, usize) callconv(.C) usize,
         sendNotification: ?*const fn (*ZigEditorInterface, notification: u32) callconv(.C) void,
@@ -50,6 +67,7 @@ const c = struct {
     pub const LogLevel = c_uint;
 
     pub const NOTIFY_CHANGE = 1;
+    pub const FONT_ADVANCE_TABLE_SIZE = 128;
 
     pub extern fn scintilla_init(...) void;
     pub extern fn scintilla_deinit(...) void;
@@ -58,6 +76,7 @@ const c = struct {
     pub extern fn scintilla_getText(editor: ?*ScintillaEditor, allocator: ?*anyopaque) ZigString;
     pub extern fn scintilla_tick(editor: ?*ScintillaEditor) void;
     pub extern fn scintilla_render(editor: ?*ScintillaEditor) void;
+    pub extern fn scintilla_needsRepaint(editor: ?*ScintillaEditor) bool;
     pub extern fn scintilla_setFocus(editor: ?*ScintillaEditor, focused: bool) void;
     pub extern fn scintilla_mouseMove(editor: ?*ScintillaEditor, x: c_int, y: c_int) void;
     pub extern fn scintilla_mouseDown(editor: ?*ScintillaEditor, time: f32, x: c_int, y: c_int) void;
@@ -114,6 +133,12 @@ pub fn tick(editor: *CodeEditor) void {
     c.scintilla_tick(editor.instance);
 }
 
+/// Returns whether the editor looks different than after the last `render`, for example
+/// because the text changed or the caret blinked.
+pub fn needsRepaint(editor: *CodeEditor) bool {
+    return c.scintilla_needsRepaint(editor.instance);
+}
+
 pub fn render(editor: *CodeEditor) void {
     c.scintilla_render(editor.instance);
 }
@@ -169,10 +194,9 @@ const default_editor_impl = c.ZigEditorInterface{
     .getFontCharWidth = getFontCharWidth,
     .measureStringWidth = measureStringWidth,
     .measureCharPositions = measureCharPositions,
-    .drawRectangle = drawRectangle,
-    .fillRectangle = fillRectangle,
-    .drawString = drawString,
-    .setClipRect = setClipRect,
+    .getFontAdvanceTable = getFontAdvanceTable,
+    .measureCodepoints = measureCodepoints,
+    .renderDrawList = renderDrawList,
     .setClipboardContent = setClipboardContent,
     .getClipboardContent = getClipboardContent,
     .sendNotification = sendNotification,
@@ -284,9 +308,13 @@ fn getFontLineGap(zedit: PZigEditor, font_ptr: ?*c.ZigFont) callconv(.C) f32 {
 
 fn getFontCharWidth(zedit: PZigEditor, font_ptr: ?*c.ZigFont, char: u32) callconv(.C) f32 {
     const self = getEditor(zedit);
-    const font = getFont(font_ptr);
+    return self.getAdvance(getFont(font_ptr), char);
+}
 
-    const glyph = self.renderer.getGlyph(font, @truncate(u21, char)) catch return 0.0;
+fn getAdvance(editor: *CodeEditor, font: *const Renderer.Font, codepoint: u32) f32 {
+    if (codepoint > std.math.maxInt(u21))
+        return 0.0;
+    const glyph = editor.renderer.getGlyph(font, @intCast(u21, codepoint)) catch return 0.0;
     return font.scaleValue(glyph.advance_width);
 }
 
@@ -299,31 +327,56 @@ fn measureStringWidth(zedit: PZigEditor, font_ptr: ?*c.ZigFont, str: [*]const u8
     return @intToFloat(f32, size.width);
 }
 
+/// Fallback when the C++ side has no advance table for `font_ptr`. Invalid sequences
+/// are measured byte by byte as U+FFFD.
 fn measureCharPositions(zedit: PZigEditor, font_ptr: ?*c.ZigFont, str: [*]const u8, length: usize, positions: [*]f32) callconv(.C) void {
     const self = getEditor(zedit);
     const font = getFont(font_ptr);
-
-    var view = std.unicode.Utf8View.init(str[0..length]) catch @panic("invalid utf8 detected!");
+    const text = str[0..length];
 
     var glyph_offset: f32 = 0.0;
     var str_offset: usize = 0;
 
-    // log.debug("measureCharPositions(\"{s}\")", .{view.bytes});
-
-    var iter = view.iterator();
-    while (iter.nextCodepointSlice()) |slice| {
-        const codepoint = std.unicode.utf8Decode(slice) catch unreachable;
-
-        var glyph = self.renderer.getGlyph(font, codepoint) catch continue;
-
-        glyph_offset += font.scaleValue(glyph.advance_width);
-        for (slice) |_| {
+    // log.debug("measureCharPositions(\"{s}\")", .{text});
+
+    while (str_offset < text.len) {
+        var char_len: usize = 1;
+        var codepoint: u21 = 0xFFFD;
+        if (std.unicode.utf8ByteSequenceLength(text[str_offset])) |seq_len| {
+            if (str_offset + seq_len <= text.len) {
+                if (std.unicode.utf8Decode(text[str_offset .. str_offset + seq_len])) |value| {
+                    char_len = seq_len;
+                    codepoint = value;
+                } else |_| {}
+            }
+        } else |_| {}
+
+        glyph_offset += self.getAdvance(font, codepoint);
+        for (text[str_offset .. str_offset + char_len]) |_| {
             positions[str_offset] = glyph_offset;
             str_offset += 1;
         }
     }
 }
 
+fn getFontAdvanceTable(zedit: PZigEditor, font_ptr: ?*c.ZigFont, advances: [*]f32) callconv(.C) void {
+    const self = getEditor(zedit);
+    const font = getFont(font_ptr);
+
+    for (advances[0..c.FONT_ADVANCE_TABLE_SIZE]) |*advance, codepoint| {
+        advance.* = self.getAdvance(font, @intCast(u32, codepoint));
+    }
+}
+
+fn measureCodepoints(zedit: PZigEditor, font_ptr: ?*c.ZigFont, codepoints: [*]const u32, count: usize, advances: [*]f32) callconv(.C) void {
+    const self = getEditor(zedit);
+    const font = getFont(font_ptr);
+
+    for (codepoints[0..count]) |codepoint, i| {
+        advances[i] = self.getAdvance(font, codepoint);
+    }
+}
+
 fn patchRect(editor: *CodeEditor, rect: Rectangle) Rectangle {
     return Rectangle{
         .x = editor.position.x + rect.x,
@@ -333,33 +386,147 @@ fn patchRect(editor: *CodeEditor, rect: Rectangle) Rectangle {
     };
 }
 
-fn drawRectangle(zedit: PZigEditor, rect: *const c.ZigRect, color: c.ZigColor) callconv(.C) void {
+fn renderDrawList(zedit: PZigEditor, list: *const c.ZigDrawList) callconv(.C) void {
     const self = getEditor(zedit);
+    const commands = if (list.commands) |commands| commands[0..list.command_count] else return;
+
+    // The draw list sets its own clip rectangles. They go onto a stack entry of their own,
+    // so the clip of whatever is drawn after the editor is restored when the list ends.
+    self.renderer.pushClipRectangle(self.position) catch return;
+    defer self.renderer.popClipRectangle() catch {};
 
-    self.renderer.drawRectangle(self.patchRect(getRect(rect.*)), getColor(color)) catch {};
+    var batcher = DrawBatcher{
+        .editor = self,
+        .text = if (list.text) |text| text[0..list.text_length] else "",
+    };
+    for (commands) |command| {
+        switch (command.kind) {
+            c.DRAW_FILL_RECTANGLE => batcher.fillRectangle(command.rect, command.color),
+            c.DRAW_STRING => batcher.drawString(command),
+            c.DRAW_RECTANGLE => {
+                batcher.flush();
+                self.renderer.drawRectangle(self.patchRect(getRect(command.rect)), getColor(command.color)) catch {};
+            },
+            c.DRAW_SET_CLIP => {
+                batcher.flush();
+                self.renderer.setClipRectangle(self.patchRect(getRect(command.rect))) catch {};
+            },
+            else => log.warn("unknown draw command {}", .{command.kind}),
+        }
+    }
+    batcher.flush();
 }
 
-fn fillRectangle(zedit: PZigEditor, rect: *const c.ZigRect, color: c.ZigColor) callconv(.C) void {
-    const self = getEditor(zedit);
+/// Feeds a draw list into the renderer, merging what Scintilla paints piece by piece.
+/// One fill and one string are held back: a fill absorbs following fills of the same
+/// color that extend it to a larger rectangle, a string absorbs the runs that continue it
+/// on the same line. Fills that don't overlap the held string may be drawn before it, so
+/// the per-token background and text pairs of a line collapse into one of each.
+const DrawBatcher = struct {
+    editor: *CodeEditor,
+    text: []const u8,
 
-    self.renderer.fillRectangle(self.patchRect(getRect(rect.*)), getColor(color)) catch {};
-}
+    /// Always drawn before `string`.
+    fill: ?Fill = null,
+    string: ?String = null,
 
-fn drawString(zedit: PZigEditor, rect: *const c.ZigRect, font_ptr: ?*c.ZigFont, color: c.ZigColor, str: [*]const u8, length: usize) callconv(.C) void {
-    const self = getEditor(zedit);
-    const font = getFont(font_ptr);
-    const dst_rect = self.patchRect(getRect(rect.*));
-    const dst_color = getColor(color);
+    const Fill = struct {
+        rect: c.ZigRect,
+        color: c.ZigColor,
+    };
 
-    self.renderer.drawString(font, str[0..length], dst_rect.x, dst_rect.y, dst_color) catch {};
-}
+    const String = struct {
+        rect: c.ZigRect,
+        color: c.ZigColor,
+        font: ?*c.ZigFont,
+        start: usize,
+        end: usize,
+    };
 
-fn setClipRect(zedit: PZigEditor, zrect: *const c.ZigRect) callconv(.C) void {
-    const self = getEditor(zedit);
-    const rect = getRect(zrect.*);
+    fn fillRectangle(batcher: *DrawBatcher, rect: c.ZigRect, color: c.ZigColor) void {
+        if (batcher.string) |string| {
+            if (overlaps(string.rect, rect))
+                batcher.flush();
+        }
+        if (batcher.fill) |*fill| {
+            if (fill.color == color) {
+                if (mergeRects(fill.rect, rect)) |merged| {
+                    fill.rect = merged;
+                    return;
+                }
+            }
+            batcher.drawFill(fill.*);
+        }
+        batcher.fill = Fill{ .rect = rect, .color = color };
+    }
 
-    self.renderer.setClipRectangle(rect) catch {};
-}
+    fn drawString(batcher: *DrawBatcher, command: c.ZigDrawCommand) void {
+        const start = std.math.min(@as(usize, command.text_offset), batcher.text.len);
+        const end = std.math.min(start + command.text_length, batcher.text.len);
+
+        if (batcher.string) |*string| {
+            const continues = (string.font == command.font) and
+                (string.color == command.color) and
+                (string.end == start) and
+                (string.rect.y == command.rect.y) and
+                (string.rect.height == command.rect.height) and
+                (string.rect.x + string.rect.width == command.rect.x);
+            if (continues) {
+                string.rect.width += command.rect.width;
+                string.end = end;
+                return;
+            }
+            batcher.flush();
+        }
+        batcher.string = String{
+            .rect = command.rect,
+            .color = command.color,
+            .font = command.font,
+            .start = start,
+            .end = end,
+        };
+    }
+
+    fn flush(batcher: *DrawBatcher) void {
+        if (batcher.fill) |fill| {
+            batcher.drawFill(fill);
+        }
+        if (batcher.string) |string| {
+            const editor = batcher.editor;
+            const rect = editor.patchRect(getRect(string.rect));
+            editor.renderer.drawString(getFont(string.font), batcher.text[string.start..string.end], rect.x, rect.y, getColor(string.color)) catch {};
+        }
+        batcher.fill = null;
+        batcher.string = null;
+    }
+
+    fn drawFill(batcher: *DrawBatcher, fill: Fill) void {
+        const editor = batcher.editor;
+        editor.renderer.fillRectangle(editor.patchRect(getRect(fill.rect)), getColor(fill.color)) catch {};
+    }
+
+    fn overlaps(a: c.ZigRect, b: c.ZigRect) bool {
+        return (a.x < b.x + b.width) and (b.x < a.x + a.width) and
+            (a.y < b.y + b.height) and (b.y < a.y + a.height);
+    }
+
+    /// Returns the union of `a` and `b` when they share an edge completely.
+    fn mergeRects(a: c.ZigRect, b: c.ZigRect) ?c.ZigRect {
+        if (a.y == b.y and a.height == b.height) {
+            if (a.x + a.width == b.x)
+                return c.ZigRect{ .x = a.x, .y = a.y, .width = a.width + b.width, .height = a.height };
+            if (b.x + b.width == a.x)
+                return c.ZigRect{ .x = b.x, .y = a.y, .width = a.width + b.width, .height = a.height };
+        }
+        if (a.x == b.x and a.width == b.width) {
+            if (a.y + a.height == b.y)
+                return c.ZigRect{ .x = a.x, .y = a.y, .width = a.width, .height = a.height + b.height };
+            if (b.y + b.height == a.y)
+                return c.ZigRect{ .x = a.x, .y = b.y, .width = a.width, .height = a.height + b.height };
+        }
+        return null;
+    }
+};
 
 fn setClipboardContent(zedit: PZigEditor, str: [*]const u8, length: usize) callconv(.C) void {
     _ = zedit;
@@ -12,6 +12,7 @@
 #include <vector>
 #include <cmath>
 #include <map>
+#include <unordered_map>
 #include <array>
 #include <string>
 
@@ -234,6 +235,80 @@ void Platform::DebugPrintf(const char *, ...) {
 //////////////////////////////////////////////////////////////////////////
 // FONT
 
+// Glyph advances of a single font. ASCII is fetched once when the font is
+// created, all other codepoints are requested in batches the first time they
+// are measured, so MeasureWidths only calls into Zig for unseen codepoints.
+struct FontAdvances {
+  std::array<float, FONT_ADVANCE_TABLE_SIZE> table;
+  std::unordered_map<uint32_t, float> codepoints;
+
+  // scratch buffers for MeasureWidths
+  std::vector<uint32_t> missing;
+  std::vector<float> missing_advances;
+
+  void MeasureWidths(ZigFont *font, unsigned char const *str, int len, float *positions);
+};
+
+static std::map<ZigFont *, FontAdvances> font_advances;
+
+static bool has_advance_api(ZigEditorInterface *app) {
+  return (app->getFontAdvanceTable != nullptr) && (app->measureCodepoints != nullptr);
+}
+
+// Decodes the character at `str` and stores its length in `width`.
+// Invalid sequences are a single byte wide and decode to U+FFFD.
+static uint32_t decode_utf8(unsigned char const *str, int len, int *width) {
+  if (str[0] < 0x80) {
+    *width = 1;
+    return str[0];
+  }
+  int const classified = UTF8Classify(str, len);
+  if (classified & UTF8MaskInvalid) {
+    *width = 1;
+    return unicodeReplacementChar;
+  }
+  *width = classified & UTF8MaskWidth;
+  switch (*width) {
+  case 2:
+    return ((str[0] & 0x1FU) << 6) | (str[1] & 0x3FU);
+  case 3:
+    return ((str[0] & 0x0FU) << 12) | ((str[1] & 0x3FU) << 6) | (str[2] & 0x3FU);
+  default:
+    return ((str[0] & 0x07U) << 18) | ((str[1] & 0x3FU) << 12) | ((str[2] & 0x3FU) << 6) | (str[3] & 0x3FU);
+  }
+}
+
+void FontAdvances::MeasureWidths(ZigFont *font, unsigned char const *str, int len, float *positions) {
+  // Collect all codepoints we haven't seen yet and resolve them with a single call.
+  this->missing.clear();
+  for (int i = 0; i < len;) {
+    int width;
+    uint32_t const codepoint = decode_utf8(str + i, len - i, &width);
+    if (codepoint >= FONT_ADVANCE_TABLE_SIZE && this->codepoints.emplace(codepoint, 0.0f).second) {
+      this->missing.push_back(codepoint);
+    }
+    i += width;
+  }
+  if (!this->missing.empty()) {
+    this->missing_advances.resize(this->missing.size());
+    current_app()->measureCodepoints(current_app(), font, this->missing.data(), this->missing.size(), this->missing_advances.data());
+    for (size_t i = 0; i < this->missing.size(); i++) {
+      this->codepoints[this->missing[i]] = this->missing_advances[i];
+    }
+  }
+
+  float x = 0.0f;
+  for (int i = 0; i < len;) {
+    int width;
+    uint32_t const codepoint = decode_utf8(str + i, len - i, &width);
+    x += (codepoint < FONT_ADVANCE_TABLE_SIZE) ? this->table[codepoint] : this->codepoints[codepoint];
+    for (int j = 0; j < width; j++) {
+      positions[i + j] = x;
+    }
+    i += width;
+  }
+}
+
 Font::Font() : fid(0) {
 }
 
@@ -243,15 +318,57 @@ Font::~Font() {
 void Font::Create(const FontParameters &fp) {
   log_debug("Font::Create(%s, %.3f, %d, %d)", fp.faceName, fp.size, fp.italic, fp.weight);
   // TODO: Implement font weight
-  this->fid = current_app()->createFont(current_app(), fp.faceName, fp.size);
+  auto const font = current_app()->createFont(current_app(), fp.faceName, fp.size);
+  this->fid = font;
+
+  if (font != nullptr && has_advance_api(current_app())) {
+    auto &advances = font_advances[font];
+    advances.codepoints.clear();
+    current_app()->getFontAdvanceTable(current_app(), font, advances.table.data());
+  }
 }
 
 void Font::Release() {
   if (this->fid != nullptr) {
+    font_advances.erase(static_cast<ZigFont *>(this->fid));
     current_app()->destroyFont(current_app(), static_cast<ZigFont *>(this->fid));
   }
 }
 
+//////////////////////////////////////////////////////////////////////////
+// DRAW LIST
+
+// Records the draw operations of a surface so a whole repaint crosses into
+// Zig with a single renderDrawList call.
+struct DrawList {
+  std::vector<ZigDrawCommand> commands;
+  std::vector<char> text;
+
+  void Clear() {
+    this->commands.clear();
+    this->text.clear();
+  }
+
+  void Push(ZigDrawCommandType type, PRectangle rc, ColourDesired color) {
+    this->commands.push_back(ZigDrawCommand{uint32_t(type), cpp2zig(color), cpp2zig(rc), nullptr, 0, 0});
+  }
+
+  void PushString(PRectangle rc, ZigFont *font, ColourDesired color, const char *str, int len) {
+    auto const offset = this->text.size();
+    this->text.insert(this->text.end(), str, str + len);
+    this->commands.push_back(ZigDrawCommand{uint32_t(DRAW_STRING), cpp2zig(color), cpp2zig(rc), font, uint32_t(offset), uint32_t(len)});
+  }
+
+  ZigDrawList Get() const {
+    return ZigDrawList{
+        this->commands.data(),
+        this->commands.size(),
+        this->text.data(),
+        this->text.size(),
+    };
+  }
+};
+
 //////////////////////////////////////////////////////////////////////////
 // SURFACE
 
@@ -259,6 +376,7 @@ void Font::Release() {
 namespace Scintilla {
 #endif
 struct SurfaceImpl : public Surface {
+  DrawList drawList;
   ColourDesired penColour;
   float currentX;
   float currentY;
@@ -349,10 +467,12 @@ void SurfaceImpl::InitPixMap(int width, int height, Surface *surface, WindowID w
   UNUSED(height);
   UNUSED(surface);
   UNUSED(wid);
+  this->drawList.Clear();
   this->initialised = true;
 }
 
 void SurfaceImpl::Release() {
+  this->drawList.Clear();
 }
 
 bool SurfaceImpl::Initialised() {
@@ -403,15 +523,12 @@ void SurfaceImpl::Polygon(Point * /*pts*/, int /*npts*/, ColourDesired /*fore*/,
 }
 
 void SurfaceImpl::RectangleDraw(PRectangle rc, ColourDesired fore, ColourDesired back) {
-  auto const temp_rect1 = cpp2zig(rc);
-  current_app()->fillRectangle(current_app(), &temp_rect1, cpp2zig(back));
-  auto const temp_rect2 = cpp2zig(rc);
-  current_app()->drawRectangle(current_app(), &temp_rect2, cpp2zig(fore));
+  this->drawList.Push(DRAW_FILL_RECTANGLE, rc, back);
+  this->drawList.Push(DRAW_RECTANGLE, rc, fore);
 }
 
 void SurfaceImpl::FillRectangle(PRectangle rc, ColourDesired back) {
-  auto const temp_rect = cpp2zig(rc);
-  current_app()->fillRectangle(current_app(), &temp_rect, cpp2zig(back));
+  this->drawList.Push(DRAW_FILL_RECTANGLE, rc, back);
 }
 
 void SurfaceImpl::FillRectangle(PRectangle rc, Surface &surfacePattern) {
@@ -445,14 +562,7 @@ void SurfaceImpl::Copy(PRectangle rc, Point from, Surface &surfaceSource) {
 }
 
 void SurfaceImpl::DrawTextBase(PRectangle rc, Font &font, float ybase, const char *str, int len, ColourDesired fore) {
-  auto const temp_rect = cpp2zig(rc);
-  current_app()->drawString(
-      current_app(),
-      &temp_rect,
-      static_cast<ZigFont *>(font.GetID()),
-      cpp2zig(fore),
-      str,
-      size_t(len));
+  this->drawList.PushString(rc, static_cast<ZigFont *>(font.GetID()), fore, str, len);
 }
 
 void SurfaceImpl::DrawTextNoClip(PRectangle rc, Font &font, float ybase, const char *s, int len,
@@ -474,7 +584,13 @@ void SurfaceImpl::DrawTextTransparent(PRectangle rc, Font &font, float ybase, co
 }
 
 void SurfaceImpl::MeasureWidths(Font &font, const char *str, int len, float *positions) {
-  current_app()->measureCharPositions(current_app(), static_cast<ZigFont *>(font.GetID()), str, size_t(len), positions);
+  auto const zig_font = static_cast<ZigFont *>(font.GetID());
+  auto const advances = font_advances.find(zig_font);
+  if (advances != font_advances.end()) {
+    advances->second.MeasureWidths(zig_font, reinterpret_cast<unsigned char const *>(str), len, positions);
+  } else {
+    current_app()->measureCharPositions(current_app(), zig_font, str, size_t(len), positions);
+  }
 }
 
 float SurfaceImpl::WidthText(Font &font, const char *str, int len) {
@@ -511,7 +627,7 @@ float SurfaceImpl::AverageCharWidth(Font &font) {
 }
 
 void SurfaceImpl::SetClip(PRectangle rc) {
-  // we deal with this in the renderer
+  this->drawList.Push(DRAW_SET_CLIP, rc, ColourDesired());
 }
 
 void SurfaceImpl::FlushCachedState() {
@@ -544,11 +660,17 @@ bool Window::HasFocus() {
 
 static std::map<Scintilla::WindowID, Scintilla::PRectangle> rects;
 
+// Only the main window of an editor has an id, see ScintillaEditor::Initialise.
+static void invalidate_window(Scintilla::WindowID wid);
+
 PRectangle Window::GetPosition() {
   return rects[wid];
 }
 
 void Window::SetPosition(PRectangle rc) {
+  if (!(rects[wid] == rc)) {
+    invalidate_window(wid);
+  }
   rects[wid] = rc;
 }
 
@@ -563,9 +685,11 @@ void Window::Show(bool show) {
 }
 
 void Window::InvalidateAll() {
+  invalidate_window(wid);
 }
 
 void Window::InvalidateRectangle(PRectangle rc) {
+  invalidate_window(wid);
 }
 
 void Window::SetFont(Font &font) {
@@ -631,6 +755,10 @@ const int nOpacity = 0xFF;
 const std::string sFontFile{"SourceCodePro-Regular.ttf"};
 const int nFontSize = 10;
 
+// Scintilla's default of 1024 entries churns on large files; each entry only
+// holds runs shorter than 30 bytes, so this stays small.
+const size_t nPositionCacheSize = 0x4000;
+
 const bool bUseSpacesForTabs = true;
 const int nTabSize = 4;
 
@@ -701,18 +829,21 @@ static char const *const lola_keywords =
 
 struct ScintillaEditor : public Scintilla::Editor {
   ZigEditorInterface *current_app;
-  Scintilla::Surface *surface;
+  Scintilla::SurfaceImpl *surface;
   Scintilla::LexState *lexState;
 
   bool bReadOnly = false;
   bool bHasMouseCapture = false;
 
+  // Set when Scintilla invalidates any part of the window, cleared by Render.
+  bool bNeedsRepaint = true;
+
   ScintillaEditor(ZigEditorInterface *interface) : current_app(interface),
                                                    surface(nullptr),
                                                    lexState(nullptr) {
     log_debug("ScintillaEditor::ScintillaEditor()");
 
-    this->surface = Scintilla::Surface::Allocate(SC_TECHNOLOGY_DEFAULT);
+    this->surface = static_cast<Scintilla::SurfaceImpl *>(Scintilla::Surface::Allocate(SC_TECHNOLOGY_DEFAULT));
     this->surface->Init(nullptr);
 
     this->Initialise();
@@ -727,20 +858,18 @@ struct ScintillaEditor : public Scintilla::Editor {
   }
 
   void Render() {
-    auto const window_pos = this->wMain.GetPosition();
-
     auto rect = this->GetClientRectangle();
 
-    auto clip_rect = rect;
-    clip_rect.left += window_pos.left;
-    clip_rect.right += window_pos.left;
-    clip_rect.top += window_pos.top;
-    clip_rect.bottom += window_pos.top;
+    // Cleared before painting, so invalidations from within Paint ask for another frame.
+    this->bNeedsRepaint = false;
 
-    auto const temp_rect = cpp2zig(clip_rect);
-    current_app->setClipRect(current_app, &temp_rect);
+    this->surface->drawList.Clear();
+    this->surface->SetClip(rect);
 
     this->Paint(this->surface, rect);
+
+    auto const list = this->surface->drawList.Get();
+    current_app->renderDrawList(current_app, &list);
   }
 
   void Initialise() override {
@@ -750,6 +879,7 @@ struct ScintillaEditor : public Scintilla::Editor {
 
     this->WndProc(SCI_SETBUFFEREDDRAW, 0, 0);
     this->WndProc(SCI_SETCODEPAGE, SC_CP_UTF8, 0);
+    this->WndProc(SCI_SETPOSITIONCACHE, nPositionCacheSize, 0);
 
     this->WndProc(SCI_SETWRAPMODE, SC_WRAP_WORD, 0);
 
@@ -1035,6 +1165,12 @@ public:
   }
 };
 
+static void invalidate_window(Scintilla::WindowID wid) {
+  if (wid != nullptr) {
+    reinterpret_cast<ScintillaEditor *>(wid)->bNeedsRepaint = true;
+  }
+}
+
 ScintillaEditor *scintilla_create(ZigEditorInterface *interface) {
   PseudoGlobal<ZigEditorInterface *, EditorInterfaceHack> pseudo_global{interface};
   return new ScintillaEditor(interface);
@@ -1050,6 +1186,10 @@ void scintilla_tick(ScintillaEditor *editor) {
   editor->Tick();
 }
 
+bool scintilla_needsRepaint(ScintillaEditor *editor) {
+  return editor->bNeedsRepaint;
+}
+
 void scintilla_render(ScintillaEditor *editor) {
   PseudoGlobal<ZigEditorInterface *, EditorInterfaceHack> pseudo_global{editor->current_app};
   // Renderer::SetTextRenderingViewport( wMain.GetPosition() );
@@ -15,11 +15,16 @@ extern "C" {
 
 #define NOTIFY_CHANGE (1U << 0)
 
+// Number of codepoints in the advance table returned by getFontAdvanceTable.
+#define FONT_ADVANCE_TABLE_SIZE 128
+
 typedef struct ZigEditorInterface ZigEditorInterface;
 typedef struct ZigFont ZigFont;
 typedef struct ScintillaEditor ScintillaEditor;
 typedef struct ZigRect ZigRect;
 typedef struct ZigString ZigString;
+typedef struct ZigDrawCommand ZigDrawCommand;
+typedef struct ZigDrawList ZigDrawList;
 
 enum LogLevel {
   LOG_DEBUG,
@@ -42,6 +47,32 @@ struct ZigString {
   size_t len;
 };
 
+enum ZigDrawCommandType {
+  DRAW_FILL_RECTANGLE,
+  DRAW_RECTANGLE,
+  DRAW_STRING,
+  DRAW_SET_CLIP,
+};
+typedef enum ZigDrawCommandType ZigDrawCommandType;
+
+// All rectangles are relative to the editor position.
+struct ZigDrawCommand {
+  uint32_t kind; // ZigDrawCommandType
+  ZigColor color;
+  ZigRect rect;
+  ZigFont *font;        // DRAW_STRING only
+  uint32_t text_offset; // DRAW_STRING only, range in ZigDrawList.text
+  uint32_t text_length;
+};
+
+// Everything drawn in a single scintilla_render call, in painting order.
+struct ZigDrawList {
+  ZigDrawCommand const *commands;
+  size_t command_count;
+  char const *text;
+  size_t text_length;
+};
+
 struct ZigEditorInterface {
   ZigFont *(*createFont)(ZigEditorInterface *app, char const *font_name, float size);
   void (*destroyFont)(ZigEditorInterface *app, ZigFont *font);
@@ -54,10 +85,13 @@ struct ZigEditorInterface {
   // render commands
   float (*measureStringWidth)(ZigEditorInterface *app, ZigFont *font, char const *str, size_t length);
   void (*measureCharPositions)(ZigEditorInterface *app, ZigFont *font, char const *str, size_t length, float *positions);
-  void (*drawString)(ZigEditorInterface *app, ZigRect const *rectangle, ZigFont *font, ZigColor color, char const *str, size_t length);
-  void (*drawRectangle)(ZigEditorInterface *app, ZigRect const *rectangle, ZigColor color);
-  void (*fillRectangle)(ZigEditorInterface *app, ZigRect const *rectangle, ZigColor color);
-  void (*setClipRect)(ZigEditorInterface *app, ZigRect const *rectangle);
+
+  // Optional. When both are set, glyph advances are cached on the C++ side and
+  // measureCharPositions is not used anymore.
+  void (*getFontAdvanceTable)(ZigEditorInterface *app, ZigFont *font, float *advances);
+  void (*measureCodepoints)(ZigEditorInterface *app, ZigFont *font, uint32_t const *codepoints, size_t count, float *advances);
+
+  void (*renderDrawList)(ZigEditorInterface *app, ZigDrawList const *list);
 
   void (*setClipboardContent)(ZigEditorInterface *app, char const *str, size_t length);
   size_t (*getClipboardContent)(ZigEditorInterface *app, char *str, size_t max_length);
@@ -74,6 +108,8 @@ void scintilla_setText(ScintillaEditor *editor, char const *string, size_t lengt
 ZigString scintilla_getText(ScintillaEditor *editor, void *allocator);
 void scintilla_tick(ScintillaEditor *editor);
 void scintilla_render(ScintillaEditor *editor);
+// Returns whether the editor looks different than after the last scintilla_render call.
+bool scintilla_needsRepaint(ScintillaEditor *editor);
 
 void scintilla_mouseMove(ScintillaEditor *editor, int x, int y);
 void scintilla_mouseDown(ScintillaEditor *editor, float time, int x, int y);
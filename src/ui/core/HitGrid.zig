@@ -0,0 +1,344 @@
+const std = @import("std");
+
+/// An axis aligned rectangle in pixels. `min` is inclusive, `max` exclusive.
+pub const Box = struct {
+    min_x: i32,
+    min_y: i32,
+    max_x: i32,
+    max_y: i32,
+
+    pub const empty = Box{ .min_x = 0, .min_y = 0, .max_x = 0, .max_y = 0 };
+
+    pub fn new(x: i32, y: i32, width: i32, height: i32) Box {
+        return Box{ .min_x = x, .min_y = y, .max_x = x + width, .max_y = y + height };
+    }
+
+    pub fn isEmpty(box: Box) bool {
+        return box.max_x <= box.min_x or box.max_y <= box.min_y;
+    }
+
+    pub fn contains(box: Box, x: i32, y: i32) bool {
+        return x >= box.min_x and y >= box.min_y and x < box.max_x and y < box.max_y;
+    }
+
+    pub fn intersect(a: Box, b: Box) Box {
+        return Box{
+            .min_x = std.math.max(a.min_x, b.min_x),
+            .min_y = std.math.max(a.min_y, b.min_y),
+            .max_x = std.math.min(a.max_x, b.max_x),
+            .max_y = std.math.min(a.max_y, b.max_y),
+        };
+    }
+
+    pub fn eql(a: Box, b: Box) bool {
+        return std.meta.eql(a, b);
+    }
+};
+
+/// A spatial index that finds the topmost item at a point.
+/// Items are kept in the order they were appended, which is their z-order: later items
+/// are above earlier ones. Each item is stored in all cells of a uniform grid it overlaps,
+/// items that would cover more than `max_item_cells` cells are kept in a separate list that
+/// is searched by every query.
+///
+/// When a function returns an error, the grid must be cleared before it is used again.
+pub fn HitGrid(comptime Item: type) type {
+    return struct {
+        const Grid = @This();
+
+        /// Width and height of a cell in pixels.
+        pub const cell_size = 64;
+
+        /// Items covering more cells are stored in `large` instead.
+        pub const max_item_cells = 64;
+
+        const Entry = struct {
+            item: Item,
+            box: Box,
+        };
+
+        /// All items in z-order.
+        entries: std.ArrayListUnmanaged(Entry) = .{},
+
+        /// Indices into `entries` of the items overlapping each cell in z-order, keyed by `cellKey`.
+        cells: std.AutoHashMapUnmanaged(u32, std.ArrayListUnmanaged(u32)) = .{},
+
+        /// Indices into `entries` of the items covering too many cells in z-order.
+        large: std.ArrayListUnmanaged(u32) = .{},
+
+        pub fn deinit(grid: *Grid, allocator: std.mem.Allocator) void {
+            var it = grid.cells.valueIterator();
+            while (it.next()) |cell| {
+                cell.deinit(allocator);
+            }
+            grid.cells.deinit(allocator);
+            grid.entries.deinit(allocator);
+            grid.large.deinit(allocator);
+            grid.* = undefined;
+        }
+
+        /// Removes all items, but keeps the memory of the cells.
+        pub fn clear(grid: *Grid) void {
+            var it = grid.cells.valueIterator();
+            while (it.next()) |cell| {
+                cell.shrinkRetainingCapacity(0);
+            }
+            grid.entries.shrinkRetainingCapacity(0);
+            grid.large.shrinkRetainingCapacity(0);
+        }
+
+        pub fn len(grid: Grid) usize {
+            return grid.entries.items.len;
+        }
+
+        pub fn get(grid: Grid, index: usize) Item {
+            return grid.entries.items[index].item;
+        }
+
+        /// Adds `item` above all other items.
+        pub fn append(grid: *Grid, allocator: std.mem.Allocator, item: Item, box: Box) !void {
+            const index = @intCast(u32, grid.entries.items.len);
+            try grid.entries.append(allocator, Entry{ .item = item, .box = box });
+            try grid.insert(allocator, index);
+        }
+
+        /// Moves the item at `index` to `box`, keeping its place in the z-order.
+        pub fn setBox(grid: *Grid, allocator: std.mem.Allocator, index: usize, box: Box) !void {
+            const entry = &grid.entries.items[index];
+            if (entry.box.eql(box))
+                return;
+
+            grid.erase(@intCast(u32, index));
+            entry.box = box;
+            try grid.insert(allocator, @intCast(u32, index));
+        }
+
+        /// Removes all items from `new_len` on.
+        pub fn shrink(grid: *Grid, new_len: usize) void {
+            var index = grid.entries.items.len;
+            while (index > new_len) {
+                index -= 1;
+                grid.erase(@intCast(u32, index));
+            }
+            grid.entries.shrinkRetainingCapacity(new_len);
+        }
+
+        /// Replaces the item at `index`, or appends it if `index` is the end of the list.
+        /// Items above `index` are removed if they are different, so calling this for all items
+        /// in z-order and then `shrink` keeps all unchanged items in place.
+        pub fn sync(grid: *Grid, allocator: std.mem.Allocator, index: usize, item: Item, box: Box) !void {
+            if (index < grid.entries.items.len) {
+                if (grid.entries.items[index].item == item) {
+                    return grid.setBox(allocator, index, box);
+                }
+                grid.shrink(index);
+            }
+            try grid.append(allocator, item, box);
+        }
+
+        /// Returns the topmost item whose box contains the point and which `accept`s.
+        pub fn find(grid: Grid, x: i32, y: i32, context: anytype, comptime accept: fn (@TypeOf(context), Item) bool) ?Item {
+            var best: ?u32 = null;
+            if (grid.cells.get(cellKey(cellCoord(x), cellCoord(y)))) |cell| {
+                best = grid.topmost(cell.items, x, y, 0, context, accept);
+            }
+            const min_large = if (best) |index| index + 1 else 0;
+            if (grid.topmost(grid.large.items, x, y, min_large, context, accept)) |index| {
+                best = index;
+            }
+            return if (best) |index| grid.entries.items[index].item else null;
+        }
+
+        fn topmost(grid: Grid, indices: []const u32, x: i32, y: i32, min_index: u32, context: anytype, comptime accept: fn (@TypeOf(context), Item) bool) ?u32 {
+            var i = indices.len;
+            while (i > 0) {
+                i -= 1;
+                const index = indices[i];
+                if (index < min_index)
+                    return null;
+                const entry = grid.entries.items[index];
+                if (entry.box.contains(x, y) and accept(context, entry.item))
+                    return index;
+            }
+            return null;
+        }
+
+        const CellRange = struct {
+            min_x: i32,
+            min_y: i32,
+            max_x: i32,
+            max_y: i32,
+
+            fn count(range: CellRange) i64 {
+                return @as(i64, range.max_x - range.min_x + 1) * @as(i64, range.max_y - range.min_y + 1);
+            }
+        };
+
+        fn cellRange(box: Box) CellRange {
+            return CellRange{
+                .min_x = cellCoord(box.min_x),
+                .min_y = cellCoord(box.min_y),
+                .max_x = cellCoord(box.max_x - 1),
+                .max_y = cellCoord(box.max_y - 1),
+            };
+        }
+
+        fn cellCoord(v: i32) i32 {
+            return @divFloor(v, cell_size);
+        }
+
+        fn cellKey(x: i32, y: i32) u32 {
+            return ((@bitCast(u32, x) & 0xFFFF) << 16) | (@bitCast(u32, y) & 0xFFFF);
+        }
+
+        fn insert(grid: *Grid, allocator: std.mem.Allocator, index: u32) !void {
+            const box = grid.entries.items[index].box;
+            if (box.isEmpty())
+                return;
+
+            const range = cellRange(box);
+            if (range.count() > max_item_cells) {
+                return insertSorted(&grid.large, allocator, index);
+            }
+
+            var y = range.min_y;
+            while (y <= range.max_y) : (y += 1) {
+                var x = range.min_x;
+                while (x <= range.max_x) : (x += 1) {
+                    const cell = try grid.cells.getOrPut(allocator, cellKey(x, y));
+                    if (!cell.found_existing) {
+                        cell.value_ptr.* = .{};
+                    }
+                    try insertSorted(cell.value_ptr, allocator, index);
+                }
+            }
+        }
+
+        fn erase(grid: *Grid, index: u32) void {
+            const box = grid.entries.items[index].box;
+            if (box.isEmpty())
+                return;
+
+            const range = cellRange(box);
+            if (range.count() > max_item_cells) {
+                return removeSorted(&grid.large, index);
+            }
+
+            var y = range.min_y;
+            while (y <= range.max_y) : (y += 1) {
+                var x = range.min_x;
+                while (x <= range.max_x) : (x += 1) {
+                    if (grid.cells.getPtr(cellKey(x, y))) |cell| {
+                        removeSorted(cell, index);
+                    }
+                }
+            }
+        }
+
+        fn insertSorted(list: *std.ArrayListUnmanaged(u32), allocator: std.mem.Allocator, index: u32) !void {
+            // items are mostly appended in z-order
+            if (list.items.len == 0 or list.items[list.items.len - 1] < index) {
+                return list.append(allocator, index);
+            }
+            try list.insert(allocator, lowerBound(list.items, index), index);
+        }
+
+        fn removeSorted(list: *std.ArrayListUnmanaged(u32), index: u32) void {
+            const pos = lowerBound(list.items, index);
+            if (pos < list.items.len and list.items[pos] == index) {
+                _ = list.orderedRemove(pos);
+            }
+        }
+
+        /// Returns the position of the first element in `items` that is not less than `index`.
+        fn lowerBound(items: []const u32, index: u32) usize {
+            var low: usize = 0;
+            var high: usize = items.len;
+            while (low < high) {
+                const mid = low + (high - low) / 2;
+                if (items[mid] < index) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+            return low;
+        }
+    };
+}
+
+fn acceptAll(_: void, _: u32) bool {
+    return true;
+}
+
+fn acceptEven(_: void, item: u32) bool {
+    return (item % 2) == 0;
+}
+
+test "hit grid: z-order and filtering" {
+    var grid = HitGrid(u32){};
+    defer grid.deinit(std.testing.allocator);
+
+    try grid.append(std.testing.allocator, 0, Box.new(0, 0, 2000, 2000)); // large
+    try grid.append(std.testing.allocator, 1, Box.new(10, 10, 100, 100));
+    try grid.append(std.testing.allocator, 2, Box.new(50, 50, 10, 10));
+    try grid.append(std.testing.allocator, 3, Box.new(55, 55, 10, 10));
+
+    try std.testing.expectEqual(@as(?u32, 3), grid.find(56, 56, {}, acceptAll));
+    try std.testing.expectEqual(@as(?u32, 2), grid.find(56, 56, {}, acceptEven));
+    try std.testing.expectEqual(@as(?u32, 1), grid.find(20, 20, {}, acceptAll));
+    try std.testing.expectEqual(@as(?u32, 0), grid.find(500, 500, {}, acceptAll));
+    try std.testing.expectEqual(@as(?u32, null), grid.find(-1, 5, {}, acceptAll));
+
+    // moving keeps the z-order
+    try grid.setBox(std.testing.allocator, 3, Box.new(1000, 1000, 10, 10));
+    try std.testing.expectEqual(@as(?u32, 2), grid.find(56, 56, {}, acceptAll));
+    try grid.setBox(std.testing.allocator, 1, Box.new(50, 50, 20, 20));
+    try std.testing.expectEqual(@as(?u32, 2), grid.find(56, 56, {}, acceptAll));
+    try std.testing.expectEqual(@as(?u32, 1), grid.find(65, 65, {}, acceptAll));
+
+    // syncing a different item drops everything above it
+    try grid.sync(std.testing.allocator, 2, 7, Box.new(0, 0, 10, 10));
+    try std.testing.expectEqual(@as(usize, 3), grid.len());
+    try std.testing.expectEqual(@as(?u32, 1), grid.find(56, 56, {}, acceptAll));
+    try std.testing.expectEqual(@as(?u32, 0), grid.find(1005, 1005, {}, acceptAll));
+}
+
+test "hit grid: same results as linear search" {
+    const item_count = 1_000;
+    const query_count = 500;
+
+    var prng = std.rand.DefaultPrng.init(0x5EED);
+    const random = prng.random();
+
+    const boxes = try std.testing.allocator.alloc(Box, item_count);
+    defer std.testing.allocator.free(boxes);
+    for (boxes) |*box| {
+        // a dense property grid: mostly small rows and cells, some panels
+        const size: i32 = if (random.uintLessThan(u32, 100) == 0) 800 else 40;
+        box.* = Box.new(random.intRangeLessThan(i32, 0, 1920), random.intRangeLessThan(i32, 0, 1080), size, @divTrunc(size, 2));
+    }
+
+    var grid = HitGrid(u32){};
+    defer grid.deinit(std.testing.allocator);
+    for (boxes) |box, i| {
+        try grid.append(std.testing.allocator, @intCast(u32, i), box);
+    }
+
+    var q: usize = 0;
+    while (q < query_count) : (q += 1) {
+        const x = random.intRangeLessThan(i32, 0, 1920);
+        const y = random.intRangeLessThan(i32, 0, 1080);
+
+        var expected: ?u32 = null;
+        var i: usize = boxes.len;
+        while (i > 0) {
+            i -= 1;
+            if (boxes[i].contains(x, y)) {
+                expected = @intCast(u32, i);
+                break;
+            }
+        }
+        try std.testing.expectEqual(expected, grid.find(x, y, {}, acceptAll));
+    }
+}
@@ -0,0 +1,583 @@
+//!
+//! An editable text stored in a gap buffer. The buffer keeps the byte offset of every line
+//! start and caches the measured width of each line, so placing the caret, hit-testing and
+//! scrolling only measure a small part of the text instead of everything in front of the caret.
+//!
+//! Lines longer than `chunk_size` bytes are measured in chunks, and the width of the text in
+//! front of an offset is the sum of the chunks before it plus the part of its own chunk. This
+//! ignores kerning across chunk borders, so long lines should be drawn chunk by chunk with
+//! `chunks`.
+//!
+//! Fonts are passed as `anytype` and need a `measureString(font, text: []const u8) u15`
+//! function, like `ui.Font`. Call `setFont` when the font changes.
+//!
+
+const std = @import("std");
+
+const TextBuffer = @This();
+
+/// Lines longer than this many bytes are measured in chunks.
+pub const chunk_size = 256;
+
+pub const Direction = enum { left, right };
+
+/// The amount of text a cursor movement or deletion covers.
+pub const Unit = enum { letter, word, line };
+
+/// A part of a line and its horizontal position relative to the line start.
+pub const Chunk = struct {
+    offset: usize,
+    text: []const u8,
+    x: u32,
+};
+
+const LineWidth = struct {
+    /// Width of the line in pixels, `null` if it was not measured yet.
+    total: ?u32 = null,
+
+    /// Width of the line up to the end of each chunk. Only used for lines longer than `chunk_size`.
+    chunk_ends: []u32 = &.{},
+
+    /// Number of leading `chunk_ends` that are still correct after an edit. An edit only
+    /// changes the chunks from the one it touches on, so only those are measured again.
+    valid_chunks: usize = 0,
+};
+
+allocator: std.mem.Allocator,
+
+/// The text is `buffer[0..gap_start] ++ buffer[gap_end..]`.
+buffer: []u8 = &.{},
+gap_start: usize = 0,
+gap_end: usize = 0,
+
+/// Byte offset of the first character of each line. The first line always starts at 0.
+line_starts: std.ArrayListUnmanaged(usize) = .{},
+
+/// The cached width of each line, parallel to `line_starts`.
+line_widths: std.ArrayListUnmanaged(LineWidth) = .{},
+
+/// Identifies the font `line_widths` was measured with.
+font_key: usize = 0,
+
+/// Incremented with every change of the text.
+revision: u64 = 0,
+
+pub fn init(allocator: std.mem.Allocator, text: []const u8) !TextBuffer {
+    var buffer = TextBuffer{ .allocator = allocator };
+    errdefer buffer.deinit();
+
+    try buffer.line_starts.append(allocator, 0);
+    try buffer.line_widths.append(allocator, .{});
+    try buffer.insert(0, text);
+
+    return buffer;
+}
+
+pub fn deinit(buffer: *TextBuffer) void {
+    for (buffer.line_widths.items) |*width| {
+        buffer.resetWidth(width);
+    }
+    buffer.line_widths.deinit(buffer.allocator);
+    buffer.line_starts.deinit(buffer.allocator);
+    buffer.allocator.free(buffer.buffer);
+    buffer.* = undefined;
+}
+
+/// Returns the length of the text in bytes.
+pub fn len(buffer: TextBuffer) usize {
+    return buffer.buffer.len - buffer.gapSize();
+}
+
+pub fn lineCount(buffer: TextBuffer) usize {
+    return buffer.line_starts.items.len;
+}
+
+pub fn byteAt(buffer: TextBuffer, offset: usize) u8 {
+    return if (offset < buffer.gap_start)
+        buffer.buffer[offset]
+    else
+        buffer.buffer[offset + buffer.gapSize()];
+}
+
+/// Returns the text between `start` and `end`. Moves the gap out of the range if necessary,
+/// so the slice is only valid until the buffer is changed or sliced again.
+pub fn slice(buffer: *TextBuffer, start: usize, end: usize) []const u8 {
+    std.debug.assert(start <= end and end <= buffer.len());
+
+    if (end <= buffer.gap_start)
+        return buffer.buffer[start..end];
+
+    if (start < buffer.gap_start) {
+        // the gap splits the range, move it to the closer end
+        if (buffer.gap_start - start < end - buffer.gap_start) {
+            buffer.moveGap(start);
+        } else {
+            buffer.moveGap(end);
+            return buffer.buffer[start..end];
+        }
+    }
+
+    const gap = buffer.gapSize();
+    return buffer.buffer[start + gap .. end + gap];
+}
+
+/// Returns the whole text, see `slice`.
+pub fn getText(buffer: *TextBuffer) []const u8 {
+    return buffer.slice(0, buffer.len());
+}
+
+/// Replaces the whole text.
+pub fn setText(buffer: *TextBuffer, text: []const u8) !void {
+    for (buffer.line_widths.items) |*width| {
+        buffer.resetWidth(width);
+    }
+    buffer.line_starts.shrinkRetainingCapacity(1);
+    buffer.line_widths.shrinkRetainingCapacity(1);
+    buffer.gap_start = 0;
+    buffer.gap_end = buffer.buffer.len;
+    buffer.revision += 1;
+
+    try buffer.insert(0, text);
+}
+
+/// Inserts `text` in front of the byte at `offset`.
+pub fn insert(buffer: *TextBuffer, offset: usize, text: []const u8) !void {
+    std.debug.assert(offset <= buffer.len());
+    if (text.len == 0)
+        return;
+
+    const new_lines = std.mem.count(u8, text, "\n");
+    try buffer.line_starts.ensureUnusedCapacity(buffer.allocator, new_lines);
+    try buffer.line_widths.ensureUnusedCapacity(buffer.allocator, new_lines);
+    try buffer.ensureGap(text.len);
+
+    const line = buffer.lineOf(offset);
+    buffer.invalidateWidth(line, offset);
+
+    buffer.moveGap(offset);
+    std.mem.copy(u8, buffer.buffer[buffer.gap_start..], text);
+    buffer.gap_start += text.len;
+    buffer.revision += 1;
+
+    // make room for the new lines behind `line` and move the following lines back
+    const starts = &buffer.line_starts;
+    const widths = &buffer.line_widths;
+    const count = starts.items.len;
+    starts.items.len += new_lines;
+    widths.items.len += new_lines;
+    std.mem.copyBackwards(usize, starts.items[line + 1 + new_lines ..], starts.items[line + 1 .. count]);
+    std.mem.copyBackwards(LineWidth, widths.items[line + 1 + new_lines ..], widths.items[line + 1 .. count]);
+    for (starts.items[line + 1 + new_lines ..]) |*start| {
+        start.* += text.len;
+    }
+
+    var index = line + 1;
+    var pos: usize = 0;
+    while (std.mem.indexOfScalarPos(u8, text, pos, '\n')) |newline| : ({
+        pos = newline + 1;
+        index += 1;
+    }) {
+        starts.items[index] = offset + newline + 1;
+        widths.items[index] = .{};
+    }
+}
+
+/// Removes the bytes between `start` and `end`.
+pub fn remove(buffer: *TextBuffer, start: usize, end: usize) void {
+    std.debug.assert(start <= end and end <= buffer.len());
+    if (start == end)
+        return;
+
+    // the lines after `first` up to `last` start inside the removed range
+    const first = buffer.lineOf(start);
+    const last = buffer.lineOf(end);
+    const removed = last - first;
+
+    buffer.invalidateWidth(first, start);
+    for (buffer.line_widths.items[first + 1 .. last + 1]) |*width| {
+        buffer.resetWidth(width);
+    }
+
+    const starts = &buffer.line_starts;
+    const widths = &buffer.line_widths;
+    std.mem.copy(usize, starts.items[first + 1 ..], starts.items[last + 1 ..]);
+    std.mem.copy(LineWidth, widths.items[first + 1 ..], widths.items[last + 1 ..]);
+    starts.items.len -= removed;
+    widths.items.len -= removed;
+    for (starts.items[first + 1 ..]) |*line_start| {
+        line_start.* -= (end - start);
+    }
+
+    buffer.moveGap(start);
+    buffer.gap_end += (end - start);
+    buffer.revision += 1;
+}
+
+/// Returns the line that contains the byte at `offset`.
+pub fn lineOf(buffer: TextBuffer, offset: usize) usize {
+    const starts = buffer.line_starts.items;
+
+    // `starts[low] <= offset`, and `starts[high] > offset` unless `high` is past the end
+    var low: usize = 0;
+    var high: usize = starts.len;
+    while (high - low > 1) {
+        const mid = low + (high - low) / 2;
+        if (starts[mid] <= offset) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/// Returns the offset of the first byte of `line`.
+pub fn lineStart(buffer: TextBuffer, line: usize) usize {
+    return buffer.line_starts.items[line];
+}
+
+/// Returns the offset behind the last byte of `line`, excluding the line break.
+pub fn lineEnd(buffer: TextBuffer, line: usize) usize {
+    return if (line + 1 < buffer.line_starts.items.len)
+        buffer.line_starts.items[line + 1] - 1
+    else
+        buffer.len();
+}
+
+/// Returns the offset reached from `offset` by moving one `unit` in `direction`.
+pub fn step(buffer: TextBuffer, offset: usize, direction: Direction, unit: Unit) usize {
+    const end = buffer.len();
+    var pos = offset;
+    switch (unit) {
+        .letter => switch (direction) {
+            .left => if (pos > 0) {
+                pos -= 1;
+                while (pos > 0 and isContinuation(buffer.byteAt(pos))) pos -= 1;
+            },
+            .right => if (pos < end) {
+                pos += 1;
+                while (pos < end and isContinuation(buffer.byteAt(pos))) pos += 1;
+            },
+        },
+        .word => switch (direction) {
+            .left => {
+                while (pos > 0 and std.ascii.isSpace(buffer.byteAt(pos - 1))) pos -= 1;
+                while (pos > 0 and !std.ascii.isSpace(buffer.byteAt(pos - 1))) pos -= 1;
+            },
+            .right => {
+                while (pos < end and !std.ascii.isSpace(buffer.byteAt(pos))) pos += 1;
+                while (pos < end and std.ascii.isSpace(buffer.byteAt(pos))) pos += 1;
+            },
+        },
+        .line => pos = switch (direction) {
+            .left => buffer.lineStart(buffer.lineOf(offset)),
+            .right => buffer.lineEnd(buffer.lineOf(offset)),
+        },
+    }
+    return pos;
+}
+
+/// Drops all cached widths if `key` identifies another font than before.
+pub fn setFont(buffer: *TextBuffer, key: usize) void {
+    if (buffer.font_key == key)
+        return;
+    buffer.font_key = key;
+    for (buffer.line_widths.items) |*width| {
+        buffer.resetWidth(width);
+    }
+}
+
+/// Returns the width of `line` in pixels.
+pub fn lineWidth(buffer: *TextBuffer, font: anytype, line: usize) !u32 {
+    return (try buffer.measureLine(font, line)).total.?;
+}
+
+/// Returns the horizontal position of `offset` relative to the start of its line.
+pub fn offsetToX(buffer: *TextBuffer, font: anytype, offset: usize) !u32 {
+    const line = buffer.lineOf(offset);
+    const width = try buffer.measureLine(font, line);
+    const start = buffer.lineStart(line);
+
+    if (width.chunk_ends.len == 0)
+        return font.measureString(buffer.slice(start, offset));
+
+    const chunk = buffer.chunkOf(start, offset);
+    const chunk_x = if (chunk > 0) width.chunk_ends[chunk - 1] else 0;
+    return chunk_x + font.measureString(buffer.slice(buffer.chunkStart(start, chunk), offset));
+}
+
+/// Returns the offset in `line` whose position is closest to `x`.
+pub fn xToOffset(buffer: *TextBuffer, font: anytype, line: usize, x: i32) !usize {
+    const width = try buffer.measureLine(font, line);
+    const start = buffer.lineStart(line);
+    const end = buffer.lineEnd(line);
+
+    if (x <= 0)
+        return start;
+    if (x >= width.total.?)
+        return end;
+
+    // find the chunk that contains `x`, then search for the closest codepoint border inside the chunk
+    var chunk_start = start;
+    var chunk_end = end;
+    var target = @intCast(u32, x);
+    if (width.chunk_ends.len > 0) {
+        var chunk: usize = 0;
+        while (chunk + 1 < width.chunk_ends.len and width.chunk_ends[chunk] <= target) chunk += 1;
+        chunk_start = buffer.chunkStart(start, chunk);
+        chunk_end = std.math.min(buffer.chunkStart(start, chunk + 1), end);
+        if (chunk > 0)
+            target -= width.chunk_ends[chunk - 1];
+    }
+
+    var previous = chunk_start;
+    var previous_x: u32 = 0;
+    var pos = chunk_start;
+    while (pos < chunk_end) {
+        pos = buffer.step(pos, .right, .letter);
+        const pos_x = font.measureString(buffer.slice(chunk_start, pos));
+        if (pos_x >= target) {
+            return if (pos_x - target < target - previous_x) pos else previous;
+        }
+        previous = pos;
+        previous_x = pos_x;
+    }
+    return chunk_end;
+}
+
+/// Returns the chunks of `line` that overlap the horizontal range from `x_min` to `x_max`.
+/// Short lines are a single chunk.
+pub fn chunks(buffer: *TextBuffer, font: anytype, line: usize, x_min: i32, x_max: i32) !ChunkIterator {
+    const width = try buffer.measureLine(font, line);
+
+    var iterator = ChunkIterator{
+        .buffer = buffer,
+        .line_start = buffer.lineStart(line),
+        .line_end = buffer.lineEnd(line),
+        .chunk_ends = width.chunk_ends,
+        .index = 0,
+        .x_max = x_max,
+    };
+    if (width.chunk_ends.len > 0) {
+        while (iterator.index + 1 < width.chunk_ends.len and width.chunk_ends[iterator.index] <= x_min) {
+            iterator.index += 1;
+        }
+    }
+    return iterator;
+}
+
+pub const ChunkIterator = struct {
+    buffer: *TextBuffer,
+    line_start: usize,
+    line_end: usize,
+    chunk_ends: []const u32,
+    index: usize,
+    x_max: i32,
+
+    pub fn next(iterator: *ChunkIterator) ?Chunk {
+        const buffer = iterator.buffer;
+        const count = std.math.max(iterator.chunk_ends.len, 1);
+        if (iterator.index >= count)
+            return null;
+
+        const chunk = iterator.index;
+        const x: u32 = if (chunk > 0) iterator.chunk_ends[chunk - 1] else 0;
+        if (chunk > 0 and x >= iterator.x_max)
+            return null;
+        iterator.index += 1;
+
+        const start = buffer.chunkStart(iterator.line_start, chunk);
+        const end = if (chunk + 1 < count)
+            buffer.chunkStart(iterator.line_start, chunk + 1)
+        else
+            iterator.line_end;
+
+        return Chunk{
+            .offset = start,
+            .text = buffer.slice(start, end),
+            .x = x,
+        };
+    }
+};
+
+fn measureLine(buffer: *TextBuffer, font: anytype, line: usize) !*const LineWidth {
+    const width = &buffer.line_widths.items[line];
+    if (width.total != null)
+        return width;
+
+    const start = buffer.lineStart(line);
+    const end = buffer.lineEnd(line);
+    if (end - start <= chunk_size) {
+        buffer.resetWidth(width);
+        width.total = font.measureString(buffer.slice(start, end));
+        return width;
+    }
+
+    const count = (end - start + chunk_size - 1) / chunk_size;
+    if (width.chunk_ends.len != count) {
+        width.chunk_ends = try buffer.allocator.realloc(width.chunk_ends, count);
+        width.valid_chunks = std.math.min(width.valid_chunks, count);
+    }
+
+    // the chunks in front of the first edit are unchanged
+    var chunk = width.valid_chunks;
+    var total: u32 = if (chunk > 0) width.chunk_ends[chunk - 1] else 0;
+    while (chunk < count) : (chunk += 1) {
+        const chunk_end = if (chunk + 1 < count) buffer.chunkStart(start, chunk + 1) else end;
+        total += font.measureString(buffer.slice(buffer.chunkStart(start, chunk), chunk_end));
+        width.chunk_ends[chunk] = total;
+    }
+
+    width.total = total;
+    width.valid_chunks = count;
+    return width;
+}
+
+/// Chunk `chunk` of the line at `line_start` begins at the first codepoint border at or after `chunk * chunk_size`.
+fn chunkStart(buffer: TextBuffer, line_start: usize, chunk: usize) usize {
+    const end = buffer.len();
+    var pos = std.math.min(line_start + chunk * chunk_size, end);
+    while (pos < end and isContinuation(buffer.byteAt(pos))) pos += 1;
+    return pos;
+}
+
+/// Returns the chunk of the line at `line_start` that contains `offset`.
+fn chunkOf(buffer: TextBuffer, line_start: usize, offset: usize) usize {
+    const chunk = (offset - line_start) / chunk_size;
+    return if (chunk > 0 and offset < buffer.chunkStart(line_start, chunk)) chunk - 1 else chunk;
+}
+
+/// Marks the width of `line` as stale from the chunk that contains `offset` on. Must be called
+/// before the text at `offset` changes. The chunk that ends at `offset` is dropped too, as
+/// finding its end may look at the byte at `offset`.
+fn invalidateWidth(buffer: *TextBuffer, line: usize, offset: usize) void {
+    const width = &buffer.line_widths.items[line];
+    width.total = null;
+    if (width.chunk_ends.len == 0)
+        return;
+
+    const start = buffer.lineStart(line);
+    const chunk = if (offset > start) buffer.chunkOf(start, offset - 1) else 0;
+    width.valid_chunks = std.math.min(width.valid_chunks, chunk);
+}
+
+fn resetWidth(buffer: *TextBuffer, width: *LineWidth) void {
+    buffer.allocator.free(width.chunk_ends);
+    width.* = .{};
+}
+
+fn gapSize(buffer: TextBuffer) usize {
+    return buffer.gap_end - buffer.gap_start;
+}
+
+/// Moves the gap so it starts at `offset`.
+fn moveGap(buffer: *TextBuffer, offset: usize) void {
+    if (offset < buffer.gap_start) {
+        const count = buffer.gap_start - offset;
+        std.mem.copyBackwards(u8, buffer.buffer[buffer.gap_end - count .. buffer.gap_end], buffer.buffer[offset..buffer.gap_start]);
+        buffer.gap_start -= count;
+        buffer.gap_end -= count;
+    } else if (offset > buffer.gap_start) {
+        const count = offset - buffer.gap_start;
+        std.mem.copy(u8, buffer.buffer[buffer.gap_start .. buffer.gap_start + count], buffer.buffer[buffer.gap_end .. buffer.gap_end + count]);
+        buffer.gap_start += count;
+        buffer.gap_end += count;
+    }
+}
+
+/// Grows the buffer until the gap holds at least `size` bytes.
+fn ensureGap(buffer: *TextBuffer, size: usize) !void {
+    if (buffer.gapSize() >= size)
+        return;
+
+    const tail = buffer.buffer.len - buffer.gap_end;
+    const capacity = std.math.max(2 * buffer.buffer.len, buffer.len() + size + 64);
+
+    const new_buffer = try buffer.allocator.alloc(u8, capacity);
+    std.mem.copy(u8, new_buffer, buffer.buffer[0..buffer.gap_start]);
+    std.mem.copy(u8, new_buffer[capacity - tail ..], buffer.buffer[buffer.gap_end..]);
+
+    buffer.allocator.free(buffer.buffer);
+    buffer.buffer = new_buffer;
+    buffer.gap_end = capacity - tail;
+}
+
+fn isContinuation(byte: u8) bool {
+    return (byte & 0xC0) == 0x80;
+}
+
+test "text buffer: editing and line index" {
+    var buffer = try TextBuffer.init(std.testing.allocator, "hello\nworld");
+    defer buffer.deinit();
+
+    try std.testing.expectEqual(@as(usize, 2), buffer.lineCount());
+    try std.testing.expectEqual(@as(usize, 1), buffer.lineOf(6));
+    try std.testing.expectEqual(@as(usize, 0), buffer.lineOf(5));
+
+    try buffer.insert(5, ",\nbig");
+    try std.testing.expectEqualStrings("hello,\nbig\nworld", buffer.getText());
+    try std.testing.expectEqual(@as(usize, 3), buffer.lineCount());
+    try std.testing.expectEqual(@as(usize, 11), buffer.lineStart(2));
+    try std.testing.expectEqual(@as(usize, 10), buffer.lineEnd(1));
+
+    buffer.remove(3, 13);
+    try std.testing.expectEqualStrings("helrld", buffer.getText());
+    try std.testing.expectEqual(@as(usize, 1), buffer.lineCount());
+
+    try buffer.insert(0, "ä ");
+    try std.testing.expectEqual(@as(usize, 2), buffer.step(0, .right, .letter));
+    try std.testing.expectEqual(@as(usize, 3), buffer.step(0, .right, .word));
+    try std.testing.expectEqual(@as(usize, 0), buffer.step(3, .left, .word));
+    try std.testing.expectEqual(buffer.len(), buffer.step(0, .right, .line));
+}
+
+test "text buffer: caret placement in a long line measures a single chunk" {
+    const CountingFont = struct {
+        measured: *usize,
+        calls: *usize,
+
+        pub fn measureString(font: @This(), text: []const u8) u15 {
+            font.measured.* += text.len;
+            font.calls.* += 1;
+            return @intCast(u15, 10 * text.len);
+        }
+    };
+
+    const text = try std.testing.allocator.alloc(u8, 1 << 20);
+    defer std.testing.allocator.free(text);
+    std.mem.set(u8, text, 'x');
+
+    var buffer = try TextBuffer.init(std.testing.allocator, text);
+    defer buffer.deinit();
+
+    var measured: usize = 0;
+    var calls: usize = 0;
+    const font = CountingFont{ .measured = &measured, .calls = &calls };
+
+    try std.testing.expectEqual(@as(u32, 10 << 20), try buffer.lineWidth(font, 0));
+
+    measured = 0;
+    try std.testing.expectEqual(@as(u32, 10 * 700_000), try buffer.offsetToX(font, 700_000));
+    try std.testing.expect(measured <= chunk_size);
+
+    try std.testing.expectEqual(@as(usize, 700_000), try buffer.xToOffset(font, 0, 10 * 700_000 + 4));
+
+    // An edit only remeasures the chunks from the edited one on. Here those are the
+    // chunks 4093 to 4096, the last one holds the byte that was pushed out of chunk 4095.
+    const edit = (1 << 20) - 3 * chunk_size + 7;
+    try buffer.insert(edit, "y");
+    calls = 0;
+    try std.testing.expectEqual(@as(u32, 10 * ((1 << 20) + 1)), try buffer.lineWidth(font, 0));
+    try std.testing.expectEqual(@as(usize, 4), calls);
+
+    buffer.remove(edit, edit + 1);
+    calls = 0;
+    try std.testing.expectEqual(@as(u32, 10 << 20), try buffer.lineWidth(font, 0));
+    try std.testing.expectEqual(@as(usize, 3), calls);
+
+    // an edit at the start of the line remeasures all of it, and positions behind it move
+    try buffer.insert(5, "y");
+    calls = 0;
+    try std.testing.expectEqual(@as(u32, 10 * 700_001), try buffer.offsetToX(font, 700_001));
+    try std.testing.expectEqual(@as(usize, 4097 + 1), calls);
+}
@@ -37,6 +37,33 @@ event_queue: ui.RingBuffer(Event, 64) = .{},
 /// The currently clicked widget per mouse button
 clicked_widgets: std.enums.EnumArray(MouseButton, ?*Widget) = std.enums.EnumArray(MouseButton, ?*Widget).initFill(null),
 
+/// The allocator passed to `init`, used for `hit_grid`.
+allocator: ?std.mem.Allocator = null,
+
+/// Spatial index of all widgets in draw order, keyed by their absolute bounds clipped to their parents.
+/// Maintained by `updateAbsolutePositions`.
+hit_grid: ui.HitGrid(*Widget) = .{},
+
+/// If `false`, `hit_grid` is out of date and hit tests walk the widget tree instead.
+hit_grid_valid: bool = false,
+
+/// The `Widget.bounds_revision` that `hit_grid` was built for. When it differs, a widget was
+/// moved or resized and the positions are updated before the next hit test.
+bounds_revision: u32 = 0,
+
+/// Position in `order` where the next hit test continues checking for widgets that were moved
+/// by writing `Widget.bounds` directly.
+stale_check_cursor: usize = 0,
+
+/// All widgets in draw order, each parent followed by its children from bottom to top.
+/// This is also the order in which Tab moves the focus. `Widget.order_index` is the
+/// position of a widget in this list.
+order: std.ArrayListUnmanaged(*Widget) = .{},
+
+/// If `false`, widgets were inserted or removed and `order` and `hit_grid` are rebuilt
+/// on the next hit test or focus change.
+order_valid: bool = false,
+
 fn inputToWidgetEvent(input: InputEvent) Widget.Event {
     return switch (input) {
         .mouse_button_down => |v| .{ .mouse_button_down = v },
@@ -125,9 +152,65 @@ pub fn pushInput(view: *View, input: InputEvent) void {
 }
 
 fn widgetFromPosition(view: *View, point: Point) ?*Widget {
+    view.ensureOrder();
+    if (view.hit_grid_valid and view.bounds_revision != Widget.bounds_revision)
+        view.updateAbsolutePositions();
+    if (view.hit_grid_valid) {
+        const hit = view.hit_grid.find(point.x, point.y, {}, isHitTestVisibleInTree);
+        if (view.positionsLookFresh(hit))
+            return hit;
+
+        // a layout engine wrote the bounds directly, so the grid is rebuilt from the tree
+        view.updateAbsolutePositions();
+        if (view.hit_grid_valid)
+            return view.hit_grid.find(point.x, point.y, {}, isHitTestVisibleInTree);
+    }
     return view.recursiveWidgetFromPosition(view.widgets, point);
 }
 
+/// Number of widgets `positionsLookFresh` checks per hit test in addition to the hit itself.
+const stale_check_count = 8;
+
+/// Bounds written through `Widget.bounds` directly, for example by a layout engine, don't bump
+/// `Widget.bounds_revision`. This catches them without walking all widgets on every pointer event:
+/// the hit and its ancestors are always checked, and a few more widgets of `order` in turn, so a
+/// moved widget is found after a few hit tests at the latest.
+fn positionsLookFresh(view: *View, hit: ?*Widget) bool {
+    var iter = hit;
+    while (iter) |widget| : (iter = widget.parent) {
+        if (!isPositionFresh(widget))
+            return false;
+    }
+
+    const items = view.order.items;
+    var i: usize = 0;
+    while (i < std.math.min(stale_check_count, items.len)) : (i += 1) {
+        view.stale_check_cursor = (view.stale_check_cursor + 1) % items.len;
+        if (!isPositionFresh(items[view.stale_check_cursor]))
+            return false;
+    }
+    return true;
+}
+
+fn isPositionFresh(widget: *Widget) bool {
+    const offset = if (widget.parent) |parent| parent.absolute_bounds.position() else ui.Point.zero;
+    const expected = ui.Rectangle.new(
+        ui.Point.new(widget.bounds.position.x + offset.x, widget.bounds.position.y + offset.y),
+        widget.bounds.size,
+    );
+    return std.meta.eql(widget.absolute_bounds, expected);
+}
+
+/// Hidden widgets hide their whole subtree from hit testing.
+fn isHitTestVisibleInTree(_: void, widget: *Widget) bool {
+    var iter: ?*Widget = widget;
+    while (iter) |w| : (iter = w.parent) {
+        if (!w.isHitTestVisible())
+            return false;
+    }
+    return true;
+}
+
 fn recursiveWidgetFromPosition(view: *View, list: Widget.List, point: Point) ?*Widget {
     var iter = Widget.Iterator.init(list, .top_to_bottom);
     while (iter.next()) |widget| {
@@ -164,15 +247,19 @@ pub fn pushEvent(view: *View, event: Event) void {
 
 /// Initializes all widgets, sets their `parent` and `absolute_bounds` fields.
 pub fn init(view: *View, allocator: std.mem.Allocator) !void {
+    view.allocator = allocator;
     try view.recursiveInit(view.widgets, allocator);
     view.updateAbsolutePositions();
-    view.updateParents();
 }
 
+/// Initializes all widgets in `list` and their children. If one of them fails, the ones that
+/// were already initialized are released again, so nothing in `list` is left initialized.
 fn recursiveInit(view: *View, list: Widget.List, allocator: std.mem.Allocator) !void {
     var it = Widget.Iterator.init(list, .bottom_to_top);
     while (it.next()) |w| {
+        errdefer view.recursiveDeinitUntil(list, w);
         try w.init(allocator);
+        errdefer w.deinit();
         try view.recursiveInit(w.children, allocator);
     }
 }
@@ -180,26 +267,106 @@ fn recursiveInit(view: *View, list: Widget.List, allocator: std.mem.Allocator) !
 /// Releases the resources allocated by `Widget.init`.
 pub fn deinit(view: *View) void {
     view.recursiveDeinit(view.widgets);
+    if (view.allocator) |allocator| {
+        view.hit_grid.deinit(allocator);
+        view.order.deinit(allocator);
+    }
 }
 
-fn recursiveDeinit(view: *View, list: Widget.List) !void {
+fn recursiveDeinit(view: *View, list: Widget.List) void {
     var it = Widget.Iterator.init(list, .bottom_to_top);
     while (it.next()) |w| {
-        try w.deinit();
-        try view.recursiveDeinit(w.children);
+        w.deinit();
+        view.recursiveDeinit(w.children);
     }
 }
 
-fn updateParents(view: *View) void {
-    view.updateParentsRecursive(view.widgets, null);
-}
-
-fn updateParentsRecursive(view: *View, list: Widget.List, parent: ?*Widget) void {
+/// Releases the widgets in `list` that come before `end`, and their children.
+fn recursiveDeinitUntil(view: *View, list: Widget.List, end: *Widget) void {
     var it = Widget.Iterator.init(list, .bottom_to_top);
     while (it.next()) |w| {
-        w.parent = parent;
-        view.updateParentsRecursive(w.children, w);
+        if (w == end)
+            return;
+        w.deinit();
+        view.recursiveDeinit(w.children);
+    }
+}
+
+/// Inserts `widget` and its children as the top-most child of `parent`, or as a top-level
+/// widget if `parent` is `null`. The inserted widgets are initialized like in `init`.
+pub fn insertWidget(view: *View, parent: ?*Widget, widget: *Widget) !void {
+    if (view.allocator) |allocator| {
+        try widget.init(allocator);
+        errdefer widget.deinit();
+        try view.recursiveInit(widget.children, allocator);
+    }
+
+    const list = if (parent) |p| &p.children else &view.widgets;
+    list.append(&widget.siblings);
+    widget.parent = parent;
+
+    view.invalidateOrder();
+    view.updateSubtreePositions(widget);
+}
+
+/// Removes `widget` and its children from the view and releases their resources like `deinit`.
+pub fn removeWidget(view: *View, widget: *Widget) void {
+    // drop all references into the removed subtree
+    if (view.focus) |focused| {
+        if (isInSubtree(focused, widget))
+            view.setFocus(null);
+    }
+    if (view.hovered_widget) |hovered| {
+        if (isInSubtree(hovered, widget))
+            view.hovered_widget = null;
+    }
+    for (view.clicked_widgets.values) |*clicked| {
+        if (clicked.*) |w| {
+            if (isInSubtree(w, widget))
+                clicked.* = null;
+        }
+    }
+
+    const list = if (widget.parent) |p| &p.children else &view.widgets;
+    list.remove(&widget.siblings);
+    widget.parent = null;
+
+    view.invalidateOrder();
+
+    widget.deinit();
+    view.recursiveDeinit(widget.children);
+}
+
+/// Moves and resizes `widget` inside its parent and updates the absolute positions of its subtree.
+pub fn setWidgetBounds(view: *View, widget: *Widget, rectangle: ui.Rectangle) void {
+    // the subtree is updated right away, so this change alone doesn't need a full update
+    const up_to_date = view.bounds_revision == Widget.bounds_revision;
+    widget.setBounds(rectangle);
+    view.updateSubtreePositions(widget);
+    if (up_to_date)
+        view.bounds_revision = Widget.bounds_revision;
+}
+
+/// Returns `true` if `widget` is `root` or one of its descendants.
+fn isInSubtree(widget: *Widget, root: *Widget) bool {
+    var iter: ?*Widget = widget;
+    while (iter) |w| : (iter = w.parent) {
+        if (w == root)
+            return true;
     }
+    return false;
+}
+
+/// Marks `order` and `hit_grid` as outdated after a structural change of the widget tree.
+fn invalidateOrder(view: *View) void {
+    view.order_valid = false;
+    view.hit_grid_valid = false;
+}
+
+/// Rebuilds `order` and `hit_grid` if widgets were inserted or removed since the last rebuild.
+fn ensureOrder(view: *View) void {
+    if (!view.order_valid and view.allocator != null)
+        view.updateAbsolutePositions();
 }
 
 const FocusSearchDir = enum { next, previous };
@@ -217,6 +384,10 @@ pub fn setFocus(view: *View, new_focus: ?*Widget) void {
 }
 
 fn searchFocusWidget(view: *View, widget: ?*Widget, dir: FocusSearchDir) ?*Widget {
+    view.ensureOrder();
+    if (view.order_valid)
+        return view.searchFocusWidgetInOrder(widget, dir);
+
     var iter = widget;
 
     while (true) {
@@ -230,9 +401,32 @@ fn searchFocusWidget(view: *View, widget: ?*Widget, dir: FocusSearchDir) ?*Widge
     }
 }
 
-fn searchFocusWidgetInner(view: *View, widget: ?*Widget, dir: FocusSearchDir) ?*Widget {
-    view.updateParents();
+/// Walks `order` from `widget` and returns the first widget that can receive the focus,
+/// so every step of Tab and Shift-Tab only visits the widgets that are skipped.
+fn searchFocusWidgetInOrder(view: *View, widget: ?*Widget, dir: FocusSearchDir) ?*Widget {
+    const items = view.order.items;
+    if (items.len == 0)
+        return null;
+
+    // without a focused widget, start before the first or after the last widget
+    var index: usize = if (widget) |w| w.order_index else switch (dir) {
+        .next => items.len - 1,
+        .previous => 0,
+    };
 
+    var steps: usize = 0;
+    while (steps < items.len) : (steps += 1) {
+        index = switch (dir) {
+            .next => (index + 1) % items.len,
+            .previous => (index + items.len - 1) % items.len,
+        };
+        if (items[index].canReceiveFocus())
+            return items[index];
+    }
+    return widget;
+}
+
+fn searchFocusWidgetInner(view: *View, widget: ?*Widget, dir: FocusSearchDir) ?*Widget {
     if (widget) |w| {
         return switch (dir) {
             .next => if (w.children.first) |child|
@@ -265,13 +459,71 @@ fn findLastChild(widget: ?*Widget.Node) ?*Widget.Node {
     return widget;
 }
 
-/// Updates `Widget.absolute_bounds` for all widgets in the tree.
-/// Call when adding widgets or changing any widgets position.
+/// The clip box of top-level widgets.
+const unclipped = ui.HitBox.new(std.math.minInt(i16), std.math.minInt(i16), 1 << 16, 1 << 16);
+
+/// Updates `Widget.absolute_bounds` and `Widget.parent` for all widgets in the tree and rebuilds `order`
+/// and the hit test index. Widgets inserted with `insertWidget` and moved with `setWidgetBounds` don't
+/// need this, call it after changing the widget lists directly.
 pub fn updateAbsolutePositions(view: *View) void {
-    view.updateAbsolutePositionInner(view.widgets, ui.Point.zero);
+    var index: usize = 0;
+    view.updateAbsolutePositionInner(view.widgets, null, ui.Point.zero, unclipped, &index) catch {
+        logger.warn("out of memory, falling back to tree hit testing", .{});
+        view.hit_grid.clear();
+        view.hit_grid_valid = false;
+        view.order.shrinkRetainingCapacity(0);
+        view.order_valid = false;
+        return;
+    };
+    if (view.allocator != null) {
+        view.hit_grid.shrink(index);
+        view.hit_grid_valid = true;
+        view.bounds_revision = Widget.bounds_revision;
+        view.order.shrinkRetainingCapacity(index);
+        view.order_valid = true;
+    }
+}
+
+/// Updates `Widget.absolute_bounds` of `widget` and its descendants and moves them in the hit test index.
+/// Call after changing the bounds of `widget`, for example from a layout engine.
+pub fn updateSubtreePositions(view: *View, widget: *Widget) void {
+    // children are only hit inside all of their ancestors
+    var clip = unclipped;
+    var iter = widget.parent;
+    while (iter) |ancestor| : (iter = ancestor.parent) {
+        const bounds = ancestor.absolute_bounds;
+        clip = clip.intersect(ui.HitBox.new(bounds.x, bounds.y, bounds.width, bounds.height));
+    }
+
+    const offset = if (widget.parent) |parent| parent.absolute_bounds.position() else ui.Point.zero;
+    view.updateSubtreePositionsInner(widget, offset, clip);
+}
+
+fn updateSubtreePositionsInner(view: *View, widget: *Widget, offset: ui.Point, clip: ui.HitBox) void {
+    const pos = ui.Point.new(
+        widget.bounds.position.x + offset.x,
+        widget.bounds.position.y + offset.y,
+    );
+    widget.absolute_bounds = ui.Rectangle.new(pos, widget.bounds.size);
+
+    const box = clip.intersect(ui.HitBox.new(pos.x, pos.y, widget.bounds.size.width, widget.bounds.size.height));
+    if (view.hit_grid_valid) {
+        view.hit_grid.setBox(view.allocator.?, widget.order_index, box) catch {
+            // rebuilt on the next hit test
+            view.invalidateOrder();
+        };
+    }
+
+    var it = Widget.Iterator.init(widget.children, .bottom_to_top);
+    while (it.next()) |child| {
+        child.parent = widget;
+        view.updateSubtreePositionsInner(child, pos, box);
+    }
 }
 
-fn updateAbsolutePositionInner(view: *View, list: Widget.List, offset: ui.Point) void {
+/// Walks the tree in draw order. Widgets that stay at the same place in that order are only moved
+/// in `hit_grid`, everything after the first structural change is inserted again.
+fn updateAbsolutePositionInner(view: *View, list: Widget.List, parent: ?*Widget, offset: ui.Point, clip: ui.HitBox, index: *usize) error{OutOfMemory}!void {
     var it = Widget.Iterator.init(list, .bottom_to_top);
     while (it.next()) |widget| {
         const pos = ui.Point.new(
@@ -280,7 +532,184 @@ fn updateAbsolutePositionInner(view: *View, list: Widget.List, offset: ui.Point)
         );
 
         widget.absolute_bounds = ui.Rectangle.new(pos, widget.bounds.size);
+        widget.parent = parent;
+
+        // children are only hit inside their parent
+        const box = clip.intersect(ui.HitBox.new(pos.x, pos.y, widget.bounds.size.width, widget.bounds.size.height));
+        if (view.allocator) |allocator| {
+            if (index.* < view.order.items.len) {
+                view.order.items[index.*] = widget;
+            } else {
+                try view.order.append(allocator, widget);
+            }
+            widget.order_index = index.*;
+            try view.hit_grid.sync(allocator, index.*, widget, box);
+            index.* += 1;
+        }
 
-        view.updateAbsolutePositionInner(widget.children, pos);
+        try view.updateAbsolutePositionInner(widget.children, widget, pos, box, index);
     }
 }
+
+fn testWidget(control: ui.controls.Control, x: i16, y: i16, width: u15, height: u15) Widget {
+    return Widget{
+        .control = control,
+        .bounds = .{ .position = Point.new(x, y), .size = ui.Size.new(width, height) },
+    };
+}
+
+fn pressKey(view: *View, key: ui.KeyCode, shift: bool) void {
+    view.pushInput(.{ .key_down = .{ .scancode = 0, .key = key, .modifiers = .{ .shift = shift } } });
+}
+
+test "view: insert and remove under a parent" {
+    var panel = testWidget(.{ .Panel = .{} }, 10, 10, 100, 100);
+    var first = testWidget(.{ .Button = .{} }, 0, 0, 50, 20);
+    var second = testWidget(.{ .Button = .{} }, 0, 30, 50, 20);
+
+    var view = View{ .widgets = .{} };
+    try view.init(std.testing.allocator);
+    defer view.deinit();
+
+    try view.insertWidget(null, &panel);
+    try view.insertWidget(&panel, &first);
+    try view.insertWidget(&panel, &second);
+
+    try std.testing.expectEqual(@as(?*Widget, &panel), second.parent);
+    try std.testing.expectEqual(@as(usize, 2), panel.children.len);
+    try std.testing.expectEqual(ui.Rectangle.new(Point.new(10, 40), ui.Size.new(50, 20)), second.absolute_bounds);
+    try std.testing.expectEqual(@as(?*Widget, &first), view.widgetFromPosition(Point.new(15, 15)));
+    try std.testing.expectEqual(@as(?*Widget, &second), view.widgetFromPosition(Point.new(15, 45)));
+
+    view.removeWidget(&first);
+
+    try std.testing.expectEqual(@as(?*Widget, null), first.parent);
+    try std.testing.expectEqual(@as(usize, 1), panel.children.len);
+    try std.testing.expectEqual(@as(?*Widget, &panel), view.widgetFromPosition(Point.new(15, 15)));
+    try std.testing.expectEqual(@as(?*Widget, &second), view.widgetFromPosition(Point.new(15, 45)));
+}
+
+test "view: hit tests follow widgets moved without a position update" {
+    var panel = testWidget(.{ .Panel = .{} }, 10, 10, 100, 100);
+    var first = testWidget(.{ .Button = .{} }, 0, 0, 50, 20);
+    var second = testWidget(.{ .Button = .{} }, 0, 30, 50, 20);
+
+    var view = View{ .widgets = .{} };
+    try view.init(std.testing.allocator);
+    defer view.deinit();
+
+    try view.insertWidget(null, &panel);
+    try view.insertWidget(&panel, &first);
+    try view.insertWidget(&panel, &second);
+    try std.testing.expectEqual(@as(?*Widget, &first), view.widgetFromPosition(Point.new(15, 15)));
+
+    // moved through the setter
+    first.setPosition(Point.new(0, 60));
+    try std.testing.expectEqual(@as(?*Widget, &panel), view.widgetFromPosition(Point.new(15, 15)));
+    try std.testing.expectEqual(@as(?*Widget, &first), view.widgetFromPosition(Point.new(15, 75)));
+
+    // written directly, like a layout engine does
+    second.bounds.position = Point.new(60, 0);
+    try std.testing.expectEqual(@as(?*Widget, &panel), view.widgetFromPosition(Point.new(15, 45)));
+    try std.testing.expectEqual(@as(?*Widget, &second), view.widgetFromPosition(Point.new(75, 15)));
+}
+
+test "view: removing a subtree drops focus, hover and click state" {
+    var panel = testWidget(.{ .Panel = .{} }, 10, 10, 100, 100);
+    var button = testWidget(.{ .Button = .{} }, 0, 0, 50, 20);
+    var other = testWidget(.{ .Button = .{} }, 200, 0, 50, 20);
+
+    var view = View{ .widgets = .{} };
+    try view.init(std.testing.allocator);
+    defer view.deinit();
+
+    try view.insertWidget(null, &panel);
+    try view.insertWidget(&panel, &button);
+    try view.insertWidget(null, &other);
+
+    view.pushInput(.{ .mouse_motion = Point.new(20, 15) });
+    view.pushInput(.{ .mouse_button_down = .primary });
+    view.setFocus(&button);
+
+    try std.testing.expectEqual(@as(?*Widget, &button), view.hovered_widget);
+    try std.testing.expectEqual(@as(?*Widget, &button), view.clicked_widgets.get(.primary));
+
+    view.removeWidget(&panel);
+
+    try std.testing.expectEqual(@as(?*Widget, null), view.focus);
+    try std.testing.expectEqual(@as(?*Widget, null), view.hovered_widget);
+    try std.testing.expectEqual(@as(?*Widget, null), view.clicked_widgets.get(.primary));
+
+    // the release doesn't reach the removed button anymore
+    view.pushInput(.{ .mouse_button_up = .primary });
+    try std.testing.expectEqual(@as(?*Widget, null), view.focus);
+
+    pressKey(&view, .tab, false);
+    try std.testing.expectEqual(@as(?*Widget, &other), view.focus);
+}
+
+test "view: tab order follows insertions and removals" {
+    var a = testWidget(.{ .Button = .{} }, 0, 0, 50, 20);
+    var panel = testWidget(.{ .Panel = .{} }, 0, 30, 100, 100);
+    var b = testWidget(.{ .Button = .{} }, 0, 0, 50, 20);
+    var label = testWidget(.{ .Label = .{} }, 0, 30, 50, 20);
+    var c = testWidget(.{ .Button = .{} }, 0, 60, 50, 20);
+    var d = testWidget(.{ .Button = .{} }, 0, 140, 50, 20);
+    var e = testWidget(.{ .Button = .{} }, 60, 0, 30, 20);
+
+    var view = View{ .widgets = .{} };
+    try view.init(std.testing.allocator);
+    defer view.deinit();
+
+    try view.insertWidget(null, &a);
+    try view.insertWidget(null, &panel);
+    try view.insertWidget(&panel, &b);
+    try view.insertWidget(&panel, &label);
+    try view.insertWidget(&panel, &c);
+    try view.insertWidget(null, &d);
+
+    // panels and labels are skipped, the order wraps around at both ends
+    for ([_]*Widget{ &a, &b, &c, &d, &a }) |expected| {
+        pressKey(&view, .tab, false);
+        try std.testing.expectEqual(@as(?*Widget, expected), view.focus);
+    }
+    for ([_]*Widget{ &d, &c, &b, &a }) |expected| {
+        pressKey(&view, .tab, true);
+        try std.testing.expectEqual(@as(?*Widget, expected), view.focus);
+    }
+
+    try view.insertWidget(&panel, &e);
+    view.removeWidget(&b);
+
+    view.setFocus(&a);
+    for ([_]*Widget{ &c, &e, &d, &a }) |expected| {
+        pressKey(&view, .tab, false);
+        try std.testing.expectEqual(@as(?*Widget, expected), view.focus);
+    }
+    for ([_]*Widget{ &d, &e, &c, &a }) |expected| {
+        pressKey(&view, .tab, true);
+        try std.testing.expectEqual(@as(?*Widget, expected), view.focus);
+    }
+}
+
+fn insertTextBoxes(allocator: std.mem.Allocator) !void {
+    var panel = testWidget(.{ .Panel = .{} }, 0, 0, 100, 100);
+    var boxes: [3]Widget = undefined;
+    for (boxes) |*box, i| {
+        box.* = testWidget(.{ .TextBox = .{} }, 0, @intCast(i16, 20 * i), 100, 20);
+        panel.children.append(&box.siblings);
+    }
+    var nested = testWidget(.{ .TextBox = .{} }, 0, 0, 10, 10);
+    boxes[1].children.append(&nested.siblings);
+
+    var view = View{ .widgets = .{} };
+    try view.init(allocator);
+    defer view.deinit();
+
+    try view.insertWidget(null, &panel);
+}
+
+test "view: a failing insert releases the widgets it initialized" {
+    // every allocation in turn fails, the testing allocator reports anything that isn't freed
+    try std.testing.checkAllAllocationFailures(std.testing.allocator, insertTextBoxes, .{});
+}
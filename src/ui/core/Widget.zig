@@ -18,10 +18,12 @@ siblings: Node = .{ .data = {} },
 children: List = .{},
 
 /// Pointer to the parent widget, if any.
-/// All non-top-level widgets have a parent widget that is lazily updated by the UI
-/// when its needed.
+/// All non-top-level widgets have a parent widget that is maintained by the `View`.
 parent: ?*Widget = null,
 
+/// The position of the widget in `View.order`, maintained by the `View`.
+order_index: usize = 0,
+
 /// The actual behaviour of the widget. This defines how the control is rendered
 /// and reacts to input.
 control: ui.controls.Control,
@@ -35,7 +37,7 @@ bounds: ui.LayoutedRectangle = .{
 },
 
 /// Absolute rectangle on the screen for the widget. Will only be updated by
-/// calling `View.updateAbsolutePositions`.
+/// the `View` functions that insert and move widgets, or by calling `View.updateAbsolutePositions`.
 absolute_bounds: ui.Rectangle = undefined,
 
 /// If a widget is enabled, it is able to receive events from the user. Otherwise,
@@ -159,10 +161,15 @@ pub const Iterator = struct {
     }
 };
 
+/// Incremented by `setPosition` and `setSize`, so a `View` notices that its hit test index
+/// may be outdated without walking all of its widgets.
+pub var bounds_revision: u32 = 0;
+
 /// Moves the widget on the screen, relative to its parent.
 /// **NOTE:** If a layout engine is used, it might override the values set here.
 pub fn setPosition(widget: *Widget, pos: ui.Point) void {
     widget.bounds.position = pos;
+    bounds_revision +%= 1;
 }
 
 /// Resizes the widget, respecting size constraints.
@@ -172,6 +179,7 @@ pub fn setSize(widget: *Widget, size: ui.Size) void {
         std.math.clamp(size.width, widget.bounds.min_size.width, widget.bounds.max_size.width),
         std.math.clamp(size.height, widget.bounds.min_size.height, widget.bounds.max_size.height),
     );
+    bounds_revision +%= 1;
 }
 
 /// Sets the position and size of the widget, respecting size constraints.
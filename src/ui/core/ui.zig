@@ -28,6 +28,9 @@ pub const Builder = @import("Builder.zig");
 
 pub const MemoryPool = @import("MemoryPool.zig").MemoryPool;
 pub const RingBuffer = @import("RingBuffer.zig").RingBuffer;
+pub const HitGrid = @import("HitGrid.zig").HitGrid;
+pub const HitBox = @import("HitGrid.zig").Box;
+pub const TextBuffer = @import("TextBuffer.zig");
 
 pub const Visibility = enum {
     /// The item is fully visible
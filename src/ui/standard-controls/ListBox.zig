@@ -1,3 +1,72 @@
+//!
+//! A list box shows a vertical list of text rows the user can select from.
+//! Rows are pulled from a `DataSource` on demand. Only the rows in the visible
+//! window are queried and drawn, so a list can hold millions of rows.
+//!
+
+const std = @import("std");
+const ui = @import("ui");
+const RowIndex = @import("RowIndex.zig");
+
+const ListBox = @This();
+
+/// Provides the rows of a list box.
+pub const DataSource = struct {
+    ptr: *anyopaque,
+    vtable: *const VTable,
+
+    pub const VTable = struct {
+        /// Returns the number of rows.
+        getCountFn: *const fn (*anyopaque) usize,
+
+        /// Returns the text of the row at `index`. The text must stay valid until the next call.
+        getTextFn: *const fn (*anyopaque, index: usize) []const u8,
+
+        /// Returns the height of the row at `index` in pixels. Heights are cached until `ListBox.reload`
+        /// is called. If `null`, all rows are `ListBox.row_height` pixels high.
+        getHeightFn: ?*const fn (*anyopaque, index: usize) u15 = null,
+    };
+
+    pub fn getCount(source: DataSource) usize {
+        return source.vtable.getCountFn(source.ptr);
+    }
+
+    pub fn getText(source: DataSource, index: usize) []const u8 {
+        return source.vtable.getTextFn(source.ptr, index);
+    }
+};
+
+on_selection_changed: ?ui.EventHandler = null,
+
+font: ?ui.Font = null,
+
+source: ?DataSource = null,
+
+/// Height of every row in pixels, unless the data source provides individual heights.
+row_height: u15 = 20,
+
+/// Number of rows above and below the visible window that are prepared as well.
+overscan: u15 = 2,
+
+/// Vertical scroll position in pixels.
+scroll_offset: u64 = 0,
+
+/// Index of the selected row, if any.
+selection: ?usize = null,
+
+/// Height of the list box during the last `update`, used for paging.
+viewport_height: u15 = 0,
+
+rows: RowIndex = undefined,
+
+pub fn init(ctrl: *ListBox, allocator: std.mem.Allocator) !void {
+    ctrl.rows = RowIndex.init(allocator);
+}
+
+pub fn deinit(ctrl: *ListBox) void {
+    ctrl.rows.deinit();
+}
+
 pub fn canReceiveFocus(ctrl: *@This()) bool {
     _ = ctrl;
     return true;
@@ -7,3 +76,89 @@ pub fn isHitTestVisible(ctrl: *@This()) bool {
     _ = ctrl;
     return true;
 }
+
+/// Brings the row index up to date with the data source for a list box of `viewport_height` pixels.
+/// Rows appended to the data source are measured incrementally, the other cached heights are kept.
+pub fn update(ctrl: *ListBox, viewport_height: u15) !void {
+    ctrl.viewport_height = viewport_height;
+
+    const count = if (ctrl.source) |source| source.getCount() else 0;
+    const getHeight = if (ctrl.source) |source| source.vtable.getHeightFn else null;
+
+    if (getHeight) |getHeightFn| {
+        ctrl.rows.setVariable();
+        ctrl.rows.truncate(count);
+        while (ctrl.rows.count < count) {
+            try ctrl.rows.append(getHeightFn(ctrl.source.?.ptr, ctrl.rows.count));
+        }
+    } else {
+        ctrl.rows.setFixed(ctrl.row_height, count);
+    }
+
+    if (ctrl.selection) |row| {
+        if (row >= count)
+            ctrl.selection = null;
+    }
+    ctrl.scroll_offset = ctrl.rows.clampScroll(ctrl.scroll_offset, viewport_height);
+}
+
+/// Drops all cached row heights, so they are queried again in the next `update`.
+pub fn reload(ctrl: *ListBox) void {
+    ctrl.rows.truncate(0);
+}
+
+/// Returns the rows that have to be drawn at the current scroll position.
+pub fn visibleRows(ctrl: ListBox) RowIndex.Range {
+    return ctrl.rows.visibleRange(ctrl.scroll_offset, ctrl.viewport_height, ctrl.overscan);
+}
+
+/// Returns the area of `row` when the list box is drawn into `area`.
+pub fn rowRectangle(ctrl: ListBox, area: ui.Rectangle, row: usize) ui.Rectangle {
+    const top = @intCast(i64, ctrl.rows.offsetOf(row)) - @intCast(i64, ctrl.scroll_offset);
+    return ui.Rectangle{
+        .x = area.x,
+        .y = @intCast(i16, std.math.clamp(area.y + top, std.math.minInt(i16), std.math.maxInt(i16))),
+        .width = area.width,
+        .height = ctrl.rows.heightOf(row),
+    };
+}
+
+/// Scrolls the least amount so `row` is fully visible.
+pub fn scrollToRow(ctrl: *ListBox, row: usize) void {
+    ctrl.scroll_offset = ctrl.rows.scrollTo(ctrl.scroll_offset, row, ctrl.viewport_height);
+}
+
+/// Selects `row`, scrolls it into view and emits `on_selection_changed` if the selection changed.
+pub fn select(ctrl: *ListBox, widget: *ui.Widget, view: *ui.View, row: ?usize) void {
+    if (std.meta.eql(ctrl.selection, row))
+        return;
+    ctrl.selection = row;
+    if (row) |index| {
+        ctrl.scrollToRow(index);
+    }
+    if (ctrl.on_selection_changed) |handler| {
+        view.pushEvent(.{
+            .sender = widget,
+            .data = .none,
+            .handler = handler,
+        });
+    }
+}
+
+pub fn sendInput(ctrl: *ListBox, widget: *ui.Widget, view: *ui.View, input: ui.Widget.Event) ui.Widget.InputHandling {
+    switch (input) {
+        .mouse_button_down => |button| if (button == .primary and ctrl.rows.count > 0) {
+            const y = view.mouse_position.y - widget.absolute_bounds.y;
+            // `rowAt` clamps to the last row, so clicks into the empty space below it are dropped here.
+            if (y >= 0 and ctrl.scroll_offset + @intCast(u64, y) < ctrl.rows.totalHeight()) {
+                ctrl.select(widget, view, ctrl.rows.rowAt(ctrl.scroll_offset + @intCast(u64, y)));
+            }
+        },
+        .key_down => |key| if (RowIndex.stepFromKey(key.key)) |step| {
+            ctrl.select(widget, view, ctrl.rows.navigate(ctrl.selection, step, ctrl.viewport_height));
+            return .ignore;
+        },
+        else => {},
+    }
+    return .process;
+}
@@ -1,3 +1,77 @@
+//!
+//! A multi-line text editor with styled runs of text. The text is stored in a
+//! `ui.TextBuffer`, so only the lines in view are measured and drawn, and moving
+//! the cursor doesn't depend on the length of the text.
+//!
+
+const std = @import("std");
+const ui = @import("ui");
+const RichTextEditor = @This();
+const TextBox = @import("TextBox.zig");
+const logger = std.log.scoped(.RichTextEditor);
+
+/// Space between the border and the text in pixels, the same as in a text box.
+pub const padding = TextBox.padding;
+
+/// The look of a run of text. `null` values use the theme of the renderer.
+pub const Style = struct {
+    color: ?ui.Color = null,
+    background: ?ui.Color = null,
+    underline: bool = false,
+};
+
+/// A range of text that shares a style. It begins at the end of the previous run, `end` is exclusive.
+pub const Run = struct {
+    end: usize,
+    style: Style,
+};
+
+/// A part of the text with a single style, returned by `styleRuns`.
+pub const Segment = struct {
+    start: usize,
+    end: usize,
+    style: Style,
+};
+
+// public:
+read_only: bool = false,
+font: ?ui.Font = null,
+buffer: ui.TextBuffer = undefined,
+
+// private:
+allocator: std.mem.Allocator = undefined,
+
+/// The runs in text order. They cover the whole text, so the last run ends at the end of the text.
+runs: std.ArrayListUnmanaged(Run) = .{},
+
+/// Byte offset of the cursor in `buffer`.
+cursor: usize = 0,
+
+/// The horizontal position the cursor keeps while it moves up and down.
+preferred_x: ?u32 = null,
+
+/// Horizontal and vertical scroll position in pixels, changed by `update` to keep the cursor visible.
+scroll_x: u32 = 0,
+scroll_y: u64 = 0,
+
+/// Horizontal position of the cursor in its line, set by `update`.
+cursor_x: u32 = 0,
+
+/// The font, line height and viewport of the last `update`.
+layout_font: ?ui.Font = null,
+line_height: u15 = 1,
+viewport: ui.Size = ui.Size.new(0, 0),
+
+pub fn init(ctrl: *RichTextEditor, allocator: std.mem.Allocator) !void {
+    ctrl.allocator = allocator;
+    ctrl.buffer = try ui.TextBuffer.init(allocator, "");
+}
+
+pub fn deinit(ctrl: *RichTextEditor) void {
+    ctrl.runs.deinit(ctrl.allocator);
+    ctrl.buffer.deinit();
+}
+
 pub fn canReceiveFocus(ctrl: *@This()) bool {
     _ = ctrl;
     return true;
@@ -7,3 +81,282 @@ pub fn isHitTestVisible(ctrl: *@This()) bool {
     _ = ctrl;
     return true;
 }
+
+/// Replaces the text with `string` in the default style.
+pub fn setText(ctrl: *RichTextEditor, string: []const u8) !void {
+    try ctrl.runs.ensureTotalCapacity(ctrl.allocator, 1);
+    try ctrl.buffer.setText(string);
+
+    ctrl.runs.shrinkRetainingCapacity(0);
+    if (string.len > 0) {
+        ctrl.runs.appendAssumeCapacity(Run{ .end = string.len, .style = .{} });
+    }
+    ctrl.cursor = 0;
+    ctrl.preferred_x = null;
+}
+
+pub fn getText(ctrl: *RichTextEditor) []const u8 {
+    return ctrl.buffer.getText();
+}
+
+/// Inserts `text` at `offset`. The text takes the style of the run it is inserted into.
+pub fn insert(ctrl: *RichTextEditor, offset: usize, text: []const u8) !void {
+    if (text.len == 0)
+        return;
+    try ctrl.runs.ensureUnusedCapacity(ctrl.allocator, 1);
+    try ctrl.buffer.insert(offset, text);
+
+    if (ctrl.runs.items.len == 0) {
+        ctrl.runs.appendAssumeCapacity(Run{ .end = text.len, .style = .{} });
+    } else {
+        // text at the end of a run extends that run
+        for (ctrl.runs.items) |*run| {
+            if (run.end >= offset)
+                run.end += text.len;
+        }
+    }
+
+    if (ctrl.cursor >= offset)
+        ctrl.cursor += text.len;
+}
+
+/// Removes the text between `start` and `end`.
+pub fn remove(ctrl: *RichTextEditor, start: usize, end: usize) void {
+    ctrl.buffer.remove(start, end);
+
+    const length = end - start;
+    var count: usize = 0;
+    var previous_end: usize = 0;
+    for (ctrl.runs.items) |run| {
+        var new_end = run.end;
+        if (new_end > end) {
+            new_end -= length;
+        } else if (new_end > start) {
+            new_end = start;
+        }
+        // drop runs that became empty
+        if (new_end > previous_end) {
+            ctrl.runs.items[count] = Run{ .end = new_end, .style = run.style };
+            count += 1;
+            previous_end = new_end;
+        }
+    }
+    ctrl.runs.shrinkRetainingCapacity(count);
+    ctrl.mergeRuns();
+
+    if (ctrl.cursor > end) {
+        ctrl.cursor -= length;
+    } else if (ctrl.cursor > start) {
+        ctrl.cursor = start;
+    }
+}
+
+/// Applies `style` to the text between `start` and `end`.
+pub fn setStyle(ctrl: *RichTextEditor, start: usize, end: usize, style: Style) !void {
+    std.debug.assert(start <= end and end <= ctrl.buffer.len());
+    if (start == end)
+        return;
+
+    try ctrl.runs.ensureUnusedCapacity(ctrl.allocator, 2);
+    ctrl.splitRun(start);
+    ctrl.splitRun(end);
+
+    var run_start: usize = 0;
+    for (ctrl.runs.items) |*run| {
+        if (run_start >= start and run.end <= end)
+            run.style = style;
+        run_start = run.end;
+    }
+    ctrl.mergeRuns();
+}
+
+/// Returns the index of the run that contains `offset`.
+pub fn runAt(ctrl: RichTextEditor, offset: usize) usize {
+    const runs = ctrl.runs.items;
+    var low: usize = 0;
+    var high: usize = runs.len;
+    while (low < high) {
+        const mid = low + (high - low) / 2;
+        if (runs[mid].end <= offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/// Returns the parts of the text between `start` and `end` with a common style.
+pub fn styleRuns(ctrl: RichTextEditor, start: usize, end: usize) SegmentIterator {
+    return SegmentIterator{
+        .runs = ctrl.runs.items,
+        .index = ctrl.runAt(start),
+        .pos = start,
+        .end = end,
+    };
+}
+
+pub const SegmentIterator = struct {
+    runs: []const Run,
+    index: usize,
+    pos: usize,
+    end: usize,
+
+    pub fn next(iterator: *SegmentIterator) ?Segment {
+        if (iterator.pos >= iterator.end)
+            return null;
+
+        var segment = Segment{ .start = iterator.pos, .end = iterator.end, .style = .{} };
+        if (iterator.index < iterator.runs.len) {
+            const run = iterator.runs[iterator.index];
+            segment.end = std.math.min(run.end, iterator.end);
+            segment.style = run.style;
+            iterator.index += 1;
+        }
+        iterator.pos = segment.end;
+        return segment;
+    }
+};
+
+/// Returns the first and the last line that are visible at the current scroll position.
+pub fn visibleLines(ctrl: RichTextEditor) [2]usize {
+    const last_line = ctrl.buffer.lineCount() - 1;
+    const first = std.math.min(ctrl.scroll_y / ctrl.line_height, last_line);
+    const last = std.math.min((ctrl.scroll_y + ctrl.viewport.height) / ctrl.line_height, last_line);
+    return [2]usize{ @intCast(usize, first), @intCast(usize, last) };
+}
+
+/// Prepares the editor for drawing with `font` into an area of `size` and scrolls the cursor into view.
+pub fn update(ctrl: *RichTextEditor, font: ui.Font, size: ui.Size) !void {
+    ctrl.layout_font = font;
+    ctrl.buffer.setFont(@ptrToInt(font.ptr));
+    ctrl.line_height = std.math.max(font.getLineHeight(), 1);
+    ctrl.viewport = ui.Size.new(size.width -| 2 * padding, size.height -| 2 * padding);
+
+    ctrl.cursor_x = try ctrl.buffer.offsetToX(font, ctrl.cursor);
+    if (ctrl.cursor_x < ctrl.scroll_x) {
+        ctrl.scroll_x = ctrl.cursor_x;
+    } else if (ctrl.cursor_x > ctrl.scroll_x + ctrl.viewport.width) {
+        ctrl.scroll_x = ctrl.cursor_x - ctrl.viewport.width;
+    }
+
+    const top = @as(u64, ctrl.buffer.lineOf(ctrl.cursor)) * ctrl.line_height;
+    if (top < ctrl.scroll_y) {
+        ctrl.scroll_y = top;
+    } else if (top + ctrl.line_height > ctrl.scroll_y + ctrl.viewport.height) {
+        ctrl.scroll_y = (top + ctrl.line_height) -| ctrl.viewport.height;
+    }
+}
+
+pub fn sendInput(ctrl: *RichTextEditor, widget: *ui.Widget, view: *ui.View, input: ui.Widget.Event) ui.Widget.InputHandling {
+    switch (input) {
+        .mouse_button_down => |button| if (button == .primary) {
+            const font = ctrl.layout_font orelse return .ignore;
+            const x = @as(i32, view.mouse_position.x) - widget.absolute_bounds.x - padding + @intCast(i32, ctrl.scroll_x);
+            const y = @as(i64, view.mouse_position.y) - widget.absolute_bounds.y - padding + @intCast(i64, ctrl.scroll_y);
+            const line = std.math.min(@intCast(usize, std.math.max(y, 0)) / ctrl.line_height, ctrl.buffer.lineCount() - 1);
+            ctrl.cursor = ctrl.buffer.xToOffset(font, line, x) catch |err| blk: {
+                logger.err("Could not place cursor: {s}", .{@errorName(err)});
+                break :blk ctrl.cursor;
+            };
+            ctrl.preferred_x = null;
+        },
+
+        .key_down => |key_info| {
+            const unit: ui.TextBuffer.Unit = if (key_info.modifiers.ctrl) .word else .letter;
+            switch (key_info.key) {
+                .left => ctrl.moveCursor(ctrl.buffer.step(ctrl.cursor, .left, unit)),
+                .right => ctrl.moveCursor(ctrl.buffer.step(ctrl.cursor, .right, unit)),
+                .up => ctrl.moveLines(-1),
+                .down => ctrl.moveLines(1),
+                .page_up => ctrl.moveLines(-@as(isize, ctrl.viewport.height / ctrl.line_height)),
+                .page_down => ctrl.moveLines(@as(isize, ctrl.viewport.height / ctrl.line_height)),
+
+                .home => ctrl.moveCursor(if (key_info.modifiers.ctrl) 0 else ctrl.buffer.step(ctrl.cursor, .left, .line)),
+                .end => ctrl.moveCursor(if (key_info.modifiers.ctrl) ctrl.buffer.len() else ctrl.buffer.step(ctrl.cursor, .right, .line)),
+
+                .backspace => ctrl.delete(.left, unit),
+                .delete => ctrl.delete(.right, unit),
+                .@"return", .keypad_enter => ctrl.enterText("\n"),
+
+                else => return .process,
+            }
+        },
+
+        .text_input => |text| ctrl.enterText(text),
+
+        .mouse_button_up,
+        .mouse_motion,
+        .mouse_enter,
+        .mouse_leave,
+        .click,
+        .enter,
+        .leave,
+        => {},
+
+        .key_up => return .process,
+    }
+
+    return .ignore;
+}
+
+fn moveCursor(ctrl: *RichTextEditor, offset: usize) void {
+    ctrl.cursor = offset;
+    ctrl.preferred_x = null;
+}
+
+/// Moves the cursor `delta` lines up or down and keeps its horizontal position.
+fn moveLines(ctrl: *RichTextEditor, delta: isize) void {
+    const font = ctrl.layout_font orelse return;
+    const x = if (ctrl.preferred_x) |preferred| preferred else ctrl.buffer.offsetToX(font, ctrl.cursor) catch return;
+
+    const line = @intCast(isize, ctrl.buffer.lineOf(ctrl.cursor));
+    const target = std.math.clamp(line + delta, 0, @intCast(isize, ctrl.buffer.lineCount() - 1));
+    ctrl.cursor = ctrl.buffer.xToOffset(font, @intCast(usize, target), @intCast(i32, std.math.min(x, std.math.maxInt(i32)))) catch return;
+    ctrl.preferred_x = x;
+}
+
+fn delete(ctrl: *RichTextEditor, direction: ui.TextBuffer.Direction, unit: ui.TextBuffer.Unit) void {
+    if (ctrl.read_only)
+        return;
+    const other = ctrl.buffer.step(ctrl.cursor, direction, unit);
+    ctrl.remove(std.math.min(ctrl.cursor, other), std.math.max(ctrl.cursor, other));
+    ctrl.preferred_x = null;
+}
+
+fn enterText(ctrl: *RichTextEditor, text: []const u8) void {
+    if (ctrl.read_only)
+        return;
+    ctrl.insert(ctrl.cursor, text) catch |err| logger.err("Could not insert text: {s}", .{@errorName(err)});
+    ctrl.preferred_x = null;
+}
+
+/// Splits the run that contains `offset`, so a run ends at `offset`. Needs capacity for one more run.
+fn splitRun(ctrl: *RichTextEditor, offset: usize) void {
+    const index = ctrl.runAt(offset);
+    if (index >= ctrl.runs.items.len)
+        return;
+    const run_start = if (index > 0) ctrl.runs.items[index - 1].end else 0;
+    if (run_start == offset)
+        return;
+    const run = Run{ .end = offset, .style = ctrl.runs.items[index].style };
+    ctrl.runs.insert(ctrl.allocator, index, run) catch unreachable; // capacity was reserved by the caller
+}
+
+/// Joins neighbouring runs with the same style.
+fn mergeRuns(ctrl: *RichTextEditor) void {
+    const runs = ctrl.runs.items;
+    if (runs.len == 0)
+        return;
+
+    var count: usize = 1;
+    for (runs[1..]) |run| {
+        if (std.meta.eql(runs[count - 1].style, run.style)) {
+            runs[count - 1].end = run.end;
+        } else {
+            runs[count] = run;
+            count += 1;
+        }
+    }
+    ctrl.runs.shrinkRetainingCapacity(count);
+}
@@ -0,0 +1,260 @@
+//!
+//! Maps between row indices and vertical pixel offsets of a virtualized list.
+//! Rows either all share the same height, or their heights are cached in a
+//! Fenwick tree, so both directions take O(log n) and rows can be appended
+//! and resized without touching the others.
+//!
+
+const std = @import("std");
+
+const RowIndex = @This();
+
+allocator: std.mem.Allocator,
+
+/// Number of rows.
+count: usize = 0,
+
+/// Height of every row, if `variable` is `false`.
+fixed_height: u15 = 0,
+
+/// If `true`, row heights are stored in `heights` and `tree`.
+variable: bool = false,
+
+/// The cached height of each row.
+heights: std.ArrayListUnmanaged(u15) = .{},
+
+/// Fenwick tree over `heights`: `tree.items[i - 1]` is the sum of the rows `(i - lowbit(i), i]`.
+tree: std.ArrayListUnmanaged(u64) = .{},
+
+pub fn init(allocator: std.mem.Allocator) RowIndex {
+    return RowIndex{ .allocator = allocator };
+}
+
+pub fn deinit(index: *RowIndex) void {
+    index.heights.deinit(index.allocator);
+    index.tree.deinit(index.allocator);
+    index.* = undefined;
+}
+
+/// Makes all `count` rows `height` pixels high.
+pub fn setFixed(index: *RowIndex, height: u15, count: usize) void {
+    index.variable = false;
+    index.fixed_height = height;
+    index.count = count;
+    index.heights.shrinkRetainingCapacity(0);
+    index.tree.shrinkRetainingCapacity(0);
+}
+
+/// Switches to individual row heights. Keeps the rows if the index already stored individual heights.
+pub fn setVariable(index: *RowIndex) void {
+    if (!index.variable) {
+        index.variable = true;
+        index.count = 0;
+    }
+}
+
+/// Removes all rows from `count` on.
+pub fn truncate(index: *RowIndex, count: usize) void {
+    if (count >= index.count)
+        return;
+    index.count = count;
+    if (index.variable) {
+        // the entries below `count` only cover rows below `count`
+        index.heights.shrinkRetainingCapacity(count);
+        index.tree.shrinkRetainingCapacity(count);
+    }
+}
+
+/// Appends a row with `height` pixels. Requires individual row heights.
+pub fn append(index: *RowIndex, height: u15) !void {
+    std.debug.assert(index.variable);
+
+    const i = index.count + 1; // one based
+    const covered_start = i - lowbit(i);
+    const sum = @as(u64, height) + index.prefix(i - 1) - index.prefix(covered_start);
+
+    try index.heights.ensureUnusedCapacity(index.allocator, 1);
+    try index.tree.ensureUnusedCapacity(index.allocator, 1);
+    index.heights.appendAssumeCapacity(height);
+    index.tree.appendAssumeCapacity(sum);
+    index.count += 1;
+}
+
+/// Changes the height of the row at `row`. Requires individual row heights.
+pub fn setHeight(index: *RowIndex, row: usize, height: u15) void {
+    std.debug.assert(index.variable);
+
+    const old = index.heights.items[row];
+    if (old == height)
+        return;
+    index.heights.items[row] = height;
+
+    var i = row + 1;
+    while (i <= index.count) : (i += lowbit(i)) {
+        index.tree.items[i - 1] = index.tree.items[i - 1] + height - old;
+    }
+}
+
+pub fn heightOf(index: RowIndex, row: usize) u15 {
+    return if (index.variable) index.heights.items[row] else index.fixed_height;
+}
+
+/// Returns the vertical offset of the top of `row`. `row` may be `count` to get the total height.
+pub fn offsetOf(index: RowIndex, row: usize) u64 {
+    std.debug.assert(row <= index.count);
+    if (!index.variable)
+        return @as(u64, index.fixed_height) * @as(u64, row);
+    return index.prefix(row);
+}
+
+pub fn totalHeight(index: RowIndex) u64 {
+    return index.offsetOf(index.count);
+}
+
+/// Returns the row that contains the vertical offset `y`, clamped to the last row.
+/// Returns 0 if there are no rows.
+pub fn rowAt(index: RowIndex, y: u64) usize {
+    if (index.count == 0)
+        return 0;
+
+    if (!index.variable) {
+        if (index.fixed_height == 0)
+            return 0;
+        return @intCast(usize, std.math.min(y / index.fixed_height, index.count - 1));
+    }
+
+    // Walk down the tree and find the number of rows that end at or before `y`.
+    var pos: usize = 0;
+    var remaining = y;
+    var step = std.math.floorPowerOfTwo(usize, index.count);
+    while (step > 0) : (step /= 2) {
+        if (pos + step <= index.count and index.tree.items[pos + step - 1] <= remaining) {
+            pos += step;
+            remaining -= index.tree.items[pos - 1];
+        }
+    }
+    return std.math.min(pos, index.count - 1);
+}
+
+/// A range of rows, `end` is exclusive.
+pub const Range = struct {
+    first: usize,
+    end: usize,
+};
+
+/// Returns the rows that intersect a viewport of `height` pixels at `scroll_offset`,
+/// extended by `overscan` rows in both directions.
+pub fn visibleRange(index: RowIndex, scroll_offset: u64, height: u15, overscan: usize) Range {
+    if (index.count == 0 or height == 0)
+        return Range{ .first = 0, .end = 0 };
+    const first = index.rowAt(scroll_offset);
+    const last = index.rowAt(scroll_offset + height - 1);
+    return Range{
+        .first = first -| overscan,
+        .end = std.math.min(last + 1 + overscan, index.count),
+    };
+}
+
+/// Returns the scroll offset closest to `scroll_offset` that shows `row` completely in a viewport of `height` pixels.
+pub fn scrollTo(index: RowIndex, scroll_offset: u64, row: usize, height: u15) u64 {
+    const top = index.offsetOf(row);
+    const bottom = top + index.heightOf(row);
+    if (top < scroll_offset)
+        return top;
+    if (bottom > scroll_offset + height)
+        return bottom -| height;
+    return scroll_offset;
+}
+
+/// Limits `scroll_offset` so a viewport of `height` pixels doesn't scroll past the last row.
+pub fn clampScroll(index: RowIndex, scroll_offset: u64, height: u15) u64 {
+    return std.math.min(scroll_offset, index.totalHeight() -| height);
+}
+
+/// A keyboard navigation step through the rows.
+pub const Step = enum { previous, next, page_up, page_down, first, last };
+
+/// Maps the navigation keys of a `ui.KeyCode` to a step.
+pub fn stepFromKey(key: anytype) ?Step {
+    return switch (key) {
+        .up => .previous,
+        .down => .next,
+        .page_up => .page_up,
+        .page_down => .page_down,
+        .home => .first,
+        .end => .last,
+        else => null,
+    };
+}
+
+/// Returns the row reached from `current` with `step` in a viewport of `height` pixels.
+pub fn navigate(index: RowIndex, current: ?usize, step: Step, height: u15) ?usize {
+    if (index.count == 0)
+        return null;
+    const last = index.count - 1;
+    const row = std.math.min(current orelse return if (step == .last) last else 0, last);
+    return switch (step) {
+        .previous => row -| 1,
+        .next => std.math.min(row + 1, last),
+        .page_up => index.rowAt(index.offsetOf(row) -| height),
+        .page_down => index.rowAt(index.offsetOf(row) + height),
+        .first => 0,
+        .last => last,
+    };
+}
+
+/// Returns the sum of the first `count` row heights.
+fn prefix(index: RowIndex, count: usize) u64 {
+    var sum: u64 = 0;
+    var i = count;
+    while (i > 0) : (i -= lowbit(i)) {
+        sum += index.tree.items[i - 1];
+    }
+    return sum;
+}
+
+fn lowbit(i: usize) usize {
+    return i & (~i +% 1);
+}
+
+test "row index: fixed height" {
+    var index = RowIndex.init(std.testing.allocator);
+    defer index.deinit();
+
+    index.setFixed(20, 1_000_000);
+    try std.testing.expectEqual(@as(u64, 20_000_000), index.totalHeight());
+    try std.testing.expectEqual(@as(usize, 0), index.rowAt(19));
+    try std.testing.expectEqual(@as(usize, 1), index.rowAt(20));
+    try std.testing.expectEqual(@as(usize, 999_999), index.rowAt(std.math.maxInt(u64)));
+}
+
+test "row index: variable height" {
+    var index = RowIndex.init(std.testing.allocator);
+    defer index.deinit();
+
+    index.setVariable();
+
+    const row_count = 1000;
+    var expected_offset: u64 = 0;
+    var i: usize = 0;
+    while (i < row_count) : (i += 1) {
+        try index.append(@intCast(u15, 10 + i % 7));
+    }
+
+    i = 0;
+    while (i < row_count) : (i += 1) {
+        try std.testing.expectEqual(expected_offset, index.offsetOf(i));
+        try std.testing.expectEqual(i, index.rowAt(expected_offset));
+        try std.testing.expectEqual(i, index.rowAt(expected_offset + index.heightOf(i) - 1));
+        expected_offset += index.heightOf(i);
+    }
+    try std.testing.expectEqual(expected_offset, index.totalHeight());
+
+    index.setHeight(10, 100);
+    try std.testing.expectEqual(index.offsetOf(10) + 100, index.offsetOf(11));
+    try std.testing.expectEqual(@as(usize, 10), index.rowAt(index.offsetOf(10) + 99));
+
+    index.truncate(500);
+    try index.append(5);
+    try std.testing.expectEqual(index.offsetOf(500) + 5, index.totalHeight());
+}
@@ -3,11 +3,13 @@
 //!
 
 const std = @import("std");
-const TextEditor = @import("TextEditor");
 const ui = @import("ui");
 const TextBox = @This();
 const logger = std.log.scoped(.TextBox);
 
+/// Space between the border and the text in pixels.
+pub const padding = 2;
+
 const Flags = packed struct {
     password: bool = false,
     read_only: bool = false,
@@ -15,21 +17,30 @@ const Flags = packed struct {
 
 // public:
 flags: Flags = .{},
-editor: TextEditor = undefined,
+buffer: ui.TextBuffer = undefined,
 font: ?ui.Font = null,
 
 // private:
 
+/// Byte offset of the cursor in `buffer`.
+cursor: usize = 0,
+
 /// The scroll offset of the cursor. Shift of the text to the left.
-/// Should be changed by the renderer to scroll the text view left/right on overflow.
-scroll_offset: u15 = 0,
+/// Changed by `update` to keep the cursor visible.
+scroll_offset: u32 = 0,
+
+/// Horizontal position of the cursor in the text, set by `update`.
+cursor_x: u32 = 0,
+
+/// The font used in the last `update`, used to place the cursor on clicks.
+layout_font: ?ui.Font = null,
 
 pub fn init(ctrl: *TextBox, allocator: std.mem.Allocator) !void {
-    ctrl.editor = try TextEditor.init(allocator, "");
+    ctrl.buffer = try ui.TextBuffer.init(allocator, "");
 }
 
 pub fn deinit(ctrl: *TextBox) void {
-    ctrl.editor.deinit();
+    ctrl.buffer.deinit();
 }
 
 pub fn canReceiveFocus(ctrl: *TextBox) bool {
@@ -43,23 +54,58 @@ pub fn isHitTestVisible(ctrl: *TextBox) bool {
 }
 
 pub fn setText(ctrl: *TextBox, string: []const u8) !void {
-    try ctrl.editor.setText(string);
+    try ctrl.buffer.setText(string);
+    ctrl.cursor = ctrl.buffer.len();
 }
 
-pub fn getText(ctrl: TextBox) []const u8 {
-    return ctrl.editor.getText();
+pub fn getText(ctrl: *TextBox) []const u8 {
+    return ctrl.buffer.getText();
 }
 
+/// Returns the byte offset of the cursor.
 pub fn getCursor(ctrl: TextBox) usize {
-    return ctrl.editor.cursor;
+    return ctrl.cursor;
 }
 
-pub fn sendInput(ctrl: *TextBox, widget: *ui.Widget, view: *ui.View, input: ui.Widget.Event) ui.Widget.InputHandling {
-    _ = widget;
-    _ = view;
+/// Prepares the text box for drawing with `font` into an area `width` pixels wide and scrolls
+/// the cursor into view. Only the line of the cursor is measured, and only once per change.
+pub fn update(ctrl: *TextBox, font: ui.Font, width: u15) !void {
+    ctrl.layout_font = font;
+    ctrl.buffer.setFont(@ptrToInt(font.ptr));
+    ctrl.cursor_x = try ctrl.buffer.offsetToX(font, ctrl.cursor);
+
+    const view_width = width -| 2 * padding;
+    if (ctrl.cursor_x < ctrl.scroll_offset) {
+        ctrl.scroll_offset = ctrl.cursor_x;
+    } else if (ctrl.cursor_x > ctrl.scroll_offset + view_width) {
+        ctrl.scroll_offset = ctrl.cursor_x - view_width;
+    }
+}
 
+fn moveCursor(ctrl: *TextBox, direction: ui.TextBuffer.Direction, unit: ui.TextBuffer.Unit) void {
+    ctrl.cursor = ctrl.buffer.step(ctrl.cursor, direction, unit);
+}
+
+fn delete(ctrl: *TextBox, direction: ui.TextBuffer.Direction, unit: ui.TextBuffer.Unit) void {
+    if (ctrl.flags.read_only)
+        return;
+    const other = ctrl.buffer.step(ctrl.cursor, direction, unit);
+    const start = std.math.min(ctrl.cursor, other);
+    ctrl.buffer.remove(start, std.math.max(ctrl.cursor, other));
+    ctrl.cursor = start;
+}
+
+pub fn sendInput(ctrl: *TextBox, widget: *ui.Widget, view: *ui.View, input: ui.Widget.Event) ui.Widget.InputHandling {
     switch (input) {
-        .mouse_button_down,
+        .mouse_button_down => |button| if (button == .primary) {
+            const font = ctrl.layout_font orelse return .ignore;
+            const x = @as(i32, view.mouse_position.x) - widget.absolute_bounds.x - padding + @intCast(i32, ctrl.scroll_offset);
+            ctrl.cursor = ctrl.buffer.xToOffset(font, ctrl.buffer.lineOf(ctrl.cursor), x) catch |err| blk: {
+                logger.err("Could not place cursor: {s}", .{@errorName(err)});
+                break :blk ctrl.cursor;
+            };
+        },
+
         .mouse_button_up,
         .mouse_motion,
         .mouse_enter,
@@ -70,24 +116,24 @@ pub fn sendInput(ctrl: *TextBox, widget: *ui.Widget, view: *ui.View, input: ui.W
         => return .ignore,
 
         .key_down => |key_info| switch (key_info.key) {
-            .left => ctrl.editor.moveCursor(.left, if (key_info.modifiers.ctrl)
+            .left => ctrl.moveCursor(.left, if (key_info.modifiers.ctrl)
                 .word
             else
                 .letter),
-            .right => ctrl.editor.moveCursor(.right, if (key_info.modifiers.ctrl)
+            .right => ctrl.moveCursor(.right, if (key_info.modifiers.ctrl)
                 .word
             else
                 .letter),
 
-            .home => ctrl.editor.moveCursor(.left, .line),
-            .end => ctrl.editor.moveCursor(.right, .line),
+            .home => ctrl.moveCursor(.left, .line),
+            .end => ctrl.moveCursor(.right, .line),
 
-            .backspace => ctrl.editor.delete(.left, if (key_info.modifiers.ctrl)
+            .backspace => ctrl.delete(.left, if (key_info.modifiers.ctrl)
                 .word
             else
                 .letter),
 
-            .delete => ctrl.editor.delete(.right, if (key_info.modifiers.ctrl)
+            .delete => ctrl.delete(.right, if (key_info.modifiers.ctrl)
                 .word
             else
                 .letter),
@@ -98,7 +144,13 @@ pub fn sendInput(ctrl: *TextBox, widget: *ui.Widget, view: *ui.View, input: ui.W
         .key_up => return .process,
 
         .text_input => |text| {
-            ctrl.editor.insertText(text) catch |err| logger.err("Could not insert text: {s}", .{@errorName(err)});
+            if (!ctrl.flags.read_only) {
+                if (ctrl.buffer.insert(ctrl.cursor, text)) {
+                    ctrl.cursor += text.len;
+                } else |err| {
+                    logger.err("Could not insert text: {s}", .{@errorName(err)});
+                }
+            }
         },
     }
 
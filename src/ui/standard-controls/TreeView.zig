@@ -1,3 +1,114 @@
+//!
+//! A tree view shows a hierarchy of text nodes that can be expanded and collapsed.
+//! Nodes are pulled from a `DataSource`. The tree view only keeps the flat list of
+//! currently reachable nodes and queries texts for the rows in the visible window.
+//!
+
+const std = @import("std");
+const ui = @import("ui");
+const RowIndex = @import("RowIndex.zig");
+
+const TreeView = @This();
+
+/// Provides the nodes of a tree view. Nodes are identified by a number chosen by the data source.
+pub const DataSource = struct {
+    ptr: *anyopaque,
+    vtable: *const VTable,
+
+    pub const VTable = struct {
+        /// Returns the number of children of `parent`, or the number of root nodes if `parent` is `null`.
+        getChildCountFn: *const fn (*anyopaque, parent: ?usize) usize,
+
+        /// Returns the node at `index` in the children of `parent`.
+        getChildFn: *const fn (*anyopaque, parent: ?usize, index: usize) usize,
+
+        /// Returns the text of `node`. The text must stay valid until the next call.
+        getTextFn: *const fn (*anyopaque, node: usize) []const u8,
+
+        /// Returns `true` if the children of `node` are shown.
+        isExpandedFn: *const fn (*anyopaque, node: usize) bool,
+
+        /// Stores the expand state of `node`.
+        setExpandedFn: *const fn (*anyopaque, node: usize, expanded: bool) void,
+
+        /// Returns the height of the row of `node` in pixels. If `null`, all rows are
+        /// `TreeView.row_height` pixels high.
+        getHeightFn: ?*const fn (*anyopaque, node: usize) u15 = null,
+    };
+
+    pub fn getChildCount(source: DataSource, parent: ?usize) usize {
+        return source.vtable.getChildCountFn(source.ptr, parent);
+    }
+
+    pub fn getChild(source: DataSource, parent: ?usize, index: usize) usize {
+        return source.vtable.getChildFn(source.ptr, parent, index);
+    }
+
+    pub fn getText(source: DataSource, node: usize) []const u8 {
+        return source.vtable.getTextFn(source.ptr, node);
+    }
+
+    pub fn isExpanded(source: DataSource, node: usize) bool {
+        return source.vtable.isExpandedFn(source.ptr, node);
+    }
+
+    pub fn setExpanded(source: DataSource, node: usize, expanded: bool) void {
+        source.vtable.setExpandedFn(source.ptr, node, expanded);
+    }
+};
+
+/// A node that is currently reachable by expanding its ancestors.
+pub const Row = struct {
+    node: usize,
+    depth: u16,
+    has_children: bool,
+    expanded: bool,
+};
+
+on_selection_changed: ?ui.EventHandler = null,
+
+font: ?ui.Font = null,
+
+source: ?DataSource = null,
+
+/// Height of every row in pixels, unless the data source provides individual heights.
+row_height: u15 = 20,
+
+/// Horizontal offset per tree level in pixels. The expander is drawn in the last level.
+indent: u15 = 16,
+
+/// Number of rows above and below the visible window that are prepared as well.
+overscan: u15 = 2,
+
+/// Vertical scroll position in pixels.
+scroll_offset: u64 = 0,
+
+/// Index of the selected row, if any.
+selection: ?usize = null,
+
+/// Height of the tree view during the last `update`, used for paging.
+viewport_height: u15 = 0,
+
+/// If `false`, `flat_rows` is rebuilt from the data source in the next `update`.
+rows_valid: bool = false,
+
+allocator: std.mem.Allocator = undefined,
+
+/// All reachable nodes in display order.
+flat_rows: std.ArrayListUnmanaged(Row) = .{},
+
+rows: RowIndex = undefined,
+
+pub fn init(ctrl: *TreeView, allocator: std.mem.Allocator) !void {
+    ctrl.allocator = allocator;
+    ctrl.rows = RowIndex.init(allocator);
+}
+
+pub fn deinit(ctrl: *TreeView) void {
+    ctrl.flat_rows.deinit(ctrl.allocator);
+    ctrl.rows.deinit();
+}
+
 pub fn canReceiveFocus(ctrl: *@This()) bool {
     _ = ctrl;
     return true;
@@ -7,3 +118,349 @@ pub fn isHitTestVisible(ctrl: *@This()) bool {
     _ = ctrl;
     return true;
 }
+
+/// Rebuilds the rows if `reload` was called and clamps the scroll position for a tree view of `viewport_height` pixels.
+pub fn update(ctrl: *TreeView, viewport_height: u15) !void {
+    ctrl.viewport_height = viewport_height;
+
+    if (!ctrl.rows_valid) {
+        ctrl.flat_rows.shrinkRetainingCapacity(0);
+        if (ctrl.source) |source| {
+            try ctrl.appendChildren(&ctrl.flat_rows, source, null, 0);
+        }
+        try ctrl.updateRowIndex(0);
+        ctrl.rows_valid = true;
+
+        if (ctrl.selection) |row| {
+            if (row >= ctrl.flat_rows.items.len)
+                ctrl.selection = null;
+        }
+    }
+
+    ctrl.scroll_offset = ctrl.rows.clampScroll(ctrl.scroll_offset, viewport_height);
+}
+
+/// Queries the whole tree again in the next `update`. Call this when the data source changed.
+pub fn reload(ctrl: *TreeView) void {
+    ctrl.rows_valid = false;
+}
+
+/// Returns the rows that have to be drawn at the current scroll position.
+pub fn visibleRows(ctrl: TreeView) RowIndex.Range {
+    return ctrl.rows.visibleRange(ctrl.scroll_offset, ctrl.viewport_height, ctrl.overscan);
+}
+
+/// Returns the area of `row` when the tree view is drawn into `area`.
+pub fn rowRectangle(ctrl: TreeView, area: ui.Rectangle, row: usize) ui.Rectangle {
+    const top = @intCast(i64, ctrl.rows.offsetOf(row)) - @intCast(i64, ctrl.scroll_offset);
+    return ui.Rectangle{
+        .x = area.x,
+        .y = @intCast(i16, std.math.clamp(area.y + top, std.math.minInt(i16), std.math.maxInt(i16))),
+        .width = area.width,
+        .height = ctrl.rows.heightOf(row),
+    };
+}
+
+/// Scrolls the least amount so `row` is fully visible.
+pub fn scrollToRow(ctrl: *TreeView, row: usize) void {
+    ctrl.scroll_offset = ctrl.rows.scrollTo(ctrl.scroll_offset, row, ctrl.viewport_height);
+}
+
+/// Shows or hides the children of the node in `row`.
+pub fn setExpanded(ctrl: *TreeView, row: usize, expanded: bool) !void {
+    const source = ctrl.source orelse return;
+    const item = &ctrl.flat_rows.items[row];
+    if (!item.has_children or item.expanded == expanded)
+        return;
+
+    if (expanded) {
+        var children = std.ArrayListUnmanaged(Row){};
+        defer children.deinit(ctrl.allocator);
+
+        try ctrl.appendChildren(&children, source, item.node, item.depth + 1);
+        try ctrl.flat_rows.insertSlice(ctrl.allocator, row + 1, children.items);
+
+        if (ctrl.selection) |selection| {
+            if (selection > row)
+                ctrl.selection = selection + children.items.len;
+        }
+    } else {
+        const end = ctrl.subtreeEnd(row);
+        const removed = end - (row + 1);
+        ctrl.flat_rows.replaceRange(ctrl.allocator, row + 1, removed, &.{}) catch unreachable; // shrinking never allocates
+
+        if (ctrl.selection) |selection| {
+            if (selection >= end) {
+                ctrl.selection = selection - removed;
+            } else if (selection > row) {
+                ctrl.selection = row;
+            }
+        }
+    }
+
+    // `item` may be invalidated by the insertion
+    ctrl.flat_rows.items[row].expanded = expanded;
+    source.setExpanded(ctrl.flat_rows.items[row].node, expanded);
+
+    try ctrl.updateRowIndex(row + 1);
+}
+
+/// Selects `row`, scrolls it into view and emits `on_selection_changed` if the selection changed.
+pub fn select(ctrl: *TreeView, widget: *ui.Widget, view: *ui.View, row: ?usize) void {
+    if (std.meta.eql(ctrl.selection, row))
+        return;
+    ctrl.selection = row;
+    if (row) |index| {
+        ctrl.scrollToRow(index);
+    }
+    if (ctrl.on_selection_changed) |handler| {
+        view.pushEvent(.{
+            .sender = widget,
+            .data = .none,
+            .handler = handler,
+        });
+    }
+}
+
+pub fn sendInput(ctrl: *TreeView, widget: *ui.Widget, view: *ui.View, input: ui.Widget.Event) ui.Widget.InputHandling {
+    switch (input) {
+        .mouse_button_down => |button| if (button == .primary and ctrl.rows.count > 0) {
+            const x = view.mouse_position.x - widget.absolute_bounds.x;
+            const y = view.mouse_position.y - widget.absolute_bounds.y;
+            // `rowAt` clamps to the last row, so clicks into the empty space below it are dropped here.
+            if (x < 0 or y < 0 or ctrl.scroll_offset + @intCast(u64, y) >= ctrl.rows.totalHeight())
+                return .process;
+
+            const row = ctrl.rows.rowAt(ctrl.scroll_offset + @intCast(u64, y));
+            const item = ctrl.flat_rows.items[row];
+            const expander_start = @as(i32, item.depth) * ctrl.indent;
+            if (item.has_children and x >= expander_start and x < expander_start + ctrl.indent) {
+                ctrl.toggle(row);
+            } else {
+                ctrl.select(widget, view, row);
+            }
+        },
+        .key_down => |key| {
+            if (RowIndex.stepFromKey(key.key)) |step| {
+                ctrl.select(widget, view, ctrl.rows.navigate(ctrl.selection, step, ctrl.viewport_height));
+                return .ignore;
+            }
+            const row = ctrl.selection orelse return .process;
+            const item = ctrl.flat_rows.items[row];
+            switch (key.key) {
+                .right => if (item.has_children and !item.expanded) {
+                    ctrl.toggle(row);
+                } else if (item.expanded and row + 1 < ctrl.flat_rows.items.len) {
+                    ctrl.select(widget, view, row + 1);
+                },
+                .left => if (item.expanded) {
+                    ctrl.toggle(row);
+                } else if (ctrl.parentRow(row)) |parent| {
+                    ctrl.select(widget, view, parent);
+                },
+                .space, .@"return" => ctrl.toggle(row),
+                else => return .process,
+            }
+            return .ignore;
+        },
+        else => {},
+    }
+    return .process;
+}
+
+fn toggle(ctrl: *TreeView, row: usize) void {
+    const expanded = ctrl.flat_rows.items[row].expanded;
+    ctrl.setExpanded(row, !expanded) catch |err| {
+        std.log.scoped(.tree_view).err("failed to expand tree node: {s}", .{@errorName(err)});
+        ctrl.reload();
+    };
+}
+
+/// Returns the row of the closest ancestor of `row`.
+fn parentRow(ctrl: TreeView, row: usize) ?usize {
+    const depth = ctrl.flat_rows.items[row].depth;
+    var i = row;
+    while (i > 0) {
+        i -= 1;
+        if (ctrl.flat_rows.items[i].depth < depth)
+            return i;
+    }
+    return null;
+}
+
+/// Returns the first row after the subtree of `row`.
+fn subtreeEnd(ctrl: TreeView, row: usize) usize {
+    const depth = ctrl.flat_rows.items[row].depth;
+    var end = row + 1;
+    while (end < ctrl.flat_rows.items.len and ctrl.flat_rows.items[end].depth > depth) {
+        end += 1;
+    }
+    return end;
+}
+
+/// Appends the children of `parent` and their expanded descendants in display order.
+fn appendChildren(ctrl: *TreeView, list: *std.ArrayListUnmanaged(Row), source: DataSource, parent: ?usize, depth: u16) error{OutOfMemory}!void {
+    const count = source.getChildCount(parent);
+    try list.ensureUnusedCapacity(ctrl.allocator, count);
+
+    var i: usize = 0;
+    while (i < count) : (i += 1) {
+        const node = source.getChild(parent, i);
+        const has_children = source.getChildCount(node) > 0;
+        const expanded = has_children and source.isExpanded(node);
+        try list.append(ctrl.allocator, Row{
+            .node = node,
+            .depth = depth,
+            .has_children = has_children,
+            .expanded = expanded,
+        });
+        if (expanded) {
+            try ctrl.appendChildren(list, source, node, depth + 1);
+        }
+    }
+}
+
+/// Updates the row heights from `first` on after `flat_rows` changed.
+fn updateRowIndex(ctrl: *TreeView, first: usize) !void {
+    const count = ctrl.flat_rows.items.len;
+    const getHeight = if (ctrl.source) |source| source.vtable.getHeightFn else null;
+
+    if (getHeight) |getHeightFn| {
+        ctrl.rows.setVariable();
+        ctrl.rows.truncate(first);
+        while (ctrl.rows.count < count) {
+            try ctrl.rows.append(getHeightFn(ctrl.source.?.ptr, ctrl.flat_rows.items[ctrl.rows.count].node));
+        }
+    } else {
+        ctrl.rows.setFixed(ctrl.row_height, count);
+    }
+}
+
+/// A fixed tree for the tests. Nodes are indices into `children`. Every node has its own row
+/// height, so a misplaced row shows up in the offsets.
+const TestTree = struct {
+    const roots = [_]usize{ 0, 3, 5 };
+    const children = [_][]const usize{
+        &.{ 1, 2 }, // 0
+        &.{}, // 1
+        &.{ 6, 7 }, // 2
+        &.{4}, // 3
+        &.{}, // 4
+        &.{}, // 5
+        &.{}, // 6
+        &.{}, // 7
+    };
+
+    expanded: [children.len]bool = [1]bool{false} ** children.len,
+
+    fn get(ptr: *anyopaque) *TestTree {
+        return @ptrCast(*TestTree, @alignCast(@alignOf(TestTree), ptr));
+    }
+
+    fn childList(parent: ?usize) []const usize {
+        return if (parent) |node| children[node] else &roots;
+    }
+
+    fn getChildCount(ptr: *anyopaque, parent: ?usize) usize {
+        _ = ptr;
+        return childList(parent).len;
+    }
+
+    fn getChild(ptr: *anyopaque, parent: ?usize, index: usize) usize {
+        _ = ptr;
+        return childList(parent)[index];
+    }
+
+    fn getText(ptr: *anyopaque, node: usize) []const u8 {
+        _ = ptr;
+        _ = node;
+        return "";
+    }
+
+    fn isExpanded(ptr: *anyopaque, node: usize) bool {
+        return get(ptr).expanded[node];
+    }
+
+    fn setExpanded(ptr: *anyopaque, node: usize, expanded: bool) void {
+        get(ptr).expanded[node] = expanded;
+    }
+
+    fn getHeight(ptr: *anyopaque, node: usize) u15 {
+        _ = ptr;
+        return nodeHeight(node);
+    }
+
+    fn nodeHeight(node: usize) u15 {
+        return @intCast(u15, 10 + node);
+    }
+};
+
+/// Checks that the flat rows show `nodes` and that the row index matches their heights.
+fn expectRows(ctrl: TreeView, nodes: []const usize) !void {
+    try std.testing.expectEqual(nodes.len, ctrl.flat_rows.items.len);
+    try std.testing.expectEqual(nodes.len, ctrl.rows.count);
+
+    var offset: u64 = 0;
+    for (nodes) |node, row| {
+        const height = if (ctrl.rows.variable) TestTree.nodeHeight(node) else ctrl.row_height;
+        try std.testing.expectEqual(node, ctrl.flat_rows.items[row].node);
+        try std.testing.expectEqual(offset, ctrl.rows.offsetOf(row));
+        try std.testing.expectEqual(height, ctrl.rows.heightOf(row));
+        try std.testing.expectEqual(row, ctrl.rows.rowAt(offset + height - 1));
+        offset += height;
+    }
+    try std.testing.expectEqual(offset, ctrl.rows.totalHeight());
+}
+
+test "tree view: expanding and collapsing splices the row index" {
+    inline for ([_]bool{ false, true }) |variable| {
+        var tree = TestTree{};
+        const vtable = DataSource.VTable{
+            .getChildCountFn = TestTree.getChildCount,
+            .getChildFn = TestTree.getChild,
+            .getTextFn = TestTree.getText,
+            .isExpandedFn = TestTree.isExpanded,
+            .setExpandedFn = TestTree.setExpanded,
+            .getHeightFn = if (variable) TestTree.getHeight else null,
+        };
+
+        var ctrl = TreeView{ .source = DataSource{ .ptr = &tree, .vtable = &vtable } };
+        try ctrl.init(std.testing.allocator);
+        defer ctrl.deinit();
+
+        try ctrl.update(100);
+        try expectRows(ctrl, &.{ 0, 3, 5 });
+
+        try ctrl.setExpanded(0, true);
+        try expectRows(ctrl, &.{ 0, 1, 2, 3, 5 });
+        try std.testing.expect(tree.expanded[0]);
+
+        // a nested subtree is spliced in front of the following root
+        try ctrl.setExpanded(2, true);
+        try expectRows(ctrl, &.{ 0, 1, 2, 6, 7, 3, 5 });
+
+        try ctrl.setExpanded(5, true);
+        try expectRows(ctrl, &.{ 0, 1, 2, 6, 7, 3, 4, 5 });
+
+        // leaves don't expand
+        try ctrl.setExpanded(7, true);
+        try expectRows(ctrl, &.{ 0, 1, 2, 6, 7, 3, 4, 5 });
+
+        // collapsing removes the whole subtree, but keeps the expand state of its nodes
+        ctrl.selection = 6;
+        try ctrl.setExpanded(0, false);
+        try expectRows(ctrl, &.{ 0, 3, 4, 5 });
+        try std.testing.expectEqual(@as(?usize, 2), ctrl.selection);
+        try std.testing.expect(tree.expanded[2]);
+
+        try ctrl.setExpanded(0, true);
+        try expectRows(ctrl, &.{ 0, 1, 2, 6, 7, 3, 4, 5 });
+        try std.testing.expectEqual(@as(?usize, 6), ctrl.selection);
+
+        // a selection inside the collapsed subtree moves to its root
+        ctrl.selection = 3;
+        try ctrl.setExpanded(2, false);
+        try expectRows(ctrl, &.{ 0, 1, 2, 3, 4, 5 });
+        try std.testing.expectEqual(@as(?usize, 2), ctrl.selection);
+    }
+}
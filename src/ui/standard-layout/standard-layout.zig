@@ -9,6 +9,9 @@
 //! - *table*, a layout that will put children into table cells
 //! - *canvas*, a layout that allows arbitrary positioning of the children
 //!
+//! A tree of nodes is layouted by flattening it into a `Tree`, which measures and arranges
+//! the nodes in two passes and only touches the parts of the tree that changed since the last update.
+//!
 
 const std = @import("std");
 const ui = @import("ui");
@@ -19,32 +22,44 @@ pub const Rectangle = ui.Rectangle;
 
 /// A rectangle that can either be stored out-of-tree (for example in a widget)
 /// or in-tree (in the `Bounds` value itself).
-const Bounds = union(enum) {
+pub const Bounds = union(enum) {
     storage: Rectangle,
     reference: *Rectangle,
+    /// The bounds of a widget, used by generated layout templates.
+    widget: *ui.LayoutedRectangle,
 
     pub fn set(bounds: *Bounds, value: Rectangle) void {
         switch (bounds.*) {
             .storage => |*val| val.* = value,
             .reference => |ref| ref.* = value,
+            .widget => |ref| {
+                ref.position = value.position();
+                ref.size = value.size();
+            },
         }
     }
 
     pub fn get(bounds: Bounds) Rectangle {
-        return switch (bounds.*) {
+        return switch (bounds) {
             .storage => |val| val,
             .reference => |ref| ref.*,
+            .widget => |ref| Rectangle.new(ref.position, ref.size),
         };
     }
 };
 
 pub const Margins = struct {
-    left: u15,
-    right: u15,
-    top: u15,
-    bottom: u15,
+    pub const none = Margins{};
+
+    left: u15 = 0,
+    right: u15 = 0,
+    top: u15 = 0,
+    bottom: u15 = 0,
 };
 
+/// An extent that isn't limited. Used in `Node.max_size` and for measuring without constraints.
+pub const unbounded: u15 = std.math.maxInt(u15);
+
 pub const VerticalAlignment = enum {
     /// expands the item to the available horizontal space
     stretch,
@@ -63,21 +78,21 @@ pub const HorizontalAlignment = enum {
 
 /// A node in the layout tree, has a position and size
 pub const Node = struct {
-    bounds: Bounds,
+    bounds: Bounds = .{ .storage = Rectangle{ .x = 0, .y = 0, .width = 0, .height = 0 } },
 
-    min_size: Size,
-    max_size: Size,
+    min_size: Size = Size.empty,
+    max_size: Size = Size.new(unbounded, unbounded),
 
-    children: []Node,
-    layout: Layout,
+    children: []const Node = &.{},
+    layout: Layout = .basic,
 
-    margin: Margins, // outer margins
-    padding: Margins, // inner margins
+    margin: Margins = Margins.none, // outer margins
+    padding: Margins = Margins.none, // inner margins
 
-    vertical_alignment: VerticalAlignment, // layout inside the parent region
-    horizontal_alignment: HorizontalAlignment, // layout inside the parent region
+    vertical_alignment: VerticalAlignment = .stretch, // layout inside the parent region
+    horizontal_alignment: HorizontalAlignment = .stretch, // layout inside the parent region
 
-    container_layout_data: ContainerLayoutData,
+    container_layout_data: ContainerLayoutData = ContainerLayoutData.empty,
 };
 
 pub const ContainerLayoutData = union {
@@ -198,3 +213,823 @@ pub const CanvasLayout = struct {
 
     pub const Location = Point;
 };
+
+/// Maximum number of rows or columns of a `TableLayout`. Further tracks are ignored.
+pub const max_table_tracks = 32;
+
+/// A layout tree stored in a flat array. The nodes are stored breadth-first, so the
+/// children of each node are consecutive and the root has the index `Tree.root`.
+///
+/// `update` measures the desired size of each node and then arranges the nodes into
+/// their final rectangles. Desired sizes are cached per available size, and a node is
+/// only arranged again if it was invalidated or its size changed. Changing a single
+/// node thus only touches its ancestors and the siblings that moved.
+///
+/// The resulting rectangles are written into `Node.bounds`. The root is placed at
+/// the absolute area passed to `update`, all other nodes are relative to their parent.
+pub const Tree = struct {
+    pub const Index = u32;
+
+    pub const root: Index = 0;
+
+    const no_parent = std.math.maxInt(Index);
+
+    pub const Statistics = struct {
+        /// Number of nodes that computed their desired size in the last `update`.
+        measured_nodes: usize = 0,
+
+        /// Number of nodes that arranged their children in the last `update`.
+        arranged_nodes: usize = 0,
+    };
+
+    const MeasureResult = struct {
+        available: Size,
+        desired: Size,
+    };
+
+    const Entry = struct {
+        node: Node,
+
+        parent: Index,
+        first_child: Index,
+        child_count: Index,
+
+        /// The desired sizes for the last two distinct available sizes, most recent first.
+        measure_cache: [2]?MeasureResult = .{ null, null },
+
+        /// The size of the last arrange or `null` if the node wasn't arranged yet.
+        arranged_size: ?Size = null,
+
+        /// The node or one of its descendants was invalidated since the last arrange.
+        needs_arrange: bool = true,
+    };
+
+    allocator: std.mem.Allocator,
+    entries: std.ArrayListUnmanaged(Entry) = .{},
+    statistics: Statistics = .{},
+
+    pub fn init(allocator: std.mem.Allocator) Tree {
+        return Tree{ .allocator = allocator };
+    }
+
+    pub fn deinit(tree: *Tree) void {
+        tree.entries.deinit(tree.allocator);
+        tree.* = undefined;
+    }
+
+    /// Replaces the contents of the tree with a copy of `root_node` and all its descendants.
+    /// The `children` of the copied nodes are empty, use `child` and `childCount` to walk the tree.
+    pub fn build(tree: *Tree, root_node: Node) !void {
+        tree.entries.shrinkRetainingCapacity(0);
+        try tree.entries.append(tree.allocator, Entry{
+            .node = root_node,
+            .parent = no_parent,
+            .first_child = 0,
+            .child_count = 0,
+        });
+
+        var index: usize = 0;
+        while (index < tree.entries.items.len) : (index += 1) {
+            const children = tree.entries.items[index].node.children;
+            const first_child = @intCast(Index, tree.entries.items.len);
+
+            try tree.entries.ensureUnusedCapacity(tree.allocator, children.len);
+            for (children) |child_node| {
+                tree.entries.appendAssumeCapacity(Entry{
+                    .node = child_node,
+                    .parent = @intCast(Index, index),
+                    .first_child = 0,
+                    .child_count = 0,
+                });
+            }
+
+            const entry = &tree.entries.items[index];
+            entry.node.children = &.{};
+            entry.first_child = first_child;
+            entry.child_count = @intCast(Index, children.len);
+        }
+    }
+
+    pub fn count(tree: Tree) usize {
+        return tree.entries.items.len;
+    }
+
+    pub fn parent(tree: Tree, index: Index) ?Index {
+        const parent_index = tree.entries.items[index].parent;
+        return if (parent_index != no_parent) parent_index else null;
+    }
+
+    pub fn childCount(tree: Tree, index: Index) usize {
+        return tree.entries.items[index].child_count;
+    }
+
+    /// Returns the index of the `n`th child of `index`.
+    pub fn child(tree: Tree, index: Index, n: usize) Index {
+        const entry = tree.entries.items[index];
+        std.debug.assert(n < entry.child_count);
+        return entry.first_child + @intCast(Index, n);
+    }
+
+    pub fn get(tree: Tree, index: Index) *const Node {
+        return &tree.entries.items[index].node;
+    }
+
+    /// Returns the node at `index` for modification and invalidates its layout.
+    /// The children of the node must not be changed, use `build` for structural changes.
+    pub fn modify(tree: *Tree, index: Index) *Node {
+        tree.invalidate(index);
+        return &tree.entries.items[index].node;
+    }
+
+    /// Marks the layout of the node at `index` as outdated, for example when the
+    /// content of the widget behind the node changed.
+    pub fn invalidate(tree: *Tree, index: Index) void {
+        var current = index;
+        while (current != no_parent) {
+            const entry = &tree.entries.items[current];
+            entry.measure_cache = .{ null, null };
+            entry.needs_arrange = true;
+            current = entry.parent;
+        }
+    }
+
+    /// Layouts the tree into `area`.
+    pub fn update(tree: *Tree, area: Rectangle) void {
+        tree.statistics = .{};
+        if (tree.entries.items.len == 0)
+            return;
+        _ = tree.measure(root, area.size());
+        tree.arrange(root, area);
+    }
+
+    /// Returns the desired size of the node at `index` if it can take up to `available`.
+    fn measure(tree: *Tree, index: Index, available: Size) Size {
+        const entry = &tree.entries.items[index];
+        for (entry.measure_cache) |cached| {
+            if (cached) |result| {
+                if (std.meta.eql(result.available, available))
+                    return result.desired;
+            }
+        }
+        tree.statistics.measured_nodes += 1;
+
+        const node = entry.node;
+        const inner = shrinkSize(available, node.padding);
+        const first = entry.first_child;
+        const end = first + entry.child_count;
+
+        const content: Size = switch (node.layout) {
+            .basic => tree.measureBasic(first, end, inner),
+            .stack => |stack| tree.measureStack(first, end, inner, stack),
+            .dock => tree.measureDock(first, end, inner),
+            .flow => |flow| tree.measureFlow(first, end, inner, flow),
+            .table => |table| tree.measureTable(first, end, inner, table),
+            .canvas => |canvas| tree.measureCanvas(first, end, canvas),
+        };
+
+        const desired = Size{
+            .width = clampExtent(@as(u32, content.width) + node.padding.left + node.padding.right, node.min_size.width, node.max_size.width),
+            .height = clampExtent(@as(u32, content.height) + node.padding.top + node.padding.bottom, node.min_size.height, node.max_size.height),
+        };
+
+        entry.measure_cache[1] = entry.measure_cache[0];
+        entry.measure_cache[0] = MeasureResult{ .available = available, .desired = desired };
+
+        return desired;
+    }
+
+    /// Returns the desired size of the node at `index` including its margins.
+    fn measureOuter(tree: *Tree, index: Index, available: Size) Size {
+        const margin = tree.entries.items[index].node.margin;
+        return growSize(tree.measure(index, shrinkSize(available, margin)), margin);
+    }
+
+    /// Places the node at `index` at `rect` and arranges its children.
+    fn arrange(tree: *Tree, index: Index, rect: Rectangle) void {
+        const entry = &tree.entries.items[index];
+        entry.node.bounds.set(rect);
+
+        if (!entry.needs_arrange) {
+            // moving a node doesn't change the relative positions of its children
+            if (entry.arranged_size) |size| {
+                if (std.meta.eql(size, rect.size()))
+                    return;
+            }
+        }
+        entry.needs_arrange = false;
+        entry.arranged_size = rect.size();
+        tree.statistics.arranged_nodes += 1;
+
+        const node = entry.node;
+        const content = Rectangle.new(
+            Point.new(@intCast(i16, node.padding.left), @intCast(i16, node.padding.top)),
+            shrinkSize(rect.size(), node.padding),
+        );
+        const first = entry.first_child;
+        const end = first + entry.child_count;
+
+        switch (node.layout) {
+            .basic => tree.arrangeBasic(first, end, content),
+            .stack => |stack| tree.arrangeStack(first, end, content, stack),
+            .dock => tree.arrangeDock(first, end, content),
+            .flow => |flow| tree.arrangeFlow(first, end, content, flow),
+            .table => |table| tree.arrangeTable(first, end, content, table),
+            .canvas => |canvas| tree.arrangeCanvas(first, end, content, canvas),
+        }
+    }
+
+    /// Aligns the node at `index` inside `slot`, which includes the margins of the node.
+    /// `available` must be the size the node was measured with.
+    fn place(tree: *Tree, index: Index, slot: Rectangle, available: Size) void {
+        const node = tree.entries.items[index].node;
+        const desired = tree.measure(index, shrinkSize(available, node.margin));
+        const space = shrinkRect(slot, node.margin);
+
+        // `VerticalAlignment` holds the placement on the horizontal axis and vice versa
+        const width = switch (node.vertical_alignment) {
+            .stretch => std.math.min(space.width, node.max_size.width),
+            .left, .center, .right => std.math.min(space.width, desired.width),
+        };
+        const height = switch (node.horizontal_alignment) {
+            .stretch => std.math.min(space.height, node.max_size.height),
+            .top, .middle, .bottom => std.math.min(space.height, desired.height),
+        };
+
+        const x = switch (node.vertical_alignment) {
+            .stretch, .left => space.x,
+            .center => space.x + @intCast(i16, (space.width - width) / 2),
+            .right => space.x + @intCast(i16, space.width - width),
+        };
+        const y = switch (node.horizontal_alignment) {
+            .stretch, .top => space.y,
+            .middle => space.y + @intCast(i16, (space.height - height) / 2),
+            .bottom => space.y + @intCast(i16, space.height - height),
+        };
+
+        tree.arrange(index, Rectangle{ .x = x, .y = y, .width = width, .height = height });
+    }
+
+    fn measureBasic(tree: *Tree, first: Index, end: Index, available: Size) Size {
+        var result = Size.empty;
+        var index = first;
+        while (index < end) : (index += 1) {
+            const outer = tree.measureOuter(index, available);
+            result.width = std.math.max(result.width, outer.width);
+            result.height = std.math.max(result.height, outer.height);
+        }
+        return result;
+    }
+
+    fn arrangeBasic(tree: *Tree, first: Index, end: Index, content: Rectangle) void {
+        var index = first;
+        while (index < end) : (index += 1) {
+            tree.place(index, content, content.size());
+        }
+    }
+
+    /// Children of a stack are not limited along the stacking direction.
+    fn stackConstraint(available: Size, axis: Axis) Size {
+        return switch (axis) {
+            .horizontal => Size.new(unbounded, available.height),
+            .vertical => Size.new(available.width, unbounded),
+        };
+    }
+
+    fn measureStack(tree: *Tree, first: Index, end: Index, available: Size, stack: StackLayout) Size {
+        const axis = Axis.fromStack(stack.direction);
+        const constraint = stackConstraint(available, axis);
+
+        var along: u32 = 0;
+        var across: u32 = 0;
+        var index = first;
+        while (index < end) : (index += 1) {
+            const outer = axis.split(tree.measureOuter(index, constraint));
+            along += outer.along;
+            across = std.math.max(across, outer.across);
+        }
+        return axis.join(along, across);
+    }
+
+    fn arrangeStack(tree: *Tree, first: Index, end: Index, content: Rectangle, stack: StackLayout) void {
+        const axis = Axis.fromStack(stack.direction);
+        const constraint = stackConstraint(content.size(), axis);
+        const reverse = (stack.direction == .right_to_left or stack.direction == .bottom_to_top);
+        const space = axis.split(content.size());
+
+        var offset: u32 = 0;
+        var index = first;
+        while (index < end) : (index += 1) {
+            const outer = axis.split(tree.measureOuter(index, constraint));
+            const position = if (reverse)
+                @as(i32, space.along) - @intCast(i32, offset + outer.along)
+            else
+                @intCast(i32, offset);
+            offset += outer.along;
+
+            tree.place(index, axis.rectangle(content, position, 0, outer.along, space.across), constraint);
+        }
+    }
+
+    fn measureDock(tree: *Tree, first: Index, end: Index, available: Size) Size {
+        // `used_*` is the space taken by docked children, `max_*` the space needed
+        // across the docking direction.
+        var used_width: u32 = 0;
+        var used_height: u32 = 0;
+        var max_width: u32 = 0;
+        var max_height: u32 = 0;
+
+        var index = first;
+        while (index < end) : (index += 1) {
+            const remaining = Size.new(
+                if (available.width == unbounded) unbounded else fit(available.width -| used_width),
+                if (available.height == unbounded) unbounded else fit(available.height -| used_height),
+            );
+            const outer = tree.measureOuter(index, remaining);
+
+            if (index == end - 1) {
+                // the last child fills the remaining space
+                max_width = std.math.max(max_width, used_width + outer.width);
+                max_height = std.math.max(max_height, used_height + outer.height);
+            } else switch (tree.entries.items[index].node.container_layout_data.dock_layout) {
+                .left, .right => {
+                    max_height = std.math.max(max_height, used_height + outer.height);
+                    used_width += outer.width;
+                },
+                .top, .bottom => {
+                    max_width = std.math.max(max_width, used_width + outer.width);
+                    used_height += outer.height;
+                },
+            }
+        }
+
+        return Size.new(
+            fit(std.math.max(max_width, used_width)),
+            fit(std.math.max(max_height, used_height)),
+        );
+    }
+
+    fn arrangeDock(tree: *Tree, first: Index, end: Index, content: Rectangle) void {
+        var remaining = content;
+
+        var index = first;
+        while (index < end) : (index += 1) {
+            const constraint = remaining.size();
+            if (index == end - 1) {
+                tree.place(index, remaining, constraint);
+                break;
+            }
+
+            const outer = tree.measureOuter(index, constraint);
+            var slot = remaining;
+            switch (tree.entries.items[index].node.container_layout_data.dock_layout) {
+                .left => {
+                    slot.width = std.math.min(outer.width, remaining.width);
+                    remaining.x += @intCast(i16, slot.width);
+                    remaining.width -= slot.width;
+                },
+                .right => {
+                    slot.width = std.math.min(outer.width, remaining.width);
+                    slot.x += @intCast(i16, remaining.width - slot.width);
+                    remaining.width -= slot.width;
+                },
+                .top => {
+                    slot.height = std.math.min(outer.height, remaining.height);
+                    remaining.y += @intCast(i16, slot.height);
+                    remaining.height -= slot.height;
+                },
+                .bottom => {
+                    slot.height = std.math.min(outer.height, remaining.height);
+                    slot.y += @intCast(i16, remaining.height - slot.height);
+                    remaining.height -= slot.height;
+                },
+            }
+            tree.place(index, slot, constraint);
+        }
+    }
+
+    /// Children of a flow are only limited along the major axis, so they keep their
+    /// measurement when the height of a line changes.
+    fn flowConstraint(available: Size, axis: Axis) Size {
+        return axis.join(axis.split(available).along, unbounded);
+    }
+
+    fn measureFlow(tree: *Tree, first: Index, end: Index, available: Size, flow: FlowLayout) Size {
+        const axis = Axis.fromFlow(flow.major_axis);
+        const constraint = flowConstraint(available, axis);
+        const limit = axis.split(available).along;
+
+        var line_along: u32 = 0;
+        var line_across: u32 = 0;
+        var max_along: u32 = 0;
+        var total_across: u32 = 0;
+
+        var index = first;
+        while (index < end) : (index += 1) {
+            const outer = axis.split(tree.measureOuter(index, constraint));
+            if (index > first and line_along + outer.along > limit) {
+                max_along = std.math.max(max_along, line_along);
+                total_across += line_across;
+                line_along = 0;
+                line_across = 0;
+            }
+            line_along += outer.along;
+            line_across = std.math.max(line_across, outer.across);
+        }
+        max_along = std.math.max(max_along, line_along);
+        total_across += line_across;
+
+        return axis.join(max_along, total_across);
+    }
+
+    fn arrangeFlow(tree: *Tree, first: Index, end: Index, content: Rectangle, flow: FlowLayout) void {
+        const axis = Axis.fromFlow(flow.major_axis);
+        const constraint = flowConstraint(content.size(), axis);
+        const limit = axis.split(content.size()).along;
+
+        var line_start = first;
+        var line_along: u32 = 0;
+        var line_across: u32 = 0;
+        var line_offset: u32 = 0;
+
+        var index = first;
+        while (index < end) : (index += 1) {
+            const outer = axis.split(tree.measureOuter(index, constraint));
+            if (index > line_start and line_along + outer.along > limit) {
+                tree.arrangeFlowLine(line_start, index, content, flow, line_offset, line_across);
+                line_offset += line_across;
+                line_start = index;
+                line_along = 0;
+                line_across = 0;
+            }
+            line_along += outer.along;
+            line_across = std.math.max(line_across, outer.across);
+        }
+        if (line_start < end) {
+            tree.arrangeFlowLine(line_start, end, content, flow, line_offset, line_across);
+        }
+    }
+
+    fn arrangeFlowLine(tree: *Tree, first: Index, end: Index, content: Rectangle, flow: FlowLayout, line_offset: u32, line_across: u32) void {
+        const axis = Axis.fromFlow(flow.major_axis);
+        const constraint = flowConstraint(content.size(), axis);
+        const space = axis.split(content.size());
+
+        const across = switch (flow.secondary_direction) {
+            .increment => @intCast(i32, line_offset),
+            .decrement => @as(i32, space.across) - @intCast(i32, line_offset + line_across),
+        };
+
+        var offset: u32 = 0;
+        var index = first;
+        while (index < end) : (index += 1) {
+            const outer = axis.split(tree.measureOuter(index, constraint));
+            const along = switch (flow.primary_direction) {
+                .increment => @intCast(i32, offset),
+                .decrement => @as(i32, space.along) - @intCast(i32, offset + outer.along),
+            };
+            offset += outer.along;
+
+            tree.place(index, axis.rectangle(content, along, across, outer.along, line_across), constraint);
+        }
+    }
+
+    /// Computes the sizes of the tracks of a table along `axis`. Absolute and relative tracks
+    /// take their specified size, flexible tracks the size of their largest single-track child.
+    /// If `distribute` is set, the space left in `available` is shared between the flexible tracks.
+    fn computeTracks(tree: *Tree, first: Index, end: Index, available: Size, specs: []const TableLayout.SizeSpecification, axis: Axis, distribute: bool, sizes: []u32) void {
+        const space = axis.split(available).along;
+
+        for (sizes) |*size, i| {
+            size.* = switch (specs[i]) {
+                .absolute => |value| value,
+                .relative => |fraction| if (space == unbounded)
+                    0
+                else
+                    @floatToInt(u32, std.math.clamp(fraction, 0.0, 1.0) * @intToFloat(f32, space)),
+                .flex => 0,
+            };
+        }
+
+        var index = first;
+        while (index < end) : (index += 1) {
+            const slot = tree.entries.items[index].node.container_layout_data.table_layout;
+            const track = std.math.min(if (axis == .horizontal) slot.column else slot.row, sizes.len - 1);
+            const span = if (axis == .horizontal) slot.col_span else slot.row_span;
+            if (span > 1)
+                continue;
+            const auto_sized = switch (specs[track]) {
+                .absolute => false,
+                .relative => (space == unbounded),
+                .flex => true,
+            };
+            if (auto_sized) {
+                const outer = axis.split(tree.measureOuter(index, available));
+                sizes[track] = std.math.max(sizes[track], outer.along);
+            }
+        }
+
+        if (!distribute or space == unbounded)
+            return;
+
+        var used: u32 = 0;
+        var total_weight: f32 = 0.0;
+        for (sizes) |size, i| {
+            used += size;
+            switch (specs[i]) {
+                .flex => |weight| {
+                    total_weight += std.math.max(weight, 0.0);
+                },
+                else => {},
+            }
+        }
+        if (used >= space or total_weight <= 0.0)
+            return;
+
+        const leftover = @intToFloat(f32, space - used);
+        for (sizes) |*size, i| {
+            switch (specs[i]) {
+                .flex => |weight| {
+                    size.* += @floatToInt(u32, leftover * std.math.max(weight, 0.0) / total_weight);
+                },
+                else => {},
+            }
+        }
+    }
+
+    fn measureTable(tree: *Tree, first: Index, end: Index, available: Size, table: TableLayout) Size {
+        var columns: [max_table_tracks]u32 = undefined;
+        var rows: [max_table_tracks]u32 = undefined;
+        const column_sizes = columns[0..std.math.min(table.columns.len, max_table_tracks)];
+        const row_sizes = rows[0..std.math.min(table.rows.len, max_table_tracks)];
+        if (column_sizes.len == 0 or row_sizes.len == 0)
+            return Size.empty;
+
+        tree.computeTracks(first, end, available, table.columns, .horizontal, false, column_sizes);
+        tree.computeTracks(first, end, available, table.rows, .vertical, false, row_sizes);
+
+        return Size.new(fit(sum(column_sizes)), fit(sum(row_sizes)));
+    }
+
+    fn arrangeTable(tree: *Tree, first: Index, end: Index, content: Rectangle, table: TableLayout) void {
+        var columns: [max_table_tracks + 1]u32 = undefined;
+        var rows: [max_table_tracks + 1]u32 = undefined;
+        const column_count = std.math.min(table.columns.len, max_table_tracks);
+        const row_count = std.math.min(table.rows.len, max_table_tracks);
+        if (column_count == 0 or row_count == 0)
+            return;
+
+        const constraint = content.size();
+        tree.computeTracks(first, end, constraint, table.columns, .horizontal, true, columns[0..column_count]);
+        tree.computeTracks(first, end, constraint, table.rows, .vertical, true, rows[0..row_count]);
+
+        // turn the sizes into offsets, so `offsets[i + 1] - offsets[i]` is the size of track `i`
+        toOffsets(columns[0 .. column_count + 1]);
+        toOffsets(rows[0 .. row_count + 1]);
+
+        var index = first;
+        while (index < end) : (index += 1) {
+            const slot = tree.entries.items[index].node.container_layout_data.table_layout;
+            const column = std.math.min(slot.column, column_count - 1);
+            const row = std.math.min(slot.row, row_count - 1);
+            const column_end = std.math.min(@as(usize, column) + std.math.max(slot.col_span, 1), column_count);
+            const row_end = std.math.min(@as(usize, row) + std.math.max(slot.row_span, 1), row_count);
+
+            tree.place(index, Rectangle{
+                .x = coord(@as(i32, content.x) + @intCast(i32, columns[column])),
+                .y = coord(@as(i32, content.y) + @intCast(i32, rows[row])),
+                .width = fit(columns[column_end] - columns[column]),
+                .height = fit(rows[row_end] - rows[row]),
+            }, constraint);
+        }
+    }
+
+    fn measureCanvas(tree: *Tree, first: Index, end: Index, canvas: CanvasLayout) Size {
+        const constraint = Size.new(unbounded, unbounded);
+
+        var width: i32 = 0;
+        var height: i32 = 0;
+        var index = first;
+        while (index < end) : (index += 1) {
+            const location = tree.entries.items[index].node.container_layout_data.canvas_layout;
+            const outer = tree.measureOuter(index, constraint);
+            width = std.math.max(width, @as(i32, location.x) - canvas.reference.x + outer.width);
+            height = std.math.max(height, @as(i32, location.y) - canvas.reference.y + outer.height);
+        }
+        return Size.new(fit(@intCast(u32, width)), fit(@intCast(u32, height)));
+    }
+
+    fn arrangeCanvas(tree: *Tree, first: Index, end: Index, content: Rectangle, canvas: CanvasLayout) void {
+        const constraint = Size.new(unbounded, unbounded);
+
+        var index = first;
+        while (index < end) : (index += 1) {
+            const location = tree.entries.items[index].node.container_layout_data.canvas_layout;
+            const outer = tree.measureOuter(index, constraint);
+            tree.place(index, Rectangle{
+                .x = coord(@as(i32, content.x) + location.x - canvas.reference.x),
+                .y = coord(@as(i32, content.y) + location.y - canvas.reference.y),
+                .width = outer.width,
+                .height = outer.height,
+            }, constraint);
+        }
+    }
+};
+
+/// The axis a stack or flow places its children along.
+const Axis = enum {
+    horizontal,
+    vertical,
+
+    const Split = struct {
+        along: u15,
+        across: u15,
+    };
+
+    fn fromStack(direction: StackLayout.Direction) Axis {
+        return switch (direction) {
+            .left_to_right, .right_to_left => .horizontal,
+            .top_to_bottom, .bottom_to_top => .vertical,
+        };
+    }
+
+    fn fromFlow(major_axis: FlowLayout.Axis) Axis {
+        // a `row` flow fills rows, so it places the items horizontally
+        return switch (major_axis) {
+            .row => .horizontal,
+            .column => .vertical,
+        };
+    }
+
+    fn split(axis: Axis, size: Size) Split {
+        return switch (axis) {
+            .horizontal => Split{ .along = size.width, .across = size.height },
+            .vertical => Split{ .along = size.height, .across = size.width },
+        };
+    }
+
+    fn join(axis: Axis, along: u32, across: u32) Size {
+        return switch (axis) {
+            .horizontal => Size.new(fit(along), fit(across)),
+            .vertical => Size.new(fit(across), fit(along)),
+        };
+    }
+
+    /// Returns a rectangle relative to `content`, with the offsets and sizes given along and across the axis.
+    fn rectangle(axis: Axis, content: Rectangle, along: i32, across: i32, along_size: u32, across_size: u32) Rectangle {
+        const position = switch (axis) {
+            .horizontal => Point.new(coord(content.x + along), coord(content.y + across)),
+            .vertical => Point.new(coord(content.x + across), coord(content.y + along)),
+        };
+        return Rectangle.new(position, axis.join(along_size, across_size));
+    }
+};
+
+fn fit(value: u32) u15 {
+    return @intCast(u15, std.math.min(value, unbounded));
+}
+
+fn coord(value: i32) i16 {
+    return @intCast(i16, std.math.clamp(value, std.math.minInt(i16), std.math.maxInt(i16)));
+}
+
+fn clampExtent(value: u32, min: u15, max: u15) u15 {
+    return fit(std.math.clamp(value, min, std.math.max(min, max)));
+}
+
+fn sum(values: []const u32) u32 {
+    var result: u32 = 0;
+    for (values) |value| {
+        result += value;
+    }
+    return result;
+}
+
+/// Converts `values[0..values.len - 1]` from sizes into offsets, with the total size in the last element.
+fn toOffsets(values: []u32) void {
+    var offset: u32 = 0;
+    for (values) |*value, i| {
+        const size = if (i < values.len - 1) value.* else 0;
+        value.* = offset;
+        offset += size;
+    }
+}
+
+fn shrinkSize(size: Size, margins: Margins) Size {
+    return Size.new(
+        if (size.width == unbounded) unbounded else fit(@as(u32, size.width) -| (@as(u32, margins.left) + margins.right)),
+        if (size.height == unbounded) unbounded else fit(@as(u32, size.height) -| (@as(u32, margins.top) + margins.bottom)),
+    );
+}
+
+fn growSize(size: Size, margins: Margins) Size {
+    return Size.new(
+        fit(@as(u32, size.width) + margins.left + margins.right),
+        fit(@as(u32, size.height) + margins.top + margins.bottom),
+    );
+}
+
+fn shrinkRect(rect: Rectangle, margins: Margins) Rectangle {
+    return Rectangle.new(
+        Point.new(coord(@as(i32, rect.x) + margins.left), coord(@as(i32, rect.y) + margins.top)),
+        shrinkSize(rect.size(), margins),
+    );
+}
+
+test "layout: dock and table" {
+    var header: Rectangle = undefined;
+    var body: Rectangle = undefined;
+    var cell: Rectangle = undefined;
+
+    const cells = [_]Node{
+        Node{
+            .bounds = .{ .reference = &cell },
+            .container_layout_data = .{ .table_layout = .{ .row = 1, .column = 1, .row_span = 1, .col_span = 1 } },
+        },
+    };
+    const children = [_]Node{
+        Node{
+            .bounds = .{ .reference = &header },
+            .min_size = Size.new(0, 30),
+            .container_layout_data = .{ .dock_layout = .top },
+        },
+        Node{
+            .bounds = .{ .reference = &body },
+            .children = &cells,
+            .layout = .{ .table = .{
+                .rows = &[_]TableLayout.SizeSpecification{ .{ .absolute = 10 }, TableLayout.SizeSpecification.expand },
+                .columns = &[_]TableLayout.SizeSpecification{ .{ .relative = 0.25 }, TableLayout.SizeSpecification.expand },
+            } },
+        },
+    };
+
+    var tree = Tree.init(std.testing.allocator);
+    defer tree.deinit();
+
+    try tree.build(Node{ .layout = .{ .dock = .{} }, .children = &children });
+    tree.update(Rectangle{ .x = 0, .y = 0, .width = 200, .height = 100 });
+
+    try std.testing.expectEqual(Rectangle{ .x = 0, .y = 0, .width = 200, .height = 30 }, header);
+    try std.testing.expectEqual(Rectangle{ .x = 0, .y = 30, .width = 200, .height = 70 }, body);
+    try std.testing.expectEqual(Rectangle{ .x = 50, .y = 10, .width = 150, .height = 60 }, cell);
+}
+
+test "layout: incremental relayout matches a full layout" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+
+    const row_count = 20;
+    const items_per_row = 9;
+    const changed_row = row_count / 2;
+    const changed_item = 4;
+
+    // the root stacks flow rows of fixed size items
+    const rows = try arena.allocator().alloc(Node, row_count);
+    var changed_items: []Node = undefined;
+    for (rows) |*row, i| {
+        const items = try arena.allocator().alloc(Node, items_per_row);
+        for (items) |*item| {
+            item.* = Node{
+                .min_size = Size.new(20, 20),
+                .vertical_alignment = .left,
+                .horizontal_alignment = .top,
+            };
+        }
+        if (i == changed_row) {
+            changed_items = items;
+        }
+        row.* = Node{ .layout = .{ .flow = .{} }, .children = items };
+    }
+    const root_node = Node{ .layout = .{ .stack = .{ .direction = .top_to_bottom } }, .children = rows };
+
+    const area = Rectangle{ .x = 0, .y = 0, .width = 100, .height = 1080 };
+
+    var incremental = Tree.init(std.testing.allocator);
+    defer incremental.deinit();
+    try incremental.build(root_node);
+    incremental.update(area);
+    try std.testing.expectEqual(incremental.count(), incremental.statistics.measured_nodes);
+
+    for ([_]Size{ Size.new(20, 40), Size.new(60, 10), Size.new(20, 20) }) |min_size| {
+        const row_index = incremental.child(Tree.root, changed_row);
+        incremental.modify(incremental.child(row_index, changed_item)).min_size = min_size;
+        incremental.update(area);
+
+        // only the changed item and its ancestors are measured and arranged again,
+        // the siblings are just moved
+        try std.testing.expectEqual(@as(usize, 3), incremental.statistics.measured_nodes);
+        try std.testing.expectEqual(@as(usize, 3), incremental.statistics.arranged_nodes);
+
+        changed_items[changed_item].min_size = min_size;
+
+        var full = Tree.init(std.testing.allocator);
+        defer full.deinit();
+        try full.build(root_node);
+        full.update(area);
+
+        try std.testing.expectEqual(full.count(), incremental.count());
+        var index: Tree.Index = 0;
+        while (index < full.count()) : (index += 1) {
+            try std.testing.expectEqual(full.get(index).bounds.get(), incremental.get(index).bounds.get());
+        }
+    }
+}
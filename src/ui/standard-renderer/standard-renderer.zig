@@ -11,6 +11,7 @@ const Point = ui.Point;
 const Size = ui.Size;
 const Rectangle = ui.Rectangle;
 const Color = zg.Color;
+const screenCoord = zg.Renderer2D.screenCoord;
 
 const Widget = ui.Widget;
 const View = ui.View;
@@ -154,19 +155,28 @@ pub const Renderer = struct {
         try g.pushClipRectangle(area);
         defer g.popClipRectangle() catch {};
 
-        try renderer.renderControl(area, widget.control, (widget == view.focus));
+        // virtualized controls need to know their viewport before they can be drawn
+        switch (widget.control) {
+            .ListBox => |*list| try list.update(size.height),
+            .TreeView => |*tree| try tree.update(size.height),
+            .TextBox => |*box| try box.update(box.font orelse renderer.default_font, size.width),
+            .RichTextEditor => |*editor| try editor.update(editor.font orelse renderer.default_font, size),
+            else => {},
+        }
+
+        try renderer.renderControl(area, &widget.control, (widget == view.focus));
 
         try renderer.renderWidgetList(view, area, widget.children);
     }
 
-    fn renderControl(renderer: *Renderer, target_area: Rectangle, control: Control, has_focus: bool) error{OutOfMemory}!void {
+    fn renderControl(renderer: *Renderer, target_area: Rectangle, control: *Control, has_focus: bool) error{OutOfMemory}!void {
         const g = renderer.graphics;
         const t = renderer.theme;
 
         // see if the control has a function
         //     fn standardRender(control: ControlType, renderer: *zero_graphics.Renderer2D, theme: *Theme, rectangle: Rectangle) !void
         // and if so, invoke that function instead of using the default path
-        switch (control) {
+        switch (control.*) {
             inline else => |ctrl| {
                 if (@hasDecl(@TypeOf(ctrl), "standardRender")) {
                     try ctrl.standardRender(g, t, target_area);
@@ -179,7 +189,7 @@ pub const Renderer = struct {
         if (b.width < 4 or b.height < 4) // ignore all elements that are too small
             return;
 
-        switch (control) {
+        switch (control.*) {
             .Label => |label| {
                 // TODO: Draw label text!
 
@@ -262,7 +272,7 @@ pub const Renderer = struct {
                 }
             },
 
-            .TextBox => |text_box| {
+            .TextBox => |*text_box| {
                 try g.fillRectangle(b.shrink(1), if (text_box.flags.read_only)
                     t.area
                 else
@@ -300,42 +310,34 @@ pub const Renderer = struct {
                     );
                 }
 
-                const font = Font.from(text_box.font orelse renderer.default_font);
-                const text = text_box.getText();
-                const line_height = font.inner.getLineHeight();
-
+                const font = text_box.font orelse renderer.default_font;
+                const line_height = font.getLineHeight();
                 const dy = (b.height -| line_height) / 2;
 
-                try g.drawString(
-                    font.inner,
-                    text,
-                    b.x + 2,
-                    b.y + dy,
-                    t.text,
-                );
+                const scroll = @intCast(i32, std.math.min(text_box.scroll_offset, std.math.maxInt(i32)));
+                const text_x = @as(i32, b.x) + ui.controls.all.TextBox.padding - scroll;
+
+                // only draw the chunks of the line that are visible
+                const line = text_box.buffer.lineOf(text_box.cursor);
+                var chunks = try text_box.buffer.chunks(font, line, scroll, scroll + b.width);
+                while (chunks.next()) |chunk| {
+                    try g.drawString(
+                        Font.from(font).inner,
+                        chunk.text,
+                        screenCoord(@as(i64, text_x) + chunk.x),
+                        b.y + dy,
+                        t.text,
+                    );
+                }
 
                 if (has_focus) {
                     const timestamp = @bitCast(u64, std.time.milliTimestamp() +% std.math.minInt(i64));
                     if ((timestamp % t.blink_interval) >= t.blink_interval / 2) {
-                        const cursor_position = text_box.getCursor();
-
-                        var iter = std.unicode.Utf8View.initUnchecked(text).iterator();
-                        var end_pos: usize = 0;
-                        var count: usize = 0;
-                        while (iter.nextCodepointSlice()) |cps| : (count += 1) {
-                            if (count == cursor_position)
-                                break;
-                            end_pos +|= cps.len;
-                        }
-
-                        const substring = text[0..end_pos];
-
-                        const rect = font.graphics.measureString(font.inner, substring);
-
+                        const cursor_x = screenCoord(@as(i64, text_x) + text_box.cursor_x);
                         try g.drawLine(
-                            b.x + 2 + rect.width,
+                            cursor_x,
                             b.y + dy,
-                            b.x + 2 + rect.width,
+                            cursor_x,
                             b.y + dy + line_height,
                             t.text_cursor,
                         );
@@ -343,6 +345,57 @@ pub const Renderer = struct {
                 }
             },
 
+            .RichTextEditor => |*editor| {
+                try g.fillRectangle(b, if (editor.read_only) t.area else t.window);
+                try g.drawRectangle(b, t.area_shadow);
+
+                const font = editor.font orelse renderer.default_font;
+                const inner = Font.from(font).inner;
+                const padding = ui.controls.all.RichTextEditor.padding;
+
+                const scroll_x = @intCast(i32, std.math.min(editor.scroll_x, std.math.maxInt(i32)));
+                const text_x = @as(i64, b.x) + padding - scroll_x;
+                const text_y = @as(i64, b.y) + padding - @intCast(i64, editor.scroll_y);
+
+                const lines = editor.visibleLines();
+                var line = lines[0];
+                while (line <= lines[1]) : (line += 1) {
+                    const y = screenCoord(text_y + @as(i64, editor.line_height) * @intCast(i64, line));
+
+                    var chunks = try editor.buffer.chunks(font, line, scroll_x, scroll_x + editor.viewport.width);
+                    while (chunks.next()) |chunk| {
+                        var segments = editor.styleRuns(chunk.offset, chunk.offset + chunk.text.len);
+                        while (segments.next()) |segment| {
+                            const text = chunk.text[segment.start - chunk.offset .. segment.end - chunk.offset];
+                            const prefix = chunk.text[0 .. segment.start - chunk.offset];
+                            const x = screenCoord(text_x + chunk.x + font.measureString(prefix));
+                            const color = segment.style.color orelse t.text;
+
+                            if (segment.style.background != null or segment.style.underline) {
+                                const width = font.measureString(text);
+                                if (segment.style.background) |background| {
+                                    try g.fillRectangle(Rectangle{ .x = x, .y = y, .width = width, .height = editor.line_height }, background);
+                                }
+                                if (segment.style.underline) {
+                                    try g.drawLine(x, y + editor.line_height - 1, x + width, y + editor.line_height - 1, color);
+                                }
+                            }
+                            try g.drawString(inner, text, x, y, color);
+                        }
+                    }
+                }
+
+                if (has_focus) {
+                    const timestamp = @bitCast(u64, std.time.milliTimestamp() +% std.math.minInt(i64));
+                    if ((timestamp % t.blink_interval) >= t.blink_interval / 2) {
+                        const cursor_line = editor.buffer.lineOf(editor.cursor);
+                        const x = screenCoord(text_x + editor.cursor_x);
+                        const y = screenCoord(text_y + @as(i64, editor.line_height) * @intCast(i64, cursor_line));
+                        try g.drawLine(x, y, x, y + editor.line_height, t.text_cursor);
+                    }
+                }
+            },
+
             .Picture => |pic| if (pic.image) |image| {
                 const image_size = image.getSize();
 
@@ -381,6 +434,77 @@ pub const Renderer = struct {
                 try renderer.graphics.drawTexture(Rectangle.new(dest_offset.add(Point.new(b.x, b.y)), dest_size), Image.from(image).inner, pic.tint);
             },
 
+            .ListBox => |list| {
+                try g.fillRectangle(b, t.window);
+
+                const source = list.source orelse return;
+                const font = Font.from(list.font orelse renderer.default_font).inner;
+
+                const range = list.visibleRows();
+                var row = range.first;
+                while (row < range.end) : (row += 1) {
+                    const rect = list.rowRectangle(b, row);
+                    if (list.selection) |selection| {
+                        if (selection == row)
+                            try g.fillRectangle(rect, t.area_light);
+                    }
+                    try g.drawText(font, source.getText(row), rect.shrink(2), .{
+                        .color = t.text,
+                        .vertical_alignment = .center,
+                        .horizontal_alignment = .left,
+                    });
+                }
+            },
+
+            .TreeView => |tree| {
+                try g.fillRectangle(b, t.window);
+
+                const source = tree.source orelse return;
+                const font = Font.from(tree.font orelse renderer.default_font).inner;
+
+                const range = tree.visibleRows();
+                var row = range.first;
+                while (row < range.end) : (row += 1) {
+                    const item = tree.flat_rows.items[row];
+                    const rect = tree.rowRectangle(b, row);
+                    if (tree.selection) |selection| {
+                        if (selection == row)
+                            try g.fillRectangle(rect, t.area_light);
+                    }
+
+                    const indent = @intCast(i16, std.math.min(@as(u32, item.depth) * tree.indent, std.math.maxInt(i16)));
+                    if (item.has_children and tree.indent >= 7) {
+                        // draw a box with a minus or a plus, depending on the expand state
+                        const box_size = 7;
+                        const box = Rectangle{
+                            .x = rect.x + indent + @intCast(i16, (tree.indent - box_size) / 2),
+                            .y = rect.y + @intCast(i16, (rect.height -| box_size) / 2),
+                            .width = box_size,
+                            .height = box_size,
+                        };
+                        try g.drawRectangle(box, t.area_shadow);
+                        try g.drawLine(box.x + 2, box.y + 3, box.x + 4, box.y + 3, t.text);
+                        if (!item.expanded) {
+                            try g.drawLine(box.x + 3, box.y + 2, box.x + 3, box.y + 4, t.text);
+                        }
+                    }
+
+                    const text_x = indent +| @intCast(i16, tree.indent);
+                    if (text_x < rect.width) {
+                        try g.drawText(font, source.getText(item.node), Rectangle{
+                            .x = rect.x + text_x,
+                            .y = rect.y,
+                            .width = rect.width - @intCast(u15, text_x),
+                            .height = rect.height,
+                        }, .{
+                            .color = t.text,
+                            .vertical_alignment = .center,
+                            .horizontal_alignment = .left,
+                        });
+                    }
+                }
+            },
+
             else => {
                 // unsupported widget, draw a red box with a white outline and a cross
                 try g.fillRectangle(target_area, Color.red);
@@ -388,9 +512,9 @@ pub const Renderer = struct {
                 try g.drawLine(target_area.x, target_area.y, target_area.x + target_area.width - 1, target_area.y + target_area.height - 1, Color.white);
                 try g.drawLine(target_area.x, target_area.y + target_area.height - 1, target_area.x + target_area.width - 1, target_area.y, Color.white);
 
-                if (!renderer.unsupported.contains(control)) {
-                    renderer.unsupported.insert(control);
-                    logger.err("Encountered unsupported widget type: {s}", .{@tagName(control)});
+                if (!renderer.unsupported.contains(control.*)) {
+                    renderer.unsupported.insert(control.*);
+                    logger.err("Encountered unsupported widget type: {s}", .{@tagName(control.*)});
                 }
             },
         }
@@ -17,6 +17,8 @@ pub const Renderer3D = @import("rendering/Renderer3D.zig");
 pub const RendererSky = @import("rendering/RendererSky.zig");
 pub const DebugRenderer3D = @import("rendering/DebugRenderer3D.zig");
 pub const ResourceManager = @import("rendering/ResourceManager.zig");
+pub const skinning = @import("rendering/skinning.zig");
+pub const StaticBatch = @import("rendering/StaticBatch.zig");
 
 pub const Input = @import("Input.zig");
 
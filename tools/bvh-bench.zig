@@ -0,0 +1,102 @@
+//! Measures build time, refit time and ray throughput of the bounding volume hierarchy
+//! on a large procedural mesh. Runs headless: `zig build bench-bvh`.
+const std = @import("std");
+const bvh = @import("bvh");
+
+/// The mesh is a displaced grid of `resolution`² quads, the most that fit 16 bit indices.
+const resolution = 255;
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const stdout = std.io.getStdOut().writer();
+
+    var prng = std.rand.DefaultPrng.init(0x5EED);
+    const random = prng.random();
+
+    // build the terrain
+    const vertex_count = (resolution + 1) * (resolution + 1);
+    const positions = try allocator.alloc([3]f32, vertex_count);
+    defer allocator.free(positions);
+    for (positions) |*p, i| {
+        const x = @intToFloat(f32, i % (resolution + 1));
+        const z = @intToFloat(f32, i / (resolution + 1));
+        p.* = .{ x, 4 * @sin(0.1 * x) * @cos(0.13 * z) + random.float(f32), z };
+    }
+
+    const indices = try allocator.alloc(u16, 6 * resolution * resolution);
+    defer allocator.free(indices);
+    {
+        var i: usize = 0;
+        var z: u16 = 0;
+        while (z < resolution) : (z += 1) {
+            var x: u16 = 0;
+            while (x < resolution) : (x += 1) {
+                const v0 = z * (resolution + 1) + x;
+                const v1 = v0 + 1;
+                const v2 = v0 + resolution + 1;
+                const v3 = v2 + 1;
+                for ([6]u16{ v0, v2, v1, v1, v2, v3 }) |v| {
+                    indices[i] = v;
+                    i += 1;
+                }
+            }
+        }
+    }
+    const triangle_count = indices.len / 3;
+
+    // build
+    var timer = try std.time.Timer.start();
+    var mesh = try bvh.TriangleMesh.init(allocator, positions, indices);
+    defer mesh.deinit();
+    const build_time = timer.read();
+
+    try stdout.print("triangles:  {d}\n", .{triangle_count});
+    try stdout.print("nodes:      {d}\n", .{mesh.bvh.nodes.items.len});
+    try stdout.print("build:      {d:.2} ms\n", .{@intToFloat(f64, build_time) / std.time.ns_per_ms});
+
+    // refit after moving everything up
+    {
+        const boxes = try allocator.alloc(bvh.Aabb, triangle_count);
+        defer allocator.free(boxes);
+        for (boxes) |*box, i| {
+            box.* = bvh.Aabb.fromPoint(positions[indices[3 * i + 0]])
+                .grow(positions[indices[3 * i + 1]])
+                .grow(positions[indices[3 * i + 2]]);
+            box.min[1] += 1;
+            box.max[1] += 1;
+        }
+        timer.reset();
+        mesh.bvh.refit(boxes);
+        const refit_time = timer.read();
+        try stdout.print("refit:      {d:.2} ms\n", .{@intToFloat(f64, refit_time) / std.time.ns_per_ms});
+
+        // queries below run against the unmoved triangles again
+        for (boxes) |*box| {
+            box.min[1] -= 1;
+            box.max[1] -= 1;
+        }
+        mesh.bvh.refit(boxes);
+    }
+
+    // random rays from above the terrain
+    const ray_count = 1_000_000;
+    var hits: usize = 0;
+    timer.reset();
+    var i: usize = 0;
+    while (i < ray_count) : (i += 1) {
+        const ray = bvh.Ray{
+            .origin = .{ random.float(f32) * resolution, 20, random.float(f32) * resolution },
+            .direction = .{ random.float(f32) - 0.5, -1, random.float(f32) - 0.5 },
+        };
+        if (mesh.raycast(ray, std.math.inf(f32)) != null) {
+            hits += 1;
+        }
+    }
+    const ray_time = timer.read();
+
+    try stdout.print("rays:       {d} ({d} hits)\n", .{ ray_count, hits });
+    try stdout.print("throughput: {d:.2} Mrays/s\n", .{@intToFloat(f64, ray_count) / (@intToFloat(f64, ray_time) / std.time.ns_per_s) / 1e6});
+}
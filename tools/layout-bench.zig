@@ -0,0 +1,65 @@
+//! Measures a full layout of a 50k node tree against the relayout after changing a single node.
+//! Runs headless: `zig build bench-layout`.
+const std = @import("std");
+const layout = @import("layout-engine");
+
+const Node = layout.Node;
+const Size = layout.Size;
+const Rectangle = layout.Rectangle;
+
+/// The root stacks `row_count` flow rows with `items_per_row` items each.
+const row_count = 500;
+const items_per_row = 99;
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const stdout = std.io.getStdOut().writer();
+
+    var arena = std.heap.ArenaAllocator.init(allocator);
+    defer arena.deinit();
+
+    const rows = try arena.allocator().alloc(Node, row_count);
+    for (rows) |*row| {
+        const items = try arena.allocator().alloc(Node, items_per_row);
+        for (items) |*item| {
+            item.* = Node{
+                .min_size = Size.new(20, 20),
+                .vertical_alignment = .left,
+                .horizontal_alignment = .top,
+            };
+        }
+        row.* = Node{ .layout = .{ .flow = .{} }, .children = items };
+    }
+
+    var tree = layout.Tree.init(allocator);
+    defer tree.deinit();
+
+    try tree.build(Node{ .layout = .{ .stack = .{ .direction = .top_to_bottom } }, .children = rows });
+
+    const area = Rectangle{ .x = 0, .y = 0, .width = 1920, .height = 1080 };
+
+    var timer = try std.time.Timer.start();
+    tree.update(area);
+    const full_time = timer.read();
+
+    try stdout.print("nodes:      {d}\n", .{tree.count()});
+    try stdout.print("full:       {d:.3} ms ({d} measured)\n", .{
+        @intToFloat(f64, full_time) / std.time.ns_per_ms,
+        tree.statistics.measured_nodes,
+    });
+
+    const row_index = tree.child(layout.Tree.root, row_count / 2);
+
+    timer.reset();
+    tree.modify(tree.child(row_index, 42)).min_size = Size.new(20, 40);
+    tree.update(area);
+    const incremental_time = timer.read();
+
+    try stdout.print("relayout:   {d:.3} ms ({d} measured)\n", .{
+        @intToFloat(f64, incremental_time) / std.time.ns_per_ms,
+        tree.statistics.measured_nodes,
+    });
+}
@@ -0,0 +1,755 @@
+//!
+//! Compiles `.layout` UI templates into Zig source code.
+//!
+//! A template describes a tree of widgets. Each element is a control class with
+//! an optional name, its properties and its children:
+//!
+//!     username : TextBox {
+//!         horizontal-alignment: stretch;
+//!     }
+//!
+//! Elements named after a layout (`BasicLayout`, `StackLayout`, `DockLayout`,
+//! `FlowLayout`, `TableLayout`, `CanvasLayout`) don't create a widget. They set
+//! the layout of the surrounding widget, or of the view on the top level, and
+//! their children are placed by that layout.
+//!
+//! The generated file is a struct with statically sized arrays of `Widget`s and
+//! standard-layout `Node`s. Its `init` links both trees in place, so creating a
+//! UI neither parses nor allocates. The file imports the packages `zero-ui`
+//! and `layout-engine`.
+//!
+//! Properties that are not listed in `node_properties` or `widget_properties`
+//! are passed to the control, with dashes in names replaced by underscores.
+//! Identifiers become enum literals, so the Zig compiler checks all values.
+//!
+
+const std = @import("std");
+const logger = std.log.scoped(.layout_compiler);
+
+pub fn main() !u8 {
+    var arena = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    if (args.len != 3) {
+        try std.io.getStdErr().writer().print("usage: {s} <input.layout> <output.zig>\n", .{
+            if (args.len > 0) std.fs.path.basename(args[0]) else "layout-compiler",
+        });
+        return 1;
+    }
+
+    const source = try std.fs.cwd().readFileAlloc(allocator, args[1], 1 << 20);
+
+    var output = std.ArrayList(u8).init(allocator);
+    try compile(allocator, source, std.fs.path.basename(args[1]), output.writer());
+
+    try std.fs.cwd().writeFile(args[2], output.items);
+    return 0;
+}
+
+pub const Error = error{ InvalidLayout, OutOfMemory };
+
+/// Compiles the template in `source` and writes the Zig code to `writer`. Errors in the
+/// template are logged with `file_name` and their location, then `error.InvalidLayout` is returned.
+pub fn compile(allocator: std.mem.Allocator, source: []const u8, file_name: []const u8, writer: anytype) !void {
+    var arena = std.heap.ArenaAllocator.init(allocator);
+    defer arena.deinit();
+
+    var compiler = Compiler{
+        .allocator = arena.allocator(),
+        .file_name = file_name,
+        .tokens = undefined,
+    };
+    compiler.tokens = try compiler.tokenize(source);
+
+    const elements = try compiler.parseElements();
+
+    var root = Node{ .element = null };
+    try compiler.collect(&root, elements);
+
+    var widgets = std.ArrayList(*Node).init(compiler.allocator);
+    try compiler.numberWidgets(&root, &widgets);
+
+    // nodes are numbered breadth-first, so the children of each node are consecutive
+    var nodes = std.ArrayList(*Node).init(compiler.allocator);
+    try nodes.append(&root);
+    var i: usize = 0;
+    while (i < nodes.items.len) : (i += 1) {
+        const node = nodes.items[i];
+        node.node_index = i;
+        try compiler.placeChildren(node);
+        try nodes.appendSlice(node.children.items);
+    }
+
+    try compiler.emit(writer, widgets.items, nodes.items);
+}
+
+/// Properties that configure the layout node of a widget.
+const node_properties = [_][]const u8{
+    "margin",      "padding", "min-size", "max-size", "horizontal-alignment", "vertical-alignment",
+    "dock",        "row",     "column",   "row-span", "column-span",          "x",
+    "y",
+};
+
+/// Properties that are stored in `Widget` itself instead of its control.
+const widget_properties = [_][]const u8{ "enabled", "hit-test-visible", "can-receive-focus", "visibility" };
+
+const LayoutKind = enum { basic, stack, dock, flow, table, canvas };
+
+fn layoutKind(class: []const u8) ?LayoutKind {
+    const map = .{
+        .{ "BasicLayout", LayoutKind.basic },
+        .{ "StackLayout", LayoutKind.stack },
+        .{ "DockLayout", LayoutKind.dock },
+        .{ "FlowLayout", LayoutKind.flow },
+        .{ "TableLayout", LayoutKind.table },
+        .{ "CanvasLayout", LayoutKind.canvas },
+    };
+    inline for (map) |entry| {
+        if (std.mem.eql(u8, class, entry[0]))
+            return entry[1];
+    }
+    return null;
+}
+
+const Token = struct {
+    tag: Tag,
+    text: []const u8,
+    line: u32,
+    column: u32,
+
+    const Tag = enum {
+        identifier,
+        string,
+        number,
+        percentage,
+        brace_open,
+        brace_close,
+        colon,
+        semicolon,
+        comma,
+        end_of_file,
+    };
+};
+
+const Property = struct {
+    name: Token,
+    values: []const Token,
+};
+
+const Element = struct {
+    name: ?Token,
+    class: Token,
+    properties: []const Property,
+    children: []const *const Element,
+
+    fn property(element: Element, name: []const u8) ?Property {
+        for (element.properties) |prop| {
+            if (std.mem.eql(u8, prop.name.text, name))
+                return prop;
+        }
+        return null;
+    }
+};
+
+/// A widget or the view, which is the root of both trees.
+const Node = struct {
+    /// The widget element, `null` for the view.
+    element: ?*const Element,
+
+    /// The layout element that places the children.
+    layout: ?*const Element = null,
+
+    children: std.ArrayListUnmanaged(*Node) = .{},
+
+    widget_index: usize = 0,
+    node_index: usize = 0,
+
+    /// The layout of the parent, which places this node.
+    parent_layout: LayoutKind = .basic,
+    is_last_child: bool = false,
+
+    /// The cell in the parent table, if the parent has a `TableLayout`.
+    cell: Cell = .{},
+
+    const Cell = struct {
+        row: u15 = 0,
+        column: u15 = 0,
+        row_span: u15 = 1,
+        col_span: u15 = 1,
+    };
+
+    fn layoutKindOf(node: Node) LayoutKind {
+        const layout = node.layout orelse return .basic;
+        return layoutKind(layout.class.text).?;
+    }
+};
+
+const Compiler = struct {
+    allocator: std.mem.Allocator,
+    file_name: []const u8,
+    tokens: []const Token,
+    index: usize = 0,
+
+    fn fail(compiler: Compiler, token: Token, comptime fmt: []const u8, args: anytype) error{InvalidLayout} {
+        logger.err("{s}:{}:{}: " ++ fmt, .{ compiler.file_name, token.line, token.column } ++ args);
+        return error.InvalidLayout;
+    }
+
+    fn tokenize(compiler: Compiler, source: []const u8) Error![]const Token {
+        var tokens = std.ArrayList(Token).init(compiler.allocator);
+
+        var line: u32 = 1;
+        var line_start: usize = 0;
+        var i: usize = 0;
+        while (true) {
+            // skip whitespace and comments
+            while (i < source.len) {
+                if (source[i] == '\n') {
+                    line += 1;
+                    line_start = i + 1;
+                    i += 1;
+                } else if (std.ascii.isSpace(source[i])) {
+                    i += 1;
+                } else if (std.mem.startsWith(u8, source[i..], "//")) {
+                    while (i < source.len and source[i] != '\n') i += 1;
+                } else break;
+            }
+
+            var token = Token{
+                .tag = .end_of_file,
+                .text = source[i..i],
+                .line = line,
+                .column = @intCast(u32, i - line_start + 1),
+            };
+            if (i >= source.len) {
+                try tokens.append(token);
+                return tokens.toOwnedSlice();
+            }
+
+            const start = i;
+            const c = source[i];
+            i += 1;
+            switch (c) {
+                '{' => token.tag = .brace_open,
+                '}' => token.tag = .brace_close,
+                ':' => token.tag = .colon,
+                ';' => token.tag = .semicolon,
+                ',' => token.tag = .comma,
+                '"' => {
+                    token.tag = .string;
+                    while (i < source.len and source[i] != '"' and source[i] != '\n') : (i += 1) {
+                        if (source[i] == '\\' and i + 1 < source.len) i += 1;
+                    }
+                    if (i >= source.len or source[i] != '"')
+                        return compiler.fail(token, "unterminated string", .{});
+                    i += 1;
+                },
+                '0'...'9', '-' => {
+                    token.tag = .number;
+                    while (i < source.len and (std.ascii.isDigit(source[i]) or source[i] == '.')) i += 1;
+                    if (i < source.len and source[i] == '%') {
+                        token.tag = .percentage;
+                        i += 1;
+                    }
+                },
+                'a'...'z', 'A'...'Z', '_' => {
+                    token.tag = .identifier;
+                    while (i < source.len and (std.ascii.isAlNum(source[i]) or source[i] == '_' or source[i] == '-')) i += 1;
+                },
+                else => return compiler.fail(token, "unexpected character '{c}'", .{c}),
+            }
+            token.text = source[start..i];
+            try tokens.append(token);
+        }
+    }
+
+    fn peek(compiler: Compiler, offset: usize) Token {
+        return compiler.tokens[std.math.min(compiler.index + offset, compiler.tokens.len - 1)];
+    }
+
+    fn expect(compiler: *Compiler, tag: Token.Tag) !Token {
+        const token = compiler.peek(0);
+        if (token.tag != tag)
+            return compiler.fail(token, "expected {s}, found '{s}'", .{ @tagName(tag), token.text });
+        compiler.index += 1;
+        return token;
+    }
+
+    /// Parses the elements on the top level of the file.
+    fn parseElements(compiler: *Compiler) Error![]const *const Element {
+        var elements = std.ArrayList(*const Element).init(compiler.allocator);
+        while (compiler.peek(0).tag != .end_of_file) {
+            try elements.append(try compiler.parseElement());
+        }
+        return elements.toOwnedSlice();
+    }
+
+    /// element := [ identifier ":" ] identifier "{" { property | element } "}"
+    /// property := identifier ":" value { "," value } ";"
+    fn parseElement(compiler: *Compiler) Error!*const Element {
+        var name: ?Token = null;
+        if (compiler.peek(1).tag == .colon) {
+            name = try compiler.expect(.identifier);
+            _ = try compiler.expect(.colon);
+        }
+        const class = try compiler.expect(.identifier);
+        _ = try compiler.expect(.brace_open);
+
+        var properties = std.ArrayList(Property).init(compiler.allocator);
+        var children = std.ArrayList(*const Element).init(compiler.allocator);
+
+        while (compiler.peek(0).tag != .brace_close) {
+            const is_property = compiler.peek(1).tag == .colon and
+                !(compiler.peek(2).tag == .identifier and compiler.peek(3).tag == .brace_open);
+            if (is_property) {
+                try properties.append(try compiler.parseProperty());
+            } else {
+                try children.append(try compiler.parseElement());
+            }
+        }
+        _ = try compiler.expect(.brace_close);
+
+        const element = try compiler.allocator.create(Element);
+        element.* = Element{
+            .name = name,
+            .class = class,
+            .properties = properties.toOwnedSlice(),
+            .children = children.toOwnedSlice(),
+        };
+        return element;
+    }
+
+    fn parseProperty(compiler: *Compiler) Error!Property {
+        const name = try compiler.expect(.identifier);
+        _ = try compiler.expect(.colon);
+
+        var values = std.ArrayList(Token).init(compiler.allocator);
+        while (true) {
+            const value = compiler.peek(0);
+            switch (value.tag) {
+                .identifier, .string, .number, .percentage => {},
+                else => return compiler.fail(value, "expected a value, found '{s}'", .{value.text}),
+            }
+            compiler.index += 1;
+            try values.append(value);
+
+            if (compiler.peek(0).tag != .comma)
+                break;
+            compiler.index += 1;
+        }
+        _ = try compiler.expect(.semicolon);
+
+        return Property{ .name = name, .values = values.toOwnedSlice() };
+    }
+
+    /// Adds the widgets in `elements` to `container`, layout elements configure `container` itself.
+    fn collect(compiler: *Compiler, container: *Node, elements: []const *const Element) Error!void {
+        for (elements) |element| {
+            if (layoutKind(element.class.text) != null) {
+                if (element.name) |name|
+                    return compiler.fail(name, "layouts can't be named", .{});
+                if (container.layout != null)
+                    return compiler.fail(element.class, "a widget can only have a single layout", .{});
+                container.layout = element;
+                try compiler.collect(container, element.children);
+            } else {
+                const node = try compiler.allocator.create(Node);
+                node.* = Node{ .element = element };
+                try container.children.append(compiler.allocator, node);
+                try compiler.collect(node, element.children);
+            }
+        }
+    }
+
+    /// Numbers the widgets in the order they are linked into their parents.
+    fn numberWidgets(compiler: *Compiler, node: *Node, widgets: *std.ArrayList(*Node)) Error!void {
+        for (node.children.items) |child| {
+            child.widget_index = widgets.items.len;
+            try widgets.append(child);
+            try compiler.numberWidgets(child, widgets);
+        }
+    }
+
+    /// Tells the children of `node` how they are placed and assigns table cells. Children without
+    /// a `row` and `column` take the next free cell, row by row.
+    fn placeChildren(compiler: *Compiler, node: *Node) Error!void {
+        const kind = node.layoutKindOf();
+        for (node.children.items) |child, i| {
+            child.parent_layout = kind;
+            child.is_last_child = (i == node.children.items.len - 1);
+        }
+
+        if (kind != .table)
+            return;
+
+        const columns = if (node.layout.?.property("columns")) |prop| prop.values.len else 1;
+
+        var row: u15 = 0;
+        var column: u15 = 0;
+        for (node.children.items) |child| {
+            const element = child.element.?;
+            const cell = &child.cell;
+            cell.row = if (element.property("row")) |prop| try compiler.integer(u15, prop) else row;
+            cell.column = if (element.property("column")) |prop| try compiler.integer(u15, prop) else column;
+            cell.row_span = if (element.property("row-span")) |prop| try compiler.integer(u15, prop) else 1;
+            cell.col_span = if (element.property("column-span")) |prop| try compiler.integer(u15, prop) else 1;
+
+            row = cell.row;
+            column = cell.column + cell.col_span;
+            if (column >= columns) {
+                row += 1;
+                column = 0;
+            }
+        }
+    }
+
+    fn integer(compiler: Compiler, comptime T: type, prop: Property) !T {
+        if (prop.values.len != 1)
+            return compiler.fail(prop.name, "'{s}' expects a single number", .{prop.name.text});
+        return compiler.parseInteger(T, prop.values[0]);
+    }
+
+    fn parseInteger(compiler: Compiler, comptime T: type, token: Token) !T {
+        if (token.tag != .number)
+            return compiler.fail(token, "expected a number, found '{s}'", .{token.text});
+        return std.fmt.parseInt(T, token.text, 10) catch
+            compiler.fail(token, "'{s}' is not a valid {s}", .{ token.text, @typeName(T) });
+    }
+
+    fn identifier(compiler: Compiler, prop: Property, comptime allowed: []const []const u8) ![]const u8 {
+        if (prop.values.len == 1 and prop.values[0].tag == .identifier) {
+            inline for (allowed) |value| {
+                if (std.mem.eql(u8, prop.values[0].text, value))
+                    return value;
+            }
+        }
+        return compiler.fail(prop.name, "invalid value for '{s}'", .{prop.name.text});
+    }
+
+    fn emit(compiler: *Compiler, writer: anytype, widgets: []const *Node, nodes: []const *Node) !void {
+        try writer.print(
+            \\//! Generated from `{s}` by the zero-graphics layout compiler. Do not edit.
+            \\
+            \\const ui = @import("zero-ui");
+            \\const layout = @import("layout-engine");
+            \\
+            \\const Template = @This();
+            \\
+            \\/// The named widgets of the template.
+            \\pub const Id = enum(usize) {{
+            \\
+        , .{compiler.file_name});
+
+        var names = std.StringHashMap(void).init(compiler.allocator);
+        for (widgets) |widget| {
+            const name = widget.element.?.name orelse continue;
+            const identifier_name = try snakeCase(compiler.allocator, name.text);
+            if (try names.fetchPut(identifier_name, {})) |_|
+                return compiler.fail(name, "duplicate name '{s}'", .{name.text});
+            try writer.print("    {} = {},\n", .{ std.zig.fmtId(identifier_name), widget.widget_index });
+        }
+        try writer.writeAll("    _,\n};\n\n");
+
+        try writer.print(
+            \\widgets: [{}]ui.Widget = undefined,
+            \\
+            \\/// The layout tree, `nodes[0]` is the root that covers the view.
+            \\nodes: [{}]layout.Node = undefined,
+            \\
+            \\view: ui.View = undefined,
+            \\
+            \\pub fn widget(template: *Template, id: Id) *ui.Widget {{
+            \\    return &template.widgets[@enumToInt(id)];
+            \\}}
+            \\
+            \\/// Creates the widget and layout trees in place. Nothing is parsed or allocated.
+            \\/// Call `view.init` afterwards to initialize the controls, and build a `layout.Tree`
+            \\/// from `nodes[0]` to layout the widgets.
+            \\pub fn init(template: *Template) void {{
+            \\    template.view = .{{ .widgets = .{{}} }};
+            \\
+        , .{ widgets.len, nodes.len });
+
+        for (widgets) |widget| {
+            try compiler.emitWidget(writer, widget);
+        }
+        for (nodes[0].children.items) |child| {
+            try writer.print("    template.view.widgets.append(&template.widgets[{}].siblings);\n", .{child.widget_index});
+        }
+        for (widgets) |widget| {
+            for (widget.children.items) |child| {
+                try writer.print("    template.widgets[{}].children.append(&template.widgets[{}].siblings);\n", .{ widget.widget_index, child.widget_index });
+            }
+        }
+        try writer.writeAll("\n");
+
+        for (nodes) |node| {
+            try compiler.emitNode(writer, node);
+        }
+
+        try writer.writeAll("}\n");
+    }
+
+    fn emitWidget(compiler: *Compiler, writer: anytype, node: *const Node) !void {
+        const element = node.element.?;
+
+        try writer.print("    template.widgets[{}] = .{{\n", .{node.widget_index});
+        for (element.properties) |prop| {
+            if (contains(&widget_properties, prop.name.text)) {
+                try writer.print("        .{} = ", .{std.zig.fmtId(try snakeCase(compiler.allocator, prop.name.text))});
+                try compiler.emitValue(writer, prop);
+                try writer.writeAll(",\n");
+            }
+        }
+
+        try writer.print("        .control = .{{ .{} = .{{", .{std.zig.fmtId(element.class.text)});
+        for (element.properties) |prop| {
+            if (contains(&widget_properties, prop.name.text) or contains(&node_properties, prop.name.text))
+                continue;
+            try writer.print(" .{} = ", .{std.zig.fmtId(try snakeCase(compiler.allocator, prop.name.text))});
+            try compiler.emitValue(writer, prop);
+            try writer.writeAll(",");
+        }
+        try writer.writeAll(" } },\n    };\n");
+    }
+
+    fn emitValue(compiler: *Compiler, writer: anytype, prop: Property) !void {
+        if (prop.values.len != 1)
+            return compiler.fail(prop.name, "'{s}' expects a single value", .{prop.name.text});
+        const value = prop.values[0];
+        switch (value.tag) {
+            // the string token includes its quotes and escapes
+            .string, .number => try writer.writeAll(value.text),
+            .identifier => if (std.mem.eql(u8, value.text, "true") or std.mem.eql(u8, value.text, "false") or std.mem.eql(u8, value.text, "null")) {
+                try writer.writeAll(value.text);
+            } else {
+                try writer.print(".{}", .{std.zig.fmtId(try snakeCase(compiler.allocator, value.text))});
+            },
+            else => return compiler.fail(value, "percentages are only allowed in table rows and columns", .{}),
+        }
+    }
+
+    fn emitNode(compiler: *Compiler, writer: anytype, node: *const Node) !void {
+        try writer.print("    template.nodes[{}] = .{{\n", .{node.node_index});
+
+        if (node.element != null) {
+            try writer.print("        .bounds = .{{ .widget = &template.widgets[{}].bounds }},\n", .{node.widget_index});
+        }
+        if (node.children.items.len > 0) {
+            const first = node.children.items[0].node_index;
+            try writer.print("        .children = template.nodes[{}..{}],\n", .{ first, first + node.children.items.len });
+        }
+        if (node.layout) |layout| {
+            try writer.writeAll("        .layout = ");
+            try compiler.emitLayout(writer, layout);
+            try writer.writeAll(",\n");
+        }
+
+        if (node.element) |element| {
+            for (element.properties) |prop| {
+                const name = prop.name.text;
+                if (std.mem.eql(u8, name, "margin") or std.mem.eql(u8, name, "padding")) {
+                    const m = try compiler.margins(prop);
+                    try writer.print("        .{s} = .{{ .top = {}, .right = {}, .bottom = {}, .left = {} }},\n", .{ name, m[0], m[1], m[2], m[3] });
+                } else if (std.mem.eql(u8, name, "min-size") or std.mem.eql(u8, name, "max-size")) {
+                    if (prop.values.len != 2)
+                        return compiler.fail(prop.name, "'{s}' expects a width and a height", .{name});
+                    try writer.print("        .{s}_size = .{{ .width = {}, .height = {} }},\n", .{
+                        name[0..3],
+                        try compiler.parseInteger(u15, prop.values[0]),
+                        try compiler.parseInteger(u15, prop.values[1]),
+                    });
+                } else if (std.mem.eql(u8, name, "horizontal-alignment")) {
+                    // `Node.vertical_alignment` holds the placement on the horizontal axis, see `VerticalAlignment`
+                    const value = try compiler.identifier(prop, &.{ "stretch", "left", "center", "right" });
+                    try writer.print("        .vertical_alignment = .{s},\n", .{value});
+                } else if (std.mem.eql(u8, name, "vertical-alignment")) {
+                    const value = try compiler.identifier(prop, &.{ "stretch", "top", "center", "middle", "bottom" });
+                    try writer.print("        .horizontal_alignment = .{s},\n", .{
+                        if (std.mem.eql(u8, value, "center")) "middle" else value,
+                    });
+                }
+            }
+            try compiler.emitContainerData(writer, node, element);
+        }
+
+        try writer.writeAll("    };\n");
+    }
+
+    /// Emits the data the layout of the parent needs to place `node`.
+    fn emitContainerData(compiler: *Compiler, writer: anytype, node: *const Node, element: *const Element) !void {
+        const parent_layout = node.parent_layout;
+
+        for (element.properties) |prop| {
+            const name = prop.name.text;
+            const required: LayoutKind = if (std.mem.eql(u8, name, "dock"))
+                .dock
+            else if (std.mem.eql(u8, name, "row") or std.mem.eql(u8, name, "column") or std.mem.eql(u8, name, "row-span") or std.mem.eql(u8, name, "column-span"))
+                .table
+            else if (std.mem.eql(u8, name, "x") or std.mem.eql(u8, name, "y"))
+                .canvas
+            else
+                continue;
+            if (parent_layout != required)
+                return compiler.fail(prop.name, "'{s}' requires the parent to have a {s} layout", .{ name, @tagName(required) });
+        }
+
+        switch (parent_layout) {
+            .basic, .stack, .flow => {},
+            .table => try writer.print("        .container_layout_data = .{{ .table_layout = .{{ .row = {}, .column = {}, .row_span = {}, .col_span = {} }} }},\n", .{
+                node.cell.row,
+                node.cell.column,
+                node.cell.row_span,
+                node.cell.col_span,
+            }),
+            .dock => if (element.property("dock")) |prop| {
+                const site = try compiler.identifier(prop, &.{ "top", "left", "right", "bottom" });
+                try writer.print("        .container_layout_data = .{{ .dock_layout = .{s} }},\n", .{site});
+            } else if (!node.is_last_child) {
+                return compiler.fail(element.class, "children of a dock layout need a 'dock' property, except for the last one", .{});
+            },
+            .canvas => try writer.print("        .container_layout_data = .{{ .canvas_layout = .{{ .x = {}, .y = {} }} }},\n", .{
+                if (element.property("x")) |prop| try compiler.integer(i16, prop) else 0,
+                if (element.property("y")) |prop| try compiler.integer(i16, prop) else 0,
+            }),
+        }
+    }
+
+    fn emitLayout(compiler: *Compiler, writer: anytype, layout: *const Element) !void {
+        const kind = layoutKind(layout.class.text).?;
+        switch (kind) {
+            .basic => try writer.writeAll(".basic"),
+            .dock => try writer.writeAll(".{ .dock = .{} }"),
+            .table => {
+                try writer.writeAll(".{ .table = .{");
+                for ([_][]const u8{ "rows", "columns" }) |name| {
+                    try writer.print(" .{s} = &[_]layout.TableLayout.SizeSpecification{{", .{name});
+                    if (layout.property(name)) |prop| {
+                        for (prop.values) |value| {
+                            try compiler.emitTrackSize(writer, value);
+                        }
+                    } else {
+                        try writer.writeAll(" .{ .flex = 1.0 },");
+                    }
+                    try writer.writeAll(" },");
+                }
+                try writer.writeAll(" } }");
+            },
+            .stack, .flow, .canvas => {
+                try writer.print(".{{ .{s} = .{{", .{@tagName(kind)});
+                if (kind == .stack and layout.property("direction") == null) {
+                    try writer.writeAll(" .direction = .top_to_bottom,");
+                }
+                for (layout.properties) |prop| {
+                    try writer.print(" .{} = ", .{std.zig.fmtId(try snakeCase(compiler.allocator, prop.name.text))});
+                    if (kind == .canvas and std.mem.eql(u8, prop.name.text, "reference")) {
+                        if (prop.values.len != 2)
+                            return compiler.fail(prop.name, "'reference' expects an x and a y coordinate", .{});
+                        try writer.print(".{{ .x = {}, .y = {} }}", .{
+                            try compiler.parseInteger(i16, prop.values[0]),
+                            try compiler.parseInteger(i16, prop.values[1]),
+                        });
+                    } else {
+                        try compiler.emitValue(writer, prop);
+                    }
+                    try writer.writeAll(",");
+                }
+                try writer.writeAll(" } }");
+            },
+        }
+    }
+
+    /// Emits a row or column size: `auto`, `expand`, a number of units or a percentage.
+    fn emitTrackSize(compiler: *Compiler, writer: anytype, value: Token) !void {
+        switch (value.tag) {
+            .number => try writer.print(" .{{ .absolute = {} }},", .{try compiler.parseInteger(u15, value)}),
+            .percentage => {
+                const percent = std.fmt.parseFloat(f32, value.text[0 .. value.text.len - 1]) catch
+                    return compiler.fail(value, "'{s}' is not a valid percentage", .{value.text});
+                try writer.print(" .{{ .relative = {d} }},", .{percent / 100.0});
+            },
+            .identifier => if (std.mem.eql(u8, value.text, "auto")) {
+                try writer.writeAll(" .{ .flex = 0.0 },");
+            } else if (std.mem.eql(u8, value.text, "expand")) {
+                try writer.writeAll(" .{ .flex = 1.0 },");
+            } else {
+                return compiler.fail(value, "expected 'auto', 'expand', a number or a percentage, found '{s}'", .{value.text});
+            },
+            else => return compiler.fail(value, "expected a row or column size, found '{s}'", .{value.text}),
+        }
+    }
+
+    fn margins(compiler: Compiler, prop: Property) ![4]u15 {
+        var values: [4]u15 = undefined;
+        for (prop.values) |value, i| {
+            if (i >= 4) break;
+            values[i] = try compiler.parseInteger(u15, value);
+        }
+        // top, right, bottom, left like in CSS
+        return switch (prop.values.len) {
+            1 => [4]u15{ values[0], values[0], values[0], values[0] },
+            2 => [4]u15{ values[0], values[1], values[0], values[1] },
+            4 => values,
+            else => compiler.fail(prop.name, "'{s}' expects 1, 2 or 4 values", .{prop.name.text}),
+        };
+    }
+};
+
+fn contains(list: []const []const u8, name: []const u8) bool {
+    for (list) |item| {
+        if (std.mem.eql(u8, item, name))
+            return true;
+    }
+    return false;
+}
+
+fn snakeCase(allocator: std.mem.Allocator, name: []const u8) ![]const u8 {
+    const result = try allocator.dupe(u8, name);
+    std.mem.replaceScalar(u8, result, '-', '_');
+    return result;
+}
+
+test "layout compiler: login window" {
+    const source =
+        \\Panel {
+        \\  vertical-alignment: center;
+        \\
+        \\  TableLayout {
+        \\    columns: auto, 300;
+        \\    rows: auto, 25%, expand;
+        \\
+        \\    logo : Picture { column-span: 2; }
+        \\    Label { text: "User \"name\":"; }
+        \\    username : TextBox { }
+        \\    login_button : Button { horizontal-alignment: right; text: "Login"; }
+        \\  }
+        \\}
+    ;
+
+    var output = std.ArrayList(u8).init(std.testing.allocator);
+    defer output.deinit();
+
+    try compile(std.testing.allocator, source, "test.layout", output.writer());
+
+    const expected = [_][]const u8{
+        "    logo = 1,\n",
+        "    login_button = 4,\n",
+        "widgets: [5]ui.Widget = undefined,",
+        "nodes: [6]layout.Node = undefined,",
+        "template.view.widgets.append(&template.widgets[0].siblings);",
+        "template.widgets[0].children.append(&template.widgets[4].siblings);",
+        ".control = .{ .Label = .{ .text = \"User \\\"name\\\":\", } },",
+        ".rows = &[_]layout.TableLayout.SizeSpecification{ .{ .flex = 0.0 }, .{ .relative = 0.25 }, .{ .flex = 1.0 }, },",
+        ".horizontal_alignment = .middle,",
+        ".container_layout_data = .{ .table_layout = .{ .row = 1, .column = 0, .row_span = 1, .col_span = 1 } },",
+        ".container_layout_data = .{ .table_layout = .{ .row = 2, .column = 0, .row_span = 1, .col_span = 1 } },",
+    };
+    for (expected) |snippet| {
+        if (std.mem.indexOf(u8, output.items, snippet) == null) {
+            std.debug.print("missing in output: {s}\n\n{s}\n", .{ snippet, output.items });
+            return error.TestUnexpectedResult;
+        }
+    }
+}
@@ -0,0 +1,147 @@
+//! Measures software occlusion culling on a fixed city scene: rows of buildings as occluders and
+//! small boxes scattered between and behind them, seen from street level.
+//! Runs headless: `zig build bench-occlusion`.
+const std = @import("std");
+const occlusion = @import("occlusion");
+
+const Mat4 = [4][4]f32;
+
+const buffer_width = 256;
+const buffer_height = 128;
+
+/// The buildings stand in `rows` rows of `columns` along the view direction.
+const rows = 20;
+const columns = 11;
+const object_count = 20_000;
+const rounds = 20;
+
+/// A unit cube from 0 to 1, scaled and moved into place by the occluder transform.
+const cube = occlusion.Proxy{
+    .positions = &[_][3]f32{
+        .{ 0, 0, 0 }, .{ 1, 0, 0 }, .{ 1, 1, 0 }, .{ 0, 1, 0 },
+        .{ 0, 0, 1 }, .{ 1, 0, 1 }, .{ 1, 1, 1 }, .{ 0, 1, 1 },
+    },
+    .indices = &[_]u16{
+        0, 2, 1, 0, 3, 2, // back
+        4, 5, 6, 4, 6, 7, // front
+        0, 4, 7, 0, 7, 3, // left
+        1, 2, 6, 1, 6, 5, // right
+        3, 7, 6, 3, 6, 2, // top
+        0, 1, 5, 0, 5, 4, // bottom
+    },
+};
+
+const Box = struct {
+    min: [3]f32,
+    max: [3]f32,
+};
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const stdout = std.io.getStdOut().writer();
+
+    var prng = std.rand.DefaultPrng.init(0x5EED);
+    const random = prng.random();
+
+    var occluders: [rows * columns]occlusion.Occluder = undefined;
+    for (occluders) |*occluder, i| {
+        const row = i / columns;
+        const column = i % columns;
+        const height = 10 + 20 * random.float(f32);
+        occluder.* = occlusion.Occluder{
+            .proxy = cube,
+            .transform = .{
+                .{ 16, 0, 0, 0 },
+                .{ 0, height, 0, 0 },
+                .{ 0, 0, 16, 0 },
+                .{ -108 + 20 * @intToFloat(f32, column), 0, -36 - 20 * @intToFloat(f32, row), 1 },
+            },
+        };
+    }
+
+    const objects = try allocator.alloc(Box, object_count);
+    defer allocator.free(objects);
+    for (objects) |*object| {
+        const x = -110 + 220 * random.float(f32);
+        const z = -20 - 400 * random.float(f32);
+        object.* = Box{ .min = .{ x, 0, z }, .max = .{ x + 1, 1 + random.float(f32), z + 1 } };
+    }
+
+    // a camera at street level, looking down the negative z axis
+    const view_projection = mul(perspective(std.math.pi / 3.0, 2.0, 0.5, 500), translation(0, -2, 0));
+    const identity = translation(0, 0, 0);
+
+    var buffer = try occlusion.DepthBuffer.init(allocator, buffer_width, buffer_height);
+    defer buffer.deinit();
+
+    try stdout.print("buffer:     {d}x{d}\n", .{ buffer_width, buffer_height });
+    try stdout.print("occluders:  {d} ({d} triangles)\n", .{ occluders.len, occluders.len * cube.indices.len / 3 });
+    try stdout.print("objects:    {d}\n", .{object_count});
+
+    const cpu_count = std.Thread.getCpuCount() catch 1;
+    for ([_]usize{ 1, cpu_count }) |threads| {
+        buffer.thread_count = threads;
+
+        var timer = try std.time.Timer.start();
+        var i: usize = 0;
+        while (i < rounds) : (i += 1) {
+            buffer.clear();
+            for (occluders) |occluder| {
+                try buffer.addOccluder(occluder, view_projection);
+            }
+            buffer.rasterize();
+        }
+        const rasterize_time = @intToFloat(f64, timer.read()) / rounds;
+
+        try stdout.print("rasterize:  {d:.3} ms ({d} threads)\n", .{ rasterize_time / std.time.ns_per_ms, threads });
+    }
+
+    var culled: usize = 0;
+    var timer = try std.time.Timer.start();
+    var round: usize = 0;
+    while (round < rounds) : (round += 1) {
+        culled = 0;
+        for (objects) |object| {
+            if (!buffer.isBoxVisible(object.min, object.max, identity, view_projection))
+                culled += 1;
+        }
+    }
+    const test_time = @intToFloat(f64, timer.read()) / rounds;
+
+    try stdout.print("test:       {d:.3} ms\n", .{test_time / std.time.ns_per_ms});
+    try stdout.print("culled:     {d} of {d}\n", .{ culled, object_count });
+}
+
+/// Column major, maps the view space depth from `near` to `far` to -1 to 1.
+fn perspective(fov_y: f32, aspect: f32, near: f32, far: f32) Mat4 {
+    const f = 1.0 / @tan(fov_y / 2.0);
+    return Mat4{
+        .{ f / aspect, 0, 0, 0 },
+        .{ 0, f, 0, 0 },
+        .{ 0, 0, (far + near) / (near - far), -1 },
+        .{ 0, 0, 2 * far * near / (near - far), 0 },
+    };
+}
+
+fn translation(x: f32, y: f32, z: f32) Mat4 {
+    return Mat4{
+        .{ 1, 0, 0, 0 },
+        .{ 0, 1, 0, 0 },
+        .{ 0, 0, 1, 0 },
+        .{ x, y, z, 1 },
+    };
+}
+
+fn mul(a: Mat4, b: Mat4) Mat4 {
+    // column major: result[col] = a * b[col]
+    var result: Mat4 = undefined;
+    for (result) |*col, c| {
+        for (col) |*v, r| {
+            v.* = a[0][r] * b[c][0] + a[1][r] * b[c][1] + a[2][r] * b[c][2] + a[3][r] * b[c][3];
+        }
+    }
+    return result;
+}
@@ -0,0 +1,281 @@
+//! Measures how long the Scintilla bridge takes to lay out and paint a 100k line file, once
+//! through the per-string `measureCharPositions` callback and once with the C++ side advance cache.
+//! Runs headless: `zig build bench-scintilla`.
+const std = @import("std");
+const c = @cImport({
+    @cInclude("code_editor.h");
+});
+
+const line_count = 100_000;
+
+/// Stand-in for a renderer font: advances are produced on first use and kept in a hash map,
+/// which is what `Renderer2D.getGlyph` does for real glyphs.
+const BenchFont = struct {
+    size: f32,
+    glyphs: std.AutoHashMap(u32, f32),
+
+    fn advance(font: *BenchFont, codepoint: u32) f32 {
+        const gop = font.glyphs.getOrPut(codepoint) catch return 0.0;
+        if (!gop.found_existing) {
+            gop.value_ptr.* = font.size * (0.5 + 0.05 * @intToFloat(f32, codepoint % 7));
+        }
+        return gop.value_ptr.*;
+    }
+};
+
+const Mode = enum { per_string, batched };
+
+const Bench = struct {
+    interface: c.ZigEditorInterface,
+    allocator: std.mem.Allocator,
+    bridge_calls: usize = 0,
+    measured_bytes: usize = 0,
+    draw_commands: usize = 0,
+
+    fn get(app: [*c]c.ZigEditorInterface) *Bench {
+        return @fieldParentPtr(Bench, "interface", @ptrCast(*c.ZigEditorInterface, app));
+    }
+};
+
+fn getFont(font: ?*c.ZigFont) *BenchFont {
+    return @intToPtr(*BenchFont, @ptrToInt(font));
+}
+
+fn createFont(app: [*c]c.ZigEditorInterface, name: [*c]const u8, size: f32) callconv(.C) ?*c.ZigFont {
+    _ = name;
+    const bench = Bench.get(app);
+    const font = bench.allocator.create(BenchFont) catch return null;
+    font.* = BenchFont{ .size = size, .glyphs = std.AutoHashMap(u32, f32).init(bench.allocator) };
+    return @intToPtr(*c.ZigFont, @ptrToInt(font));
+}
+
+fn destroyFont(app: [*c]c.ZigEditorInterface, font_ptr: ?*c.ZigFont) callconv(.C) void {
+    const font = getFont(font_ptr);
+    font.glyphs.deinit();
+    Bench.get(app).allocator.destroy(font);
+}
+
+fn getFontAscent(app: [*c]c.ZigEditorInterface, font_ptr: ?*c.ZigFont) callconv(.C) f32 {
+    _ = app;
+    return 0.8 * getFont(font_ptr).size;
+}
+
+fn getFontDescent(app: [*c]c.ZigEditorInterface, font_ptr: ?*c.ZigFont) callconv(.C) f32 {
+    _ = app;
+    return 0.2 * getFont(font_ptr).size;
+}
+
+fn getFontLineGap(app: [*c]c.ZigEditorInterface, font_ptr: ?*c.ZigFont) callconv(.C) f32 {
+    _ = app;
+    _ = font_ptr;
+    return 0.0;
+}
+
+fn getFontCharWidth(app: [*c]c.ZigEditorInterface, font_ptr: ?*c.ZigFont, char: u32) callconv(.C) f32 {
+    Bench.get(app).bridge_calls += 1;
+    return getFont(font_ptr).advance(char);
+}
+
+fn measureStringWidth(app: [*c]c.ZigEditorInterface, font_ptr: ?*c.ZigFont, str: [*c]const u8, length: usize) callconv(.C) f32 {
+    Bench.get(app).bridge_calls += 1;
+    var width: f32 = 0.0;
+    for (str[0..length]) |char| {
+        width += getFont(font_ptr).advance(char);
+    }
+    return width;
+}
+
+/// Same decoding as `CodeEditor.measureCharPositions`.
+fn measureCharPositions(app: [*c]c.ZigEditorInterface, font_ptr: ?*c.ZigFont, str: [*c]const u8, length: usize, positions: [*c]f32) callconv(.C) void {
+    const bench = Bench.get(app);
+    bench.bridge_calls += 1;
+    bench.measured_bytes += length;
+
+    const font = getFont(font_ptr);
+    const text = str[0..length];
+
+    var offset: f32 = 0.0;
+    var i: usize = 0;
+    while (i < text.len) {
+        var char_len: usize = 1;
+        var codepoint: u21 = 0xFFFD;
+        if (std.unicode.utf8ByteSequenceLength(text[i])) |seq_len| {
+            if (i + seq_len <= text.len) {
+                if (std.unicode.utf8Decode(text[i .. i + seq_len])) |value| {
+                    char_len = seq_len;
+                    codepoint = value;
+                } else |_| {}
+            }
+        } else |_| {}
+
+        offset += font.advance(codepoint);
+        for (text[i .. i + char_len]) |_| {
+            positions[i] = offset;
+            i += 1;
+        }
+    }
+}
+
+fn getFontAdvanceTable(app: [*c]c.ZigEditorInterface, font_ptr: ?*c.ZigFont, advances: [*c]f32) callconv(.C) void {
+    Bench.get(app).bridge_calls += 1;
+    for (advances[0..c.FONT_ADVANCE_TABLE_SIZE]) |*advance, codepoint| {
+        advance.* = getFont(font_ptr).advance(@intCast(u32, codepoint));
+    }
+}
+
+fn measureCodepoints(app: [*c]c.ZigEditorInterface, font_ptr: ?*c.ZigFont, codepoints: [*c]const u32, count: usize, advances: [*c]f32) callconv(.C) void {
+    Bench.get(app).bridge_calls += 1;
+    for (codepoints[0..count]) |codepoint, i| {
+        advances[i] = getFont(font_ptr).advance(codepoint);
+    }
+}
+
+fn renderDrawList(app: [*c]c.ZigEditorInterface, list: [*c]const c.ZigDrawList) callconv(.C) void {
+    const bench = Bench.get(app);
+    bench.bridge_calls += 1;
+    bench.draw_commands += list.*.command_count;
+}
+
+fn setClipboardContent(app: [*c]c.ZigEditorInterface, str: [*c]const u8, length: usize) callconv(.C) void {
+    _ = app;
+    _ = str;
+    _ = length;
+}
+
+fn getClipboardContent(app: [*c]c.ZigEditorInterface, str: [*c]u8, max_length: usize) callconv(.C) usize {
+    _ = app;
+    _ = str;
+    _ = max_length;
+    return 0;
+}
+
+fn sendNotification(app: [*c]c.ZigEditorInterface, notification: u32) callconv(.C) void {
+    _ = app;
+    _ = notification;
+}
+
+fn createInterface(mode: Mode) c.ZigEditorInterface {
+    return c.ZigEditorInterface{
+        .createFont = createFont,
+        .destroyFont = destroyFont,
+        .getFontAscent = getFontAscent,
+        .getFontDescent = getFontDescent,
+        .getFontLineGap = getFontLineGap,
+        .getFontCharWidth = getFontCharWidth,
+        .measureStringWidth = measureStringWidth,
+        .measureCharPositions = measureCharPositions,
+        .getFontAdvanceTable = if (mode == .batched) getFontAdvanceTable else null,
+        .measureCodepoints = if (mode == .batched) measureCodepoints else null,
+        .renderDrawList = renderDrawList,
+        .setClipboardContent = setClipboardContent,
+        .getClipboardContent = getClipboardContent,
+        .sendNotification = sendNotification,
+    };
+}
+
+/// Generates C-like source with a sprinkle of non-ASCII comments and a few long lines, so
+/// both the ASCII table and the codepoint cache are exercised.
+fn generateSource(allocator: std.mem.Allocator) ![]u8 {
+    var text = std.ArrayList(u8).init(allocator);
+    defer text.deinit();
+
+    const writer = text.writer();
+    var i: usize = 0;
+    while (i < line_count) : (i += 1) {
+        switch (i % 10) {
+            0 => try writer.print("// Größe des Puffers für Schritt {d}: ½ × λ → ∞\n", .{i}),
+            1 => try writer.print("function step_{d}(value, count) {{\n", .{i}),
+            2, 3, 4 => try writer.print("    var item_{d} = value * {d} + count; // adjust\n", .{ i, i % 97 }),
+            5 => try writer.print("    if (item_{d} > {d} and not done) {{ return \"日本語のテキスト {d}\"; }}\n", .{ i - 1, i, i }),
+            6 => {
+                try writer.writeAll("    const table = [");
+                var j: usize = 0;
+                while (j < 60) : (j += 1) {
+                    try writer.print("{d}, ", .{(i * 31 + j) % 1000});
+                }
+                try writer.writeAll("];\n");
+            },
+            else => try writer.print("    return item_{d};\n}}\n", .{i - 3}),
+        }
+    }
+
+    return text.toOwnedSlice();
+}
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const stdout = std.io.getStdOut().writer();
+
+    const source = try generateSource(allocator);
+    defer allocator.free(source);
+
+    try stdout.print("lines:      {d} ({d} KiB)\n", .{ line_count, source.len / 1024 });
+
+    c.scintilla_init();
+    defer c.scintilla_deinit();
+
+    for ([_]Mode{ .per_string, .batched }) |mode| {
+        var bench = Bench{
+            .interface = createInterface(mode),
+            .allocator = allocator,
+        };
+
+        const editor = c.scintilla_create(&bench.interface) orelse return error.OutOfMemory;
+        defer c.scintilla_destroy(editor);
+
+        c.scintilla_setPosition(editor, 0, 0, 1280, 720);
+        c.scintilla_setText(editor, source.ptr, source.len);
+        bench.bridge_calls = 0;
+        bench.measured_bytes = 0;
+
+        // There is no idle processing in the bridge, so the first paint wraps, and thus
+        // lays out, every line of the document.
+        var timer = try std.time.Timer.start();
+        c.scintilla_render(editor);
+        const layout_time = timer.read();
+
+        try stdout.print("{s}:\n", .{@tagName(mode)});
+        try stdout.print("  layout:   {d:.2} ms\n", .{@intToFloat(f64, layout_time) / std.time.ns_per_ms});
+        try stdout.print("  calls:    {d}\n", .{bench.bridge_calls});
+        try stdout.print("  measured: {d} KiB in Zig\n", .{bench.measured_bytes / 1024});
+
+        // Everything is laid out now, so this is the cost of painting a single screen.
+        bench.bridge_calls = 0;
+        bench.draw_commands = 0;
+        timer.reset();
+        c.scintilla_render(editor);
+        const repaint_time = timer.read();
+
+        try stdout.print("  repaint:  {d:.2} ms\n", .{@intToFloat(f64, repaint_time) / std.time.ns_per_ms});
+        try stdout.print("  calls:    {d} ({d} draw commands)\n", .{ bench.bridge_calls, bench.draw_commands });
+    }
+}
+
+export fn zerog_panic(msg: [*:0]const u8) noreturn {
+    @panic(std.mem.span(msg));
+}
+
+export fn zero_graphics_getDisplayDpi() callconv(.C) c_int {
+    return 96;
+}
+export fn zero_graphics_getWidth() callconv(.C) c_int {
+    return 1280;
+}
+export fn zero_graphics_getHeight() callconv(.C) c_int {
+    return 720;
+}
+
+export fn zero_graphics_alloc(raw_allocator: ?*anyopaque, size: usize) callconv(.C) ?*anyopaque {
+    _ = raw_allocator;
+    _ = size;
+    return null;
+}
+
+export fn zero_graphics_writeLog(log_level: c_uint, msg_ptr: [*]const u8, length: usize) callconv(.C) void {
+    _ = log_level;
+    _ = msg_ptr;
+    _ = length;
+}
@@ -0,0 +1,78 @@
+//! Measures the vertex throughput of CPU skinning on one thread and on all cores.
+//! Runs headless: `zig build bench-skinning`.
+const std = @import("std");
+const zero_graphics = @import("zero-graphics");
+
+const ResourceManager = zero_graphics.ResourceManager;
+const skinning = zero_graphics.skinning;
+
+// The library package resolves these from the root file.
+pub const milliTimestamp = std.time.milliTimestamp;
+pub const build_options = struct {
+    pub const features = struct {
+        pub const code_editor = false;
+    };
+};
+
+const vertex_count = 200_000;
+const bone_count = 64;
+const rounds = 20;
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const stdout = std.io.getStdOut().writer();
+
+    var prng = std.rand.DefaultPrng.init(0);
+    const random = prng.random();
+
+    const src = try allocator.alloc(ResourceManager.Vertex, vertex_count);
+    defer allocator.free(src);
+    const dst = try allocator.alloc(ResourceManager.Vertex, vertex_count);
+    defer allocator.free(dst);
+    const influences = try allocator.alloc(ResourceManager.SkinVertex, vertex_count);
+    defer allocator.free(influences);
+
+    for (src) |*vertex, i| {
+        vertex.* = ResourceManager.Vertex.init(.{ random.float(f32), random.float(f32), random.float(f32) }, .{ 0, 1, 0 }, .{ 0, 0 });
+        const a = random.uintLessThan(u8, bone_count);
+        const b = random.uintLessThan(u8, bone_count);
+        const w = random.int(u8);
+        influences[i] = ResourceManager.SkinVertex{
+            .bone_indices = .{ a, b, 0, 0 },
+            .bone_weights = .{ w, 255 - w, 0, 0 },
+        };
+    }
+
+    var palette: [bone_count][4][4]f32 = undefined;
+    for (palette) |*matrix, i| {
+        const x = random.float(f32);
+        const y = random.float(f32);
+        const z = random.float(f32);
+        const len = @sqrt(x * x + y * y + z * z + 1);
+        matrix.* = (skinning.Transform{
+            .translation = .{ @intToFloat(f32, i), 0, 0 },
+            .rotation = .{ x / len, y / len, z / len, 1 / len },
+        }).toMatrix();
+    }
+
+    const skin = ResourceManager.Skin{ .vertices = influences, .bones = &[0]ResourceManager.Bone{} };
+
+    try stdout.print("vertices:   {d}\n", .{vertex_count});
+    try stdout.print("bones:      {d}\n", .{bone_count});
+
+    const thread_count = std.Thread.getCpuCount() catch 1;
+    for ([_]usize{ 1, thread_count }) |threads| {
+        var timer = try std.time.Timer.start();
+
+        var i: usize = 0;
+        while (i < rounds) : (i += 1) {
+            skinning.skinVerticesParallel(skin, &palette, src, dst, threads);
+        }
+
+        const ms = @intToFloat(f64, timer.read()) / rounds / std.time.ns_per_ms;
+        try stdout.print("{d:>2} threads: {d:.0} vertices/ms\n", .{ threads, vertex_count / ms });
+    }
+}
@@ -0,0 +1,110 @@
+//! Measures the immediate mode user interface with 10k widgets: declaring them in a construction pass,
+//! and finding the widget under the pointer with the hit grid and with the linear search.
+//! Runs headless: `zig build bench-ui`.
+const std = @import("std");
+const zero_graphics = @import("zero-graphics");
+
+const UserInterface = zero_graphics.UserInterface;
+const Rectangle = zero_graphics.Rectangle;
+const Point = zero_graphics.Point;
+const Size = zero_graphics.Size;
+
+// The library package resolves these from the root file.
+pub const milliTimestamp = std.time.milliTimestamp;
+pub const build_options = struct {
+    pub const features = struct {
+        pub const code_editor = false;
+    };
+};
+
+const screen_size = Size{ .width = 1920, .height = 1080 };
+const widget_count = 10_000;
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const stdout = std.io.getStdOut().writer();
+
+    try stdout.print("widgets:    {d}\n", .{widget_count});
+
+    // widget lookup: every pass after the first finds all widgets of the previous one
+    {
+        var ui = try UserInterface.init(allocator, null);
+        defer ui.deinit();
+
+        const rounds = 10;
+
+        var timer = try std.time.Timer.start();
+        var round: usize = 0;
+        while (round < rounds) : (round += 1) {
+            var builder = ui.construct(screen_size);
+            defer builder.finish();
+
+            var i: usize = 0;
+            while (i < widget_count) : (i += 1) {
+                try builder.panel(Rectangle{ .x = 0, .y = 0, .width = 10, .height = 10 }, .{ .id = i });
+            }
+        }
+        const lookup_time = @intToFloat(f64, timer.read()) / rounds;
+
+        try stdout.print("construct:  {d:.3} ms\n", .{lookup_time / std.time.ns_per_ms});
+    }
+
+    // hit testing: random motion events over randomly placed widgets, a quarter of them invisible to hit tests
+    {
+        var ui = try UserInterface.init(allocator, null);
+        defer ui.deinit();
+
+        const event_count = 1_000;
+
+        var prng = std.rand.DefaultPrng.init(0x5EED);
+        const random = prng.random();
+
+        {
+            var builder = ui.construct(screen_size);
+            defer builder.finish();
+
+            var i: usize = 0;
+            while (i < widget_count) : (i += 1) {
+                try builder.panel(Rectangle{
+                    .x = random.intRangeLessThan(i16, 0, screen_size.width),
+                    .y = random.intRangeLessThan(i16, 0, screen_size.height),
+                    .width = 40,
+                    .height = 20,
+                }, .{ .id = i, .hit_test_visible = (i % 4 != 0) });
+            }
+        }
+
+        const points = try allocator.alloc(Point, event_count);
+        defer allocator.free(points);
+        for (points) |*p| {
+            p.* = Point{
+                .x = random.intRangeLessThan(i16, 0, screen_size.width),
+                .y = random.intRangeLessThan(i16, 0, screen_size.height),
+            };
+        }
+
+        try stdout.print("events:     {d}\n", .{event_count});
+
+        for ([_]bool{ true, false }) |indexed| {
+            ui.hit_grid_valid = indexed;
+
+            var timer = try std.time.Timer.start();
+            {
+                var input = ui.processInput();
+                defer input.finish();
+                for (points) |p| {
+                    input.setPointer(p);
+                }
+            }
+            const hit_time = @intToFloat(f64, timer.read());
+
+            try stdout.print("{s}{d:.3} ms\n", .{
+                if (indexed) "hit grid:   " else "linear:     ",
+                hit_time / std.time.ns_per_ms,
+            });
+        }
+    }
+}
@@ -0,0 +1,77 @@
+//! Measures how long the resource manager takes to load a large static z3d model, once copying
+//! the vertex and index data and once borrowing it from the file. Runs headless: `zig build bench-z3d`.
+const std = @import("std");
+const zero_graphics = @import("zero-graphics");
+const z3d = @import("z3d");
+
+const ResourceManager = zero_graphics.ResourceManager;
+
+// The library package resolves these from the root file. The benchmark never touches the GPU,
+// so the resource manager only needs a clock.
+pub const milliTimestamp = std.time.milliTimestamp;
+pub const build_options = struct {
+    pub const features = struct {
+        pub const code_editor = false;
+    };
+};
+
+const vertex_count = 65535;
+const index_count = 3 * 300_000;
+const rounds = 20;
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const stdout = std.io.getStdOut().writer();
+
+    const vertex_offset = @sizeOf(z3d.static_model.Header);
+    const index_offset = vertex_offset + @sizeOf(z3d.static_model.Vertex) * vertex_count;
+    const mesh_offset = index_offset + @sizeOf(z3d.static_model.Index) * index_count;
+    const file_size = mesh_offset + @sizeOf(z3d.static_model.Mesh);
+
+    const data = try allocator.alignedAlloc(u8, 16, file_size);
+    defer allocator.free(data);
+    std.mem.set(u8, data, 0);
+
+    @ptrCast(*align(1) z3d.static_model.Header, &data[0]).* = z3d.static_model.Header{
+        .common = z3d.CommonHeader{ .type = .static },
+        .vertex_count = std.mem.nativeToLittle(u32, vertex_count),
+        .index_count = std.mem.nativeToLittle(u32, index_count),
+        .mesh_count = std.mem.nativeToLittle(u32, 1),
+    };
+    for (std.mem.bytesAsSlice(z3d.static_model.Index, data[index_offset..mesh_offset])) |*index, i| {
+        index.* = std.mem.nativeToLittle(u16, @intCast(u16, i % vertex_count));
+    }
+    @ptrCast(*align(1) z3d.static_model.Mesh, &data[mesh_offset]).* = z3d.static_model.Mesh{
+        .offset = 0,
+        .length = std.mem.nativeToLittle(u32, index_count),
+        .texture_file = [1]u8{0} ** 120,
+    };
+
+    var rm = ResourceManager.init(allocator);
+    defer rm.deinit();
+
+    try stdout.print("vertices:   {d}\n", .{vertex_count});
+    try stdout.print("indices:    {d}\n", .{index_count});
+
+    inline for ([_]bool{ false, true }) |borrow| {
+        var timer = try std.time.Timer.start();
+
+        var i: usize = 0;
+        while (i < rounds) : (i += 1) {
+            const geometry = try rm.createGeometry(ResourceManager.Z3DGeometry(null){
+                .data = data,
+                .borrow_data = borrow,
+            });
+            rm.destroyGeometry(geometry);
+        }
+
+        const load_time = @intToFloat(f64, timer.read()) / rounds;
+        try stdout.print("{s}{d:.3} ms\n", .{
+            if (borrow) "zero-copy: " else "copy:      ",
+            load_time / std.time.ns_per_ms,
+        });
+    }
+}
@@ -13,6 +13,22 @@ struct MeshStream {
   void (*writeVertex)(struct MeshStream *, float x, float y, float z, float nx, float ny, float nz, float u, float v);
   void (*writeFace)(struct MeshStream *, uint16_t i0, uint16_t i1, uint16_t i2);
   void (*writeMeshRange)(struct MeshStream *, size_t offset, size_t count, char const *texture);
+  void (*writeLodHeader)(struct MeshStream *, size_t levels);
+  void (*writeLodLevel)(struct MeshStream *, size_t level, float max_error);
+  void (*writeLodRange)(struct MeshStream *, size_t level, size_t mesh, size_t offset, size_t count);
+  void (*writeDynamicHeader)(struct MeshStream *, size_t vertices, size_t indices, size_t ranges, size_t bones);
+  void (*writeDynamicVertex)(struct MeshStream *, float x, float y, float z, float nx, float ny, float nz, float u, float v, uint8_t const bone_indices[4], uint8_t const bone_weights[4]);
+  // `parent` is 0xFFFFFFFF for root bones. Matrices are column major.
+  void (*writeBone)(struct MeshStream *, char const *name, size_t parent, float const inverse_bind_matrix[16], float const local_transform[16]);
+};
+
+struct AnimationStream {
+  void (*writeAnimationHeader)(struct AnimationStream *, float duration, size_t channels);
+  void (*writeChannel)(struct AnimationStream *, char const *bone_name, size_t position_keys, size_t rotation_keys, size_t scale_keys);
+  // times are in seconds
+  void (*writePositionKey)(struct AnimationStream *, float time, float x, float y, float z);
+  void (*writeRotationKey)(struct AnimationStream *, float time, float x, float y, float z, float w);
+  void (*writeScaleKey)(struct AnimationStream *, float time, float x, float y, float z);
 };
 
 enum FileType {
@@ -20,7 +36,31 @@ enum FileType {
   static_geometry = 1,
 };
 
-bool transformFile(char const *src_file_name, struct MeshStream *stream, enum FileType create_static_model);
+struct ConvertOptions {
+  // reorders triangles and vertices for the post-transform vertex cache and overdraw
+  bool optimize;
+  // target triangle ratios of the generated levels of detail, in descending order
+  size_t lod_count;
+  float const *lod_ratios;
+};
+
+// Owns an assimp importer. Converters can be reused for several files,
+// but must only be used by one thread at a time.
+struct Converter;
+
+struct Converter *createConverter(void);
+void destroyConverter(struct Converter *converter);
+
+// Returns true when assimp has an importer for the extension of `file_name`.
+bool isSupportedFile(struct Converter *converter, char const *file_name);
+
+bool convertFile(struct Converter *converter, char const *src_file_name, struct MeshStream *stream, enum FileType create_static_model, struct ConvertOptions const *options);
+
+// Converts the animation with the given index into the zani format.
+bool convertAnimation(struct Converter *converter, char const *src_file_name, struct AnimationStream *stream, size_t animation_index);
+
+// Converts a single file with a temporary converter.
+bool transformFile(char const *src_file_name, struct MeshStream *stream, enum FileType create_static_model, struct ConvertOptions const *options);
 
 #ifdef __cplusplus
 }
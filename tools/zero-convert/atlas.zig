@@ -0,0 +1,692 @@
+//!
+//! Packs the diffuse textures of a model into a single texture atlas, so all
+//! meshes that use the atlas can be merged into a single mesh range and are
+//! drawn with one draw call.
+//!
+//! Texture coordinates outside of [0, 1] are baked: the texture is repeated in
+//! the atlas as often as the mesh needs it. Meshes that repeat their texture
+//! too often, share vertices with other meshes or whose texture can't be
+//! loaded keep their own texture.
+//!
+
+const std = @import("std");
+const zigimg = @import("zigimg");
+
+pub const Options = struct {
+    /// Maximum width and height of the atlas in pixels.
+    max_size: u32 = 2048,
+    /// Pixels around each texture that are filled with the wrapped texture, so
+    /// filtering and the first mip levels don't bleed into the neighbours.
+    padding: u32 = 4,
+    /// Meshes whose texture coordinates span more repetitions of the texture
+    /// in one direction keep their own texture.
+    max_repeat: u32 = 4,
+    /// Directory the texture file names are relative to.
+    texture_dir: []const u8,
+    /// Texture file name of the atlas that is stored in the model.
+    atlas_name: []const u8,
+};
+
+pub const Mesh = struct {
+    offset: usize,
+    length: usize,
+    texture: ?[]const u8,
+};
+
+pub const Range = struct {
+    offset: usize,
+    length: usize,
+};
+
+pub const Model = struct {
+    /// Texture coordinates of all vertices. Remapped into the atlas by `build`.
+    uvs: [][2]f32,
+    indices: []const u16,
+    meshes: []const Mesh,
+    /// Index ranges of the levels of detail, `lod_ranges[level * meshes.len + mesh]`.
+    lod_ranges: []const Range,
+};
+
+pub const Image = struct {
+    width: u32,
+    height: u32,
+    /// RGBA8, rows are stored from v = 0 to v = 1.
+    pixels: []u8,
+};
+
+/// The model data after atlasing. The first mesh uses the atlas.
+pub const Atlas = struct {
+    arena: std.heap.ArenaAllocator,
+    image: Image,
+    /// The index list, reordered so the merged meshes are contiguous in every level of detail.
+    indices: []u16,
+    meshes: []Mesh,
+    lod_ranges: []Range,
+    /// Number of source meshes merged into the atlas mesh.
+    merged_meshes: usize,
+    /// Number of distinct textures in the atlas.
+    texture_count: usize,
+
+    pub fn deinit(self: *Atlas) void {
+        self.arena.deinit();
+        self.* = undefined;
+    }
+};
+
+/// A texture, repeated `repeat` times, and its place in the atlas.
+const Region = struct {
+    texture: usize,
+    repeat: [2]u32,
+
+    x: u32 = 0,
+    y: u32 = 0,
+    placed: bool = false,
+};
+
+/// Builds the atlas for `model` and remaps its texture coordinates.
+/// Returns null and leaves the model untouched if less than two meshes could be merged.
+pub fn build(allocator: std.mem.Allocator, model: Model, options: Options) !?Atlas {
+    var scratch_arena = std.heap.ArenaAllocator.init(allocator);
+    defer scratch_arena.deinit();
+    const scratch = scratch_arena.allocator();
+
+    const mesh_count = model.meshes.len;
+    const level_count = if (mesh_count > 0) 1 + model.lod_ranges.len / mesh_count else 1;
+
+    // Vertices are remapped for exactly one texture, so meshes must not share them.
+    const no_owner = std.math.maxInt(usize);
+    const vertex_owner = try scratch.alloc(usize, model.uvs.len);
+    std.mem.set(usize, vertex_owner, no_owner);
+    const shared = try scratch.alloc(bool, mesh_count);
+    std.mem.set(bool, shared, false);
+
+    for (model.meshes) |_, m| {
+        var level: usize = 0;
+        while (level < level_count) : (level += 1) {
+            for (meshIndices(model, level, m)) |index| {
+                if (vertex_owner[index] == no_owner) {
+                    vertex_owner[index] = m;
+                } else if (vertex_owner[index] != m) {
+                    shared[m] = true;
+                    shared[vertex_owner[index]] = true;
+                }
+            }
+        }
+    }
+
+    var textures = std.StringArrayHashMap(?Image).init(scratch);
+    var regions = std.ArrayList(Region).init(scratch);
+
+    // The region and uv origin of each mesh in the atlas, null if the mesh keeps its texture.
+    const mesh_regions = try scratch.alloc(?usize, mesh_count);
+    std.mem.set(?usize, mesh_regions, null);
+    const mesh_origins = try scratch.alloc([2]f32, mesh_count);
+
+    for (model.meshes) |mesh, m| {
+        const texture_name = mesh.texture orelse continue;
+        if (texture_name.len == 0 or texture_name[0] == '*') // embedded textures are referenced by index
+            continue;
+        if (shared[m]) {
+            std.log.warn("mesh {} shares vertices with another mesh and keeps its texture {s}", .{ m, texture_name });
+            continue;
+        }
+
+        // Texture coordinates slightly above an integer don't need another repetition.
+        const epsilon = 1e-4;
+        var uv_min = [2]f32{ std.math.inf(f32), std.math.inf(f32) };
+        var uv_max = [2]f32{ -std.math.inf(f32), -std.math.inf(f32) };
+        for (meshIndices(model, 0, m)) |index| {
+            for (model.uvs[index]) |t, i| {
+                uv_min[i] = std.math.min(uv_min[i], t);
+                uv_max[i] = std.math.max(uv_max[i], t);
+            }
+        }
+        if (uv_min[0] > uv_max[0])
+            continue; // empty mesh
+
+        var origin: [2]f32 = undefined;
+        var repeat: [2]u32 = undefined;
+        for (origin) |*o, i| {
+            o.* = @floor(uv_min[i] + epsilon);
+            const span = @ceil(uv_max[i] - epsilon) - o.*;
+            repeat[i] = if (span <= 1.0) 1 else if (span > @intToFloat(f32, options.max_repeat)) 0 else @floatToInt(u32, span);
+        }
+        if (repeat[0] == 0 or repeat[1] == 0) {
+            std.log.info("mesh {} repeats its texture {s} too often and keeps it", .{ m, texture_name });
+            continue;
+        }
+
+        const texture = try textures.getOrPut(texture_name);
+        if (!texture.found_existing) {
+            texture.value_ptr.* = loadTexture(scratch, options.texture_dir, texture_name) catch |err| blk: {
+                std.log.warn("could not load texture {s}, the meshes keep it: {s}", .{ texture_name, @errorName(err) });
+                break :blk null;
+            };
+        }
+        if (texture.value_ptr.* == null)
+            continue;
+
+        const region_index = for (regions.items) |region, r| {
+            if (region.texture == texture.index and std.mem.eql(u32, &region.repeat, &repeat))
+                break r;
+        } else blk: {
+            try regions.append(Region{ .texture = texture.index, .repeat = repeat });
+            break :blk regions.items.len - 1;
+        };
+
+        mesh_regions[m] = region_index;
+        mesh_origins[m] = origin;
+    }
+
+    if (countMerged(mesh_regions) < 2)
+        return null;
+
+    const images = textures.values();
+
+    // Place the tallest regions first, so the shelves are filled evenly.
+    const order = try scratch.alloc(usize, regions.items.len);
+    for (order) |*o, i| {
+        o.* = i;
+    }
+    const SortContext = struct {
+        regions: []const Region,
+        images: []const ?Image,
+        padding: u32,
+
+        fn lessThan(ctx: @This(), lhs: usize, rhs: usize) bool {
+            return regionSize(ctx.regions[lhs], ctx.images, ctx.padding)[1] > regionSize(ctx.regions[rhs], ctx.images, ctx.padding)[1];
+        }
+    };
+    std.sort.sort(usize, order, SortContext{ .regions = regions.items, .images = images, .padding = options.padding }, SortContext.lessThan);
+
+    // Use the smallest square atlas all regions fit into, otherwise leave out the
+    // regions that don't fit into the largest one.
+    var size: u32 = 64;
+    var used_height: u32 = undefined;
+    while (true) : (size *= 2) {
+        size = std.math.min(size, options.max_size);
+        used_height = packShelves(regions.items, order, images, options.padding, size);
+        if (size >= options.max_size or allPlaced(regions.items))
+            break;
+    }
+    for (mesh_regions) |*region| {
+        if (region.*) |r| {
+            if (!regions.items[r].placed) {
+                std.log.warn("texture {s} doesn't fit into the atlas", .{textures.keys()[regions.items[r].texture]});
+                region.* = null;
+            }
+        }
+    }
+
+    const merged_meshes = countMerged(mesh_regions);
+    if (merged_meshes < 2)
+        return null;
+
+    var arena = std.heap.ArenaAllocator.init(allocator);
+    errdefer arena.deinit();
+
+    const image = Image{
+        .width = size,
+        .height = std.math.ceilPowerOfTwoAssert(u32, std.math.max(used_height, 1)),
+        .pixels = undefined,
+    };
+    var atlas = Atlas{
+        .arena = arena,
+        .image = image,
+        .indices = undefined,
+        .meshes = undefined,
+        .lod_ranges = undefined,
+        .merged_meshes = merged_meshes,
+        .texture_count = 0,
+    };
+    const result_allocator = atlas.arena.allocator();
+
+    atlas.image.pixels = try result_allocator.alloc(u8, 4 * @as(usize, image.width) * image.height);
+    std.mem.set(u8, atlas.image.pixels, 0);
+
+    // Every region is used by at least one mesh, as regions are only created for meshes.
+    var used_textures = try scratch.alloc(bool, images.len);
+    std.mem.set(bool, used_textures, false);
+    for (regions.items) |region| {
+        if (!region.placed)
+            continue;
+        if (!used_textures[region.texture]) {
+            used_textures[region.texture] = true;
+            atlas.texture_count += 1;
+        }
+        blitRegion(atlas.image, region, images[region.texture].?, options.padding);
+    }
+
+    // Remap the texture coordinates of the merged meshes into their region.
+    for (model.uvs) |*uv, v| {
+        const m = vertex_owner[v];
+        if (m == no_owner)
+            continue;
+        const region = regions.items[mesh_regions[m] orelse continue];
+        const texture = images[region.texture].?;
+        const offset = [2]f32{
+            @intToFloat(f32, region.x + options.padding),
+            @intToFloat(f32, region.y + options.padding),
+        };
+        const scale = [2]f32{ @intToFloat(f32, texture.width), @intToFloat(f32, texture.height) };
+        const atlas_size = [2]f32{ @intToFloat(f32, atlas.image.width), @intToFloat(f32, atlas.image.height) };
+        for (uv) |*t, i| {
+            t.* = (offset[i] + (t.* - mesh_origins[m][i]) * scale[i]) / atlas_size[i];
+        }
+    }
+
+    // The atlas mesh comes first, followed by the meshes that keep their textures.
+    var groups = std.ArrayList([]const usize).init(scratch);
+    var atlas_group = std.ArrayList(usize).init(scratch);
+    for (mesh_regions) |region, m| {
+        if (region != null)
+            try atlas_group.append(m);
+    }
+    try groups.append(atlas_group.items);
+    for (mesh_regions) |region, m| {
+        if (region == null)
+            try groups.append(try scratch.dupe(usize, &[_]usize{m}));
+    }
+
+    var indices = std.ArrayList(u16).init(result_allocator);
+    atlas.meshes = try result_allocator.alloc(Mesh, groups.items.len);
+    atlas.lod_ranges = try result_allocator.alloc(Range, (level_count - 1) * groups.items.len);
+
+    var level: usize = 0;
+    while (level < level_count) : (level += 1) {
+        for (groups.items) |group, g| {
+            const start = indices.items.len;
+            for (group) |m| {
+                try indices.appendSlice(meshIndices(model, level, m));
+            }
+            const range = Range{ .offset = start, .length = indices.items.len - start };
+            if (level == 0) {
+                atlas.meshes[g] = Mesh{
+                    .offset = range.offset,
+                    .length = range.length,
+                    .texture = if (g == 0)
+                        try result_allocator.dupe(u8, options.atlas_name)
+                    else if (model.meshes[group[0]].texture) |name|
+                        try result_allocator.dupe(u8, name)
+                    else
+                        null,
+                };
+            } else {
+                atlas.lod_ranges[(level - 1) * groups.items.len + g] = range;
+            }
+        }
+    }
+    atlas.indices = indices.items; // owned by the arena
+
+    return atlas;
+}
+
+fn meshIndices(model: Model, level: usize, mesh: usize) []const u16 {
+    const range = if (level == 0)
+        Range{ .offset = model.meshes[mesh].offset, .length = model.meshes[mesh].length }
+    else
+        model.lod_ranges[(level - 1) * model.meshes.len + mesh];
+    return model.indices[range.offset..][0..range.length];
+}
+
+fn countMerged(mesh_regions: []const ?usize) usize {
+    var count: usize = 0;
+    for (mesh_regions) |region| {
+        if (region != null)
+            count += 1;
+    }
+    return count;
+}
+
+fn regionSize(region: Region, images: []const ?Image, padding: u32) [2]u32 {
+    const texture = images[region.texture].?;
+    return .{
+        texture.width * region.repeat[0] + 2 * padding,
+        texture.height * region.repeat[1] + 2 * padding,
+    };
+}
+
+fn allPlaced(regions: []const Region) bool {
+    for (regions) |region| {
+        if (!region.placed)
+            return false;
+    }
+    return true;
+}
+
+/// Places the regions in rows of `size` pixels, tallest first. Returns the used height.
+fn packShelves(regions: []Region, order: []const usize, images: []const ?Image, padding: u32, size: u32) u32 {
+    var x: u32 = 0;
+    var y: u32 = 0;
+    var shelf_height: u32 = 0;
+    for (order) |r| {
+        const region = &regions[r];
+        const region_size = regionSize(region.*, images, padding);
+        region.placed = false;
+
+        if (x + region_size[0] > size) {
+            y += shelf_height;
+            x = 0;
+            shelf_height = 0;
+        }
+        if (region_size[0] > size or y + region_size[1] > size)
+            continue;
+
+        region.x = x;
+        region.y = y;
+        region.placed = true;
+        x += region_size[0];
+        shelf_height = std.math.max(shelf_height, region_size[1]);
+    }
+    return y + shelf_height;
+}
+
+/// Copies the repeated texture into the region, including the padding, so the
+/// padding continues the texture as if it was wrapped.
+fn blitRegion(atlas: Image, region: Region, texture: Image, padding: u32) void {
+    const size = [2]u32{
+        texture.width * region.repeat[0] + 2 * padding,
+        texture.height * region.repeat[1] + 2 * padding,
+    };
+    var py: u32 = 0;
+    while (py < size[1]) : (py += 1) {
+        const sy = @intCast(usize, @mod(@as(i64, py) - padding, texture.height));
+        const dst_row = 4 * (@as(usize, region.y + py) * atlas.width + region.x);
+        var px: u32 = 0;
+        while (px < size[0]) : (px += 1) {
+            const sx = @intCast(usize, @mod(@as(i64, px) - padding, texture.width));
+            const src = 4 * (sy * texture.width + sx);
+            std.mem.copy(u8, atlas.pixels[dst_row + 4 * px ..][0..4], texture.pixels[src..][0..4]);
+        }
+    }
+}
+
+fn loadTexture(allocator: std.mem.Allocator, texture_dir: []const u8, texture_name: []const u8) !Image {
+    // Textures exported on Windows often use backslashes.
+    const name = try allocator.dupe(u8, texture_name);
+    std.mem.replaceScalar(u8, name, '\\', '/');
+
+    const path = if (std.fs.path.isAbsolute(name))
+        name
+    else
+        try std.fs.path.join(allocator, &[_][]const u8{ texture_dir, name });
+
+    const data = try std.fs.cwd().readFileAlloc(allocator, path, 1 << 28);
+
+    var image = try zigimg.Image.fromMemory(allocator, data);
+    defer image.deinit();
+
+    if (image.width == 0 or image.height == 0)
+        return error.InvalidFormat;
+
+    const pixels = try allocator.alloc(u8, 4 * image.width * image.height);
+
+    var i: usize = 0;
+    var pixel_iterator = image.iterator();
+    while (pixel_iterator.next()) |pix| : (i += 1) {
+        const p8 = pix.toRgba32();
+        pixels[4 * i + 0] = p8.r;
+        pixels[4 * i + 1] = p8.g;
+        pixels[4 * i + 2] = p8.b;
+        pixels[4 * i + 3] = p8.a;
+    }
+    if (i != image.width * image.height)
+        return error.InvalidFormat;
+
+    return Image{
+        .width = @intCast(u32, image.width),
+        .height = @intCast(u32, image.height),
+        .pixels = pixels,
+    };
+}
+
+/// Writes `image` as a PNG file. The image data is stored without compression,
+/// as the standard library has no deflate compressor yet.
+pub fn writePng(allocator: std.mem.Allocator, writer: anytype, image: Image) !void {
+    try writer.writeAll("\x89PNG\r\n\x1a\n");
+
+    var header: [13]u8 = undefined;
+    std.mem.writeIntBig(u32, header[0..4], image.width);
+    std.mem.writeIntBig(u32, header[4..8], image.height);
+    header[8] = 8; // bit depth
+    header[9] = 6; // color type: rgba
+    header[10] = 0; // compression: deflate
+    header[11] = 0; // filter: adaptive
+    header[12] = 0; // interlace: none
+    try writeChunk(writer, "IHDR", &header);
+
+    // The zlib stream consists of stored deflate blocks with up to 65535 bytes.
+    var stream = std.ArrayList(u8).init(allocator);
+    defer stream.deinit();
+    try stream.appendSlice(&[_]u8{ 0x78, 0x01 });
+
+    const row_size = 1 + 4 * @as(usize, image.width);
+    var raw = try allocator.alloc(u8, row_size * image.height);
+    defer allocator.free(raw);
+    var y: usize = 0;
+    while (y < image.height) : (y += 1) {
+        raw[row_size * y] = 0; // filter: none
+        std.mem.copy(u8, raw[row_size * y + 1 ..][0 .. row_size - 1], image.pixels[(row_size - 1) * y ..][0 .. row_size - 1]);
+    }
+
+    var offset: usize = 0;
+    while (true) {
+        const length = std.math.min(raw.len - offset, 0xFFFF);
+        const final = (offset + length == raw.len);
+        try stream.append(@boolToInt(final));
+        try stream.writer().writeIntLittle(u16, @intCast(u16, length));
+        try stream.writer().writeIntLittle(u16, ~@intCast(u16, length));
+        try stream.appendSlice(raw[offset..][0..length]);
+        offset += length;
+        if (final)
+            break;
+    }
+    try stream.writer().writeIntBig(u32, std.hash.Adler32.hash(raw));
+
+    try writeChunk(writer, "IDAT", stream.items);
+    try writeChunk(writer, "IEND", "");
+}
+
+fn writeChunk(writer: anytype, chunk_type: *const [4]u8, data: []const u8) !void {
+    var crc = std.hash.Crc32.init();
+    crc.update(chunk_type);
+    crc.update(data);
+
+    try writer.writeIntBig(u32, @intCast(u32, data.len));
+    try writer.writeAll(chunk_type);
+    try writer.writeAll(data);
+    try writer.writeIntBig(u32, crc.final());
+}
+
+/// A texture where every texel is different: `r` identifies the texture, `g` and `b` are the texel position.
+fn testTexture(allocator: std.mem.Allocator, id: u8, width: u32, height: u32) !Image {
+    const pixels = try allocator.alloc(u8, 4 * width * height);
+    var y: u32 = 0;
+    while (y < height) : (y += 1) {
+        var x: u32 = 0;
+        while (x < width) : (x += 1) {
+            pixels[4 * (y * width + x) ..][0..4].* = .{ id, @intCast(u8, x), @intCast(u8, y), 255 };
+        }
+    }
+    return Image{ .width = width, .height = height, .pixels = pixels };
+}
+
+fn texel(image: Image, x: usize, y: usize) [4]u8 {
+    return image.pixels[4 * (y * image.width + x) ..][0..4].*;
+}
+
+test "atlas: packed regions don't overlap and keep their padding" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    const padding = 4;
+    const size = 128;
+
+    const images = [_]?Image{
+        try testTexture(allocator, 1, 8, 8),
+        try testTexture(allocator, 2, 16, 4),
+        try testTexture(allocator, 3, 30, 12),
+        try testTexture(allocator, 4, 5, 40),
+        try testTexture(allocator, 5, 1, 1),
+    };
+    var regions = [_]Region{
+        .{ .texture = 0, .repeat = .{ 1, 1 } },
+        .{ .texture = 0, .repeat = .{ 3, 2 } },
+        .{ .texture = 1, .repeat = .{ 1, 4 } },
+        .{ .texture = 2, .repeat = .{ 2, 1 } },
+        .{ .texture = 3, .repeat = .{ 1, 1 } },
+        .{ .texture = 4, .repeat = .{ 4, 4 } },
+        .{ .texture = 3, .repeat = .{ 2, 1 } },
+    };
+    var order: [regions.len]usize = undefined;
+    for (order) |*o, i| {
+        o.* = i;
+    }
+
+    const used_height = packShelves(&regions, &order, &images, padding, size);
+    try std.testing.expect(allPlaced(&regions));
+    try std.testing.expect(used_height <= size);
+
+    for (regions) |a, i| {
+        const a_size = regionSize(a, &images, padding);
+        try std.testing.expect(a.x + a_size[0] <= size);
+        try std.testing.expect(a.y + a_size[1] <= used_height);
+        for (regions[i + 1 ..]) |b| {
+            const b_size = regionSize(b, &images, padding);
+            const apart = a.x + a_size[0] <= b.x or b.x + b_size[0] <= a.x or
+                a.y + a_size[1] <= b.y or b.y + b_size[1] <= a.y;
+            try std.testing.expect(apart);
+        }
+    }
+
+    // Every pixel of a region, including its padding, continues the wrapped texture.
+    // An overlapping region would have overwritten some of them.
+    const atlas = Image{ .width = size, .height = size, .pixels = try allocator.alloc(u8, 4 * size * size) };
+    std.mem.set(u8, atlas.pixels, 0);
+    for (regions) |region| {
+        blitRegion(atlas, region, images[region.texture].?, padding);
+    }
+    for (regions) |region| {
+        const texture = images[region.texture].?;
+        const region_size = regionSize(region, &images, padding);
+        var py: u32 = 0;
+        while (py < region_size[1]) : (py += 1) {
+            var px: u32 = 0;
+            while (px < region_size[0]) : (px += 1) {
+                const sx = @intCast(usize, @mod(@as(i64, px) - padding, texture.width));
+                const sy = @intCast(usize, @mod(@as(i64, py) - padding, texture.height));
+                try std.testing.expectEqual(texel(texture, sx, sy), texel(atlas, region.x + px, region.y + py));
+            }
+        }
+    }
+}
+
+test "atlas: remapped texture coordinates stay inside their region" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    const padding = 4;
+
+    const textures = [_]Image{
+        try testTexture(allocator, 1, 8, 8),
+        try testTexture(allocator, 2, 16, 4),
+    };
+    for ([_][]const u8{ "a.png", "b.png" }) |name, i| {
+        var file = try tmp.dir.createFile(name, .{});
+        defer file.close();
+        try writePng(allocator, file.writer(), textures[i]);
+    }
+
+    // Texture coordinates hit texel centers, so each vertex maps to exactly one atlas pixel.
+    const original_uvs = [_][2]f32{
+        // a.png
+        .{ 0.5 / 8.0, 0.5 / 8.0 },
+        .{ 7.5 / 8.0, 0.5 / 8.0 },
+        .{ 3.5 / 8.0, 7.5 / 8.0 },
+        // b.png
+        .{ 0.5 / 16.0, 0.5 / 4.0 },
+        .{ 15.5 / 16.0, 3.5 / 4.0 },
+        .{ 8.5 / 16.0, 1.5 / 4.0 },
+        // a.png, repeated twice horizontally
+        .{ 0.5 / 8.0, 0.5 / 8.0 },
+        .{ 1.0 + 7.5 / 8.0, 0.5 / 8.0 },
+        .{ 1.0 + 3.5 / 8.0, 7.5 / 8.0 },
+        // untextured
+        .{ 0.3, 0.3 },
+        .{ 0.6, 0.3 },
+        .{ 0.3, 0.6 },
+    };
+    const mesh_textures = [_]?usize{ 0, 1, 0, null };
+
+    var uvs = original_uvs;
+    var indices: [uvs.len]u16 = undefined;
+    for (indices) |*index, i| {
+        index.* = @intCast(u16, i);
+    }
+    const meshes = [_]Mesh{
+        .{ .offset = 0, .length = 3, .texture = "a.png" },
+        .{ .offset = 3, .length = 3, .texture = "b.png" },
+        .{ .offset = 6, .length = 3, .texture = "a.png" },
+        .{ .offset = 9, .length = 3, .texture = null },
+    };
+
+    var atlas = (try build(std.testing.allocator, Model{
+        .uvs = &uvs,
+        .indices = &indices,
+        .meshes = &meshes,
+        .lod_ranges = &.{},
+    }, Options{
+        .padding = padding,
+        .texture_dir = try tmp.dir.realpathAlloc(allocator, "."),
+        .atlas_name = "atlas.png",
+    })) orelse return error.NoAtlas;
+    defer atlas.deinit();
+
+    try std.testing.expectEqual(@as(usize, 3), atlas.merged_meshes);
+    try std.testing.expectEqual(@as(usize, 2), atlas.texture_count);
+    try std.testing.expectEqual(@as(usize, 2), atlas.meshes.len);
+
+    const atlas_size = [2]f32{ @intToFloat(f32, atlas.image.width), @intToFloat(f32, atlas.image.height) };
+
+    // The pixel bounds of each merged mesh in the atlas.
+    var bounds: [3][2][2]u32 = undefined;
+    for (bounds) |*mesh_bounds, m| {
+        const texture = textures[mesh_textures[m].?];
+        mesh_bounds.* = .{ .{ std.math.maxInt(u32), std.math.maxInt(u32) }, .{ 0, 0 } };
+
+        for (uvs[3 * m ..][0..3]) |uv, v| {
+            const original = original_uvs[3 * m + v];
+
+            var pixel: [2]u32 = undefined;
+            for (pixel) |*p, i| {
+                const t = uv[i] * atlas_size[i];
+                try std.testing.expect(t >= @intToFloat(f32, padding));
+                try std.testing.expect(t <= atlas_size[i] - @intToFloat(f32, padding));
+                p.* = @floatToInt(u32, t);
+                mesh_bounds[0][i] = std.math.min(mesh_bounds[0][i], p.*);
+                mesh_bounds[1][i] = std.math.max(mesh_bounds[1][i], p.*);
+            }
+
+            const sx = @floatToInt(usize, original[0] * @intToFloat(f32, texture.width)) % texture.width;
+            const sy = @floatToInt(usize, original[1] * @intToFloat(f32, texture.height)) % texture.height;
+            try std.testing.expectEqual(texel(texture, sx, sy), texel(atlas.image, pixel[0], pixel[1]));
+        }
+    }
+
+    // Different regions are at least the padding of both apart.
+    for (bounds) |a, i| {
+        for (bounds[i + 1 ..]) |b| {
+            const apart = a[1][0] + 2 * padding < b[0][0] or b[1][0] + 2 * padding < a[0][0] or
+                a[1][1] + 2 * padding < b[0][1] or b[1][1] + 2 * padding < a[0][1];
+            try std.testing.expect(apart);
+        }
+    }
+
+    // the untextured mesh keeps its texture coordinates
+    try std.testing.expectEqualSlices([2]f32, original_uvs[9..], uvs[9..]);
+}
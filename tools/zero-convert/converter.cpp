@@ -12,6 +12,15 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <new>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
 extern "C" void printErrorMessage(char const *text, size_t length);
 extern "C" void printInfoMessage(char const *text, size_t length);
 extern "C" void printWarningMessage(char const *text, size_t length);
@@ -26,76 +35,668 @@ void printWarningMessage(char const *error_string) {
   printWarningMessage(error_string, strlen(error_string));
 }
 
-static bool createStaticModel(aiScene const *scene, MeshStream *stream) {
+struct Vertex {
+  aiVector3D position;
+  aiVector3D normal;
+  aiVector3D uv;
+  // only used for dynamic models. weights sum up to 255.
+  uint8_t bone_indices[4] = {0, 0, 0, 0};
+  uint8_t bone_weights[4] = {0, 0, 0, 0};
+};
+
+// A single mesh range of the output file. Indices are local to `vertices`.
+struct MeshPart {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  aiString texture;
+  bool has_texture = false;
+  // index lists of the generated levels of detail, sharing `vertices`
+  std::vector<std::vector<uint32_t>> lods;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Mesh optimization
+//
+// Implements "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+// (Sander, Nehab, Barczak 2007):
+// 1. Tipsify reorders the triangles for the post-transform vertex cache and
+//    yields the points where the sequence had to jump (hard boundaries).
+// 2. The sequence is split into clusters at those boundaries and the clusters
+//    are sorted so outward-facing clusters are drawn first, which reduces
+//    overdraw without losing much cache efficiency.
+// 3. The vertices are reordered into first-use order so vertex fetch is linear.
+//
+// Every step only uses stable orderings and no hashing, so the output is
+// deterministic for a given input.
+
+static size_t const vertex_cache_size = 16;
+
+// Clusters are only split when the cache efficiency of the cluster stays below
+// this factor of the efficiency of the whole tipsified mesh.
+static float const overdraw_cluster_threshold = 1.05f;
+
+struct VertexCacheStatistics {
+  // average cache miss ratio: transformed vertices per triangle
+  float acmr;
+  // average transform to vertex ratio: transformed vertices per referenced vertex
+  float atvr;
+};
+
+// Simulates a FIFO cache of `cache_size` entries, which is what most mobile GPUs implement.
+static VertexCacheStatistics analyzeVertexCache(std::vector<uint32_t> const &indices, size_t vertex_count, size_t cache_size) {
+  std::vector<size_t> timestamps(vertex_count, 0);
+  std::vector<bool> referenced(vertex_count, false);
+
+  size_t time = cache_size + 1;
+  size_t misses = 0;
+  size_t unique = 0;
+  for (uint32_t index : indices) {
+    if (!referenced[index]) {
+      referenced[index] = true;
+      unique += 1;
+    }
+    if (time - timestamps[index] > cache_size) {
+      timestamps[index] = time;
+      time += 1;
+      misses += 1;
+    }
+  }
+
+  VertexCacheStatistics stats{0.0f, 0.0f};
+  if (indices.size() > 0)
+    stats.acmr = float(misses) / float(indices.size() / 3);
+  if (unique > 0)
+    stats.atvr = float(misses) / float(unique);
+  return stats;
+}
+
+// Returns the reordered index list. `cluster_starts` receives the triangle
+// index of every hard boundary, starting with 0.
+static std::vector<uint32_t> tipsify(std::vector<uint32_t> const &indices, size_t vertex_count, size_t cache_size, std::vector<size_t> &cluster_starts) {
+  size_t const triangle_count = indices.size() / 3;
+
+  // vertex -> triangle adjacency in CSR layout
+  std::vector<uint32_t> live_triangles(vertex_count, 0);
+  for (uint32_t index : indices) {
+    live_triangles[index] += 1;
+  }
+  std::vector<size_t> adjacency_offsets(vertex_count + 1, 0);
+  for (size_t v = 0; v < vertex_count; v++) {
+    adjacency_offsets[v + 1] = adjacency_offsets[v] + live_triangles[v];
+  }
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<size_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+    for (size_t t = 0; t < triangle_count; t++) {
+      for (size_t k = 0; k < 3; k++) {
+        adjacency[fill[indices[3 * t + k]]++] = uint32_t(t);
+      }
+    }
+  }
+
+  std::vector<size_t> cache_time(vertex_count, 0);
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<uint32_t> dead_end;
+  std::vector<uint32_t> candidates;
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+
+  cluster_starts.clear();
+  cluster_starts.push_back(0);
+
+  size_t time = cache_size + 1;
+  size_t cursor = 0;
+  int64_t fanning = (vertex_count > 0) ? 0 : -1;
+
+  while (fanning >= 0) {
+    candidates.clear();
+
+    for (size_t a = adjacency_offsets[fanning]; a < adjacency_offsets[fanning + 1]; a++) {
+      uint32_t const t = adjacency[a];
+      if (emitted[t])
+        continue;
+      for (size_t k = 0; k < 3; k++) {
+        uint32_t const v = indices[3 * t + k];
+        output.push_back(v);
+        dead_end.push_back(v);
+        candidates.push_back(v);
+        live_triangles[v] -= 1;
+        if (time - cache_time[v] > cache_size) {
+          cache_time[v] = time;
+          time += 1;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    // Select the candidate that stays in the cache the longest after fanning it.
+    int64_t next = -1;
+    int64_t best_priority = -1;
+    for (uint32_t v : candidates) {
+      if (live_triangles[v] == 0)
+        continue;
+      int64_t priority = 0;
+      if (time - cache_time[v] + 2 * live_triangles[v] <= cache_size) {
+        priority = int64_t(time - cache_time[v]);
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        next = v;
+      }
+    }
+
+    if (next < 0) {
+      // Dead end: the next triangle won't share vertices with the cache.
+      while (!dead_end.empty()) {
+        uint32_t const v = dead_end.back();
+        dead_end.pop_back();
+        if (live_triangles[v] > 0) {
+          next = v;
+          break;
+        }
+      }
+      while (next < 0 && cursor < vertex_count) {
+        if (live_triangles[cursor] > 0) {
+          next = int64_t(cursor);
+        }
+        cursor += 1;
+      }
+      if (next >= 0 && output.size() / 3 < triangle_count) {
+        cluster_starts.push_back(output.size() / 3);
+      }
+    }
+
+    fanning = next;
+  }
+
+  return output;
+}
+
+// Splits the tipsified sequence into clusters and sorts them front-to-back
+// by how much they face away from the mesh center.
+static void sortClustersForOverdraw(std::vector<Vertex> const &vertices, std::vector<uint32_t> &indices, std::vector<size_t> const &hard_boundaries, size_t cache_size) {
+  size_t const triangle_count = indices.size() / 3;
+
+  float const mesh_acmr = analyzeVertexCache(indices, vertices.size(), cache_size).acmr;
+
+  // Only keep the boundaries where the cluster before is still cache efficient on
+  // its own, as reordering the clusters flushes the cache at each boundary.
+  std::vector<size_t> clusters;
+  {
+    std::vector<size_t> cache_time(vertices.size(), 0);
+    size_t time = cache_size + 1;
+    size_t cluster_misses = 0;
+    size_t cluster_start = 0;
+    size_t next_boundary = 1;
+
+    clusters.push_back(0);
+    for (size_t t = 0; t < triangle_count; t++) {
+      if (next_boundary < hard_boundaries.size() && hard_boundaries[next_boundary] == t) {
+        next_boundary += 1;
+        float const cluster_acmr = float(cluster_misses) / float(t - cluster_start);
+        if (cluster_acmr <= overdraw_cluster_threshold * mesh_acmr) {
+          clusters.push_back(t);
+          cluster_start = t;
+          cluster_misses = 0;
+          time += cache_size + 1; // flush
+        }
+      }
+      for (size_t k = 0; k < 3; k++) {
+        uint32_t const v = indices[3 * t + k];
+        if (time - cache_time[v] > cache_size) {
+          cache_time[v] = time;
+          time += 1;
+          cluster_misses += 1;
+        }
+      }
+    }
+  }
+  if (clusters.size() < 2)
+    return;
+
+  aiVector3D mesh_centroid(0, 0, 0);
+  float mesh_area = 0.0f;
+
+  struct Cluster {
+    size_t start;
+    size_t end;
+    aiVector3D centroid;
+    aiVector3D normal;
+    float area;
+    float sort_key;
+  };
+  std::vector<Cluster> cluster_infos(clusters.size());
+  for (size_t c = 0; c < clusters.size(); c++) {
+    Cluster &cluster = cluster_infos[c];
+    cluster.start = clusters[c];
+    cluster.end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangle_count;
+    cluster.centroid = aiVector3D(0, 0, 0);
+    cluster.normal = aiVector3D(0, 0, 0);
+    cluster.area = 0.0f;
+
+    for (size_t t = cluster.start; t < cluster.end; t++) {
+      aiVector3D const &p0 = vertices[indices[3 * t + 0]].position;
+      aiVector3D const &p1 = vertices[indices[3 * t + 1]].position;
+      aiVector3D const &p2 = vertices[indices[3 * t + 2]].position;
+
+      aiVector3D const cross = (p1 - p0) ^ (p2 - p0);
+      float const area = 0.5f * cross.Length();
+
+      cluster.centroid += (p0 + p1 + p2) * (area / 3.0f);
+      cluster.normal += cross; // area weighted
+      cluster.area += area;
+    }
+
+    mesh_centroid += cluster.centroid;
+    mesh_area += cluster.area;
+
+    if (cluster.area > 0.0f)
+      cluster.centroid /= cluster.area;
+    if (cluster.normal.SquareLength() > 0.0f)
+      cluster.normal.Normalize();
+  }
+  if (mesh_area > 0.0f)
+    mesh_centroid /= mesh_area;
+
+  for (Cluster &cluster : cluster_infos) {
+    cluster.sort_key = (cluster.centroid - mesh_centroid) * cluster.normal;
+  }
+
+  std::stable_sort(cluster_infos.begin(), cluster_infos.end(), [](Cluster const &a, Cluster const &b) {
+    return a.sort_key > b.sort_key;
+  });
+
+  std::vector<uint32_t> sorted;
+  sorted.reserve(indices.size());
+  for (Cluster const &cluster : cluster_infos) {
+    sorted.insert(sorted.end(), indices.begin() + 3 * cluster.start, indices.begin() + 3 * cluster.end);
+  }
+  indices.swap(sorted);
+}
+
+// Reorders the vertices into the order they are first referenced by the index list.
+// Unreferenced vertices are moved to the end.
+static void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+  uint32_t const unmapped = ~uint32_t(0);
+  std::vector<uint32_t> remap(vertices.size(), unmapped);
+
+  std::vector<Vertex> reordered;
+  reordered.reserve(vertices.size());
+
+  for (uint32_t &index : indices) {
+    if (remap[index] == unmapped) {
+      remap[index] = uint32_t(reordered.size());
+      reordered.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  for (size_t v = 0; v < vertices.size(); v++) {
+    if (remap[v] == unmapped) {
+      reordered.push_back(vertices[v]);
+    }
+  }
+
+  vertices.swap(reordered);
+}
+
+static void optimizeMeshPart(size_t part_index, MeshPart &part) {
+  VertexCacheStatistics const before = analyzeVertexCache(part.indices, part.vertices.size(), vertex_cache_size);
+
+  std::vector<size_t> boundaries;
+  part.indices = tipsify(part.indices, part.vertices.size(), vertex_cache_size, boundaries);
+  sortClustersForOverdraw(part.vertices, part.indices, boundaries, vertex_cache_size);
+  optimizeVertexFetch(part.vertices, part.indices);
+
+  VertexCacheStatistics const after = analyzeVertexCache(part.indices, part.vertices.size(), vertex_cache_size);
 
   char buffer[256];
-  sprintf(buffer, "converting %u meshes", scene->mNumMeshes);
+  snprintf(buffer, sizeof buffer, "mesh %zu: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+           part_index,
+           before.acmr, after.acmr,
+           before.atvr, after.atvr);
+  printInfoMessage(buffer);
+}
 
-  size_t total_vertex_count = 0;
-  size_t total_index_count = 0;
+///////////////////////////////////////////////////////////////////////////////
+// Mesh simplification
+//
+// Generates levels of detail with quadric error metrics (Garland, Heckbert 1997).
+// Vertices are only collapsed onto other existing vertices, so all levels share
+// the vertex buffer and only add index ranges to the file.
+//
+// Vertices on a UV or normal seam (several vertices with the same position) and
+// on open borders are locked, so the silhouette and texture mapping stay intact.
 
-  for (size_t i = 0; i < scene->mNumMeshes; i++) {
-    aiMesh const *mesh = scene->mMeshes[i];
-    total_vertex_count += mesh->mNumVertices;
-    total_index_count += 3 * mesh->mNumFaces;
+struct Quadric {
+  double a2 = 0, ab = 0, ac = 0, ad = 0;
+  double b2 = 0, bc = 0, bd = 0;
+  double c2 = 0, cd = 0;
+  double d2 = 0;
+
+  void add(Quadric const &other) {
+    a2 += other.a2, ab += other.ab, ac += other.ac, ad += other.ad;
+    b2 += other.b2, bc += other.bc, bd += other.bd;
+    c2 += other.c2, cd += other.cd;
+    d2 += other.d2;
   }
 
-  if (total_vertex_count >= (1 << 16)) {
-    printErrorMessage("Model has too many vertices. Only up to 65536 are supported!");
-    return false;
+  // squared distance of `p` to all accumulated planes
+  double evaluate(aiVector3D const &p) const {
+    double const x = p.x, y = p.y, z = p.z;
+    return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+           b2 * y * y + 2 * bc * y * z + 2 * bd * y +
+           c2 * z * z + 2 * cd * z +
+           d2;
   }
 
-  stream->writeStaticHeader(stream, total_vertex_count, total_index_count, scene->mNumMeshes);
+  static Quadric fromPlane(aiVector3D const &n, double d) {
+    Quadric q;
+    q.a2 = n.x * n.x, q.ab = n.x * n.y, q.ac = n.x * n.z, q.ad = n.x * d;
+    q.b2 = n.y * n.y, q.bc = n.y * n.z, q.bd = n.y * d;
+    q.c2 = n.z * n.z, q.cd = n.z * d;
+    q.d2 = d * d;
+    return q;
+  }
+};
 
-  for (size_t i = 0; i < scene->mNumMeshes; i++) {
-    aiMesh const *mesh = scene->mMeshes[i];
+struct SimplifyResult {
+  std::vector<uint32_t> indices;
+  // maximum distance of the simplified surface to the original planes in model units
+  float error;
+};
 
-    for (size_t vi = 0; vi < mesh->mNumVertices; vi++) {
-      aiVector3D uv(0, 0, 0);
-      if (mesh->HasTextureCoords(0)) {
-        uv = mesh->mTextureCoords[0][vi];
+static aiVector3D triangleNormal(aiVector3D const &p0, aiVector3D const &p1, aiVector3D const &p2) {
+  return (p1 - p0) ^ (p2 - p0);
+}
+
+static SimplifyResult simplifyMesh(std::vector<Vertex> const &vertices, std::vector<uint32_t> const &source_indices, size_t target_index_count) {
+  size_t const vertex_count = vertices.size();
+
+  // Weld vertices by position to find seams.
+  std::vector<uint32_t> position_id(vertex_count);
+  std::vector<uint32_t> wedge_count;
+  {
+    std::map<std::tuple<float, float, float>, uint32_t> positions;
+    for (size_t v = 0; v < vertex_count; v++) {
+      aiVector3D const &p = vertices[v].position;
+      auto const inserted = positions.emplace(std::make_tuple(p.x, p.y, p.z), uint32_t(positions.size()));
+      position_id[v] = inserted.first->second;
+      if (inserted.second)
+        wedge_count.push_back(0);
+      wedge_count[position_id[v]] += 1;
+    }
+  }
+
+  std::vector<bool> locked(vertex_count, false);
+  for (size_t v = 0; v < vertex_count; v++) {
+    if (wedge_count[position_id[v]] > 1)
+      locked[v] = true;
+  }
+  {
+    // Edges that only belong to a single triangle are borders.
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> edge_use;
+    for (size_t i = 0; i < source_indices.size(); i += 3) {
+      for (size_t k = 0; k < 3; k++) {
+        uint32_t const a = position_id[source_indices[i + k]];
+        uint32_t const b = position_id[source_indices[i + (k + 1) % 3]];
+        edge_use[std::make_pair(std::min(a, b), std::max(a, b))] += 1;
       }
-      aiVector3D normal(0, 0, 0);
-      if (mesh->HasNormals()) {
-        normal = mesh->mNormals[vi];
+    }
+    std::vector<bool> border_position(wedge_count.size(), false);
+    for (auto const &edge : edge_use) {
+      if (edge.second == 1) {
+        border_position[edge.first.first] = true;
+        border_position[edge.first.second] = true;
       }
-      aiVector3D pos = mesh->mVertices[vi];
+    }
+    for (size_t v = 0; v < vertex_count; v++) {
+      if (border_position[position_id[v]])
+        locked[v] = true;
+    }
+  }
 
-      stream->writeVertex(stream,
-                          pos.x, pos.y, pos.z,
-                          normal.x, normal.y, normal.z,
-                          uv.x, uv.y);
+  std::vector<Quadric> quadrics(wedge_count.size());
+  for (size_t i = 0; i < source_indices.size(); i += 3) {
+    aiVector3D const &p0 = vertices[source_indices[i + 0]].position;
+    aiVector3D const &p1 = vertices[source_indices[i + 1]].position;
+    aiVector3D const &p2 = vertices[source_indices[i + 2]].position;
+    aiVector3D normal = triangleNormal(p0, p1, p2);
+    if (normal.SquareLength() == 0.0f)
+      continue;
+    normal.Normalize();
+    Quadric const q = Quadric::fromPlane(normal, -double(normal * p0));
+    for (size_t k = 0; k < 3; k++) {
+      quadrics[position_id[source_indices[i + k]]].add(q);
     }
   }
 
-  size_t index_offset = 0;
+  SimplifyResult result;
+  result.indices = source_indices;
+  result.error = 0.0f;
+
+  struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+  };
+  std::vector<Collapse> collapses;
+  std::vector<uint32_t> remap(vertex_count);
+  std::vector<bool> touched(vertex_count);
+  std::vector<size_t> adjacency_offsets(vertex_count + 1);
+  std::vector<uint32_t> adjacency;
+
+  double max_cost = 0.0;
+
+  size_t const max_passes = 100;
+  for (size_t pass = 0; pass < max_passes && result.indices.size() > target_index_count; pass++) {
+    std::vector<uint32_t> &indices = result.indices;
+    size_t const triangle_count = indices.size() / 3;
+
+    // vertex -> triangle adjacency of the current mesh
+    std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+    for (uint32_t index : indices) {
+      adjacency_offsets[index + 1] += 1;
+    }
+    for (size_t v = 0; v < vertex_count; v++) {
+      adjacency_offsets[v + 1] += adjacency_offsets[v];
+    }
+    adjacency.resize(indices.size());
+    {
+      std::vector<size_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+      for (size_t t = 0; t < triangle_count; t++) {
+        for (size_t k = 0; k < 3; k++) {
+          adjacency[fill[indices[3 * t + k]]++] = uint32_t(t);
+        }
+      }
+    }
+
+    collapses.clear();
+    for (size_t t = 0; t < triangle_count; t++) {
+      for (size_t k = 0; k < 3; k++) {
+        uint32_t const a = indices[3 * t + k];
+        uint32_t const b = indices[3 * t + (k + 1) % 3];
+        if (!locked[a]) {
+          Quadric q = quadrics[position_id[a]];
+          q.add(quadrics[position_id[b]]);
+          collapses.push_back(Collapse{a, b, q.evaluate(vertices[b].position)});
+        }
+        if (!locked[b]) {
+          Quadric q = quadrics[position_id[b]];
+          q.add(quadrics[position_id[a]]);
+          collapses.push_back(Collapse{b, a, q.evaluate(vertices[a].position)});
+        }
+      }
+    }
+    if (collapses.empty())
+      break;
+
+    std::sort(collapses.begin(), collapses.end(), [](Collapse const &lhs, Collapse const &rhs) {
+      if (lhs.cost != rhs.cost)
+        return lhs.cost < rhs.cost;
+      if (lhs.from != rhs.from)
+        return lhs.from < rhs.from;
+      return lhs.to < rhs.to;
+    });
+
+    for (size_t v = 0; v < vertex_count; v++) {
+      remap[v] = uint32_t(v);
+    }
+    std::fill(touched.begin(), touched.end(), false);
+
+    size_t remaining_triangles = triangle_count;
+    size_t const target_triangles = target_index_count / 3;
+    size_t performed = 0;
+
+    for (Collapse const &collapse : collapses) {
+      if (remaining_triangles <= target_triangles)
+        break;
+      if (touched[collapse.from] || touched[collapse.to])
+        continue;
+
+      aiVector3D const &target = vertices[collapse.to].position;
+
+      // Reject collapses that flip a triangle around `from`.
+      bool flips = false;
+      size_t removed = 0;
+      for (size_t a = adjacency_offsets[collapse.from]; a < adjacency_offsets[collapse.from + 1]; a++) {
+        uint32_t const *tri = &indices[3 * adjacency[a]];
+        if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+          removed += 1;
+          continue;
+        }
+        aiVector3D p[3];
+        aiVector3D q[3];
+        for (size_t k = 0; k < 3; k++) {
+          p[k] = vertices[tri[k]].position;
+          q[k] = (tri[k] == collapse.from) ? target : p[k];
+        }
+        aiVector3D const before = triangleNormal(p[0], p[1], p[2]);
+        aiVector3D const after = triangleNormal(q[0], q[1], q[2]);
+        if (before * after <= 0.0f) {
+          flips = true;
+          break;
+        }
+      }
+      if (flips)
+        continue;
+
+      remap[collapse.from] = collapse.to;
+      quadrics[position_id[collapse.to]].add(quadrics[position_id[collapse.from]]);
+      max_cost = std::max(max_cost, collapse.cost);
+
+      // Only one collapse per neighbourhood and pass, so the adjacency stays valid.
+      for (size_t a = adjacency_offsets[collapse.from]; a < adjacency_offsets[collapse.from + 1]; a++) {
+        uint32_t const *tri = &indices[3 * adjacency[a]];
+        touched[tri[0]] = true;
+        touched[tri[1]] = true;
+        touched[tri[2]] = true;
+      }
+
+      remaining_triangles -= removed;
+      performed += 1;
+    }
+
+    if (performed == 0)
+      break;
+
+    size_t write = 0;
+    for (size_t t = 0; t < triangle_count; t++) {
+      uint32_t const i0 = remap[indices[3 * t + 0]];
+      uint32_t const i1 = remap[indices[3 * t + 1]];
+      uint32_t const i2 = remap[indices[3 * t + 2]];
+      if (i0 == i1 || i1 == i2 || i0 == i2)
+        continue;
+      indices[write++] = i0;
+      indices[write++] = i1;
+      indices[write++] = i2;
+    }
+    indices.resize(write);
+  }
+
+  result.error = float(std::sqrt(std::max(max_cost, 0.0)));
+  return result;
+}
+
+static void generateLods(std::vector<MeshPart> &parts, std::vector<float> const &ratios, std::vector<float> &errors, bool optimize) {
+  errors.assign(ratios.size(), 0.0f);
+
+  for (size_t i = 0; i < parts.size(); i++) {
+    MeshPart &part = parts[i];
+    part.lods.resize(ratios.size());
+
+    for (size_t level = 0; level < ratios.size(); level++) {
+      size_t target = size_t(float(part.indices.size() / 3) * ratios[level]) * 3;
+
+      // Continue from the previous level, so the levels get coarser monotonically.
+      std::vector<uint32_t> const &source = (level > 0) ? part.lods[level - 1] : part.indices;
+
+      SimplifyResult simplified = simplifyMesh(part.vertices, source, target);
+      if (optimize) {
+        std::vector<size_t> boundaries;
+        simplified.indices = tipsify(simplified.indices, part.vertices.size(), vertex_cache_size, boundaries);
+      }
+
+      part.lods[level] = std::move(simplified.indices);
+      errors[level] = std::max(errors[level], simplified.error);
+      if (level > 0)
+        errors[level] = std::max(errors[level], errors[level - 1]);
+
+      char buffer[256];
+      snprintf(buffer, sizeof buffer, "mesh %zu: lod %zu has %zu triangles (%.1f%%), error %.4f",
+               i, level + 1,
+               part.lods[level].size() / 3,
+               100.0f * float(part.lods[level].size()) / float(part.indices.size()),
+               simplified.error);
+      printInfoMessage(buffer);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Copies the meshes of `scene` into `parts`, one part per mesh.
+static bool gatherMeshParts(aiScene const *scene, std::vector<MeshPart> &parts, size_t &total_vertex_count, size_t &total_index_count) {
+  parts.resize(scene->mNumMeshes);
+
+  auto texture_warning = false;
+
+  total_vertex_count = 0;
+  total_index_count = 0;
+
   for (size_t i = 0; i < scene->mNumMeshes; i++) {
     aiMesh const *mesh = scene->mMeshes[i];
+    MeshPart &part = parts[i];
 
+    part.vertices.resize(mesh->mNumVertices);
+    for (size_t vi = 0; vi < mesh->mNumVertices; vi++) {
+      Vertex &vertex = part.vertices[vi];
+      vertex.position = mesh->mVertices[vi];
+      vertex.normal = aiVector3D(0, 0, 0);
+      vertex.uv = aiVector3D(0, 0, 0);
+      if (mesh->HasNormals()) {
+        vertex.normal = mesh->mNormals[vi];
+      }
+      if (mesh->HasTextureCoords(0)) {
+        vertex.uv = mesh->mTextureCoords[0][vi];
+      }
+    }
+
+    part.indices.reserve(3 * mesh->mNumFaces);
     for (size_t fi = 0; fi < mesh->mNumFaces; fi++) {
       aiFace face = mesh->mFaces[fi];
       if (face.mNumIndices != 3) {
         printErrorMessage("Triangulation of the model failed. Found at least one non-triangle face!");
         return false;
       }
-      stream->writeFace(stream, index_offset + face.mIndices[0], index_offset + face.mIndices[1], index_offset + face.mIndices[2]);
+      part.indices.push_back(face.mIndices[0]);
+      part.indices.push_back(face.mIndices[1]);
+      part.indices.push_back(face.mIndices[2]);
     }
-    index_offset += mesh->mNumVertices;
-  }
 
-  auto texture_warning = false;
-
-  index_offset = 0;
-  for (size_t i = 0; i < scene->mNumMeshes; i++) {
-    aiMesh const *mesh = scene->mMeshes[i];
     aiMaterial const *mtl = scene->mMaterials[mesh->mMaterialIndex];
-
-    aiString name = mtl->GetName();
-
-    aiString path;
-    bool has_texture = false;
-    if (mtl->GetTexture(aiTextureType_DIFFUSE, 0, &path) == aiReturn_SUCCESS) {
-      has_texture = true;
+    if (mtl->GetTexture(aiTextureType_DIFFUSE, 0, &part.texture) == aiReturn_SUCCESS) {
+      part.has_texture = true;
     } else {
       if (!texture_warning) {
         printErrorMessage("At least once mesh doesn't have a texture assigned!");
@@ -103,30 +704,393 @@ static bool createStaticModel(aiScene const *scene, MeshStream *stream) {
       }
     }
 
-    // char msgBuf[64];
-    // sprintf(msgBuf, "texture: %s, %s", name.C_Str(), path.C_Str());
-    // printWarningMessage(msgBuf);
+    total_vertex_count += part.vertices.size();
+    total_index_count += part.indices.size();
+  }
+
+  if (total_vertex_count >= (1 << 16)) {
+    printErrorMessage("Model has too many vertices. Only up to 65536 are supported!");
+    return false;
+  }
+
+  return true;
+}
+
+static bool createStaticModel(aiScene const *scene, MeshStream *stream, ConvertOptions const *options) {
+  std::vector<MeshPart> parts;
+  size_t total_vertex_count;
+  size_t total_index_count;
+  if (!gatherMeshParts(scene, parts, total_vertex_count, total_index_count))
+    return false;
+
+  if (options->optimize) {
+    // Each part is optimized on its own, so the mesh ranges stay the same.
+    for (size_t i = 0; i < parts.size(); i++) {
+      optimizeMeshPart(i, parts[i]);
+    }
+  }
+
+  std::vector<float> lod_ratios(options->lod_ratios, options->lod_ratios + options->lod_count);
+  std::vector<float> lod_errors;
+  if (!lod_ratios.empty()) {
+    generateLods(parts, lod_ratios, lod_errors, options->optimize);
+    for (MeshPart const &part : parts) {
+      for (auto const &lod : part.lods) {
+        total_index_count += lod.size();
+      }
+    }
+  }
+
+  stream->writeStaticHeader(stream, total_vertex_count, total_index_count, parts.size());
+
+  for (MeshPart const &part : parts) {
+    for (Vertex const &vertex : part.vertices) {
+      stream->writeVertex(stream,
+                          vertex.position.x, vertex.position.y, vertex.position.z,
+                          vertex.normal.x, vertex.normal.y, vertex.normal.z,
+                          vertex.uv.x, vertex.uv.y);
+    }
+  }
+
+  size_t vertex_offset = 0;
+  for (MeshPart const &part : parts) {
+    for (size_t i = 0; i < part.indices.size(); i += 3) {
+      stream->writeFace(stream,
+                        vertex_offset + part.indices[i + 0],
+                        vertex_offset + part.indices[i + 1],
+                        vertex_offset + part.indices[i + 2]);
+    }
+    vertex_offset += part.vertices.size();
+  }
+
+  for (size_t level = 0; level < lod_ratios.size(); level++) {
+    vertex_offset = 0;
+    for (MeshPart const &part : parts) {
+      std::vector<uint32_t> const &indices = part.lods[level];
+      for (size_t i = 0; i < indices.size(); i += 3) {
+        stream->writeFace(stream,
+                          vertex_offset + indices[i + 0],
+                          vertex_offset + indices[i + 1],
+                          vertex_offset + indices[i + 2]);
+      }
+      vertex_offset += part.vertices.size();
+    }
+  }
 
+  size_t index_offset = 0;
+  for (MeshPart const &part : parts) {
     stream->writeMeshRange(stream,
                            index_offset,
-                           3 * mesh->mNumFaces,
-                           has_texture ? path.C_Str() : nullptr);
+                           part.indices.size(),
+                           part.has_texture ? part.texture.C_Str() : nullptr);
+
+    index_offset += part.indices.size();
+  }
 
-    index_offset += 3 * mesh->mNumFaces;
+  if (!lod_ratios.empty()) {
+    stream->writeLodHeader(stream, lod_ratios.size());
+    for (size_t level = 0; level < lod_ratios.size(); level++) {
+      stream->writeLodLevel(stream, level, lod_errors[level]);
+      for (size_t i = 0; i < parts.size(); i++) {
+        stream->writeLodRange(stream, level, i, index_offset, parts[i].lods[level].size());
+        index_offset += parts[i].lods[level].size();
+      }
+    }
   }
 
   return true;
 }
 
-static bool createDynamicModel(aiScene const *scene, MeshStream *stream) {
-  printErrorMessage("dynamic models are not supported yet!");
-  return false;
+///////////////////////////////////////////////////////////////////////////////
+// Dynamic models
+
+static size_t const max_bones = 256;
+static size_t const no_parent = 0xFFFFFFFF;
+
+struct Bone {
+  aiNode const *node;
+  size_t parent;
+  // only set for nodes referenced by an aiBone, the others use the identity
+  bool has_offset;
+  aiMatrix4x4 inverse_bind_matrix;
+};
+
+// aiMatrix4x4 is row major, z3d stores column major matrices.
+static void toColumnMajor(aiMatrix4x4 const &m, float out[16]) {
+  float const rows[4][4] = {
+      {m.a1, m.a2, m.a3, m.a4},
+      {m.b1, m.b2, m.b3, m.b4},
+      {m.c1, m.c2, m.c3, m.c4},
+      {m.d1, m.d2, m.d3, m.d4},
+  };
+  for (size_t col = 0; col < 4; col++) {
+    for (size_t row = 0; row < 4; row++) {
+      out[4 * col + row] = rows[row][col];
+    }
+  }
+}
+
+// Returns true if `node` or one of its children is in `used`, and collects those into `required`.
+static bool markRequiredNodes(aiNode const *node, std::set<std::string> const &used, std::set<aiNode const *> &required) {
+  bool is_required = (used.count(node->mName.C_Str()) > 0);
+  for (size_t i = 0; i < node->mNumChildren; i++) {
+    if (markRequiredNodes(node->mChildren[i], used, required))
+      is_required = true;
+  }
+  if (is_required)
+    required.insert(node);
+  return is_required;
+}
+
+// Adds the required nodes in depth first order, so parents are always stored before their children.
+static void collectBones(aiNode const *node, size_t parent, std::set<aiNode const *> const &required, std::vector<Bone> &bones, std::map<std::string, size_t> &bone_indices) {
+  if (required.count(node) == 0)
+    return;
+
+  size_t const index = bones.size();
+  bones.push_back(Bone{node, parent, false, aiMatrix4x4()});
+  bone_indices[node->mName.C_Str()] = index;
+
+  for (size_t i = 0; i < node->mNumChildren; i++) {
+    collectBones(node->mChildren[i], index, required, bones, bone_indices);
+  }
+}
+
+static void findMeshNodes(aiNode const *node, std::vector<aiNode const *> &mesh_nodes) {
+  for (size_t i = 0; i < node->mNumMeshes; i++) {
+    if (mesh_nodes[node->mMeshes[i]] == nullptr)
+      mesh_nodes[node->mMeshes[i]] = node;
+  }
+  for (size_t i = 0; i < node->mNumChildren; i++) {
+    findMeshNodes(node->mChildren[i], mesh_nodes);
+  }
 }
 
-extern "C" bool transformFile(char const *src_file_name, MeshStream *stream, FileType create_static_model) {
+// Keeps the four largest influences of a vertex and quantizes them so they sum up to 255.
+static void packBoneWeights(std::vector<std::pair<float, size_t>> influences, Vertex &vertex) {
+  std::stable_sort(influences.begin(), influences.end(), [](std::pair<float, size_t> const &lhs, std::pair<float, size_t> const &rhs) {
+    return lhs.first > rhs.first;
+  });
+  if (influences.size() > 4)
+    influences.resize(4);
+
+  float total = 0.0f;
+  for (auto const &influence : influences) {
+    total += influence.first;
+  }
+  if (influences.empty() || total <= 0.0f) {
+    // Unweighted vertices follow the first bone.
+    vertex.bone_weights[0] = 255;
+    return;
+  }
 
-  // Create an instance of the Importer class
+  int sum = 0;
+  for (size_t i = 0; i < influences.size(); i++) {
+    int const weight = int(std::round(255.0f * influences[i].first / total));
+    vertex.bone_indices[i] = uint8_t(influences[i].second);
+    vertex.bone_weights[i] = uint8_t(std::min(weight, 255));
+    sum += vertex.bone_weights[i];
+  }
+  // Rounding errors go to the largest weight.
+  vertex.bone_weights[0] = uint8_t(int(vertex.bone_weights[0]) + (255 - sum));
+}
+
+static bool createDynamicModel(aiScene const *scene, MeshStream *stream, ConvertOptions const *options) {
+  if (options->lod_count > 0) {
+    printWarningMessage("Levels of detail are only generated for static models and will be skipped.");
+  }
+
+  std::vector<MeshPart> parts;
+  size_t total_vertex_count;
+  size_t total_index_count;
+  if (!gatherMeshParts(scene, parts, total_vertex_count, total_index_count))
+    return false;
+
+  // Rigid meshes are attached to the node that references them.
+  std::vector<aiNode const *> mesh_nodes(scene->mNumMeshes, nullptr);
+  findMeshNodes(scene->mRootNode, mesh_nodes);
+
+  std::set<std::string> used_nodes;
+  for (size_t i = 0; i < scene->mNumMeshes; i++) {
+    aiMesh const *mesh = scene->mMeshes[i];
+    if (mesh->HasBones()) {
+      for (size_t b = 0; b < mesh->mNumBones; b++) {
+        used_nodes.insert(mesh->mBones[b]->mName.C_Str());
+      }
+    } else if (mesh_nodes[i] != nullptr) {
+      used_nodes.insert(mesh_nodes[i]->mName.C_Str());
+    }
+  }
+
+  std::set<aiNode const *> required;
+  markRequiredNodes(scene->mRootNode, used_nodes, required);
+
+  std::vector<Bone> bones;
+  std::map<std::string, size_t> bone_indices;
+  collectBones(scene->mRootNode, no_parent, required, bones, bone_indices);
+
+  if (bones.empty()) {
+    printErrorMessage("Model does not contain a skeleton!");
+    return false;
+  }
+  if (bones.size() > max_bones) {
+    printErrorMessage("Model has too many bones. Only up to 256 are supported!");
+    return false;
+  }
+
+  for (size_t i = 0; i < scene->mNumMeshes; i++) {
+    aiMesh const *mesh = scene->mMeshes[i];
+    MeshPart &part = parts[i];
+
+    if (!mesh->HasBones()) {
+      size_t const bone = (mesh_nodes[i] != nullptr) ? bone_indices[mesh_nodes[i]->mName.C_Str()] : 0;
+      for (Vertex &vertex : part.vertices) {
+        vertex.bone_indices[0] = uint8_t(bone);
+        vertex.bone_weights[0] = 255;
+      }
+      continue;
+    }
+
+    std::vector<std::vector<std::pair<float, size_t>>> influences(mesh->mNumVertices);
+    for (size_t b = 0; b < mesh->mNumBones; b++) {
+      aiBone const *src_bone = mesh->mBones[b];
+      auto const it = bone_indices.find(src_bone->mName.C_Str());
+      if (it == bone_indices.end()) {
+        printErrorMessage("Mesh references a bone that is not in the node hierarchy!");
+        return false;
+      }
+
+      Bone &bone = bones[it->second];
+      bone.has_offset = true;
+      bone.inverse_bind_matrix = src_bone->mOffsetMatrix;
+
+      for (size_t w = 0; w < src_bone->mNumWeights; w++) {
+        aiVertexWeight const &weight = src_bone->mWeights[w];
+        influences[weight.mVertexId].push_back(std::make_pair(weight.mWeight, it->second));
+      }
+    }
+    for (size_t v = 0; v < part.vertices.size(); v++) {
+      packBoneWeights(influences[v], part.vertices[v]);
+    }
+  }
+
+  // Vertex fetch optimization reorders whole vertices, so the bone data stays attached.
+  if (options->optimize) {
+    for (size_t i = 0; i < parts.size(); i++) {
+      optimizeMeshPart(i, parts[i]);
+    }
+  }
+
+  stream->writeDynamicHeader(stream, total_vertex_count, total_index_count, parts.size(), bones.size());
+
+  for (MeshPart const &part : parts) {
+    for (Vertex const &vertex : part.vertices) {
+      stream->writeDynamicVertex(stream,
+                                 vertex.position.x, vertex.position.y, vertex.position.z,
+                                 vertex.normal.x, vertex.normal.y, vertex.normal.z,
+                                 vertex.uv.x, vertex.uv.y,
+                                 vertex.bone_indices, vertex.bone_weights);
+    }
+  }
+
+  size_t vertex_offset = 0;
+  for (MeshPart const &part : parts) {
+    for (size_t i = 0; i < part.indices.size(); i += 3) {
+      stream->writeFace(stream,
+                        vertex_offset + part.indices[i + 0],
+                        vertex_offset + part.indices[i + 1],
+                        vertex_offset + part.indices[i + 2]);
+    }
+    vertex_offset += part.vertices.size();
+  }
+
+  size_t index_offset = 0;
+  for (MeshPart const &part : parts) {
+    stream->writeMeshRange(stream,
+                           index_offset,
+                           part.indices.size(),
+                           part.has_texture ? part.texture.C_Str() : nullptr);
+    index_offset += part.indices.size();
+  }
+
+  for (Bone const &bone : bones) {
+    float inverse_bind_matrix[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    float local_transform[16];
+    if (bone.has_offset)
+      toColumnMajor(bone.inverse_bind_matrix, inverse_bind_matrix);
+    toColumnMajor(bone.node->mTransformation, local_transform);
+
+    stream->writeBone(stream, bone.node->mName.C_Str(), bone.parent, inverse_bind_matrix, local_transform);
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Animations
+
+static bool createAnimation(aiScene const *scene, AnimationStream *stream, size_t index) {
+  if (index >= scene->mNumAnimations) {
+    printErrorMessage("File does not contain the requested animation!");
+    return false;
+  }
+
+  aiAnimation const *animation = scene->mAnimations[index];
+
+  // Some formats don't store a tick rate, assimp recommends 25 in that case.
+  double const ticks_per_second = (animation->mTicksPerSecond > 0.0) ? animation->mTicksPerSecond : 25.0;
+
+  stream->writeAnimationHeader(stream, float(animation->mDuration / ticks_per_second), animation->mNumChannels);
+
+  for (size_t c = 0; c < animation->mNumChannels; c++) {
+    aiNodeAnim const *channel = animation->mChannels[c];
+
+    stream->writeChannel(stream,
+                         channel->mNodeName.C_Str(),
+                         channel->mNumPositionKeys,
+                         channel->mNumRotationKeys,
+                         channel->mNumScalingKeys);
+
+    for (size_t k = 0; k < channel->mNumPositionKeys; k++) {
+      aiVectorKey const &key = channel->mPositionKeys[k];
+      stream->writePositionKey(stream, float(key.mTime / ticks_per_second), key.mValue.x, key.mValue.y, key.mValue.z);
+    }
+    for (size_t k = 0; k < channel->mNumRotationKeys; k++) {
+      aiQuatKey const &key = channel->mRotationKeys[k];
+      stream->writeRotationKey(stream, float(key.mTime / ticks_per_second), key.mValue.x, key.mValue.y, key.mValue.z, key.mValue.w);
+    }
+    for (size_t k = 0; k < channel->mNumScalingKeys; k++) {
+      aiVectorKey const &key = channel->mScalingKeys[k];
+      stream->writeScaleKey(stream, float(key.mTime / ticks_per_second), key.mValue.x, key.mValue.y, key.mValue.z);
+    }
+  }
+
+  return true;
+}
+
+// Keeps the importer alive between conversions, so assimp only initializes
+// its importers and post processing steps once per worker.
+struct Converter {
   Assimp::Importer importer;
+};
+
+extern "C" Converter *createConverter() {
+  return new (std::nothrow) Converter();
+}
+
+extern "C" void destroyConverter(Converter *converter) {
+  delete converter;
+}
+
+extern "C" bool isSupportedFile(Converter *converter, char const *file_name) {
+  char const *extension = strrchr(file_name, '.');
+  if (extension == nullptr)
+    return false;
+  return converter->importer.IsExtensionSupported(extension);
+}
+
+extern "C" bool convertFile(Converter *converter, char const *src_file_name, MeshStream *stream, FileType create_static_model, ConvertOptions const *options) {
+  Assimp::Importer &importer = converter->importer;
 
   auto import_flags = aiProcess_CalcTangentSpace |
                       aiProcess_Triangulate |
@@ -137,7 +1101,9 @@ extern "C" bool transformFile(char const *src_file_name, MeshStream *stream, Fil
   if (create_static_model) {
     import_flags |= aiProcess_PreTransformVertices;
   } else {
-    import_flags |= aiProcess_OptimizeGraph;
+    // No aiProcess_OptimizeGraph here: collapsing nodes changes the local transforms
+    // the animations of the model refer to.
+    import_flags |= aiProcess_LimitBoneWeights;
   }
 
   // And have it read the given file with some example postprocessing
@@ -151,14 +1117,46 @@ extern "C" bool transformFile(char const *src_file_name, MeshStream *stream, Fil
     return false;
   }
 
+  bool success;
   if (not scene->HasMeshes()) {
     printErrorMessage("Model does not contain any meshes!");
+    success = false;
+  } else if (create_static_model) {
+    success = createStaticModel(scene, stream, options);
+  } else {
+    success = createDynamicModel(scene, stream, options);
+  }
+
+  // Don't keep the scene alive until the next file is converted.
+  importer.FreeScene();
+
+  return success;
+}
+
+extern "C" bool convertAnimation(Converter *converter, char const *src_file_name, AnimationStream *stream, size_t animation_index) {
+  Assimp::Importer &importer = converter->importer;
+
+  // The node names must match the ones of the dynamic model, so the graph is not touched.
+  const aiScene *scene = importer.ReadFile(src_file_name, 0);
+  if (scene == nullptr) {
+    printErrorMessage(importer.GetErrorString());
     return false;
   }
 
-  if (create_static_model) {
-    return createStaticModel(scene, stream);
+  bool success;
+  if (not scene->HasAnimations()) {
+    printErrorMessage("File does not contain any animations!");
+    success = false;
   } else {
-    return createDynamicModel(scene, stream);
+    success = createAnimation(scene, stream, animation_index);
   }
-}
\ No newline at end of file
+
+  importer.FreeScene();
+
+  return success;
+}
+
+extern "C" bool transformFile(char const *src_file_name, MeshStream *stream, FileType create_static_model, ConvertOptions const *options) {
+  Converter converter;
+  return convertFile(&converter, src_file_name, stream, create_static_model, options);
+}
@@ -4,12 +4,15 @@
 //! zero-convert sound --output /tmp/foo.zsnd /game/foo/bam.ogg
 //! zero-convert music --output /tmp/foo.zmus /bla/blub/tmp.ogg
 //! zero-convert animation --output /tmp/foo.zani /bla/blub/tmp.fbx
+//! zero-convert batch --jobs 8 --output /tmp/assets /game/models
 //!
 
 const std = @import("std");
 const api = @import("api");
 const z3d = @import("z3d");
+const zani = @import("zani");
 const args_parser = @import("args");
+const atlas = @import("atlas.zig");
 
 const CliArgs = struct {
     output: ?[]const u8 = null,
@@ -24,19 +27,65 @@ const CliArgs = struct {
 
 const ModelArgs = struct {
     dynamic: bool = false,
+    @"no-optimize": bool = false,
+    quantize: bool = false,
+    lod: ?[]const u8 = null,
+    atlas: ?u32 = null,
 
     pub const shorthands = .{
         .d = "dynamic",
+        .q = "quantize",
+        .l = "lod",
+        .a = "atlas",
     };
 };
 
+const AnimationArgs = struct {
+    index: u32 = 0,
+
+    pub const shorthands = .{
+        .i = "index",
+    };
+};
+
+const BatchArgs = struct {
+    dynamic: bool = false,
+    @"no-optimize": bool = false,
+    quantize: bool = false,
+    lod: ?[]const u8 = null,
+    atlas: ?u32 = null,
+    jobs: ?u32 = null,
+    cache: ?[]const u8 = null,
+    force: bool = false,
+
+    pub const shorthands = .{
+        .d = "dynamic",
+        .q = "quantize",
+        .l = "lod",
+        .a = "atlas",
+        .j = "jobs",
+        .f = "force",
+    };
+
+    fn modelArgs(self: BatchArgs) ModelArgs {
+        return ModelArgs{
+            .dynamic = self.dynamic,
+            .@"no-optimize" = self.@"no-optimize",
+            .quantize = self.quantize,
+            .lod = self.lod,
+            .atlas = self.atlas,
+        };
+    }
+};
+
 const Verbs = union(enum) {
     help: struct {},
     model: ModelArgs,
+    batch: BatchArgs,
     texture: struct {},
     sound: struct {},
     music: struct {},
-    animation: struct {},
+    animation: AnimationArgs,
 };
 
 fn printUsage(exe_name: []const u8, writer: anytype) !void {
@@ -55,9 +104,22 @@ fn printUsage(exe_name: []const u8, writer: anytype) !void {
         \\      --test           Does not write the output file, but will still perform the conversion. This can be used to check if a file is convertible.
         \\
         \\Verbs:
-        \\  model [--dynamic]
+        \\  model [--dynamic] [--no-optimize] [--quantize] [--lod <ratios>] [--atlas <size>]
         \\    Converts a 3D model into the z3d format.
         \\    -d, --dynamic        Converts the model as a dynamic model with skinning information. Those models are usually somewhat larger, but can be animated.
+        \\        --no-optimize    Keeps the triangle and vertex order of the source file instead of optimizing it for the vertex cache and overdraw.
+        \\    -q, --quantize       Writes a version 2 file with 16 byte quantized vertices instead of 32 byte float vertices.
+        \\    -l, --lod <ratios>   Generates simplified levels of detail. <ratios> is a comma separated list of triangle ratios relative to the full detail mesh, for example 0.5,0.25,0.1.
+        \\    -a, --atlas <size>   Packs the diffuse textures into an atlas of at most <size>x<size> pixels and merges the meshes that use it into one. The atlas is written next to the output file as <name>.atlas.png. Textures that repeat too often or don't fit keep their own meshes.
+        \\
+        \\  batch [--jobs <count>] [--cache <file>] [--force] [model options] <directory or manifest>
+        \\    Converts all models in a directory (recursively) or listed in a manifest file, one path per line
+        \\    relative to the manifest. --output is the output directory, otherwise the files are placed next to
+        \\    their sources. Accepts the same options as model.
+        \\    -j, --jobs <count>   Number of worker threads. Defaults to the number of CPU cores.
+        \\        --cache <file>   Stores the content and option hashes of converted files, so unchanged files are
+        \\                         skipped in the next run. Defaults to .zero-convert-cache in the output directory.
+        \\    -f, --force          Converts all files, even if they are unchanged.
         \\
         \\  texture
         \\    Converts a texture/image file into the ztex format.
@@ -68,8 +130,9 @@ fn printUsage(exe_name: []const u8, writer: anytype) !void {
         \\  music
         \\    Converts a long sound file into the zmus format.
         \\    
-        \\  animation
-        \\    Converts the animations from a 3D model into the zani format.
+        \\  animation [--index <index>]
+        \\    Converts an animation from a 3D model into the zani format.
+        \\    -i, --index <index>  Selects the animation in the file. Defaults to the first one.
         \\
     );
 }
@@ -97,8 +160,12 @@ pub fn main() !u8 {
 
     const src_file_name = cli.positionals[0];
 
+    if (cli.verb.? == .batch) {
+        return try runBatch(allocator, cli.verb.?.batch, cli.options, src_file_name);
+    }
+
     const extension = switch (cli.verb.?) {
-        .help => unreachable, // we already printed the help text
+        .help, .batch => unreachable, // handled above
         .model => ".z3d",
         .texture => ".ztex",
         .sound => ".zsnd",
@@ -121,15 +188,41 @@ pub fn main() !u8 {
     var final_buffer = std.ArrayList(u8).init(allocator);
     defer final_buffer.deinit();
 
+    var atlas_buffer = std.ArrayList(u8).init(allocator);
+    defer atlas_buffer.deinit();
+
     switch (cli.verb.?) {
         .model => |flags| {
-            var stream = MeshStream{
+            var settings = ModelSettings.init(allocator, flags) catch |err| {
+                try stderr.print("invalid lod ratios '{s}': {s}\n", .{ flags.lod.?, @errorName(err) });
+                return 1;
+            };
+            defer settings.deinit();
+
+            const converter = api.createConverter() orelse return error.OutOfMemory;
+            defer api.destroyConverter(converter);
+
+            convertModel(allocator, converter, src_file_name, dst_file.items, &settings, &final_buffer, &atlas_buffer) catch |err| {
+                try stderr.print("failed to write model: {s}\n", .{@errorName(err)});
+                return 1;
+            };
+        },
+        .animation => |flags| {
+            const converter = api.createConverter() orelse return error.OutOfMemory;
+            defer api.destroyConverter(converter);
+
+            var stream = AnimationStream{
                 .target_buffer = &final_buffer,
             };
 
-            if (!api.transformFile(src_file_name.ptr, &stream.mesh_stream, if (flags.dynamic) api.dynamic_geometry else api.static_geometry)) {
+            if (!api.convertAnimation(converter, src_file_name.ptr, &stream.animation_stream, flags.index)) {
                 return 1;
             }
+
+            stream.finish() catch |err| {
+                try stderr.print("failed to write animation: {s}\n", .{@errorName(err)});
+                return 1;
+            };
         },
         else => {
             try stderr.print("{s} conversion is not implemented yet!\n", .{std.meta.tagName(cli.verb.?)});
@@ -139,11 +232,421 @@ pub fn main() !u8 {
 
     if (!cli.options.@"test") {
         try std.fs.cwd().writeFile(dst_file.items, final_buffer.items);
+        if (atlas_buffer.items.len > 0) {
+            const atlas_file_name = try atlasFileName(allocator, dst_file.items);
+            defer allocator.free(atlas_file_name);
+            try std.fs.cwd().writeFile(atlas_file_name, atlas_buffer.items);
+        }
     }
 
     return 0;
 }
 
+/// The options of a model conversion in the form the converter expects them.
+const ModelSettings = struct {
+    flags: ModelArgs,
+    lod_ratios: std.ArrayList(f32),
+    options: api.ConvertOptions,
+
+    fn init(allocator: std.mem.Allocator, flags: ModelArgs) !ModelSettings {
+        var lod_ratios = std.ArrayList(f32).init(allocator);
+        errdefer lod_ratios.deinit();
+
+        if (flags.lod) |list| {
+            try parseLodRatios(list, &lod_ratios);
+        }
+
+        return ModelSettings{
+            .flags = flags,
+            .lod_ratios = lod_ratios,
+            .options = api.ConvertOptions{
+                .optimize = !flags.@"no-optimize",
+                .lod_count = lod_ratios.items.len,
+                .lod_ratios = lod_ratios.items.ptr,
+            },
+        };
+    }
+
+    fn deinit(self: *ModelSettings) void {
+        self.lod_ratios.deinit();
+        self.* = undefined;
+    }
+
+    /// Returns a hash of everything that changes the output for the same input file.
+    fn hash(self: ModelSettings) u64 {
+        var hasher = std.hash.Wyhash.init(0);
+        hasher.update(converter_revision);
+        hasher.update(&[_]u8{
+            @boolToInt(self.flags.dynamic),
+            @boolToInt(self.flags.@"no-optimize"),
+            @boolToInt(self.flags.quantize),
+        });
+        hasher.update(std.mem.sliceAsBytes(self.lod_ratios.items));
+        hasher.update(std.mem.asBytes(&(self.flags.atlas orelse 0)));
+        return hasher.final();
+    }
+};
+
+/// Change this whenever the output of the converter changes, so cached files are converted again.
+const converter_revision = "z3d-2";
+
+/// Converts `src_file_name` into `output`. When the settings request a texture atlas and
+/// meshes could be merged, the atlas image is written into `atlas_output`, which has to be
+/// stored as `atlasFileName(dst_file_name)`.
+fn convertModel(
+    allocator: std.mem.Allocator,
+    converter: *api.Converter,
+    src_file_name: [:0]const u8,
+    dst_file_name: []const u8,
+    settings: *const ModelSettings,
+    output: *std.ArrayList(u8),
+    atlas_output: *std.ArrayList(u8),
+) !void {
+    var stream = MeshStream{
+        .allocator = allocator,
+        .target_buffer = output,
+        .quantize = settings.flags.quantize,
+        .pending_vertices = std.ArrayList(z3d.static_model.Vertex).init(allocator),
+    };
+    defer stream.pending_vertices.deinit();
+
+    atlas_output.shrinkRetainingCapacity(0);
+
+    const atlas_file_name = try atlasFileName(allocator, dst_file_name);
+    defer allocator.free(atlas_file_name);
+
+    if (settings.flags.atlas) |max_size| {
+        stream.atlas_options = atlas.Options{
+            .max_size = max_size,
+            .texture_dir = std.fs.path.dirname(src_file_name) orelse ".",
+            // textures are referenced relative to the model
+            .atlas_name = std.fs.path.basename(atlas_file_name),
+        };
+        stream.atlas_output = atlas_output;
+    }
+
+    if (!api.convertFile(converter, src_file_name.ptr, &stream.mesh_stream, if (settings.flags.dynamic) api.dynamic_geometry else api.static_geometry, &settings.options)) {
+        return error.ConversionFailed;
+    }
+
+    try stream.finish();
+}
+
+/// Returns the file name of the texture atlas for the model `dst_file_name`.
+fn atlasFileName(allocator: std.mem.Allocator, dst_file_name: []const u8) ![]u8 {
+    const ext = std.fs.path.extension(dst_file_name);
+    return try std.mem.concat(allocator, u8, &[_][]const u8{ dst_file_name[0 .. dst_file_name.len - ext.len], ".atlas.png" });
+}
+
+/// Parses a comma separated list of strictly descending ratios in the range (0, 1).
+fn parseLodRatios(list: []const u8, ratios: *std.ArrayList(f32)) !void {
+    var iter = std.mem.split(u8, list, ",");
+    while (iter.next()) |item| {
+        const ratio = try std.fmt.parseFloat(f32, std.mem.trim(u8, item, " "));
+        if (!(ratio > 0.0 and ratio < 1.0))
+            return error.OutOfRange;
+        if (ratios.items.len > 0 and ratio >= ratios.items[ratios.items.len - 1])
+            return error.NotDescending;
+        try ratios.append(ratio);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Batch conversion
+
+const BatchJob = struct {
+    src_file_name: [:0]const u8,
+    dst_file_name: []const u8,
+
+    /// Hash of the file contents and the conversion settings.
+    hash: u64 = 0,
+    result: Result = .pending,
+    err: ?anyerror = null,
+
+    const Result = enum { pending, converted, skipped, failed };
+};
+
+const Batch = struct {
+    allocator: std.mem.Allocator,
+
+    settings: ModelSettings,
+    settings_hash: u64,
+    jobs: []BatchJob,
+    next_job: std.atomic.Atomic(usize) = std.atomic.Atomic(usize).init(0),
+
+    /// Hashes of the last run. Only read while the workers are running.
+    cache: std.StringHashMapUnmanaged(u64) = .{},
+    force: bool,
+    dry_run: bool,
+
+    fn worker(batch: *Batch) void {
+        const converter = api.createConverter() orelse {
+            // Leave the remaining jobs to the other workers.
+            std.log.err("failed to create a converter", .{});
+            return;
+        };
+        defer api.destroyConverter(converter);
+
+        var output = std.ArrayList(u8).init(batch.allocator);
+        defer output.deinit();
+
+        var atlas_output = std.ArrayList(u8).init(batch.allocator);
+        defer atlas_output.deinit();
+
+        while (true) {
+            const index = batch.next_job.fetchAdd(1, .Monotonic);
+            if (index >= batch.jobs.len)
+                break;
+            const job = &batch.jobs[index];
+
+            if (batch.process(converter, job, &output, &atlas_output)) |result| {
+                job.result = result;
+            } else |err| {
+                std.log.err("failed to convert {s}: {s}", .{ job.src_file_name, @errorName(err) });
+                job.result = .failed;
+                job.err = err;
+            }
+        }
+    }
+
+    fn process(batch: *Batch, converter: *api.Converter, job: *BatchJob, output: *std.ArrayList(u8), atlas_output: *std.ArrayList(u8)) !BatchJob.Result {
+        job.hash = try batch.hashFile(job.src_file_name);
+
+        if (!batch.force) {
+            if (batch.cache.get(job.src_file_name)) |cached_hash| {
+                if (cached_hash == job.hash and fileExists(job.dst_file_name))
+                    return .skipped;
+            }
+        }
+
+        output.shrinkRetainingCapacity(0);
+        try convertModel(batch.allocator, converter, job.src_file_name, job.dst_file_name, &batch.settings, output, atlas_output);
+
+        if (!batch.dry_run) {
+            if (std.fs.path.dirname(job.dst_file_name)) |dir| {
+                try std.fs.cwd().makePath(dir);
+            }
+            try std.fs.cwd().writeFile(job.dst_file_name, output.items);
+            if (atlas_output.items.len > 0) {
+                const atlas_file_name = try atlasFileName(batch.allocator, job.dst_file_name);
+                defer batch.allocator.free(atlas_file_name);
+                try std.fs.cwd().writeFile(atlas_file_name, atlas_output.items);
+            }
+        }
+        return .converted;
+    }
+
+    fn hashFile(batch: *Batch, file_name: []const u8) !u64 {
+        var file = try std.fs.cwd().openFile(file_name, .{});
+        defer file.close();
+
+        var hasher = std.hash.Wyhash.init(batch.settings_hash);
+        var buffer: [64 * 1024]u8 = undefined;
+        while (true) {
+            const len = try file.read(&buffer);
+            if (len == 0)
+                break;
+            hasher.update(buffer[0..len]);
+        }
+        return hasher.final();
+    }
+
+    fn fileExists(file_name: []const u8) bool {
+        std.fs.cwd().access(file_name, .{}) catch return false;
+        return true;
+    }
+};
+
+fn runBatch(allocator: std.mem.Allocator, flags: BatchArgs, cli: CliArgs, source: []const u8) !u8 {
+    const stdout = std.io.getStdOut().writer();
+    const stderr = std.io.getStdErr().writer();
+
+    var arena_instance = std.heap.ArenaAllocator.init(allocator);
+    defer arena_instance.deinit();
+    const arena = arena_instance.allocator();
+
+    var settings = ModelSettings.init(allocator, flags.modelArgs()) catch |err| {
+        try stderr.print("invalid lod ratios '{s}': {s}\n", .{ flags.lod.?, @errorName(err) });
+        return 1;
+    };
+    defer settings.deinit();
+
+    const scan_converter = api.createConverter() orelse return error.OutOfMemory;
+    defer api.destroyConverter(scan_converter);
+
+    var sources = std.ArrayList([:0]const u8).init(allocator);
+    defer sources.deinit();
+
+    // The source root is used to place the files in the output directory.
+    var root: []const u8 = undefined;
+
+    const source_stat = std.fs.cwd().statFile(source) catch |err| {
+        try stderr.print("could not open {s}: {s}\n", .{ source, @errorName(err) });
+        return 1;
+    };
+    if (source_stat.kind == .Directory) {
+        root = source;
+        try collectDirectory(arena, scan_converter, source, &sources);
+    } else {
+        root = std.fs.path.dirname(source) orelse ".";
+        try collectManifest(arena, source, root, &sources);
+    }
+
+    // Sort the files so the cache and the log output are stable between runs.
+    std.sort.sort([:0]const u8, sources.items, {}, struct {
+        fn lessThan(_: void, lhs: [:0]const u8, rhs: [:0]const u8) bool {
+            return std.mem.lessThan(u8, lhs, rhs);
+        }
+    }.lessThan);
+
+    const jobs = try allocator.alloc(BatchJob, sources.items.len);
+    defer allocator.free(jobs);
+
+    for (jobs) |*job, i| {
+        const src = sources.items[i];
+        const relative = try std.fs.path.relative(arena, root, src);
+        const dst_base = if (cli.output) |output_dir|
+            try std.fs.path.join(arena, &[_][]const u8{ output_dir, relative })
+        else
+            src;
+        const ext = std.fs.path.extension(dst_base);
+        job.* = BatchJob{
+            .src_file_name = src,
+            .dst_file_name = try std.mem.concat(arena, u8, &[_][]const u8{ dst_base[0 .. dst_base.len - ext.len], ".z3d" }),
+        };
+    }
+
+    const cache_file_name = flags.cache orelse try std.fs.path.join(arena, &[_][]const u8{ cli.output orelse root, ".zero-convert-cache" });
+
+    var batch = Batch{
+        .allocator = allocator,
+        .settings = settings,
+        .settings_hash = settings.hash(),
+        .jobs = jobs,
+        .force = flags.force,
+        .dry_run = cli.@"test",
+    };
+    try loadCache(arena, cache_file_name, &batch.cache);
+
+    const cpu_count = std.Thread.getCpuCount() catch 1;
+    const worker_count = std.math.max(1, std.math.min(flags.jobs orelse @intCast(u32, cpu_count), jobs.len));
+
+    var timer = try std.time.Timer.start();
+
+    const workers = try allocator.alloc(std.Thread, worker_count - 1);
+    defer allocator.free(workers);
+
+    var spawned: usize = 0;
+    for (workers) |*thread| {
+        thread.* = std.Thread.spawn(.{}, Batch.worker, .{&batch}) catch break;
+        spawned += 1;
+    }
+    // The main thread works as well, which also guarantees progress if no thread could be spawned.
+    Batch.worker(&batch);
+    for (workers[0..spawned]) |thread| {
+        thread.join();
+    }
+
+    var converted: usize = 0;
+    var skipped: usize = 0;
+    var failed: usize = 0;
+    for (jobs) |job| {
+        switch (job.result) {
+            .converted => converted += 1,
+            .skipped => skipped += 1,
+            // jobs are only left pending when no converter could be created
+            .failed, .pending => failed += 1,
+        }
+    }
+
+    if (!batch.dry_run) {
+        saveCache(cache_file_name, jobs) catch |err| {
+            try stderr.print("failed to write cache {s}: {s}\n", .{ cache_file_name, @errorName(err) });
+        };
+    }
+
+    try stdout.print("{} files: {} converted, {} skipped, {} failed ({d:.1} s, {} workers)\n", .{
+        jobs.len,
+        converted,
+        skipped,
+        failed,
+        @intToFloat(f64, timer.read()) / std.time.ns_per_s,
+        spawned + 1,
+    });
+    for (jobs) |job| {
+        if (job.result == .failed or job.result == .pending) {
+            try stdout.print("  failed: {s} ({s})\n", .{ job.src_file_name, if (job.err) |err| @errorName(err) else "not processed" });
+        }
+    }
+
+    return if (failed > 0) 1 else 0;
+}
+
+/// Collects all files in `dir_name` and its subdirectories that assimp can import.
+fn collectDirectory(arena: std.mem.Allocator, converter: *api.Converter, dir_name: []const u8, sources: *std.ArrayList([:0]const u8)) !void {
+    var dir = try std.fs.cwd().openIterableDir(dir_name, .{});
+    defer dir.close();
+
+    var walker = try dir.walk(arena);
+    defer walker.deinit();
+
+    while (try walker.next()) |entry| {
+        if (entry.kind != .File)
+            continue;
+        const path = try std.fs.path.joinZ(arena, &[_][]const u8{ dir_name, entry.path });
+        if (api.isSupportedFile(converter, path.ptr)) {
+            try sources.append(path);
+        }
+    }
+}
+
+/// Reads a manifest with one file name per line. Empty lines and lines starting with # are ignored.
+fn collectManifest(arena: std.mem.Allocator, manifest_file_name: []const u8, root: []const u8, sources: *std.ArrayList([:0]const u8)) !void {
+    const manifest = try std.fs.cwd().readFileAlloc(arena, manifest_file_name, 1 << 24);
+
+    var lines = std.mem.tokenize(u8, manifest, "\r\n");
+    while (lines.next()) |raw_line| {
+        const line = std.mem.trim(u8, raw_line, " \t");
+        if (line.len == 0 or line[0] == '#')
+            continue;
+        try sources.append(try std.fs.path.joinZ(arena, &[_][]const u8{ root, line }));
+    }
+}
+
+/// Loads the cache written by `saveCache`. Each line is `<hash> <file name>`.
+fn loadCache(arena: std.mem.Allocator, cache_file_name: []const u8, cache: *std.StringHashMapUnmanaged(u64)) !void {
+    const data = std.fs.cwd().readFileAlloc(arena, cache_file_name, 1 << 26) catch |err| switch (err) {
+        error.FileNotFound => return,
+        else => |e| return e,
+    };
+
+    var lines = std.mem.tokenize(u8, data, "\n");
+    while (lines.next()) |line| {
+        const split = std.mem.indexOfScalar(u8, line, ' ') orelse continue;
+        const hash = std.fmt.parseInt(u64, line[0..split], 16) catch continue;
+        try cache.put(arena, line[split + 1 ..], hash);
+    }
+}
+
+fn saveCache(cache_file_name: []const u8, jobs: []const BatchJob) !void {
+    if (std.fs.path.dirname(cache_file_name)) |dir| {
+        try std.fs.cwd().makePath(dir);
+    }
+
+    var file = try std.fs.cwd().createFile(cache_file_name, .{});
+    defer file.close();
+
+    var buffered = std.io.bufferedWriter(file.writer());
+    const writer = buffered.writer();
+    for (jobs) |job| {
+        // Failed files are not stored, so they are tried again.
+        if (job.result == .converted or job.result == .skipped) {
+            try writer.print("{x:0>16} {s}\n", .{ job.hash, job.src_file_name });
+        }
+    }
+    try buffered.flush();
+}
+
 export fn printErrorMessage(text: [*]const u8, length: usize) void {
     std.log.err("{s}", .{text[0..length]});
 }
@@ -162,40 +665,94 @@ const MeshStream = struct {
         .writeVertex = writeVertex,
         .writeFace = writeFace,
         .writeMeshRange = writeMeshRange,
+        .writeLodHeader = writeLodHeader,
+        .writeLodLevel = writeLodLevel,
+        .writeLodRange = writeLodRange,
+        .writeDynamicHeader = writeDynamicHeader,
+        .writeDynamicVertex = writeDynamicVertex,
+        .writeBone = writeBone,
     },
 
+    allocator: std.mem.Allocator,
     failed: ?anyerror = null,
     target_buffer: *std.ArrayList(u8),
 
+    /// When set, `finish` packs the textures into an atlas, which is written into `atlas_output`.
+    atlas_options: ?atlas.Options = null,
+    atlas_output: ?*std.ArrayList(u8) = null,
+
+    /// When set, the vertices are collected in `pending_vertices` and written
+    /// quantized by `finish`, as the bounds are only known after the last vertex.
+    quantize: bool,
+    pending_vertices: std.ArrayList(z3d.static_model.Vertex),
+
+    /// Set by `writeDynamicHeader`.
+    dynamic: bool = false,
+
     vertex_count: usize = 0,
     index_count: usize = 0,
     mesh_count: usize = 0,
+    bone_count: usize = 0,
 
     vertex_offset: usize = 0,
     index_offset: usize = 0,
     mesh_offset: usize = 0,
+    bone_offset: usize = 0,
+
+    lod_count: usize = 0,
+    lod_level_offset: usize = 0,
+    lod_range_offset: usize = 0,
 
     fn setError(self: *MeshStream, err: anyerror) void {
         self.failed = err;
     }
 
     fn vertexOffset(self: MeshStream) usize {
-        _ = self;
-        return 24;
+        return if (self.dynamic)
+            @sizeOf(z3d.dynamic_model.Header)
+        else if (self.quantize)
+            @sizeOf(z3d.quantized_static_model.Header)
+        else
+            @sizeOf(z3d.static_model.Header);
+    }
+
+    fn vertexSize(self: MeshStream) usize {
+        return if (self.dynamic)
+            @sizeOf(z3d.dynamic_model.Vertex)
+        else if (self.quantize)
+            @sizeOf(z3d.quantized_static_model.Vertex)
+        else
+            @sizeOf(z3d.static_model.Vertex);
     }
 
     fn indexOffset(self: MeshStream) usize {
-        return self.vertexOffset() + 32 * self.vertex_count;
+        return self.vertexOffset() + self.vertexSize() * self.vertex_count;
     }
 
     fn meshOffset(self: MeshStream) usize {
         return self.indexOffset() + 2 * self.index_count;
     }
 
-    fn fileSize(self: MeshStream) usize {
+    fn boneOffset(self: MeshStream) usize {
         return self.meshOffset() + 128 * self.mesh_count;
     }
 
+    fn fileSize(self: MeshStream) usize {
+        return self.boneOffset() + @sizeOf(z3d.dynamic_model.Bone) * self.bone_count;
+    }
+
+    fn lodOffset(self: MeshStream) usize {
+        return self.fileSize();
+    }
+
+    fn lodLevelOffset(self: MeshStream) usize {
+        return self.lodOffset() + @sizeOf(z3d.lod_table.Header);
+    }
+
+    fn lodRangeOffset(self: MeshStream) usize {
+        return self.lodLevelOffset() + @sizeOf(z3d.lod_table.Level) * self.lod_count;
+    }
+
     fn writeStaticHeader(mesh_stream: ?*api.MeshStream, vertices: usize, indices: usize, ranges: usize) callconv(.C) void {
         const stream = @fieldParentPtr(MeshStream, "mesh_stream", mesh_stream.?);
         if (stream.failed != null)
@@ -224,6 +781,10 @@ const MeshStream = struct {
             .index_count = std.mem.nativeToLittle(u32, std.math.cast(u32, indices) orelse return stream.setError(error.Overflow)),
             .mesh_count = std.mem.nativeToLittle(u32, std.math.cast(u32, ranges) orelse return stream.setError(error.Overflow)),
         };
+        if (stream.quantize) {
+            header.common.version = std.mem.nativeToLittle(u16, z3d.quantized_static_model.version);
+            stream.pending_vertices.ensureTotalCapacity(vertices) catch |err| return stream.setError(err);
+        }
 
         //std.log.info("vertices: {},\tindices: {},\ttextures: {}", .{ vertices, indices, ranges });
     }
@@ -233,8 +794,7 @@ const MeshStream = struct {
         if (stream.failed != null)
             return;
 
-        const vertices = @ptrCast([*]align(1) z3d.static_model.Vertex, &stream.target_buffer.items[stream.vertexOffset()]);
-        vertices[stream.vertex_offset] = z3d.static_model.Vertex{
+        const vertex = z3d.static_model.Vertex{
             .x = x,
             .y = y,
             .z = z,
@@ -244,6 +804,13 @@ const MeshStream = struct {
             .u = u,
             .v = v,
         };
+
+        if (stream.quantize) {
+            stream.pending_vertices.append(vertex) catch |err| return stream.setError(err);
+        } else {
+            const vertices = @ptrCast([*]align(1) z3d.static_model.Vertex, &stream.target_buffer.items[stream.vertexOffset()]);
+            vertices[stream.vertex_offset] = vertex;
+        }
         stream.vertex_offset += 1;
 
         // std.log.info("({d:.3} {d:.3} {d:.3}) ({d:.3} {d:.3} {d:.3}) ({d:.4} {d:.4})", .{ x, y, z, nx, ny, nz, u, v });
@@ -290,4 +857,498 @@ const MeshStream = struct {
 
         // std.log.info("[{} {} \"{s}\"]", .{ offset, count, std.mem.sliceTo(texture.?, 0) });
     }
+
+    fn writeLodHeader(mesh_stream: ?*api.MeshStream, levels: usize) callconv(.C) void {
+        const stream = @fieldParentPtr(MeshStream, "mesh_stream", mesh_stream.?);
+        if (stream.failed != null)
+            return;
+
+        stream.lod_count = levels;
+        stream.lod_level_offset = 0;
+        stream.lod_range_offset = 0;
+
+        const table_size = z3d.lod_table.size(levels, stream.mesh_count);
+        stream.target_buffer.resize(stream.lodOffset() + table_size) catch |err| return stream.setError(err);
+        std.mem.set(u8, stream.target_buffer.items[stream.lodOffset()..], 0x55); // set to "undefined"
+
+        const header = @ptrCast(*align(1) z3d.lod_table.Header, &stream.target_buffer.items[stream.lodOffset()]);
+        header.* = z3d.lod_table.Header{
+            .level_count = std.mem.nativeToLittle(u32, std.math.cast(u32, levels) orelse return stream.setError(error.Overflow)),
+        };
+    }
+
+    fn writeLodLevel(mesh_stream: ?*api.MeshStream, level: usize, max_error: f32) callconv(.C) void {
+        const stream = @fieldParentPtr(MeshStream, "mesh_stream", mesh_stream.?);
+        if (stream.failed != null)
+            return;
+        if (level >= stream.lod_count)
+            return stream.setError(error.InvalidLevel);
+
+        const levels = @ptrCast([*]align(1) z3d.lod_table.Level, &stream.target_buffer.items[stream.lodLevelOffset()]);
+        levels[level] = z3d.lod_table.Level{
+            .max_error = max_error,
+        };
+        stream.lod_level_offset += 1;
+    }
+
+    fn writeLodRange(mesh_stream: ?*api.MeshStream, level: usize, mesh: usize, offset: usize, length: usize) callconv(.C) void {
+        const stream = @fieldParentPtr(MeshStream, "mesh_stream", mesh_stream.?);
+        if (stream.failed != null)
+            return;
+        if (level >= stream.lod_count)
+            return stream.setError(error.InvalidLevel);
+        if (mesh >= stream.mesh_count)
+            return stream.setError(error.InvalidMesh);
+        if (offset + length > stream.index_count)
+            return stream.setError(error.InvalidRange);
+
+        const ranges = @ptrCast([*]align(1) z3d.lod_table.Range, &stream.target_buffer.items[stream.lodRangeOffset()]);
+        ranges[level * stream.mesh_count + mesh] = z3d.lod_table.Range{
+            .offset = std.mem.nativeToLittle(u32, std.math.cast(u32, offset) orelse return stream.setError(error.Overflow)),
+            .length = std.mem.nativeToLittle(u32, std.math.cast(u32, length) orelse return stream.setError(error.Overflow)),
+        };
+        stream.lod_range_offset += 1;
+    }
+
+    fn writeDynamicHeader(mesh_stream: ?*api.MeshStream, vertices: usize, indices: usize, ranges: usize, bones: usize) callconv(.C) void {
+        const stream = @fieldParentPtr(MeshStream, "mesh_stream", mesh_stream.?);
+        if (stream.failed != null)
+            return;
+
+        if (stream.quantize) return stream.setError(error.QuantizedDynamicModel);
+        if (vertices == 0) return stream.setError(error.NoVertices);
+        if (indices == 0) return stream.setError(error.NoFaces);
+        if (ranges == 0) return stream.setError(error.NoMeshes);
+        if (bones == 0) return stream.setError(error.NoBones);
+        if (bones > z3d.dynamic_model.max_bones) return stream.setError(error.TooManyBones);
+
+        stream.dynamic = true;
+
+        stream.vertex_count = vertices;
+        stream.index_count = indices;
+        stream.mesh_count = ranges;
+        stream.bone_count = bones;
+
+        stream.vertex_offset = 0;
+        stream.index_offset = 0;
+        stream.mesh_offset = 0;
+        stream.bone_offset = 0;
+
+        stream.target_buffer.resize(stream.fileSize()) catch |err| return stream.setError(err);
+
+        std.mem.set(u8, stream.target_buffer.items, 0x55); // set to "undefined"
+
+        const header = @ptrCast(*align(1) z3d.dynamic_model.Header, &stream.target_buffer.items[0]);
+        header.* = z3d.dynamic_model.Header{
+            .common = z3d.CommonHeader{ .type = .dynamic },
+            .vertex_count = std.mem.nativeToLittle(u32, std.math.cast(u32, vertices) orelse return stream.setError(error.Overflow)),
+            .index_count = std.mem.nativeToLittle(u32, std.math.cast(u32, indices) orelse return stream.setError(error.Overflow)),
+            .mesh_count = std.mem.nativeToLittle(u32, std.math.cast(u32, ranges) orelse return stream.setError(error.Overflow)),
+            .bone_count = std.mem.nativeToLittle(u32, @intCast(u32, bones)),
+        };
+    }
+
+    fn writeDynamicVertex(mesh_stream: ?*api.MeshStream, x: f32, y: f32, z: f32, nx: f32, ny: f32, nz: f32, u: f32, v: f32, bone_indices: [*c]const u8, bone_weights: [*c]const u8) callconv(.C) void {
+        const stream = @fieldParentPtr(MeshStream, "mesh_stream", mesh_stream.?);
+        if (stream.failed != null)
+            return;
+        if (!stream.dynamic)
+            return stream.setError(error.NotDynamic);
+
+        var vertex = z3d.dynamic_model.Vertex{
+            .x = x,
+            .y = y,
+            .z = z,
+            .nx = nx,
+            .ny = ny,
+            .nz = nz,
+            .u = u,
+            .v = v,
+            .bone_indices = undefined,
+            .bone_weights = undefined,
+        };
+        for (vertex.bone_indices) |*index, i| {
+            if (bone_indices[i] >= stream.bone_count)
+                return stream.setError(error.InvalidBone);
+            index.* = bone_indices[i];
+            vertex.bone_weights[i] = bone_weights[i];
+        }
+
+        const vertices = @ptrCast([*]align(1) z3d.dynamic_model.Vertex, &stream.target_buffer.items[stream.vertexOffset()]);
+        vertices[stream.vertex_offset] = vertex;
+        stream.vertex_offset += 1;
+    }
+
+    fn writeBone(mesh_stream: ?*api.MeshStream, name: ?[*:0]const u8, parent: usize, inverse_bind_matrix: [*c]const f32, local_transform: [*c]const f32) callconv(.C) void {
+        const stream = @fieldParentPtr(MeshStream, "mesh_stream", mesh_stream.?);
+        if (stream.failed != null)
+            return;
+        if (!stream.dynamic)
+            return stream.setError(error.NotDynamic);
+
+        const bone_name = std.mem.sliceTo(name.?, 0);
+        if (bone_name.len > 60)
+            return stream.setError(error.BoneNameTooLong);
+        if (parent != z3d.dynamic_model.no_parent and parent >= stream.bone_offset)
+            return stream.setError(error.InvalidBone);
+
+        const bones = @ptrCast([*]align(1) z3d.dynamic_model.Bone, &stream.target_buffer.items[stream.boneOffset()]);
+        const bone = &bones[stream.bone_offset];
+        bone.* = z3d.dynamic_model.Bone{
+            .name = [1]u8{0} ** 60,
+            .parent = std.mem.nativeToLittle(u32, @intCast(u32, parent)),
+            .inverse_bind_matrix = @ptrCast(*align(1) const [4][4]f32, inverse_bind_matrix).*,
+            .local_transform = @ptrCast(*align(1) const [4][4]f32, local_transform).*,
+        };
+        std.mem.copy(u8, &bone.name, bone_name);
+
+        stream.bone_offset += 1;
+    }
+
+    /// Finalizes the file after the converter has written all data.
+    fn finish(stream: *MeshStream) !void {
+        if (stream.failed) |err|
+            return err;
+
+        if (stream.vertex_offset != stream.vertex_count) return error.MissingVertices;
+        if (stream.index_offset != stream.index_count) return error.MissingIndices;
+        if (stream.mesh_offset != stream.mesh_count) return error.MissingMeshes;
+        if (stream.bone_offset != stream.bone_count) return error.MissingBones;
+        if (stream.lod_level_offset != stream.lod_count) return error.MissingLodLevels;
+        if (stream.lod_range_offset != stream.lod_count * stream.mesh_count) return error.MissingLodRanges;
+
+        if (stream.atlas_options) |options| {
+            try stream.buildAtlas(options, stream.atlas_output.?);
+        }
+
+        if (stream.quantize) {
+            const model = z3d.quantized_static_model;
+
+            const bounds = model.Bounds.compute(stream.pending_vertices.items);
+
+            const header = @ptrCast(*align(1) model.Header, &stream.target_buffer.items[0]);
+            header.position_min = bounds.position_min;
+            header.position_max = bounds.position_max;
+            header.uv_min = bounds.uv_min;
+            header.uv_max = bounds.uv_max;
+
+            const vertices = @ptrCast([*]align(1) model.Vertex, &stream.target_buffer.items[stream.vertexOffset()]);
+            for (stream.pending_vertices.items) |src, i| {
+                vertices[i] = model.encodeVertex(bounds, src);
+            }
+        }
+
+        try stream.writeBounds();
+    }
+
+    fn buildAtlas(stream: *MeshStream, options: atlas.Options, image_output: *std.ArrayList(u8)) !void {
+        const allocator = stream.allocator;
+        const data = stream.target_buffer.items;
+
+        const uvs = try allocator.alloc([2]f32, stream.vertex_count);
+        defer allocator.free(uvs);
+        for (uvs) |*uv, i| {
+            uv.* = stream.uvPointer(i).*;
+        }
+
+        // copy the indices, as they are not aligned in the file buffer
+        const indices = try allocator.alloc(u16, stream.index_count);
+        defer allocator.free(indices);
+        for (indices) |*index, i| {
+            index.* = std.mem.littleToNative(u16, @ptrCast([*]align(1) const z3d.static_model.Index, &data[stream.indexOffset()])[i]);
+        }
+
+        const src_meshes = @ptrCast([*]align(1) const z3d.static_model.Mesh, &data[stream.meshOffset()])[0..stream.mesh_count];
+        const meshes = try allocator.alloc(atlas.Mesh, stream.mesh_count);
+        defer allocator.free(meshes);
+        for (meshes) |*mesh, i| {
+            const texture_file = std.mem.sliceTo(&src_meshes[i].texture_file, 0);
+            mesh.* = atlas.Mesh{
+                .offset = std.mem.littleToNative(u32, src_meshes[i].offset),
+                .length = std.mem.littleToNative(u32, src_meshes[i].length),
+                .texture = if (texture_file.len > 0) texture_file else null,
+            };
+        }
+
+        const lod_ranges = try allocator.alloc(atlas.Range, stream.lod_count * stream.mesh_count);
+        defer allocator.free(lod_ranges);
+        if (stream.lod_count > 0) {
+            const src_ranges = @ptrCast([*]align(1) const z3d.lod_table.Range, &data[stream.lodRangeOffset()]);
+            for (lod_ranges) |*range, i| {
+                range.* = atlas.Range{
+                    .offset = std.mem.littleToNative(u32, src_ranges[i].offset),
+                    .length = std.mem.littleToNative(u32, src_ranges[i].length),
+                };
+            }
+        }
+
+        var result = (try atlas.build(allocator, atlas.Model{
+            .uvs = uvs,
+            .indices = indices,
+            .meshes = meshes,
+            .lod_ranges = lod_ranges,
+        }, options)) orelse return;
+        defer result.deinit();
+
+        std.log.info("merged {} meshes with {} textures into a {}x{} atlas", .{
+            result.merged_meshes,
+            result.texture_count,
+            result.image.width,
+            result.image.height,
+        });
+
+        try atlas.writePng(allocator, image_output.writer(), result.image);
+
+        for (uvs) |uv, i| {
+            stream.uvPointer(i).* = uv;
+        }
+        try stream.replaceMeshes(result.indices, result.meshes, result.lod_ranges);
+    }
+
+    fn uvPointer(stream: *MeshStream, i: usize) *align(1) [2]f32 {
+        if (stream.quantize)
+            return @ptrCast(*align(1) [2]f32, &stream.pending_vertices.items[i].u);
+        const uv_offset: usize = if (stream.dynamic) @offsetOf(z3d.dynamic_model.Vertex, "u") else @offsetOf(z3d.static_model.Vertex, "u");
+        return @ptrCast(*align(1) [2]f32, &stream.target_buffer.items[stream.vertexOffset() + stream.vertexSize() * i + uv_offset]);
+    }
+
+    /// Replaces the index list, the mesh list and the level of detail ranges. The
+    /// sections behind the index list are moved to their new offsets.
+    fn replaceMeshes(stream: *MeshStream, indices: []const u16, meshes: []const atlas.Mesh, lod_ranges: []const atlas.Range) !void {
+        const allocator = stream.allocator;
+
+        const bones = try allocator.dupe(u8, stream.target_buffer.items[stream.boneOffset()..stream.fileSize()]);
+        defer allocator.free(bones);
+        const levels = try allocator.dupe(u8, if (stream.lod_count > 0) stream.target_buffer.items[stream.lodLevelOffset()..stream.lodRangeOffset()] else "");
+        defer allocator.free(levels);
+
+        stream.index_count = indices.len;
+        stream.mesh_count = meshes.len;
+        stream.index_offset = indices.len;
+        stream.mesh_offset = meshes.len;
+        stream.lod_range_offset = lod_ranges.len;
+
+        const table_size = if (stream.lod_count > 0) z3d.lod_table.size(stream.lod_count, stream.mesh_count) else 0;
+        try stream.target_buffer.resize(stream.fileSize() + table_size);
+        const data = stream.target_buffer.items;
+
+        // all header variants store the counts at the same offsets
+        const header = @ptrCast(*align(1) z3d.static_model.Header, &data[0]);
+        header.index_count = std.mem.nativeToLittle(u32, std.math.cast(u32, indices.len) orelse return error.Overflow);
+        header.mesh_count = std.mem.nativeToLittle(u32, @intCast(u32, meshes.len));
+
+        const dst_indices = @ptrCast([*]align(1) z3d.static_model.Index, &data[stream.indexOffset()]);
+        for (indices) |index, i| {
+            dst_indices[i] = std.mem.nativeToLittle(u16, index);
+        }
+
+        const dst_meshes = @ptrCast([*]align(1) z3d.static_model.Mesh, &data[stream.meshOffset()]);
+        for (meshes) |mesh, i| {
+            const texture_file = mesh.texture orelse "";
+            if (texture_file.len > 120)
+                return error.FileNameTooLong;
+            dst_meshes[i] = z3d.static_model.Mesh{
+                .offset = std.mem.nativeToLittle(u32, @intCast(u32, mesh.offset)),
+                .length = std.mem.nativeToLittle(u32, @intCast(u32, mesh.length)),
+                .texture_file = [1]u8{0} ** 120,
+            };
+            std.mem.copy(u8, &dst_meshes[i].texture_file, texture_file);
+        }
+
+        std.mem.copy(u8, data[stream.boneOffset()..stream.fileSize()], bones);
+
+        if (stream.lod_count > 0) {
+            const lod_header = @ptrCast(*align(1) z3d.lod_table.Header, &data[stream.lodOffset()]);
+            lod_header.* = z3d.lod_table.Header{
+                .level_count = std.mem.nativeToLittle(u32, @intCast(u32, stream.lod_count)),
+            };
+            std.mem.copy(u8, data[stream.lodLevelOffset()..stream.lodRangeOffset()], levels);
+
+            const dst_ranges = @ptrCast([*]align(1) z3d.lod_table.Range, &data[stream.lodRangeOffset()]);
+            for (lod_ranges) |range, i| {
+                dst_ranges[i] = z3d.lod_table.Range{
+                    .offset = std.mem.nativeToLittle(u32, @intCast(u32, range.offset)),
+                    .length = std.mem.nativeToLittle(u32, @intCast(u32, range.length)),
+                };
+            }
+        }
+    }
+
+    /// Appends the bounds table, which is computed from the final vertex data so
+    /// it also encloses the quantized positions.
+    fn writeBounds(stream: *MeshStream) !void {
+        const table = z3d.bounds_table;
+
+        const table_offset = stream.target_buffer.items.len;
+        try stream.target_buffer.resize(table_offset + table.size(stream.mesh_count));
+
+        const header = @ptrCast(*align(1) table.Header, &stream.target_buffer.items[table_offset]);
+        header.* = table.Header{
+            .mesh_count = std.mem.nativeToLittle(u32, @intCast(u32, stream.mesh_count)),
+        };
+
+        const data = stream.target_buffer.items;
+        const positions = VertexPositions{
+            .stream = stream.*,
+            .data = data,
+            .indices = null,
+        };
+        const bounds = @ptrCast([*]align(1) table.Bounds, &data[table_offset + @sizeOf(table.Header)]);
+        bounds[0] = table.Bounds.compute(positions, stream.vertex_count);
+
+        const indices = @ptrCast([*]align(1) const z3d.static_model.Index, &data[stream.indexOffset()])[0..stream.index_count];
+        const meshes = @ptrCast([*]align(1) const z3d.static_model.Mesh, &data[stream.meshOffset()])[0..stream.mesh_count];
+        for (meshes) |mesh, i| {
+            const offset = std.mem.littleToNative(u32, mesh.offset);
+            const length = std.mem.littleToNative(u32, mesh.length);
+            if (@as(usize, offset) + length > stream.index_count)
+                return error.InvalidRange;
+            var mesh_positions = positions;
+            mesh_positions.indices = indices[offset..][0..length];
+            bounds[1 + i] = table.Bounds.compute(mesh_positions, length);
+        }
+    }
+
+    /// Reads the vertex positions back from the written file.
+    const VertexPositions = struct {
+        stream: MeshStream,
+        data: []const u8,
+        indices: ?[]align(1) const z3d.static_model.Index,
+
+        pub fn position(self: VertexPositions, i: usize) [3]f32 {
+            const index = if (self.indices) |indices| indices[i] else i;
+            const offset = self.stream.vertexOffset() + self.stream.vertexSize() * index;
+            if (self.stream.dynamic) {
+                const vertex = @ptrCast(*align(1) const z3d.dynamic_model.Vertex, &self.data[offset]);
+                return .{ vertex.x, vertex.y, vertex.z };
+            } else if (self.stream.quantize) {
+                const model = z3d.quantized_static_model;
+                const header = @ptrCast(*align(1) const model.Header, &self.data[0]);
+                const vertex = model.decodeVertex(.{
+                    .position_min = header.position_min,
+                    .position_max = header.position_max,
+                    .uv_min = header.uv_min,
+                    .uv_max = header.uv_max,
+                }, @ptrCast(*align(1) const model.Vertex, &self.data[offset]).*);
+                return .{ vertex.x, vertex.y, vertex.z };
+            } else {
+                const vertex = @ptrCast(*align(1) const z3d.static_model.Vertex, &self.data[offset]);
+                return .{ vertex.x, vertex.y, vertex.z };
+            }
+        }
+    };
+};
+
+const AnimationStream = struct {
+    animation_stream: api.AnimationStream = .{
+        .writeAnimationHeader = writeAnimationHeader,
+        .writeChannel = writeChannel,
+        .writePositionKey = writePositionKey,
+        .writeRotationKey = writeRotationKey,
+        .writeScaleKey = writeScaleKey,
+    },
+
+    failed: ?anyerror = null,
+    target_buffer: *std.ArrayList(u8),
+
+    channel_count: usize = 0,
+    channel_offset: usize = 0,
+
+    /// Keys that are still expected for the current channel.
+    pending_positions: usize = 0,
+    pending_rotations: usize = 0,
+    pending_scales: usize = 0,
+
+    fn setError(self: *AnimationStream, err: anyerror) void {
+        self.failed = err;
+    }
+
+    fn append(stream: *AnimationStream, value: anytype) void {
+        stream.target_buffer.appendSlice(std.mem.asBytes(&value)) catch |err| return stream.setError(err);
+    }
+
+    fn writeAnimationHeader(animation_stream: ?*api.AnimationStream, duration: f32, channels: usize) callconv(.C) void {
+        const stream = @fieldParentPtr(AnimationStream, "animation_stream", animation_stream.?);
+        if (stream.failed != null)
+            return;
+
+        stream.channel_count = channels;
+        stream.target_buffer.shrinkRetainingCapacity(0);
+        stream.append(zani.Header{
+            .duration = duration,
+            .channel_count = std.mem.nativeToLittle(u32, std.math.cast(u32, channels) orelse return stream.setError(error.Overflow)),
+        });
+    }
+
+    fn writeChannel(animation_stream: ?*api.AnimationStream, bone_name: ?[*:0]const u8, positions: usize, rotations: usize, scales: usize) callconv(.C) void {
+        const stream = @fieldParentPtr(AnimationStream, "animation_stream", animation_stream.?);
+        if (stream.failed != null)
+            return;
+
+        if (stream.pending_positions != 0 or stream.pending_rotations != 0 or stream.pending_scales != 0)
+            return stream.setError(error.MissingKeys);
+        if (stream.channel_offset >= stream.channel_count)
+            return stream.setError(error.TooManyChannels);
+
+        const name = std.mem.sliceTo(bone_name.?, 0);
+        var channel = zani.Channel{
+            .bone_name = [1]u8{0} ** 52,
+            .position_count = std.mem.nativeToLittle(u32, std.math.cast(u32, positions) orelse return stream.setError(error.Overflow)),
+            .rotation_count = std.mem.nativeToLittle(u32, std.math.cast(u32, rotations) orelse return stream.setError(error.Overflow)),
+            .scale_count = std.mem.nativeToLittle(u32, std.math.cast(u32, scales) orelse return stream.setError(error.Overflow)),
+        };
+        if (name.len > channel.bone_name.len)
+            return stream.setError(error.BoneNameTooLong);
+        std.mem.copy(u8, &channel.bone_name, name);
+
+        stream.append(channel);
+        stream.channel_offset += 1;
+        stream.pending_positions = positions;
+        stream.pending_rotations = rotations;
+        stream.pending_scales = scales;
+    }
+
+    fn writePositionKey(animation_stream: ?*api.AnimationStream, time: f32, x: f32, y: f32, z: f32) callconv(.C) void {
+        const stream = @fieldParentPtr(AnimationStream, "animation_stream", animation_stream.?);
+        if (stream.failed != null)
+            return;
+        if (stream.pending_positions == 0)
+            return stream.setError(error.TooManyKeys);
+
+        stream.append(zani.VectorKey{ .time = time, .value = .{ x, y, z } });
+        stream.pending_positions -= 1;
+    }
+
+    fn writeRotationKey(animation_stream: ?*api.AnimationStream, time: f32, x: f32, y: f32, z: f32, w: f32) callconv(.C) void {
+        const stream = @fieldParentPtr(AnimationStream, "animation_stream", animation_stream.?);
+        if (stream.failed != null)
+            return;
+        // keys are stored in the order positions, rotations, scales
+        if (stream.pending_positions != 0 or stream.pending_rotations == 0)
+            return stream.setError(error.InvalidKeyOrder);
+
+        stream.append(zani.QuaternionKey{ .time = time, .value = .{ x, y, z, w } });
+        stream.pending_rotations -= 1;
+    }
+
+    fn writeScaleKey(animation_stream: ?*api.AnimationStream, time: f32, x: f32, y: f32, z: f32) callconv(.C) void {
+        const stream = @fieldParentPtr(AnimationStream, "animation_stream", animation_stream.?);
+        if (stream.failed != null)
+            return;
+        if (stream.pending_positions != 0 or stream.pending_rotations != 0 or stream.pending_scales == 0)
+            return stream.setError(error.InvalidKeyOrder);
+
+        stream.append(zani.VectorKey{ .time = time, .value = .{ x, y, z } });
+        stream.pending_scales -= 1;
+    }
+
+    /// Checks that the converter has written all data.
+    fn finish(stream: *AnimationStream) !void {
+        if (stream.failed) |err|
+            return err;
+
+        if (stream.channel_offset != stream.channel_count) return error.MissingChannels;
+        if (stream.pending_positions != 0 or stream.pending_rotations != 0 or stream.pending_scales != 0)
+            return error.MissingKeys;
+    }
 };
@@ -663,6 +663,10 @@ createWebGlModule(canvas_element, getInstance, stop_fn) {
         drawElements(mode, count, type, offset) {
       gl.drawElements(mode, count, type, offset)
     }
+    ,
+        drawElementsInstanced(mode, count, type, offset, instance_count) {
+      gl.drawElementsInstanced(mode, count, type, offset, instance_count)
+    }
     ,
         enable(x) {
       gl.enable(x)
@@ -853,6 +857,10 @@ createWebGlModule(canvas_element, getInstance, stop_fn) {
           offset,
       )
     }
+    ,
+        vertexAttribDivisor(index, divisor) {
+      gl.vertexAttribDivisor(index, divisor)
+    }
     ,
         viewport(x, y, width, height) {
       gl.viewport(x, y, width, height)